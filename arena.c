@@ -0,0 +1,448 @@
+/*
+ *  arena.c: The i/o buffers of a wipe.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+/* RATIONALE:
+ *
+ *   Every pass used to malloc() one or two buffers of several megabytes and
+ *   free them at its end, and the error paths returned without the free, so
+ *   that a long method leaked a little more with every failure and churned
+ *   the allocator for every pass of every round.
+ *
+ *   Now each child keeps one arena: a buffer per use, allocated once on
+ *   page boundaries from the block size that the geometry chose, grown in
+ *   the rare case that a pass asks for more, and released when the child
+ *   exits.  The passes only borrow from it, so they have nothing to free.
+ *   With --mlock the buffers are locked in memory, so that a station under
+ *   memory pressure does not swap the data that it is about to write.
+ *
+ *   The arena is private to the child, like the descriptors of badsector.c,
+ *   and only its high water mark is published in the context for the
+ *   result file.
+ *
+ *   The PRNG fill and the memcmp() of a verification walk a whole block of
+ *   4 KiB pages per request, and with dozens of children the TLB misses
+ *   show up in every profile.  So the buffers are mapped from the huge page
+ *   pool when it has pages to give, else on 2 MiB boundaries with
+ *   MADV_HUGEPAGE so that transparent huge pages can back them, else from
+ *   ordinary pages.  The buffers are touched as they are mapped, so the log
+ *   says which backing each child really got.  The pool is empty on most
+ *   systems, and --hugepages reserve grows it at startup by enough pages
+ *   for the buffers of every device, and shrinks it back at exit.
+ *
+ */
+
+#include <sys/mman.h>
+
+#include "dwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "logging.h"
+#include "geometry.h"
+#include "arena.h"
+
+
+/* The buffers of the child, their sizes and their backing. */
+static char*  dwipe_arena_base [DWIPE_ARENA_SLOTS];
+static size_t dwipe_arena_size [DWIPE_ARENA_SLOTS];
+static dwipe_arena_backing_t dwipe_arena_backing [DWIPE_ARENA_SLOTS];
+
+/* Set once a failed mlock() has been logged. */
+static int dwipe_arena_unlocked = 0;
+
+/* The size of the huge page pool before the parent grew it, or -1. */
+static long dwipe_arena_pool = -1;
+
+
+static const char* dwipe_arena_name( dwipe_arena_backing_t backing )
+{
+/**
+ * Names a backing for the log.
+ *
+ */
+
+	switch( backing )
+	{
+		case DWIPE_ARENA_HUGETLB: return "huge pages from the pool";
+		case DWIPE_ARENA_THP:     return "transparent huge pages";
+		case DWIPE_ARENA_PAGES:   break;
+	}
+
+	return "ordinary pages";
+
+} /* dwipe_arena_name */
+
+
+static int dwipe_arena_huge( const char* p )
+{
+/**
+ * Tells whether the kernel backed a mapping with transparent huge pages.
+ *
+ * @return  1 when it did, else 0.
+ *
+ */
+
+	/* The memory map of the child. */
+	FILE* fp;
+
+	/* One line of the map. */
+	char line [256];
+
+	/* The length of the hexadecimal start of a line. */
+	size_t n;
+
+	/* Set while the lines describe our mapping. */
+	int inside = 0;
+
+	/* The kilobytes of the mapping on huge pages. */
+	unsigned long kb = 0;
+
+	fp = fopen( "/proc/self/smaps", "r" );
+	if( fp == NULL ) { return 0; }
+
+	while( fgets( line, sizeof( line ), fp ) != NULL )
+	{
+		/* Each mapping starts with a line of its address range, and its fields follow. */
+		n = strspn( line, "0123456789abcdef" );
+
+		if( n > 0 && line[n] == '-' )
+		{
+			inside = ( strtoul( line, NULL, 16 ) == (unsigned long) p );
+		}
+
+		else if( inside && sscanf( line, "AnonHugePages: %lu", &kb ) == 1 )
+		{
+			break;
+		}
+	}
+
+	fclose( fp );
+
+	return kb > 0;
+
+} /* dwipe_arena_huge */
+
+
+static char* dwipe_arena_map( size_t* size, dwipe_arena_backing_t* backing )
+{
+/**
+ * Maps a buffer with the strongest backing that the kernel gives.
+ *
+ * @parameter size     The bytes needed, which is rounded up to the size of the mapping.
+ * @parameter backing  Receives the backing of the mapping.
+ * @return             The buffer, or NULL with errno set.
+ *
+ */
+
+	/* The size of a huge page. */
+	size_t huge = DWIPE_KNOB_ARENA_HUGEPAGE;
+
+	/* The size of the mapping. */
+	size_t length;
+
+	/* The mapping, and its first huge page boundary. */
+	char* p;
+	char* q;
+
+	*backing = DWIPE_ARENA_PAGES;
+
+	if( dwipe_options.hugepages == DWIPE_HUGEPAGES_OFF )
+	{
+		length = ( *size + DWIPE_KNOB_ARENA_ALIGN - 1 ) / DWIPE_KNOB_ARENA_ALIGN * DWIPE_KNOB_ARENA_ALIGN;
+
+		p = mmap( NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+		if( p == MAP_FAILED ) { return NULL; }
+
+		*size = length;
+		return p;
+	}
+
+	length = ( *size + huge - 1 ) / huge * huge;
+
+	/* The pool, which fails at once when it is short of pages. */
+	p = mmap( NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0 );
+
+	if( p != MAP_FAILED )
+	{
+		*backing = DWIPE_ARENA_HUGETLB;
+		*size    = length;
+		return p;
+	}
+
+	/* Map one huge page more than needed, and trim the ends to huge page boundaries. */
+	p = mmap( NULL, length + huge, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+	if( p == MAP_FAILED ) { return NULL; }
+
+	q = (char*)( ( (unsigned long) p + huge - 1 ) / huge * huge );
+
+	if( q > p ) { munmap( p, q - p ); }
+	munmap( q + length, p + huge - q );
+
+	/* Fault the buffer in now, so that its backing is known. */
+	madvise( q, length, MADV_HUGEPAGE );
+	memset( q, 0, length );
+
+	if( dwipe_arena_huge( q ) ) { *backing = DWIPE_ARENA_THP; }
+
+	*size = length;
+	return q;
+
+} /* dwipe_arena_map */
+
+
+static void dwipe_arena_release( dwipe_arena_slot_t slot )
+{
+/**
+ * Frees one buffer.
+ *
+ */
+
+	if( dwipe_arena_base[slot] == NULL ) { return; }
+
+	if( dwipe_options.mlock ) { munlock( dwipe_arena_base[slot], dwipe_arena_size[slot] ); }
+
+	munmap( dwipe_arena_base[slot], dwipe_arena_size[slot] );
+
+	dwipe_arena_base[slot] = NULL;
+	dwipe_arena_size[slot] = 0;
+
+} /* dwipe_arena_release */
+
+
+char* dwipe_arena_get( dwipe_context_t* c, dwipe_arena_slot_t slot, size_t size )
+{
+/**
+ * Lends a buffer of at least the given size.  The contents are undefined,
+ * and the buffer stays valid until a larger one is asked for in the same
+ * slot or the arena is freed.
+ *
+ * @parameter c     The device context.
+ * @parameter slot  The use of the buffer.
+ * @parameter size  The bytes that the caller needs.
+ * @return          The buffer, or NULL with errno set.
+ *
+ */
+
+	/* The new buffer. */
+	char* p;
+
+	/* The bytes that all the buffers hold. */
+	u64 total;
+
+	/* Generic loop variable. */
+	int i;
+
+	if( size <= dwipe_arena_size[slot] ) { return dwipe_arena_base[slot]; }
+
+	dwipe_arena_release( slot );
+
+	p = dwipe_arena_map( &size, &dwipe_arena_backing[slot] );
+	if( p == NULL ) { return NULL; }
+
+	if( dwipe_options.mlock && mlock( p, size ) != 0 && ! dwipe_arena_unlocked )
+	{
+		/* This is usually RLIMIT_MEMLOCK, and the wipe works without the lock. */
+		dwipe_perror( errno, __FUNCTION__, "mlock" );
+		dwipe_log( DWIPE_LOG_WARNING, "The buffers of '%s' are not locked in memory.", c->device_name );
+		dwipe_arena_unlocked = 1;
+	}
+
+	dwipe_arena_base[slot] = p;
+	dwipe_arena_size[slot] = size;
+
+	for( total = 0, i = 0 ; i < DWIPE_ARENA_SLOTS ; i++ ) { total += dwipe_arena_size[i]; }
+	if( total > c->buffer_peak ) { c->buffer_peak = total; }
+
+	return p;
+
+} /* dwipe_arena_get */
+
+
+int dwipe_arena_init( dwipe_context_t* c, size_t pattern )
+{
+/**
+ * Allocates the buffers that the passes of a child use.  The child calls
+ * this once, after the block size is final.
+ *
+ * @parameter c        The device context.
+ * @parameter pattern  The longest static pattern of the method.
+ * @return             0 on success, -1 on failure.
+ *
+ */
+
+	/* The backing of the buffers. */
+	dwipe_arena_backing_t backing;
+
+	/* A static pass writes from any offset into two copies of its pattern. */
+	if( dwipe_arena_get( c, DWIPE_ARENA_OUTPUT, c->io_size + pattern * 2 ) == NULL
+	 || dwipe_arena_get( c, DWIPE_ARENA_INPUT,  c->io_size ) == NULL
+	  )
+	{
+		dwipe_perror( errno, __FUNCTION__, "mmap" );
+		dwipe_log( DWIPE_LOG_FATAL, "Unable to allocate memory for the buffers of '%s'.", c->device_name );
+		return -1;
+	}
+
+	/* The buffers are only as good as the weaker of the two. */
+	backing = dwipe_arena_backing[ DWIPE_ARENA_INPUT ];
+	if( dwipe_arena_backing[ DWIPE_ARENA_OUTPUT ] < backing ) { backing = dwipe_arena_backing[ DWIPE_ARENA_OUTPUT ]; }
+
+	dwipe_log( DWIPE_LOG_NOTICE, "Device '%s' has %llu bytes of i/o buffers on %s%s.", c->device_name, c->buffer_peak, \
+	  dwipe_arena_name( backing ), dwipe_options.mlock && ! dwipe_arena_unlocked ? ", locked in memory" : "" );
+
+	return 0;
+
+} /* dwipe_arena_init */
+
+
+void dwipe_arena_free( dwipe_context_t* c )
+{
+/**
+ * Releases every buffer of the child.
+ *
+ */
+
+	/* Generic loop variable. */
+	int i;
+
+	for( i = 0 ; i < DWIPE_ARENA_SLOTS ; i++ ) { dwipe_arena_release( i ); }
+
+	if( c->buffer_peak > 0 )
+	{
+		dwipe_log( DWIPE_LOG_INFO, "Device '%s' used at most %llu bytes of i/o buffers.", c->device_name, c->buffer_peak );
+	}
+
+} /* dwipe_arena_free */
+
+
+static long dwipe_arena_pool_size( long pages )
+{
+/**
+ * Reads the number of pages in the huge page pool, and first sets it when
+ * a number is given.
+ *
+ * @parameter pages  The new size of the pool, or -1 to only read it.
+ * @return           The size of the pool, or -1 when it is unavailable.
+ *
+ */
+
+	/* The pool file. */
+	FILE* fp;
+
+	/* The size of the pool. */
+	long size = -1;
+
+	if( pages >= 0 )
+	{
+		fp = fopen( DWIPE_KNOB_ARENA_POOL, "w" );
+		if( fp == NULL ) { return -1; }
+
+		fprintf( fp, "%li\n", pages );
+		if( fclose( fp ) != 0 ) { return -1; }
+	}
+
+	fp = fopen( DWIPE_KNOB_ARENA_POOL, "r" );
+	if( fp == NULL ) { return -1; }
+
+	if( fscanf( fp, "%li", &size ) != 1 ) { size = -1; }
+	fclose( fp );
+
+	return size;
+
+} /* dwipe_arena_pool_size */
+
+
+int dwipe_arena_reserve( int count, dwipe_context_t* c )
+{
+/**
+ * Grows the huge page pool by enough pages for the buffers of every
+ * device.  Only the parent may call this, once the devices are probed.
+ *
+ * @parameter count  The number of contexts in the array.
+ * @parameter c      An array of device contexts.
+ * @return           0 on success, -1 when the pool was not grown.
+ *
+ */
+
+	/* The size of a huge page. */
+	u64 huge = DWIPE_KNOB_ARENA_HUGEPAGE;
+
+	/* The block size of the working device. */
+	u64 size;
+
+	/* The pages that the devices need, and the size of the pool with them. */
+	long pages = 0;
+	long granted;
+
+	/* Generic loop variable. */
+	int i;
+
+	for( i = 0 ; i < count ; i++ )
+	{
+		/* An empty station slot gets the default block size. */
+		size = ( c[i].io_size > 0 ) ? c[i].io_size : DWIPE_KNOB_GEOMETRY_CHUNK;
+
+		/* The input and the output buffer, with room for a pattern, and a bounce buffer for bad sectors. */
+		pages += 2 * ( ( size + DWIPE_KNOB_ARENA_ALIGN + huge - 1 ) / huge );
+		if( dwipe_options.tolerant ) { pages += ( size + huge - 1 ) / huge; }
+	}
+
+	dwipe_arena_pool = dwipe_arena_pool_size( -1 );
+
+	if( dwipe_arena_pool < 0 )
+	{
+		dwipe_log( DWIPE_LOG_WARNING, "Unable to read the huge page pool '%s'.", DWIPE_KNOB_ARENA_POOL );
+		return -1;
+	}
+
+	granted = dwipe_arena_pool_size( dwipe_arena_pool + pages );
+
+	if( granted < 0 )
+	{
+		dwipe_perror( errno, __FUNCTION__, "fopen" );
+		dwipe_log( DWIPE_LOG_WARNING, "Unable to grow the huge page pool '%s'.", DWIPE_KNOB_ARENA_POOL );
+		dwipe_arena_pool = -1;
+		return -1;
+	}
+
+	/* The kernel grows the pool as far as it finds free huge pages. */
+	dwipe_log( DWIPE_LOG_NOTICE, "Reserved %li of %li huge pages for the buffers of %i devices.", \
+	  granted - dwipe_arena_pool, pages, count );
+
+	return 0;
+
+} /* dwipe_arena_reserve */
+
+
+void dwipe_arena_unreserve( void )
+{
+/**
+ * Shrinks the huge page pool back to its size before dwipe_arena_reserve().
+ *
+ */
+
+	if( dwipe_arena_pool < 0 ) { return; }
+
+	dwipe_arena_pool_size( dwipe_arena_pool );
+	dwipe_arena_pool = -1;
+
+} /* dwipe_arena_unreserve */
+
+/* eof */
@@ -0,0 +1,57 @@
+/*
+ *  arena.h: The i/o buffers of a wipe.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef ARENA_H_
+#define ARENA_H_
+
+/* The alignment of the buffers, which suits direct i/o on every sector size. */
+#define DWIPE_KNOB_ARENA_ALIGN     4096
+
+/* The size of a huge page on the platforms that dwipe runs on. */
+#define DWIPE_KNOB_ARENA_HUGEPAGE  ( 2 << 20 )
+
+/* The file that holds the number of pages in the huge page pool. */
+#define DWIPE_KNOB_ARENA_POOL      "/proc/sys/vm/nr_hugepages"
+
+/* The buffers that a child keeps for its passes. */
+typedef enum dwipe_arena_slot_t_
+{
+	DWIPE_ARENA_INPUT,    /* The data that is read back from the device.          */
+	DWIPE_ARENA_OUTPUT,   /* The data that is written, or that a read must match. */
+	DWIPE_ARENA_BOUNCE,   /* The aligned copy for direct i/o of a bad sector.     */
+	DWIPE_ARENA_SLOTS
+} dwipe_arena_slot_t;
+
+/* The memory behind a buffer, from the weakest to the strongest. */
+typedef enum dwipe_arena_backing_t_
+{
+	DWIPE_ARENA_PAGES,    /* Ordinary pages.                                      */
+	DWIPE_ARENA_THP,      /* Transparent huge pages that the kernel gave us.      */
+	DWIPE_ARENA_HUGETLB   /* Pages from the huge page pool.                       */
+} dwipe_arena_backing_t;
+
+int   dwipe_arena_init( dwipe_context_t* c, size_t pattern );            /* Allocate the buffers of a child. */
+char* dwipe_arena_get( dwipe_context_t* c, dwipe_arena_slot_t slot, size_t size );  /* Borrow a buffer.  */
+void  dwipe_arena_free( dwipe_context_t* c );                             /* Release every buffer.           */
+int   dwipe_arena_reserve( int count, dwipe_context_t* c );               /* Grow the huge page pool.        */
+void  dwipe_arena_unreserve( void );                                      /* Shrink it back.                 */
+
+#endif /* ARENA_H_ */
+
+/* eof */
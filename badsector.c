@@ -0,0 +1,408 @@
+/*
+ *  badsector.c: Passes that work around unreadable and unwritable sectors.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+/* RATIONALE:
+ *
+ *   One media error used to fail the whole pass, and so the whole device,
+ *   even when a single sector of a large drive was bad.  With --tolerant, a
+ *   block that fails with a media error is bisected with direct i/o down to
+ *   single sectors.  Each half that works is done, and a sector that still
+ *   fails after --retries more tries is recorded and skipped: a write counts
+ *   its bytes as pass errors, and a read counts a verification error and
+ *   fills the sector with the expected data so that the rest of the block
+ *   is still compared.  The pass then carries on with full size blocks.
+ *
+ *   Direct i/o is used for the bisection because a buffered write of a
+ *   small piece would land in the page cache and only fail much later.
+ *
+ *   The bad sectors are kept in shared memory in ascending order, so that
+ *   the parent can list them in the result file and the later passes can
+ *   go around them without waiting on the drive again.  A pass gives up
+ *   once --max-bad-sectors have been found, because a drive that is that
+ *   damaged is better destroyed.
+ *
+ */
+
+#include "dwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "logging.h"
+#include "progress.h"
+#include "events.h"
+#include "badsector.h"
+#include "arena.h"
+#include "durability.h"
+
+
+/* The direct i/o descriptor of the device of the child, -1 before it is opened, or -2 without direct i/o. */
+static int dwipe_badsector_fd = -1;
+
+
+int dwipe_badsector_init( int count, dwipe_context_t* c )
+{
+/**
+ * Allocates one bad sector list per device and attaches it to the context.
+ *
+ * @parameter count  The number of contexts in the array.
+ * @parameter c      An array of device contexts.
+ * @return           0 on success, -1 on failure.
+ *
+ */
+
+	/* The list array. */
+	dwipe_badsectors_t* b;
+
+	/* Generic loop variable. */
+	int i;
+
+	b = dwipe_shm_alloc( count * sizeof( dwipe_badsectors_t ) );
+
+	if( b == NULL )
+	{
+		dwipe_log( DWIPE_LOG_FATAL, "Unable to allocate shared memory for the bad sector lists." );
+		return -1;
+	}
+
+	for( i = 0 ; i < count ; i++ )
+	{
+		c[i].badsectors = &b[i];
+	}
+
+	return 0;
+
+} /* dwipe_badsector_init */
+
+
+static size_t dwipe_badsector_size( dwipe_context_t* c )
+{
+/**
+ * Returns the size of the sectors of a device.
+ *
+ */
+
+	return ( c->sector_size > 0 ) ? c->sector_size : 512;
+
+} /* dwipe_badsector_size */
+
+
+static int dwipe_badsector_find( dwipe_badsectors_t* b, u64 lba )
+{
+/**
+ * Returns the index of the first listed sector at or after an LBA.
+ *
+ */
+
+	/* The bounds of the search. */
+	int lo = 0;
+	int hi = ( b->count < DWIPE_KNOB_BADSECTOR_LIST ) ? b->count : DWIPE_KNOB_BADSECTOR_LIST;
+
+	/* The working index. */
+	int m;
+
+	while( lo < hi )
+	{
+		m = ( lo + hi ) / 2;
+		if( b->lba[m] < lba ) { lo = m + 1; }
+		else                  { hi = m;     }
+	}
+
+	return lo;
+
+} /* dwipe_badsector_find */
+
+
+static int dwipe_badsector_known( dwipe_context_t* c, u64 offset, size_t count )
+{
+/**
+ * Checks whether a piece of the device holds a sector that is known to be bad.
+ *
+ */
+
+	/* The list. */
+	dwipe_badsectors_t* b = c->badsectors;
+
+	/* The sector size, and the first and last sectors of the piece. */
+	size_t sector = dwipe_badsector_size( c );
+	u64 first = offset / sector;
+	u64 last  = ( offset + count - 1 ) / sector;
+
+	/* The index of the first listed sector at or after the piece. */
+	int i;
+
+	if( b == NULL || b->count == 0 ) { return 0; }
+
+	i = dwipe_badsector_find( b, first );
+
+	return i < b->count && i < DWIPE_KNOB_BADSECTOR_LIST && b->lba[i] <= last;
+
+} /* dwipe_badsector_known */
+
+
+static int dwipe_badsector_media( int error )
+{
+/**
+ * Tells a media error, which can be worked around, from a failure of the
+ * whole device.
+ *
+ */
+
+	return error == EIO || error == ENODATA || error == EILSEQ;
+
+} /* dwipe_badsector_media */
+
+
+static int dwipe_badsector_io( dwipe_context_t* c, int writing, char* buffer, size_t count, u64 offset )
+{
+/**
+ * Moves one piece with direct i/o, or with buffered i/o when the piece is
+ * not aligned for it.
+ *
+ * @return  0 when the whole piece was moved, else -1 with errno set.
+ *
+ */
+
+	/* The sector size. */
+	size_t sector = dwipe_badsector_size( c );
+
+	/* The aligned buffer for direct i/o. */
+	char* bounce;
+
+	/* The result holder. */
+	ssize_t r;
+
+	if( dwipe_badsector_fd == -1 )
+	{
+		/* This is opened once per child, and writes as synchronously as the sync policy asks. */
+		dwipe_badsector_fd = open( c->device_name, O_RDWR | O_DIRECT | O_CLOEXEC
+		  | ( ( dwipe_options.sync == DWIPE_SYNC_DSYNC || dwipe_options.sync == DWIPE_SYNC_FUA ) ? O_DSYNC : 0 ) );
+
+		if( dwipe_badsector_fd < 0 )
+		{
+			dwipe_perror( errno, __FUNCTION__, "open" );
+			dwipe_log( DWIPE_LOG_WARNING, "Device '%s' has no direct i/o, so its bad sectors are only found by a flush.", c->device_name );
+			dwipe_badsector_fd = -2;
+		}
+	}
+
+	if( dwipe_badsector_fd >= 0 && offset % sector == 0 && count % sector == 0
+	    && (unsigned long) buffer % DWIPE_KNOB_ARENA_ALIGN == 0 )
+	{
+		/* An aligned piece needs no copy. */
+		r = writing ? pwrite( dwipe_badsector_fd, buffer, count, offset ) : pread( dwipe_badsector_fd, buffer, count, offset );
+	}
+
+	/* An aligned copy of the piece for direct i/o. */
+	else if( dwipe_badsector_fd < 0 || ( bounce = dwipe_arena_get( c, DWIPE_ARENA_BOUNCE, count ) ) == NULL
+	    || offset % sector != 0 || count % sector != 0 )
+	{
+		r = writing ? pwrite( c->device_fd, buffer, count, offset ) : pread( c->device_fd, buffer, count, offset );
+	}
+
+	else if( writing )
+	{
+		memcpy( bounce, buffer, count );
+		r = pwrite( dwipe_badsector_fd, bounce, count, offset );
+	}
+
+	else
+	{
+		r = pread( dwipe_badsector_fd, bounce, count, offset );
+		if( r > 0 ) { memcpy( buffer, bounce, r ); }
+	}
+
+	if( r == count ) { return 0; }
+
+	/* A short transfer is as bad as a failed one. */
+	if( r >= 0 ) { errno = EIO; }
+
+	return -1;
+
+} /* dwipe_badsector_io */
+
+
+static int dwipe_badsector_skip( dwipe_context_t* c, int writing, char* buffer, const char* expected, size_t count, u64 offset, int known )
+{
+/**
+ * Records a bad sector and skips it.
+ *
+ * @return  0 to carry on, -1 when the pass has found too many bad sectors.
+ *
+ */
+
+	/* The list. */
+	dwipe_badsectors_t* b = c->badsectors;
+
+	/* The LBA of the sector. */
+	u64 lba = offset / dwipe_badsector_size( c );
+
+	/* The position of the sector in the list. */
+	int i;
+	int n;
+
+	if( writing )
+	{
+		/* The bytes of the sector were not wiped. */
+		dwipe_progress_count( c, &c->progress->pass_errors, count );
+		dwipe_event( c, DWIPE_EVENT_WRITE_ERROR, count );
+	}
+
+	else
+	{
+		/* Compare the rest of the block as if the sector were right. */
+		memcpy( buffer, expected, count );
+		dwipe_progress_count( c, &c->progress->verify_errors, 1 );
+		dwipe_event( c, DWIPE_EVENT_VERIFY_ERROR, 1 );
+	}
+
+	if( known ) { return 0; }
+
+	dwipe_log( DWIPE_LOG_WARNING, "Skipping bad sector %llu of '%s'.", lba, c->device_name );
+
+	n = ( b->count < DWIPE_KNOB_BADSECTOR_LIST ) ? b->count : DWIPE_KNOB_BADSECTOR_LIST;
+	i = dwipe_badsector_find( b, lba );
+
+	if( n < DWIPE_KNOB_BADSECTOR_LIST )
+	{
+		memmove( &b->lba[i+1], &b->lba[i], ( n - i ) * sizeof( u64 ) );
+		b->lba[i] = lba;
+	}
+
+	/* The parent reads the list after the child has exited. */
+	__atomic_store_n( &b->count, b->count + 1, __ATOMIC_RELEASE );
+
+	if( b->count > dwipe_options.max_bad_sectors )
+	{
+		dwipe_log( DWIPE_LOG_FATAL, "Giving up on '%s' after %llu bad sectors.", c->device_name, b->count );
+		return -1;
+	}
+
+	return 0;
+
+} /* dwipe_badsector_skip */
+
+
+static int dwipe_badsector_bisect( dwipe_context_t* c, int writing, char* buffer, const char* expected, size_t count, u64 offset, int tried )
+{
+/**
+ * Moves a piece that failed, by halves, and skips the sectors that still
+ * fail on their own.
+ *
+ * @parameter tried  Set when the whole piece has already failed.
+ * @return           0 to carry on, -1 when the pass must fail.
+ *
+ */
+
+	/* The sector size, and the size of the first half. */
+	size_t sector = dwipe_badsector_size( c );
+	size_t half;
+
+	/* Generic loop variable. */
+	int i;
+
+	if( count > sector )
+	{
+		if( ! tried && ! dwipe_badsector_known( c, offset, count ) )
+		{
+			if( dwipe_badsector_io( c, writing, buffer, count, offset ) == 0 ) { return 0; }
+			if( ! dwipe_badsector_media( errno ) ) { return -1; }
+		}
+
+		half = ( count / sector / 2 ) * sector;
+		if( half == 0 ) { half = sector; }
+
+		if( dwipe_badsector_bisect( c, writing, buffer, expected, half, offset, 0 ) != 0 ) { return -1; }
+
+		return dwipe_badsector_bisect( c, writing, buffer + half, expected + half, count - half, offset + half, 0 );
+	}
+
+	/* Do not wait on a sector that an earlier pass found bad. */
+	if( dwipe_badsector_known( c, offset, count ) )
+	{
+		return dwipe_badsector_skip( c, writing, buffer, expected, count, offset, 1 );
+	}
+
+	for( i = tried ? 1 : 0 ; i <= dwipe_options.retries ; i++ )
+	{
+		if( dwipe_badsector_io( c, writing, buffer, count, offset ) == 0 ) { return 0; }
+		if( ! dwipe_badsector_media( errno ) ) { return -1; }
+	}
+
+	return dwipe_badsector_skip( c, writing, buffer, expected, count, offset, 0 );
+
+} /* dwipe_badsector_bisect */
+
+
+ssize_t dwipe_badsector_pwrite( dwipe_context_t* c, const void* buffer, size_t count, u64 offset )
+{
+/**
+ * Writes a block of a pass like pwrite().  A tolerant pass writes with
+ * direct i/o, because a buffered write only fails at a later flush, long
+ * after the block could have been bisected.  It works around the bad
+ * sectors of the block and reports it as written.
+ *
+ */
+
+	if( ! dwipe_options.tolerant ) { return dwipe_durability_pwrite( c, buffer, count, offset ); }
+
+	if( ! dwipe_badsector_known( c, offset, count ) )
+	{
+		if( dwipe_badsector_io( c, 1, (char*) buffer, count, offset ) == 0 )
+		{
+			return ( dwipe_durability_written( c, count ) == 0 ) ? count : -1;
+		}
+
+		if( ! dwipe_badsector_media( errno ) ) { return -1; }
+	}
+
+	if( dwipe_badsector_bisect( c, 1, (char*) buffer, buffer, count, offset, 1 ) != 0 ) { return -1; }
+
+	return ( dwipe_durability_written( c, count ) == 0 ) ? count : -1;
+
+} /* dwipe_badsector_pwrite */
+
+
+ssize_t dwipe_badsector_pread( dwipe_context_t* c, void* buffer, const void* expected, size_t count, u64 offset )
+{
+/**
+ * Reads a block of a verification like pread().  A tolerant verification
+ * works around the bad sectors of the block and puts the expected data in
+ * their place.
+ *
+ */
+
+	/* The result holder. */
+	ssize_t r;
+
+	if( ! dwipe_options.tolerant ) { return pread( c->device_fd, buffer, count, offset ); }
+
+	if( ! dwipe_badsector_known( c, offset, count ) )
+	{
+		r = pread( c->device_fd, buffer, count, offset );
+		if( r >= 0 || ! dwipe_badsector_media( errno ) ) { return r; }
+	}
+
+	if( dwipe_badsector_bisect( c, 0, buffer, expected, count, offset, 1 ) != 0 ) { return -1; }
+
+	return count;
+
+} /* dwipe_badsector_pread */
+
+/* eof */
@@ -0,0 +1,45 @@
+/*
+ *  badsector.h: Passes that work around unreadable and unwritable sectors.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef BADSECTOR_H_
+#define BADSECTOR_H_
+
+/* The number of bad sectors of a device that are listed in its result file. */
+#define DWIPE_KNOB_BADSECTOR_LIST     1024
+
+/* The default number of bad sectors after which a tolerant pass gives up. */
+#define DWIPE_KNOB_BADSECTOR_MAX      1000
+
+/* The default number of times that a failed sector is tried again. */
+#define DWIPE_KNOB_BADSECTOR_RETRIES  2
+
+/* The bad sectors of one device.  Only its child writes them. */
+struct dwipe_badsectors_t_
+{
+	u64 count;                             /* The number of distinct bad sectors found.       */
+	u64 lba[ DWIPE_KNOB_BADSECTOR_LIST ];  /* The first of them in ascending order, by LBA.   */
+} __attribute__(( aligned( DWIPE_KNOB_CACHELINE ) ));
+
+int     dwipe_badsector_init( int count, dwipe_context_t* c );  /* Give every context a list.  */
+ssize_t dwipe_badsector_pwrite( dwipe_context_t* c, const void* buffer, size_t count, u64 offset );  /* Write a block. */
+ssize_t dwipe_badsector_pread( dwipe_context_t* c, void* buffer, const void* expected, size_t count, u64 offset );  /* Read one. */
+
+#endif /* BADSECTOR_H_ */
+
+/* eof */
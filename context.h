@@ -50,28 +50,64 @@ typedef enum dwipe_select_t_
 	DWIPE_SELECT_FALSE,        /* Do not wipe this device.                                                 */
 	DWIPE_SELECT_FALSE_CHILD,  /* A child of this device has been selected, so we can't wipe this device.  */
 	DWIPE_SELECT_DISABLED,     /* Do not wipe this device and do not allow it to be selected.              */
-	DWIPE_SELECT_SKIPPED       /* Skipped */
+	DWIPE_SELECT_SKIPPED,      /* Skipped */
+	DWIPE_SELECT_PROBING       /* The device has not answered its probe yet.                               */
 } dwipe_select_t;
 
+typedef enum dwipe_state_t_
+{
+	DWIPE_STATE_NONE = 0,  /* This device is not scheduled.                        */
+	DWIPE_STATE_QUEUED,    /* Waiting for a free slot on its host adapter and bus.  */
+	DWIPE_STATE_RUNNING,   /* A child process is wiping this device.               */
+	DWIPE_STATE_DONE,      /* The child process has been reaped.                   */
+	DWIPE_STATE_REPORTED   /* The result file has been written.                    */
+} dwipe_state_t;
+
+
+/* The nanoseconds over which the short and the long throughput averages forget a sample. */
+#define DWIPE_KNOB_EWMA_SHORT     INT64_C( 5000000000 )
+#define DWIPE_KNOB_EWMA_LONG      INT64_C( 60000000000 )
 
-#define DWIPE_KNOB_SPEEDRING_SIZE         30
-#define DWIPE_KNOB_SPEEDRING_GRANULARITY  10
+/* The least nanoseconds between two samples, which avoids jitter from frequent wakeups. */
+#define DWIPE_KNOB_EWMA_INTERVAL  INT64_C( 500000000 )
 
-typedef struct dwipe_speedring_t_
+/* The moving averages of the rate of a counter. */
+typedef struct dwipe_ewma_t_
 {
-	u64    bytes[DWIPE_KNOB_SPEEDRING_SIZE];
-	u64    bytestotal;
-	u64    byteslast;
-	time_t times[DWIPE_KNOB_SPEEDRING_SIZE];
-	time_t timestotal;
-	time_t timeslast;
-	u32    position;
-} dwipe_speedring_t;
+	u64    last;     /* The counter at the last sample.                         */
+	u64    time;     /* The CLOCK_MONOTONIC nanoseconds of the last sample.     */
+	u64    samples;  /* The number of intervals that have been averaged.        */
+	double now;      /* The rate per second over the last interval.             */
+	double fast;     /* The rate per second averaged over the short window.     */
+	double slow;     /* The rate per second averaged over the long window.      */
+} dwipe_ewma_t;
+
+/* The shared progress counters of one device, which are defined in progress.h. */
+typedef struct dwipe_progress_t_ dwipe_progress_t;
+
+/* The event ring of one device, which is defined in events.h. */
+typedef struct dwipe_events_t_ dwipe_events_t;
+
+/* The log records of one device, which are defined in logging.h. */
+typedef struct dwipe_logring_t_ dwipe_logring_t;
+
+/* The runtime model of one device, which is defined in eta.h. */
+typedef struct dwipe_eta_t_ dwipe_eta_t;
+
+/* The checkpoint state of one wipe, which is defined in journal.h. */
+typedef struct dwipe_journal_t_ dwipe_journal_t;
+
+/* One extent of a device that is wiped, which is defined in range.h. */
+typedef struct dwipe_range_t_ dwipe_range_t;
 
+/* The bad sectors of one device, which are defined in badsector.h. */
+typedef struct dwipe_badsectors_t_ dwipe_badsectors_t;
 
 typedef struct dwipe_context_t_
 {
+	dwipe_badsectors_t* badsectors;  /* The bad sectors that the child has found.                   */
 	int               block_size;    /* The soft block size reported the device.                    */
+	u64               buffer_peak;   /* The most bytes of i/o buffers that the child has held.      */
 	int               device_bus;    /* The device bus number.                                      */
 	int               device_fd;     /* The file descriptor of the device file being wiped.         */
 	int               device_host;   /* The host number.                                            */
@@ -82,20 +118,40 @@ typedef struct dwipe_context_t_
 	int               device_minor;  /* The minor device number.                                    */
 	int               device_part;   /* The device partition or slice number.                       */
 	char*             device_name;   /* The device file name.                                       */
+	char*             device_serial; /* The serial number of the drive, or NULL when it is unknown. */
 	loff_t            device_size;   /* The device size in bytes.                                   */
 	struct stat       device_stat;   /* The device file state from fstat().                         */
 	dwipe_device_t    device_type;   /* Indicates an IDE, SCSI, or Compaq SMART device.             */
 	u64               eta;           /* The estimated number of seconds until method completion.    */
+	dwipe_eta_t*      eta_model;     /* The rates and speed curve that eta is computed from.        */
 	int               entropy_fd;    /* The entropy source. Usually /dev/urandom.                   */
+	dwipe_events_t*   events;        /* The events that the child publishes, or NULL.               */
+	int               outlier;       /* A dwipe_peer_t when the device lags its peers, else zero.   */
+	int               outlier_strikes; /* The number of checks in a row that the device has lagged. */
+	int               group;         /* The index of the host adapter and bus group of this device. */
+	int               io_depth;      /* The request queue depth of the device.                      */
+	size_t            io_size;       /* The bytes in one block of a pass.                           */
+	size_t            io_unit;       /* The granule that io_size is a multiple of and aligned to.   */
+	dwipe_journal_t*  journal;       /* The checkpoints of the wipe, or NULL.                       */
 	char*             label;         /* The string that we will show the user.                      */
+	u64               latency_p50;   /* The median i/o latency in nanoseconds.                      */
+	u64               latency_p99;   /* The 99th percentile i/o latency in nanoseconds.             */
+	u64               latency_max;   /* The slowest i/o in nanoseconds.                             */
+	dwipe_logring_t*  logring;       /* The log records that the child publishes, or NULL.          */
 	int               pass_count;    /* The number of passes performed by the working wipe method.  */
 	u64               pass_done;     /* The number of bytes that have already been i/o'd.           */
 	u64               pass_errors;   /* The number of errors across all passes.                     */
 	u64               pass_size;     /* The total number of i/o bytes across all passes.            */
-	dwipe_pass_t      pass_type;     /* The type of the current working pass.                       */
-	int               pass_working;  /* The current working pass.                                   */
+	dwipe_pass_t      pass_type;     /* The type of the working pass, as the parent last sampled.   */
+	int               pass_working;  /* The working pass, as the parent last sampled it.            */
+	int               paused;        /* Set while the child is stopped with SIGSTOP.                */
 	pid_t             pid;           /* The process that has been assigned to do the wipe.          */
+	dwipe_progress_t* progress;      /* The counters that the child publishes.                      */
 	dwipe_prng_t*     prng;          /* The PRNG implementation.                                    */
+	dwipe_range_t*    ranges;        /* The extents that every pass covers, or NULL for all of it.  */
+	int               range_count;   /* The number of elements in ranges.                           */
+	int               removed;       /* Set when the device was unplugged before its wipe finished. */
+	int               rotational;    /* Set when the device has spinning media.                     */
 	dwipe_entropy_t   prng_seed;     /* The random data that is used to seed the PRNG.              */
 	void*             prng_state;    /* The private internal state of the PRNG.                     */
 	int               result;        /* The process return value.                                   */
@@ -104,15 +160,22 @@ typedef struct dwipe_context_t_
 	u64               round_errors;  /* The number of errors across all rounds.                     */
 	u64               round_size;    /* The total number of i/o bytes across all rounds.            */
 	double            round_percent; /* The percentage complete across all rounds.                  */
-	int               round_working; /* The current working round.                                  */
+	int               round_working; /* The working round, as the parent last sampled it.           */
 	int               sector_size;   /* The hard sector size reported by the device.                */
 	dwipe_select_t    select;        /* Indicates whether this device should be wiped.              */
 	int               signal;        /* Set when the child is killed by a signal.                   */
-	dwipe_speedring_t speedring;     /* Ring buffer for computing the rolling throughput average.   */
+	dwipe_state_t     state;         /* The scheduling state of this device.                        */
+	dwipe_ewma_t      ewma;          /* The moving averages of the throughput.                      */
+	int               throttled;     /* The percentage of recent time spent asleep in the throttle. */
+	u64               throttle_ns;   /* The nanoseconds spent asleep in the throttle.               */
+	dwipe_ewma_t      throttle_ewma; /* The moving averages of the time asleep in the throttle.     */
 	int               status;        /* The last process status value from waitpid().               */
-	short             sync_status;   /* A flag to indicate when the method is syncing.              */
-	u64               throughput;    /* Average throughput in bytes per second.                     */
+	short             sync_status;   /* Set while the method is syncing, as last sampled.           */
+	u64               throughput;    /* The short average throughput in bytes per second.           */
+	u64               throughput_avg; /* The long average throughput in bytes per second.           */
+	u64               throughput_now; /* The throughput over the last sample in bytes per second.   */
 	u64               verify_errors; /* The number of verification errors across all passes.        */
+	u64               wipe_size;     /* The bytes that one pass covers.                             */
 } dwipe_context_t;
 
 #endif /* CONTEXT_H_ */
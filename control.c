@@ -0,0 +1,772 @@
+/*
+ *  control.c: A local control socket for headless wipes.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+/* RATIONALE:
+ *
+ *   A rack of drives is wiped by a service more often than by a person at a
+ *   console, so the engine must be drivable without ncurses.  The control
+ *   socket is one more descriptor in the supervisor's epoll loop: commands
+ *   change the same contexts that the scheduler dispatches from and that the
+ *   gui draws, so the terminal interface is just another client.
+ *
+ *   The protocol is one command per line, answered by any number of lines
+ *   and then a line that is either "ok" or "error <reason>", so that it can
+ *   be driven with socat or nc -U.  The socket is created with mode 0600
+ *   because anyone who can connect can wipe a disk.
+ *
+ *   Clients are non-blocking and are never waited for.  A client that does
+ *   not read its replies loses them rather than stalling the wipes.
+ *
+ */
+
+#include <ctype.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <sys/sysmacros.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "dwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "logging.h"
+#include "progress.h"
+#include "schedule.h"
+#include "supervise.h"
+#include "throttle.h"
+#include "control.h"
+
+
+/* One connected client and its partial command line. */
+typedef struct /* dwipe_control_client_t */
+{
+	int    fd;                                /* The connection, or -1 when the entry is free. */
+	size_t used;                              /* The number of bytes in the line buffer.       */
+	char   line[ DWIPE_KNOB_CONTROL_LINE ];   /* The command that is being received.           */
+} dwipe_control_client_t;
+
+/* The connected clients. */
+static dwipe_control_client_t dwipe_control_clients[ DWIPE_KNOB_CONTROL_CLIENTS ];
+
+/* The listening socket and its path. */
+static int dwipe_control_fd = -1;
+static struct sockaddr_un dwipe_control_addr;
+
+/* The context array that the commands act on. */
+static int dwipe_control_count = 0;
+static dwipe_context_t* dwipe_control_c = NULL;
+
+
+static void dwipe_control_reply( dwipe_control_client_t* client, const char* format, ... )
+{
+/**
+ * Sends one line to a client without waiting for it.
+ *
+ */
+
+	/* The formatted line. */
+	char buffer[ DWIPE_KNOB_CONTROL_LINE * 2 ];
+
+	/* The length of the line. */
+	int n;
+
+	va_list ap;
+
+	va_start( ap, format );
+	n = vsnprintf( buffer, sizeof( buffer ) - 1, format, ap );
+	va_end( ap );
+
+	if( n < 0 ) { return; }
+	if( n > (int) sizeof( buffer ) - 2 ) { n = sizeof( buffer ) - 2; }
+
+	buffer[ n++ ] = '\n';
+
+	if( send( client->fd, buffer, n, MSG_NOSIGNAL | MSG_DONTWAIT ) != n )
+	{
+		dwipe_log( DWIPE_LOG_INFO, "Dropped a reply to a control client that is not reading." );
+	}
+
+} /* dwipe_control_reply */
+
+
+static int dwipe_control_find( const char* name )
+{
+/**
+ * Finds a device by its slot number, its device name or the last part of its
+ * device name.
+ *
+ * @returns  The index of the context, or -1 if there is no such device.
+ *
+ */
+
+	/* The last part of a device name. */
+	const char* base;
+
+	/* The parsed slot number. */
+	char* end;
+	long k;
+
+	/* A generic loop variable. */
+	int i;
+
+	k = strtol( name, &end, 10 );
+
+	if( *name != '\0' && *end == '\0' )
+	{
+		if( k < 0 || k >= dwipe_control_count || dwipe_control_c[k].device_name == NULL ) { return -1; }
+		return k;
+	}
+
+	for( i = 0 ; i < dwipe_control_count ; i++ )
+	{
+		if( dwipe_control_c[i].device_name == NULL ) { continue; }
+
+		base = strrchr( dwipe_control_c[i].device_name, '/' );
+		base = base == NULL ? dwipe_control_c[i].device_name : base + 1;
+
+		if( strcmp( name, dwipe_control_c[i].device_name ) == 0 || strcmp( name, base ) == 0 ) { return i; }
+	}
+
+	return -1;
+
+} /* dwipe_control_find */
+
+
+static const char* dwipe_control_state( dwipe_context_t* c )
+{
+/**
+ * Names the state of a device for the status command.
+ *
+ */
+
+	switch( c->state )
+	{
+		case DWIPE_STATE_NONE:     return "idle";
+		case DWIPE_STATE_QUEUED:   return "queued";
+		case DWIPE_STATE_RUNNING:  return c->paused ? "paused" : "running";
+		case DWIPE_STATE_DONE:     return "finishing";
+		case DWIPE_STATE_REPORTED: return c->result == 0 ? "succeeded" : "failed";
+	}
+
+	return "unknown";
+
+} /* dwipe_control_state */
+
+
+static void dwipe_control_status( dwipe_control_client_t* client, int i )
+{
+/**
+ * Describes one device on one line of key=value pairs.
+ *
+ */
+
+	dwipe_context_t* c = &dwipe_control_c[i];
+
+	dwipe_control_reply( client, "%i %s state=%s result=%i percent=%.2f round=%i/%i pass=%i/%i"
+	  " throughput=%llu throughput_now=%llu throughput_avg=%llu eta=%lu errors=%llu verify_errors=%llu rate_limit=%llu throttled=%i",
+	  i, c->device_name, dwipe_control_state( c ), c->result, c->round_percent,
+	  c->round_working, c->round_count, c->pass_working, c->pass_count,
+	  c->throughput, c->throughput_now, c->throughput_avg, (unsigned long) c->eta, c->pass_errors, c->verify_errors,
+	  __atomic_load_n( &c->progress->rate_limit, __ATOMIC_RELAXED ), c->throttled );
+
+} /* dwipe_control_status */
+
+
+static int dwipe_control_disk( const char* device_name, char* disk, size_t size )
+{
+/**
+ * Finds the sysfs directory of the disk that holds a device: the device
+ * itself, or its parent when the device is a partition.
+ *
+ * @return  0 on success, -1 when sysfs does not know the device.
+ *
+ */
+
+	/* The device file state. */
+	struct stat st;
+
+	/* The sysfs link of the device, and where it leads. */
+	char path [PATH_MAX + 16];
+	char real [PATH_MAX];
+
+	if( stat( device_name, &st ) != 0 || ! S_ISBLK( st.st_mode ) ) { return -1; }
+
+	snprintf( path, sizeof( path ), "/sys/dev/block/%u:%u", major( st.st_rdev ), minor( st.st_rdev ) );
+	if( realpath( path, real ) == NULL ) { return -1; }
+
+	/* The directory of a partition is inside the directory of its disk. */
+	snprintf( path, sizeof( path ), "%s/partition", real );
+	if( access( path, F_OK ) == 0 ) { *strrchr( real, '/' ) = 0; }
+
+	snprintf( disk, size, "%s", real );
+	return 0;
+
+} /* dwipe_control_disk */
+
+
+static int dwipe_control_partof( const char* part, const char* disk )
+{
+/**
+ * Tells by name alone whether a device is a disk or one of its partitions,
+ * like /dev/sda1 of /dev/sda or /dev/nvme0n1p1 of /dev/nvme0n1, but not
+ * /dev/sdaa of /dev/sda.
+ *
+ */
+
+	/* The length of the disk name. */
+	size_t n = strlen( disk );
+
+	if( n == 0 || strncmp( part, disk, n ) != 0 ) { return 0; }
+
+	part += n;
+
+	if( *part == 0 ) { return 1; }
+
+	/* A disk name that ends in a digit puts a 'p' before the partition number. */
+	if( isdigit( disk[n-1] ) )
+	{
+		if( *part != 'p' ) { return 0; }
+		part++;
+	}
+
+	if( ! isdigit( *part ) ) { return 0; }
+	while( isdigit( *part ) ) { part++; }
+
+	return *part == 0;
+
+} /* dwipe_control_partof */
+
+
+static int dwipe_control_overlaps( int k )
+{
+/**
+ * Tells whether a device shares a disk with a device that is being wiped.
+ * The disks are compared through sysfs, and by name when sysfs does not
+ * know one of the devices.
+ *
+ */
+
+	/* The disks of the two devices. */
+	char a [PATH_MAX];
+	char b [PATH_MAX];
+
+	/* Set when sysfs knows the device k. */
+	int known;
+
+	/* A generic loop variable. */
+	int i;
+
+	known = ( dwipe_control_disk( dwipe_control_c[k].device_name, a, sizeof( a ) ) == 0 );
+
+	for( i = 0 ; i < dwipe_control_count ; i++ )
+	{
+		if( i == k || dwipe_control_c[i].device_name == NULL ) { continue; }
+		if( dwipe_control_c[i].state != DWIPE_STATE_QUEUED && dwipe_control_c[i].state != DWIPE_STATE_RUNNING ) { continue; }
+
+		if( known && dwipe_control_disk( dwipe_control_c[i].device_name, b, sizeof( b ) ) == 0 )
+		{
+			if( strcmp( a, b ) == 0 ) { return 1; }
+			continue;
+		}
+
+		if( dwipe_control_partof( dwipe_control_c[k].device_name, dwipe_control_c[i].device_name ) ) { return 1; }
+		if( dwipe_control_partof( dwipe_control_c[i].device_name, dwipe_control_c[k].device_name ) ) { return 1; }
+	}
+
+	return 0;
+
+} /* dwipe_control_overlaps */
+
+
+static int dwipe_control_stop( dwipe_context_t* c )
+{
+/**
+ * Drops a queued device or terminates a running one.
+ *
+ * @returns  Zero on success, -1 if the device is not being wiped.
+ *
+ */
+
+	if( c->state == DWIPE_STATE_QUEUED )
+	{
+		c->state  = DWIPE_STATE_DONE;
+		c->result = -1;
+		c->signal = SIGTERM;
+	}
+
+	else if( c->state == DWIPE_STATE_RUNNING )
+	{
+		kill( c->pid, SIGTERM );
+
+		/* A stopped child only dies once it runs again. */
+		if( c->paused ) { kill( c->pid, SIGCONT ); c->paused = 0; }
+	}
+
+	else
+	{
+		return -1;
+	}
+
+	dwipe_log( DWIPE_LOG_NOTICE, "Stopping the wipe of '%s' on request.", c->device_name );
+	return 0;
+
+} /* dwipe_control_stop */
+
+
+static void dwipe_control_command( dwipe_control_client_t* client, char* line )
+{
+/**
+ * Runs one command line and answers it.
+ *
+ */
+
+	/* The words of the command. */
+	char* verb;
+	char* arg1;
+	char* arg2;
+	char* save;
+
+	/* The device that the command names. */
+	dwipe_context_t* c;
+	int k;
+
+	/* The rate argument. */
+	double rate;
+	char* end;
+
+	/* A generic loop variable. */
+	int i;
+
+	verb = strtok_r( line, " \t\r", &save );
+	arg1 = strtok_r( NULL, " \t\r", &save );
+	arg2 = strtok_r( NULL, " \t\r", &save );
+
+	/* Ignore blank lines. */
+	if( verb == NULL ) { return; }
+
+	if( strcmp( verb, "help" ) == 0 )
+	{
+		dwipe_control_reply( client, "status [device]" );
+		dwipe_control_reply( client, "start <device>" );
+		dwipe_control_reply( client, "stop <device|all>" );
+		dwipe_control_reply( client, "pause <device|all>" );
+		dwipe_control_reply( client, "resume <device|all>" );
+		dwipe_control_reply( client, "rate <device|all> <MB/s, 0 for unlimited>" );
+		dwipe_control_reply( client, "rate-group <device> <MB/s, 0 for unlimited>" );
+		dwipe_control_reply( client, "rate-station <MB/s, 0 for unlimited>" );
+		dwipe_control_reply( client, "quit" );
+		dwipe_control_reply( client, "ok" );
+		return;
+	}
+
+	if( strcmp( verb, "quit" ) == 0 )
+	{
+		dwipe_control_reply( client, "ok" );
+		dwipe_supervise_cancel( dwipe_control_count, dwipe_control_c, SIGTERM );
+		return;
+	}
+
+	if( strcmp( verb, "rate-station" ) == 0 )
+	{
+		rate = arg1 == NULL ? -1 : strtod( arg1, &end );
+
+		if( arg1 == NULL || *end != '\0' || rate < 0 )
+		{
+			dwipe_control_reply( client, "error the rate must be a number of MB/s" );
+			return;
+		}
+
+		dwipe_throttle_station( (u64)( rate * 1000000 ) );
+		dwipe_control_reply( client, "ok" );
+		return;
+	}
+
+	if( strcmp( verb, "status" ) == 0 && arg1 == NULL )
+	{
+		for( i = 0 ; i < dwipe_control_count ; i++ )
+		{
+			/* Empty station slots have nothing to show. */
+			if( dwipe_control_c[i].device_name == NULL ) { continue; }
+			dwipe_control_status( client, i );
+		}
+
+		dwipe_control_reply( client, "ok" );
+		return;
+	}
+
+	if( arg1 == NULL )
+	{
+		dwipe_control_reply( client, "error '%s' is an unknown command or needs a device", verb );
+		return;
+	}
+
+	if( strcmp( arg1, "all" ) == 0 && strcmp( verb, "start" ) != 0 && strcmp( verb, "status" ) != 0 && strcmp( verb, "rate-group" ) != 0 )
+	{
+		/* Apply the command to every device, and never fail for one that is idle. */
+		for( i = 0 ; i < dwipe_control_count ; i++ )
+		{
+			c = &dwipe_control_c[i];
+
+			if( c->state != DWIPE_STATE_QUEUED && c->state != DWIPE_STATE_RUNNING ) { continue; }
+
+			if( strcmp( verb, "stop" ) == 0 ) { dwipe_control_stop( c ); }
+			else if( strcmp( verb, "pause" ) == 0 && c->state == DWIPE_STATE_RUNNING && ! c->paused ) { kill( c->pid, SIGSTOP ); c->paused = 1; }
+			else if( strcmp( verb, "resume" ) == 0 && c->paused ) { kill( c->pid, SIGCONT ); c->paused = 0; }
+		}
+
+		k = -1;
+	}
+
+	else
+	{
+		k = dwipe_control_find( arg1 );
+
+		if( k < 0 )
+		{
+			dwipe_control_reply( client, "error no such device '%s'", arg1 );
+			return;
+		}
+	}
+
+	c = k < 0 ? NULL : &dwipe_control_c[k];
+
+	if( strcmp( verb, "status" ) == 0 )
+	{
+		dwipe_control_status( client, k );
+	}
+
+	else if( strcmp( verb, "start" ) == 0 )
+	{
+		if( c->state != DWIPE_STATE_NONE || c->select != DWIPE_SELECT_FALSE )
+		{
+			dwipe_control_reply( client, "error '%s' cannot be started", c->device_name );
+			return;
+		}
+
+		if( dwipe_control_overlaps( k ) )
+		{
+			dwipe_control_reply( client, "error '%s' shares a disk with a device that is being wiped", c->device_name );
+			return;
+		}
+
+		c->select = DWIPE_SELECT_TRUE;
+
+		if( dwipe_schedule_add( c ) != 0 )
+		{
+			c->select = DWIPE_SELECT_FALSE;
+			dwipe_control_reply( client, "error '%s' could not be queued", c->device_name );
+			return;
+		}
+
+		dwipe_log( DWIPE_LOG_NOTICE, "Queued device '%s' on request.", c->device_name );
+	}
+
+	else if( strcmp( verb, "stop" ) == 0 )
+	{
+		if( c != NULL && dwipe_control_stop( c ) != 0 )
+		{
+			dwipe_control_reply( client, "error '%s' is not being wiped", c->device_name );
+			return;
+		}
+	}
+
+	else if( strcmp( verb, "pause" ) == 0 )
+	{
+		if( c != NULL && ( c->state != DWIPE_STATE_RUNNING || c->paused ) )
+		{
+			dwipe_control_reply( client, "error '%s' is not running", c->device_name );
+			return;
+		}
+
+		if( c != NULL ) { kill( c->pid, SIGSTOP ); c->paused = 1; }
+	}
+
+	else if( strcmp( verb, "resume" ) == 0 )
+	{
+		if( c != NULL && ! c->paused )
+		{
+			dwipe_control_reply( client, "error '%s' is not paused", c->device_name );
+			return;
+		}
+
+		if( c != NULL ) { kill( c->pid, SIGCONT ); c->paused = 0; }
+	}
+
+	else if( strcmp( verb, "rate" ) == 0 )
+	{
+		rate = arg2 == NULL ? -1 : strtod( arg2, &end );
+
+		if( arg2 == NULL || *end != '\0' || rate < 0 )
+		{
+			dwipe_control_reply( client, "error the rate must be a number of MB/s" );
+			return;
+		}
+
+		for( i = 0 ; i < dwipe_control_count ; i++ )
+		{
+			if( dwipe_control_c[i].device_name == NULL || ( c != NULL && i != k ) ) { continue; }
+			dwipe_throttle_set( &dwipe_control_c[i], (u64)( rate * 1000000 ) );
+		}
+	}
+
+	else if( strcmp( verb, "rate-group" ) == 0 )
+	{
+		rate = arg2 == NULL ? -1 : strtod( arg2, &end );
+
+		if( arg2 == NULL || *end != '\0' || rate < 0 )
+		{
+			dwipe_control_reply( client, "error the rate must be a number of MB/s" );
+			return;
+		}
+
+		if( c->group < 0 )
+		{
+			dwipe_control_reply( client, "error '%s' has not been grouped", c->device_name );
+			return;
+		}
+
+		/* The device names the group, so that clients need not know the group numbers. */
+		dwipe_throttle_group( c->group, (u64)( rate * 1000000 ) );
+		dwipe_log( DWIPE_LOG_NOTICE, "Rate limit of the group of '%s' set to %llu B/s.", c->device_name, (u64)( rate * 1000000 ) );
+	}
+
+	else
+	{
+		dwipe_control_reply( client, "error unknown command '%s'", verb );
+		return;
+	}
+
+	dwipe_control_reply( client, "ok" );
+
+} /* dwipe_control_command */
+
+
+static void dwipe_control_close( dwipe_control_client_t* client )
+{
+/**
+ * Forgets a client.
+ *
+ */
+
+	dwipe_supervise_unwatch( client->fd );
+	close( client->fd );
+	client->fd   = -1;
+	client->used = 0;
+
+} /* dwipe_control_close */
+
+
+static void dwipe_control_read( int fd, void* arg )
+{
+/**
+ * Reads what a client sent and runs every complete command in it.
+ *
+ */
+
+	dwipe_control_client_t* client = arg;
+
+	/* The end of a command. */
+	char* eol;
+
+	/* The bytes read. */
+	ssize_t n;
+
+	n = read( fd, client->line + client->used, sizeof( client->line ) - 1 - client->used );
+
+	if( n < 0 && ( errno == EAGAIN || errno == EINTR ) ) { return; }
+
+	if( n <= 0 )
+	{
+		dwipe_control_close( client );
+		return;
+	}
+
+	client->used += n;
+	client->line[ client->used ] = '\0';
+
+	while( ( eol = strchr( client->line, '\n' ) ) != NULL )
+	{
+		*eol = '\0';
+		dwipe_control_command( client, client->line );
+
+		/* Keep what follows the command. */
+		client->used -= eol + 1 - client->line;
+		memmove( client->line, eol + 1, client->used + 1 );
+	}
+
+	if( client->used == sizeof( client->line ) - 1 )
+	{
+		dwipe_control_reply( client, "error the command is too long" );
+		dwipe_control_close( client );
+	}
+
+} /* dwipe_control_read */
+
+
+static void dwipe_control_accept( int fd, void* arg )
+{
+/**
+ * Accepts a new client.
+ *
+ */
+
+	/* The new connection. */
+	int client;
+
+	/* A generic loop variable. */
+	int i;
+
+	client = accept( fd, NULL, NULL );
+
+	if( client < 0 ) { return; }
+
+	fcntl( client, F_SETFL, O_NONBLOCK );
+	fcntl( client, F_SETFD, FD_CLOEXEC );
+
+	for( i = 0 ; i < DWIPE_KNOB_CONTROL_CLIENTS ; i++ )
+	{
+		if( dwipe_control_clients[i].fd < 0 ) { break; }
+	}
+
+	if( i == DWIPE_KNOB_CONTROL_CLIENTS )
+	{
+		dwipe_log( DWIPE_LOG_WARNING, "Refused a control client because there are too many." );
+		close( client );
+		return;
+	}
+
+	if( dwipe_supervise_watch( client, dwipe_control_read, &dwipe_control_clients[i] ) != 0 )
+	{
+		close( client );
+		return;
+	}
+
+	dwipe_control_clients[i].fd   = client;
+	dwipe_control_clients[i].used = 0;
+
+} /* dwipe_control_accept */
+
+
+int dwipe_control_init( const char* path, int count, dwipe_context_t* c )
+{
+/**
+ * Creates the control socket and asks the supervisor to watch it.
+ *
+ * @parameter path   The file name of the socket.
+ * @parameter count  The number of contexts in the array.
+ * @parameter c      The context array that the commands act on.
+ * @returns          Zero on success, -1 on failure.
+ *
+ */
+
+	/* The umask of the process, and the bind() result. */
+	mode_t mask;
+	int r;
+
+	/* A generic loop variable. */
+	int i;
+
+	dwipe_control_count = count;
+	dwipe_control_c     = c;
+
+	for( i = 0 ; i < DWIPE_KNOB_CONTROL_CLIENTS ; i++ )
+	{
+		dwipe_control_clients[i].fd = -1;
+	}
+
+	if( strlen( path ) >= sizeof( dwipe_control_addr.sun_path ) )
+	{
+		dwipe_log( DWIPE_LOG_FATAL, "The control socket path '%s' is too long.", path );
+		return -1;
+	}
+
+	memset( &dwipe_control_addr, 0, sizeof( dwipe_control_addr ) );
+	dwipe_control_addr.sun_family = AF_UNIX;
+	strcpy( dwipe_control_addr.sun_path, path );
+
+	dwipe_control_fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+
+	if( dwipe_control_fd < 0 )
+	{
+		dwipe_perror( errno, __FUNCTION__, "socket" );
+		return -1;
+	}
+
+	/* Remove the socket that an earlier run left behind. */
+	unlink( path );
+
+	/* The socket is created with mode 0600, so no other user can connect before it is restricted. */
+	mask = umask( S_IXUSR | S_IRWXG | S_IRWXO );
+	r = bind( dwipe_control_fd, (struct sockaddr*) &dwipe_control_addr, sizeof( dwipe_control_addr ) );
+	umask( mask );
+
+	if( r != 0 || listen( dwipe_control_fd, DWIPE_KNOB_CONTROL_CLIENTS ) != 0 )
+	{
+		dwipe_perror( errno, __FUNCTION__, "bind" );
+		dwipe_log( DWIPE_LOG_FATAL, "Unable to create the control socket '%s'.", path );
+		close( dwipe_control_fd );
+		dwipe_control_fd = -1;
+		return -1;
+	}
+
+	fcntl( dwipe_control_fd, F_SETFL, O_NONBLOCK );
+	fcntl( dwipe_control_fd, F_SETFD, FD_CLOEXEC );
+
+	if( dwipe_supervise_watch( dwipe_control_fd, dwipe_control_accept, NULL ) != 0 )
+	{
+		dwipe_control_free();
+		return -1;
+	}
+
+	dwipe_log( DWIPE_LOG_NOTICE, "Listening for control commands on '%s'.", path );
+
+	return 0;
+
+} /* dwipe_control_init */
+
+
+void dwipe_control_free( void )
+{
+/**
+ * Closes the control socket and every client, and removes the socket file.
+ *
+ */
+
+	/* A generic loop variable. */
+	int i;
+
+	if( dwipe_control_fd < 0 ) { return; }
+
+	for( i = 0 ; i < DWIPE_KNOB_CONTROL_CLIENTS ; i++ )
+	{
+		if( dwipe_control_clients[i].fd >= 0 ) { dwipe_control_close( &dwipe_control_clients[i] ); }
+	}
+
+	dwipe_supervise_unwatch( dwipe_control_fd );
+	close( dwipe_control_fd );
+	dwipe_control_fd = -1;
+
+	unlink( dwipe_control_addr.sun_path );
+
+} /* dwipe_control_free */
+
+/* eof */
@@ -0,0 +1,34 @@
+/*
+ *  control.h: A local control socket for headless wipes.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef CONTROL_H_
+#define CONTROL_H_
+
+/* The number of control clients that may be connected at once. */
+#define DWIPE_KNOB_CONTROL_CLIENTS  8
+
+/* The longest command line that a client may send. */
+#define DWIPE_KNOB_CONTROL_LINE     256
+
+int  dwipe_control_init( const char* path, int count, dwipe_context_t* c );  /* Listen for commands. */
+void dwipe_control_free( void );                                             /* Remove the socket.   */
+
+#endif /* CONTROL_H_ */
+
+/* eof */
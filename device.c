@@ -19,6 +19,7 @@
  */
 
 #include <netinet/in.h>
+#include <ctype.h>
 #include <string.h>
 #include <scsi/scsi.h>
 
@@ -29,6 +30,8 @@
 #include "identify.h"
 #include "scsicmds.h"
 #include "logging.h"
+#include "range.h"
+#include "geometry.h"
 
 void dwipe_device_strsize(char * buffer, int buflen, loff_t size)
 {
@@ -76,6 +79,67 @@ struct my_scsi_idlun {
     int host_unique_id; /* distinguishes adapter cards from same supplier */
 };
 
+static char* dwipe_device_serial( const char* name )
+{
+    /**
+     * Reads the serial number of a whole disk from sysfs: the serial
+     * attribute of NVMe and some SCSI drivers, else the unit serial number
+     * VPD page, else the world wide identifier.  Partitions have none.
+     *
+     * @parameter  name  The device name without the '/dev/' prefix.
+     * @returns          A string that the caller frees, or NULL.
+     *
+     */
+
+    const char* attributes [] = { "serial", "vpd_pg80", "wwid" };
+    char buffer [256];
+    char path [FILENAME_MAX];
+    char* p;
+    char* q;
+    int fd;
+    int i;
+    ssize_t n;
+
+    for( i = 0 ; i < sizeof( attributes ) / sizeof( attributes[0] ) ; i++ )
+    {
+        snprintf( path, sizeof( path ), "/sys/class/block/%s/device/%s", name, attributes[i] );
+
+        fd = open( path, O_RDONLY );
+        if( fd < 0 )
+            continue;
+
+        n = read( fd, buffer, sizeof( buffer ) - 1 );
+        close( fd );
+
+        if( n <= 0 )
+            continue;
+
+        buffer[n] = 0;
+        p = buffer;
+
+        /* The VPD page starts with a four byte header. */
+        if( i == 1 )
+        {
+            if( n <= 4 )
+                continue;
+            p += 4;
+        }
+
+        /* Trim the padding that drives put around the serial. */
+        while( *p != 0 && ! isgraph( (unsigned char) *p ) )
+            p++;
+        for( q = p ; *q != 0 && isprint( (unsigned char) *q ) ; q++ );
+        *q = 0;
+        while( q > p && ! isgraph( (unsigned char) q[-1] ) )
+            *--q = 0;
+
+        if( *p != 0 )
+            return strdup( p );
+    }
+
+    return NULL;
+}
+
 void dwipe_device_identify( dwipe_context_t* c )
 {
     /**
@@ -102,9 +166,18 @@ void dwipe_device_identify( dwipe_context_t* c )
         return;
     memset(c->label, 0, DWIPE_KNOB_LABEL_SIZE);
 
+    /* Remember the serial number, which identifies the drive across restarts. */
+    c->device_serial = dwipe_device_serial(&(c->device_name[strlen(dprefix)]));
+
     if(ioctl(c->device_fd, SCSI_IOCTL_GET_IDLUN, &sg_scsi) != 0) 
     {
         dwipe_log( DWIPE_LOG_ERROR, "Error: Probe device %s SCSI ID error %d on fd %d.\n", c->device_name, errno, c->device_fd);
+
+        /* Tell the scheduler that we do not know which link this device is on. */
+        c->device_host   = -1;
+        c->device_bus    = -1;
+        c->device_target = -1;
+        c->device_lun    = -1;
         goto err;
     } 
     else 
@@ -262,6 +335,158 @@ err:
 } /* dwipe_device_identify */
 
 
+int dwipe_device_probe( dwipe_context_t* c )
+{
+    /**
+     * Opens a device, reads its geometry and size, and identifies it.
+     *
+     * This may be called from a probe thread, so it only touches c.
+     *
+     * @parameter  c              A context with device_name and device_fd = -1.
+     * @modifies   c->device_*    The device state.
+     * @modifies   c->select      Set to DWIPE_SELECT_DISABLED if the device is read-only.
+     * @returns                   The number of errors, which forbid wiping the device.
+     *
+     */
+
+    /* A result buffer for the BLKGETSIZE64 ioctl. */
+    u64 size64;
+
+    /* The number of errors. */
+    int errors = 0;
+
+    /* Open the file for reads and writes. */
+    c->device_fd = open( c->device_name, O_RDWR );
+
+    /* Check the open() result. */
+    if( c->device_fd < 0 )
+    {
+        dwipe_perror( errno, __FUNCTION__, "open" );
+        dwipe_log( DWIPE_LOG_WARNING, "Unable to open device '%s'. in rw mode", c->device_name );
+        c->select = DWIPE_SELECT_DISABLED;
+        if( ( c->device_fd = open( c->device_name, O_RDONLY ) ) < 0 )
+        {
+            dwipe_perror( errno, __FUNCTION__, "open" );
+            dwipe_log( DWIPE_LOG_WARNING, "Unable to open device '%s'. in ro mode", c->device_name );
+            dwipe_device_identify( c );
+            return 0;
+        }
+    }
+
+    /* Stat the file. */
+    if( fstat( c->device_fd, &c->device_stat ) != 0 )
+    {
+        dwipe_perror( errno, __FUNCTION__, "fstat" );
+        dwipe_log( DWIPE_LOG_ERROR, "Unable to stat file '%s'.", c->device_name );
+        return 1;
+    }
+
+    /* Check that the file is a block device. */
+    if( ! S_ISBLK( c->device_stat.st_mode ) )
+    {
+        dwipe_log( DWIPE_LOG_ERROR, "'%s' is not a block device.", c->device_name );
+        return 1;
+    }
+
+    /* Do sector size and block size checking. */
+
+    if( ioctl( c->device_fd, BLKSSZGET, &c->sector_size ) == 0 )
+    {
+        dwipe_log( DWIPE_LOG_INFO, "Device '%s' has sector size %i.", c->device_name, c->sector_size );
+
+        if( ioctl( c->device_fd, BLKBSZGET, &c->block_size ) == 0 )
+        {
+            if( c->block_size != c->sector_size )
+            {
+                dwipe_log( DWIPE_LOG_WARNING, "Changing '%s' block size from %i to %i.", c->device_name, c->block_size, c->sector_size );
+                if( ioctl( c->device_fd, BLKBSZSET, &c->sector_size ) == 0 )
+                {
+                    c->block_size = c->sector_size;
+                }
+
+                else
+                {
+                    dwipe_log( DWIPE_LOG_WARNING, "Device '%s' failed BLKBSZSET ioctl.", c->device_name );
+                }
+            }
+        }
+        else
+        {
+            dwipe_log( DWIPE_LOG_WARNING, "Device '%s' failed BLKBSZGET ioctl.", c->device_name );
+            c->block_size  = 0;
+        }
+    }
+
+    else
+    {
+        dwipe_log( DWIPE_LOG_WARNING, "Device '%s' failed BLKSSZGET ioctl.", c->device_name );
+        c->sector_size = 0;
+        c->block_size  = 0;
+    }
+
+
+    /* The st_size field is zero for block devices. */
+
+    /* Seek to the end of the device to determine its size. */
+    c->device_size = lseek( c->device_fd, 0, SEEK_END );
+
+    /* Also ask the driver for the device size. */
+    if( ioctl( c->device_fd, _IOR(0x12,114,size_t), &size64 ) )
+    {
+        /* The ioctl failed. */
+        dwipe_log( DWIPE_LOG_ERROR, "BLKGETSIZE64 failed  on '%s'.\n", c->device_name );
+        errors++;
+    }
+
+    /* Check whether the two size values agree. */
+    else if( c->device_size != size64 )
+    {
+        /* This could be caused by the linux last-odd-block problem. */
+        dwipe_log( DWIPE_LOG_ERROR, "Last-odd-block detected on '%s'.", c->device_name  );
+        errors++;
+    }
+
+    if( c->device_size == (loff_t)-1 )
+    {
+        /* We cannot determine the size of this device. */
+        dwipe_perror( errno, __FUNCTION__, "lseek" );
+        dwipe_log( DWIPE_LOG_ERROR, "Unable to determine the size of '%s'.", c->device_name );
+        errors++;
+    }
+
+    else if( lseek( c->device_fd, 0, SEEK_SET ) == (loff_t)-1 )
+    {
+        /* Reset the file pointer. */
+        dwipe_perror( errno, __FUNCTION__, "lseek" );
+        dwipe_log( DWIPE_LOG_ERROR, "Unable to reset the '%s' file offset.", c->device_name );
+        errors++;
+    }
+
+    if( c->device_size == 0 )
+    {
+        dwipe_log( DWIPE_LOG_ERROR, "Device '%s' is size %llu.", c->device_name, c->device_size );
+        return errors + 1;
+    }
+
+    else
+    {
+        dwipe_log( DWIPE_LOG_INFO, "Device '%s' is size %llu.", c->device_name,  c->device_size );
+    }
+
+    /* Try to get detailed information about this device. */
+    dwipe_device_identify( c );
+
+    /* Choose the block size of the passes from the queue limits. */
+    errors += dwipe_geometry_probe( c );
+
+    /* Find the parts of the device that the passes cover. */
+    errors += dwipe_range_resolve( c );
+
+    return errors;
+
+} /* dwipe_device_probe */
+
+
 int dwipe_device_scan( char*** device_names )
 {
     /**
@@ -23,6 +23,7 @@
 #define DEVICE_H_
 
 void dwipe_device_identify( dwipe_context_t* c );  /* Get hardware information about the device.  */
+int  dwipe_device_probe( dwipe_context_t* c );     /* Open, measure and identify one device.      */
 int  dwipe_device_scan( char*** device_names );    /* Find devices that we can wipe.              */
 
 #endif /* DEVICE_H_ */
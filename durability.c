@@ -0,0 +1,305 @@
+/*
+ *  durability.c: The policies that make writes durable.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+/* RATIONALE:
+ *
+ *   The -s option was parsed and logged, but nothing used it: every pass
+ *   was written through the page cache and flushed once at its end.  Now it
+ *   picks one of these policies, from the fastest to the most careful:
+ *
+ *     none      No flush at all.  The kernel writes the cache back when it
+ *               likes, and a verification may read the cache rather than
+ *               the media.  Only useful to measure the other policies.
+ *     pass      An fdatasync() at the end of each pass, with the rolling
+ *               writeback of writeback.c.  This is the default.
+ *     periodic  Also an fdatasync() every --sync=periodic:MiB of writes, so
+ *               that a power cut loses at most that much of a pass.
+ *     dsync     The device is opened again with O_DSYNC, so every write
+ *               returns once its data is on the media.
+ *     fua       Every block is written with direct i/o and RWF_DSYNC,
+ *               which the block layer turns into a write with Force Unit
+ *               Access on drives that support it, and into a write and a
+ *               cache flush on the others.
+ *
+ *   Passes issue one synchronous request at a time, so fua goes through
+ *   pwritev2() on a direct descriptor rather than through an asynchronous
+ *   engine.  Blocks that are not aligned for direct i/o, and kernels without
+ *   RWF_DSYNC, get a buffered write and an fdatasync() instead.
+ *
+ *   The time of every explicit flush is counted as sync time, and the result
+ *   file reports it with the rate at which the device took writes.  The cost
+ *   of dsync and fua is in the write latency itself, so the policies are
+ *   best compared by that rate.
+ *
+ */
+
+/* dwipe.h comes first, because it asks for the GNU extensions that these use. */
+#include "dwipe.h"
+
+#include <limits.h>
+#include <sys/uio.h>
+
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "logging.h"
+#include "progress.h"
+#include "arena.h"
+#include "durability.h"
+
+
+/* The direct i/o descriptor of the fua policy, or -1. */
+static int dwipe_durability_fd = -1;
+
+/* The bytes written since the last flush of the periodic policy. */
+static u64 dwipe_durability_dirty = 0;
+
+
+int dwipe_durability_parse( const char* spec, dwipe_sync_t* sync, int* period )
+{
+/**
+ * Reads the argument of the --sync option.
+ *
+ * @parameter spec    One of none, pass, periodic[:MiB], dsync or fua.
+ * @parameter sync    Receives the policy.
+ * @parameter period  Receives the megabytes of a periodic policy that gives them.
+ * @return            0 on success, -1 on a syntax error.
+ *
+ */
+
+	/* The end of the period. */
+	char* end;
+
+	/* The period that the policy gives. */
+	long megabytes;
+
+	if( strcmp( spec, "none"  ) == 0 ) { *sync = DWIPE_SYNC_NONE;  return 0; }
+	if( strcmp( spec, "pass"  ) == 0 ) { *sync = DWIPE_SYNC_PASS;  return 0; }
+	if( strcmp( spec, "dsync" ) == 0 ) { *sync = DWIPE_SYNC_DSYNC; return 0; }
+	if( strcmp( spec, "fua"   ) == 0 ) { *sync = DWIPE_SYNC_FUA;   return 0; }
+
+	if( strncmp( spec, "periodic", 8 ) != 0 ) { return -1; }
+
+	if( spec[8] == ':' )
+	{
+		megabytes = strtol( spec + 9, &end, 10 );
+		if( end == spec + 9 || *end != 0 || megabytes <= 0 || megabytes > INT_MAX ) { return -1; }
+		*period = megabytes;
+	}
+
+	else if( spec[8] != 0 ) { return -1; }
+
+	*sync = DWIPE_SYNC_PERIODIC;
+	return 0;
+
+} /* dwipe_durability_parse */
+
+
+const char* dwipe_durability_name( dwipe_sync_t sync )
+{
+/**
+ * Names a policy for the log and the result file.
+ *
+ */
+
+	switch( sync )
+	{
+		case DWIPE_SYNC_NONE:     return "none";
+		case DWIPE_SYNC_PERIODIC: return "periodic";
+		case DWIPE_SYNC_DSYNC:    return "dsync";
+		case DWIPE_SYNC_FUA:      return "fua";
+		case DWIPE_SYNC_PASS:     break;
+	}
+
+	return "pass";
+
+} /* dwipe_durability_name */
+
+
+int dwipe_durability_open( dwipe_context_t* c )
+{
+/**
+ * Applies the policy to the descriptors of a device.  The child calls this
+ * before its first write.
+ *
+ * @return  0 on success, -1 when the device cannot be written as asked.
+ *
+ */
+
+	/* The descriptor with the flags of the policy. */
+	int fd;
+
+	dwipe_durability_dirty = 0;
+
+	if( dwipe_options.sync == DWIPE_SYNC_FUA )
+	{
+		dwipe_durability_fd = open( c->device_name, O_RDWR | O_DIRECT | O_CLOEXEC );
+
+		if( dwipe_durability_fd >= 0 )
+		{
+			dwipe_log( DWIPE_LOG_NOTICE, "Device '%s' is written with the 'fua' sync policy.", c->device_name );
+			return 0;
+		}
+
+		/* Without direct i/o, a buffered write and a flush give the same guarantee. */
+		dwipe_perror( errno, __FUNCTION__, "open" );
+		dwipe_log( DWIPE_LOG_WARNING, "Device '%s' has no direct i/o and flushes after every block.", c->device_name );
+		return 0;
+	}
+
+	if( dwipe_options.sync == DWIPE_SYNC_DSYNC )
+	{
+		/* Linux ignores O_DSYNC in F_SETFL, so the descriptor is opened again in its place. */
+		fd = open( c->device_name, O_RDWR | O_DSYNC | O_CLOEXEC );
+
+		if( fd < 0 || dup2( fd, c->device_fd ) < 0 )
+		{
+			dwipe_perror( errno, __FUNCTION__, fd < 0 ? "open" : "dup2" );
+			dwipe_log( DWIPE_LOG_FATAL, "Unable to open '%s' for synchronous writes.", c->device_name );
+			if( fd >= 0 ) { close( fd ); }
+			return -1;
+		}
+
+		close( fd );
+	}
+
+	dwipe_log( DWIPE_LOG_NOTICE, "Device '%s' is written with the '%s' sync policy.", \
+	  c->device_name, dwipe_durability_name( dwipe_options.sync ) );
+
+	return 0;
+
+} /* dwipe_durability_open */
+
+
+static int dwipe_durability_flush( dwipe_context_t* c )
+{
+/**
+ * Flushes the device and counts the time as sync time.
+ *
+ */
+
+	/* The clock when the flush started. */
+	u64 t;
+
+	/* The result holder. */
+	int r;
+
+	t = dwipe_progress_clock();
+	r = fdatasync( c->device_fd );
+	dwipe_progress_count( c, &c->progress->sync_ns, dwipe_progress_clock() - t );
+
+	dwipe_durability_dirty = 0;
+
+	return r;
+
+} /* dwipe_durability_flush */
+
+
+ssize_t dwipe_durability_pwrite( dwipe_context_t* c, const void* buffer, size_t count, u64 offset )
+{
+/**
+ * Writes a block of a pass like pwrite(), with the durability of the policy.
+ *
+ */
+
+	/* The block as a vector for pwritev2(). */
+	struct iovec iov;
+
+	/* The sector size, which direct i/o is aligned to. */
+	size_t sector = ( c->sector_size > 0 ) ? c->sector_size : 512;
+
+	/* The result holder. */
+	ssize_t r;
+
+	if( dwipe_options.sync == DWIPE_SYNC_FUA )
+	{
+		if( dwipe_durability_fd >= 0 && (unsigned long) buffer % DWIPE_KNOB_ARENA_ALIGN == 0 \
+		    && offset % sector == 0 && count % sector == 0 )
+		{
+			iov.iov_base = (void*) buffer;
+			iov.iov_len  = count;
+
+			r = pwritev2( dwipe_durability_fd, &iov, 1, offset, RWF_DSYNC );
+
+			if( r >= 0 || ( errno != EOPNOTSUPP && errno != ENOSYS ) ) { return r; }
+
+			dwipe_log( DWIPE_LOG_WARNING, "Device '%s' has no RWF_DSYNC and flushes after every block.", c->device_name );
+			close( dwipe_durability_fd );
+			dwipe_durability_fd = -1;
+		}
+
+		r = pwrite( c->device_fd, buffer, count, offset );
+		if( r > 0 && dwipe_durability_flush( c ) != 0 ) { return -1; }
+
+		return r;
+	}
+
+	r = pwrite( c->device_fd, buffer, count, offset );
+
+	if( r > 0 && dwipe_durability_written( c, r ) != 0 ) { return -1; }
+
+	return r;
+
+} /* dwipe_durability_pwrite */
+
+
+int dwipe_durability_written( dwipe_context_t* c, u64 bytes )
+{
+/**
+ * Counts bytes that were written without dwipe_durability_pwrite(), and
+ * flushes when the periodic policy is due.
+ *
+ * @return  0 on success, -1 when the flush failed.
+ *
+ */
+
+	if( dwipe_options.sync != DWIPE_SYNC_PERIODIC ) { return 0; }
+
+	dwipe_durability_dirty += bytes;
+
+	if( dwipe_durability_dirty >= (u64) dwipe_options.sync_period << 20 && dwipe_durability_flush( c ) != 0 )
+	{
+		return -1;
+	}
+
+	return 0;
+
+} /* dwipe_durability_written */
+
+
+int dwipe_durability_sync( dwipe_context_t* c )
+{
+/**
+ * Flushes the device at the end of a pass, unless the policy says not to.
+ *
+ * @return  The fdatasync() result.
+ *
+ */
+
+	if( dwipe_options.sync == DWIPE_SYNC_NONE ) { return 0; }
+
+	/* The pass times this flush itself. */
+	dwipe_durability_dirty = 0;
+
+	return fdatasync( c->device_fd );
+
+} /* dwipe_durability_sync */
+
+/* eof */
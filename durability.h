@@ -0,0 +1,35 @@
+/*
+ *  durability.h: The policies that make writes durable.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef DURABILITY_H_
+#define DURABILITY_H_
+
+/* The default megabytes between flushes of the periodic policy. */
+#define DWIPE_KNOB_SYNC_PERIOD  256
+
+int         dwipe_durability_parse( const char* spec, dwipe_sync_t* sync, int* period );  /* Read a policy. */
+const char* dwipe_durability_name( dwipe_sync_t sync );                 /* Name a policy.                 */
+int         dwipe_durability_open( dwipe_context_t* c );                /* Apply the policy to a device.  */
+ssize_t     dwipe_durability_pwrite( dwipe_context_t* c, const void* buffer, size_t count, u64 offset );  /* Write a block. */
+int         dwipe_durability_written( dwipe_context_t* c, u64 bytes );  /* Count bytes written elsewhere. */
+int         dwipe_durability_sync( dwipe_context_t* c );                /* Flush at the end of a pass.    */
+
+#endif /* DURABILITY_H_ */
+
+/* eof */
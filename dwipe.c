@@ -20,8 +20,6 @@
  */
 
 
-#include <time.h>
-
 #include "dwipe.h"
 #include "context.h"
 #include "method.h"
@@ -30,6 +28,26 @@
 #include "device.h"
 #include "logging.h"
 #include "gui.h"
+#include "schedule.h"
+#include "supervise.h"
+#include "progress.h"
+#include "probe.h"
+#include "result.h"
+#include "station.h"
+#include "throttle.h"
+#include "control.h"
+#include "events.h"
+#include "metrics.h"
+#include "peer.h"
+#include "journal.h"
+#include "range.h"
+#include "badsector.h"
+#include "geometry.h"
+#include "tune.h"
+#include "arena.h"
+#include "writeback.h"
+#include "durability.h"
+#include "eta.h"
 
 #ifdef BB_DWIPE
 #include "mt19937ar-cok.c"
@@ -41,6 +59,26 @@
 #include "method.c"
 #include "logging.c"
 #include "prng.c"
+#include "schedule.c"
+#include "supervise.c"
+#include "progress.c"
+#include "probe.c"
+#include "result.c"
+#include "station.c"
+#include "throttle.c"
+#include "control.c"
+#include "events.c"
+#include "metrics.c"
+#include "peer.c"
+#include "journal.c"
+#include "range.c"
+#include "badsector.c"
+#include "geometry.c"
+#include "tune.c"
+#include "arena.c"
+#include "writeback.c"
+#include "durability.c"
+#include "eta.c"
 #endif
 
 #include <sys/ioctl.h>  /* FIXME: Twice Included */
@@ -57,20 +95,12 @@ int main( int argc, char** argv )
 	int dwipe_optind;       /* The result of dwipe_options().                    */
 	int dwipe_enumerated;   /* The number of contexts that have been enumerated. */
 	int dwipe_error = 0;    /* An error counter.                                 */
-	int dwipe_pid;          /* The fork() result holder.                         */
 	int dwipe_selected = 0; /* The number of contexts that have been selected.   */
+	int dwipe_slots;        /* The capacity of the array of selected contexts.   */
 	int dwipe_shmid;        /* A shared memory handle for the context array.     */
-	int dwipe_wait  = 0;    /* The number of child processes that have returned. */
-    
-    /* Exclude device by command */
-    dwipe_context_t * dwipe_exclude_device = NULL;
 
 	/* The list of device filenames. */
 	char** dwipe_names = NULL;
-	
-	/* Used to write-out the result file. */
-	char dwipe_result_file [FILENAME_MAX];
-	FILE* dwipe_result_fp;
 
 	/* The entropy source file handle. */
 	int dwipe_entropy; 
@@ -88,6 +118,9 @@ int main( int argc, char** argv )
 	/* The array of contexts that will actually be wiped. */
 	dwipe_context_t* c2;
 
+	/* Parse command line options first, because they say where the log goes. */
+	dwipe_optind = dwipe_options_parse( argc, argv );
+
 	dwipe_log( DWIPE_LOG_NOTICE, "Program loaded." );
 
 	/* Open the entropy source. */
@@ -103,8 +136,8 @@ int main( int argc, char** argv )
 
 	dwipe_log( DWIPE_LOG_NOTICE, "Opened entropy source '%s'.", DWIPE_KNOB_ENTROPY );
 
-	/* Parse command line options. */
-	dwipe_optind = dwipe_options_parse( argc, argv );
+	/* Record the options that this run will use. */
+	dwipe_options_log();
 
 
 	if( dwipe_optind == argc )
@@ -150,200 +183,14 @@ int main( int argc, char** argv )
 	/* Create a context struct for each device. */
 	for( i = 0; i < dwipe_enumerated; i++ )
 	{
-		/* A result buffer for the BLKGETSIZE64 ioctl. */
-		u64 size64;
-
 		/* Set the entropy source. */
 		c1[i].entropy_fd = dwipe_entropy;
 
-		/* Get the file name. */	
-		c1[i].device_name = dwipe_names[i];
-
-		/* Open the file for reads and writes. */
-		c1[i].device_fd = open( c1[i].device_name, O_RDWR );
-
-		/* Check the open() result. */
-		if( c1[i].device_fd < 0 )
-		{
-			dwipe_perror( errno, __FUNCTION__, "open" );
-			dwipe_log( DWIPE_LOG_WARNING, "Unable to open device '%s'. in rw mode", c1[i].device_name );
-			c1[i].select = DWIPE_SELECT_DISABLED;
-            if((c1[i].device_fd = open( c1[i].device_name, O_RDONLY )) < 0) 
-            {
-			    dwipe_perror( errno, __FUNCTION__, "open" );
-			    dwipe_log( DWIPE_LOG_WARNING, "Unable to open device '%s'. in ro mode", c1[i].device_name );
-                dwipe_device_identify(&c1[i]);
-                continue;
-            }
-		}
-
-		/* Stat the file. */
-		if( fstat( c1[i].device_fd, &c1[i].device_stat ) != 0 ) 
-		{
-			dwipe_perror( errno, __FUNCTION__, "fstat");
-			dwipe_log( DWIPE_LOG_ERROR, "Unable to stat file '%s'.", c1[i].device_name );
-			dwipe_error++;
-			continue;
-		}
-
-		/* Check that the file is a block device. */
-		if( ! S_ISBLK( c1[i].device_stat.st_mode ) )
-		{
-			dwipe_log( DWIPE_LOG_ERROR, "'%s' is not a block device.", c1[i].device_name );
-			dwipe_error++;
-			continue;
-		}
-
-		/* Lock the file for exclusive access. */
-		/* TODO: Determine why the LOCK_NB flag is not being honored. */
-/* 
-		if( flock( c1[i].device_fd, LOCK_EX | LOCK_NB ) != 0 )
-		{
-			dwipe_perror( errno, __FUNCTION__, "flock" );
-			dwipe_log( DWIPE_LOG_ERROR, "Unable to lock the '%s' file.", c1[i].device_name );
-			dwipe_error++;
-			continue;
-		}
-*/
-
-		/* Do sector size and block size checking. */
+		/* Get the file name.  Contexts own their names, which may be freed or replaced. */	
+		c1[i].device_name = strdup( dwipe_names[i] );
 
-		if( ioctl( c1[i].device_fd, BLKSSZGET, &c1[i].sector_size ) == 0 )
-		{
-			dwipe_log( DWIPE_LOG_INFO, "Device '%s' has sector size %i.", c1[i].device_name,  c1[i].sector_size );
-
-			if( ioctl( c1[i].device_fd, BLKBSZGET, &c1[i].block_size ) == 0 )
-			{
-				if( c1[i].block_size != c1[i].sector_size )
-				{
-					dwipe_log( DWIPE_LOG_WARNING, "Changing '%s' block size from %i to %i.", c1[i].device_name, c1[i].block_size, c1[i].sector_size );
-					if( ioctl( c1[i].device_fd, BLKBSZSET, &c1[i].sector_size ) == 0 )
-					{
-						c1[i].block_size = c1[i].sector_size;
-					}
-
-					else
-					{
-						dwipe_log( DWIPE_LOG_WARNING, "Device '%s' failed BLKBSZSET ioctl.", c1[i].device_name );
-					}
-				}
-			}
-			else
-			{
-				dwipe_log( DWIPE_LOG_WARNING, "Device '%s' failed BLKBSZGET ioctl.", c1[i].device_name );
-				c1[i].block_size  = 0;
-			}
-		}
-
-		else
-		{
-			dwipe_log( DWIPE_LOG_WARNING, "Device '%s' failed BLKSSZGET ioctl.", c1[i].device_name );
-			c1[i].sector_size = 0;
-			c1[i].block_size  = 0;
-		}
-
-
-		/* The st_size field is zero for block devices. */
-		/* ioctl( c1[i].device_fd, BLKGETSIZE64, &c1[i].device_size ); */
-
-		/* Seek to the end of the device to determine its size. */
-		c1[i].device_size = lseek( c1[i].device_fd, 0, SEEK_END );
-
-		/* Also ask the driver for the device size. */
-		/* if( ioctl( c1[i].device_fd, BLKGETSIZE64, &size64 ) ) */
-		if( ioctl( c1[i].device_fd, _IOR(0x12,114,size_t), &size64 ) )
-		{
-			/* The ioctl failed. */
-			fprintf( stderr, "Error: BLKGETSIZE64 failed  on '%s'.\n", c1[i].device_name );
-			dwipe_log( DWIPE_LOG_ERROR, "BLKGETSIZE64 failed  on '%s'.\n", c1[i].device_name );
-			dwipe_error++;
-		}
-
-		/* Check whether the two size values agree. */
-		if( c1[i].device_size != size64 )
-		{
-			/* This could be caused by the linux last-odd-block problem. */
-			fprintf( stderr, "Error: Last-odd-block detected on '%s'.\n", c1[i].device_name );
-			dwipe_log( DWIPE_LOG_ERROR, "Last-odd-block detected on '%s'.", c1[i].device_name  );
-			dwipe_error++;
-		}
-
-		if( c1[i].device_size == (loff_t)-1 )
-		{
-			/* We cannot determine the size of this device. */
-			dwipe_perror( errno, __FUNCTION__, "lseek" );
-			dwipe_log( DWIPE_LOG_ERROR, "Unable to determine the size of '%s'.", c1[i].device_name );
-			dwipe_error++;
-		}
-
-		else
-		{
-			/* Reset the file pointer. */
-			r = lseek( c1[i].device_fd, 0, SEEK_SET );
-	
-			if( r == (loff_t)-1 )
-			{
-				dwipe_perror( errno, __FUNCTION__, "lseek" );
-				dwipe_log( DWIPE_LOG_ERROR, "Unable to reset the '%s' file offset.", c1[i].device_name );
-				dwipe_error++;
-			}
-		}
-
-		if( c1[i].device_size == 0 )
-		{
-			dwipe_log( DWIPE_LOG_ERROR, "Device '%s' is size %llu.", c1[i].device_name, c1[i].device_size );
-			dwipe_error++;
-			continue;
-		}
-
-		else
-		{
-			dwipe_log( DWIPE_LOG_INFO, "Device '%s' is size %llu.", c1[i].device_name,  c1[i].device_size );
-		}
-
-		/* Try to get detailed information about this device. */
-		dwipe_device_identify( &c1[i] );
-
-        if(dwipe_options.exclude && !strcmp(c1[i].device_name, dwipe_options.exclude)) 
-        {
-            c1[i].select = DWIPE_SELECT_SKIPPED;
-            dwipe_log( DWIPE_LOG_INFO, "Device '%s' is excluded.", c1[i].device_name);
-
-            if(c1[i].device_part == 0) // if device is a disk, exclude all partations
-            {
-                dwipe_exclude_device = &c1[i]; // save dwipe_exclude_device
-            }
-        }
-
-        // trick: disk always processed before it's partations
-        if(dwipe_exclude_device) 
-        {
-            if(c1[i].device_type       == dwipe_exclude_device->device_type
-                && c1[i].device_host   == dwipe_exclude_device->device_host
-                && c1[i].device_bus    == dwipe_exclude_device->device_bus
-                && c1[i].device_target == dwipe_exclude_device->device_target
-                && c1[i].device_lun    == dwipe_exclude_device->device_lun
-                && c1[i].device_part > 0)
-            {
-                c1[i].select = DWIPE_SELECT_SKIPPED;
-                dwipe_log( DWIPE_LOG_INFO, "Device '%s' is excluded.", c1[i].device_name);
-            }
-        }
-
-		if( dwipe_options.autonuke )
-		{
-			/* When the autonuke option is set, select all disks. */
-			if( c1[i].device_part == 0 && c1[i].select != DWIPE_SELECT_DISABLED && c1[i].select != DWIPE_SELECT_SKIPPED)
-				{ c1[i].select = DWIPE_SELECT_TRUE; }
-			else if( c1[i].select != DWIPE_SELECT_DISABLED && c1[i].select != DWIPE_SELECT_SKIPPED) 
-				{ c1[i].select = DWIPE_SELECT_TRUE_PARENT; }
-		}
-		else
-		{
-			/* The user must manually select devices. */
-            if(c1[i].select != DWIPE_SELECT_DISABLED && c1[i].select != DWIPE_SELECT_SKIPPED)
-			    c1[i].select = DWIPE_SELECT_FALSE;
-		}
+		/* The probe opens the device. */
+		c1[i].device_fd = -1;
 
 		/* Set the PRNG implementation. */
 		c1[i].prng = dwipe_options.prng;
@@ -353,43 +200,62 @@ int main( int argc, char** argv )
 
 	} /* file arguments */
 
+	/* Open, measure and identify the devices concurrently. */
+	if( dwipe_probe_start( dwipe_enumerated, c1 ) != 0 ) { return -1; }
+
+	if( dwipe_options.autonuke == 1 || dwipe_options.headless )
+	{
+		/* Nobody will select devices, so every probe must finish first. */
+		dwipe_error = dwipe_probe_wait( dwipe_enumerated, c1 );
+	}
+
 	/* Check for initialization errors. */
 	if( dwipe_error ) { return -1; }
 
-	/* Start the ncurses interface. */
-	dwipe_gui_init();
-	
-	
-	if( dwipe_options.autonuke == 1 )
+	if( dwipe_options.headless )
+	{
+		/* Control clients take the place of the terminal. */
+	}
+
+	else if( dwipe_options.autonuke == 1 )
 	{
-		/* Print the options window. */
+		/* Start the ncurses interface and print the options window. */
+		dwipe_gui_init();
 		dwipe_gui_options();
 	}
 
 	else
 	{
-		/* Get device selections from the user. */
+		/* Start the ncurses interface and get device selections from the user. */
+		dwipe_gui_init();
 		dwipe_gui_select( dwipe_enumerated, c1 );
 	}
 
-	/* Count the number of selected contexts. */
+	/* Devices that are still probing cannot be wiped. */
+	dwipe_probe_finish( dwipe_enumerated, c1 );
+
+	/* Count the number of selected contexts.  A controlled daemon keeps the others idle. */
 	for( i = 0 ; i < dwipe_enumerated ; i++ )
 	{
-		if( c1[i].select == DWIPE_SELECT_TRUE )
+		if( c1[i].select == DWIPE_SELECT_TRUE || ( dwipe_options.headless && c1[i].select == DWIPE_SELECT_FALSE ) )
 		{
 			dwipe_selected += 1;
 		}
 	}
 
+	/* A station keeps empty slots for drives that are plugged in later. */
+	dwipe_slots = dwipe_selected;
+	if( dwipe_options.station ) { dwipe_slots += DWIPE_KNOB_STATION_SLOTS; }
+
 	/* Allocate shared memory for the array of selected contexts. */ 
-	dwipe_shmid = shmget( IPC_PRIVATE, dwipe_selected * sizeof( dwipe_context_t ), S_IRUSR | S_IWUSR );
+	dwipe_shmid = shmget( IPC_PRIVATE, dwipe_slots * sizeof( dwipe_context_t ), S_IRUSR | S_IWUSR );
 
 	/* Check the allocation result. */
 	if( dwipe_shmid < 0 )
 	{
 		dwipe_perror( errno, __FUNCTION__, "shmget" );
 		dwipe_log( DWIPE_LOG_FATAL, "Unable to allocate shared memory for the context array." );
-		dwipe_log( DWIPE_LOG_FATAL, "The return was %l for size %l.", dwipe_shmid, dwipe_selected * sizeof( dwipe_context_t ) );
+		dwipe_log( DWIPE_LOG_FATAL, "The return was %l for size %l.", dwipe_shmid, dwipe_slots * sizeof( dwipe_context_t ) );
 		dwipe_gui_free();
 		return errno;
 	}
@@ -409,7 +275,7 @@ int main( int argc, char** argv )
 	/* Populate the array of selected contexts. */
 	for( i = 0, j = 0 ; i < dwipe_enumerated ; i++ )
 	{
-		if( c1[i].select == DWIPE_SELECT_TRUE )
+		if( c1[i].select == DWIPE_SELECT_TRUE || ( dwipe_options.headless && c1[i].select == DWIPE_SELECT_FALSE ) )
 		{
 			/* Copy the context. */
 			c2[j++] = c1[i];
@@ -418,11 +284,13 @@ int main( int argc, char** argv )
 		else
 		{
 			/* Close the device file descriptor. */
-			close( c1[i].device_fd );
+			if( c1[i].device_fd >= 0 ) { close( c1[i].device_fd ); }
 
 			/* Release private resources. */
-			free( c1[i].device_name );
-			free( c1[i].label       );
+			free( c1[i].device_name   );
+			free( c1[i].device_serial );
+			free( c1[i].ranges        );
+			free( c1[i].label         );
 		}
 
 	} /* for */
@@ -431,148 +299,108 @@ int main( int argc, char** argv )
 	free( c1 );
 
 
-	for( i = 0 ; i < dwipe_selected ; i++ )
+	/* Give each device its own cache line for the counters that its child publishes. */
+	if( dwipe_progress_init( dwipe_slots, c2 ) != 0 )
 	{
-		if( c2[i].select )
-		{
-			/* Fork a child process. */
-			dwipe_pid = fork();
-
-			if( dwipe_pid )
-			{
-				/* The parent puts the child process number in its context. */
-				c2[i].pid = dwipe_pid;
-			}
-
-			else
-			{
-				/* The child invokes the wipe method and exits. */
-				return dwipe_options.method( &c2[i] );
-			}
-		}
-
-		else
-		{
-			c2[i].pid = -1;
-			dwipe_wait += 1;
-		}
+		dwipe_gui_free();
+		return -1;
+	}
 
-	} /* forking */
+	/* Share the bandwidth caps between the children. */
+	if( dwipe_throttle_init( dwipe_slots, c2 ) != 0 )
+	{
+		dwipe_gui_free();
+		return -1;
+	}
 
-	/* Change the terminal mode to non-blocking input. */
-	nodelay( stdscr, 0 );
-	halfdelay( DWIPE_KNOB_SLEEP * 10 );
-	
-	while( dwipe_wait < dwipe_selected )
+	/* Give each device a list of the bad sectors that its passes skip. */
+	if( dwipe_badsector_init( dwipe_slots, c2 ) != 0 )
 	{
-		/* Sleeping is handled by the getch block. */
+		dwipe_gui_free();
+		return -1;
+	}
 
-		/* Sleep between update intervals. */
-		/* sleep( DWIPE_KNOB_SLEEP );      */
+	/* Give each device a model of its remaining runtime. */
+	if( dwipe_eta_init( dwipe_slots, c2 ) != 0 )
+	{
+		dwipe_gui_free();
+		return -1;
+	}
 
-		/* Enumerate child processes. */
-		for( i = 0 ; i < dwipe_selected ; i++ )
-		{
-			if( c2[i].pid > 0 )
-			{
-				c2[i].result = waitpid( c2[i].pid, &c2[i].status, WNOHANG ); 
+	/* Give each device a ring for the messages of its child. */
+	if( dwipe_log_init( dwipe_slots, c2 ) != 0 )
+	{
+		dwipe_gui_free();
+		return -1;
+	}
 
-				/* Check for fatal errors. */
-				if( c2[i].result < 0 )
-				{
-					dwipe_perror( errno, __FUNCTION__, "waitpid" );
-					dwipe_gui_free();
-					return errno;
-				}
+	/* Set huge pages aside for the buffers of the children.  The wipes run without them. */
+	if( dwipe_options.hugepages == DWIPE_HUGEPAGES_RESERVE ) { dwipe_arena_reserve( dwipe_slots, c2 ); }
 
-				if( c2[i].result > 0 )
-				{
-					/* The child has been reaped. */
-					c2[i].pid = 0;
+	/* Give each device an event ring before anything is queued. */
+	if( dwipe_options.events && dwipe_events_init( dwipe_options.events, dwipe_slots, c2 ) != 0 )
+	{
+		dwipe_gui_free();
+		return -1;
+	}
 
-					if( WIFEXITED( c2[i].status ) )
-					{
-						/* The child returned normally. */
-						c2[i].result = WEXITSTATUS( c2[i].status );
-					}
+	/* Group the devices by host adapter and bus, and queue them. */
+	if( dwipe_schedule_init( dwipe_slots, c2 ) != 0 )
+	{
+		dwipe_gui_free();
+		return -1;
+	}
 
-					else
-					{
-						/* The child was killed.  Remember the signal. */
-						c2[i].signal = WIFSIGNALED( c2[i].status ) ? WTERMSIG( c2[i].status ) : 0;
-					}
+	/* Listen for drives that are plugged in or pulled out. */
+	if( dwipe_options.station && dwipe_station_init( dwipe_slots, c2, dwipe_entropy ) != 0 )
+	{
+		dwipe_gui_free();
+		return -1;
+	}
 
-					/* Increment the number of children that have returned. */
-					dwipe_wait += 1;
+	/* Accept commands from local clients. */
+	if( dwipe_options.control && dwipe_control_init( dwipe_options.control, dwipe_slots, c2 ) != 0 )
+	{
+		dwipe_gui_free();
+		return -1;
+	}
 
-				} /* child reaped */
+	/* Publish metrics for fleet dashboards. */
+	if( dwipe_metrics_init( dwipe_slots, c2 ) != 0 )
+	{
+		dwipe_gui_free();
+		return -1;
+	}
 
-			} /* child active */
-				  
-		} /* child waitpid */
+	/* Run the wipes and wait for them to finish. */
+	r = dwipe_supervise( dwipe_slots, c2, ! dwipe_options.headless );
 
-		/* Show the user what is happening. */
-		dwipe_gui_status( dwipe_selected, c2 );
+	dwipe_control_free();
+	dwipe_events_free();
+	dwipe_metrics_free();
+	dwipe_arena_unreserve();
 
-	} /* while */
+	if( r != 0 )
+	{
+		dwipe_gui_free();
+		return r;
+	}
 
 	/* TODO: Fanfare. */
-	dwipe_pid = getch();
+	if( ! dwipe_options.headless ) { getch(); }
 
 	/* Release the gui. */
 	dwipe_gui_free();
 
 	dwipe_log( DWIPE_LOG_NOTICE, "Wipe finished." );
 
-	for( i = 0 ; i < dwipe_selected ; i++ )
-	{
-		snprintf( dwipe_result_file, sizeof(dwipe_result_file), "%s.result", c2[i].device_name );
-		dwipe_result_fp = fopen( dwipe_result_file, "w" );
-		fprintf( dwipe_result_fp, "DWIPE_LABEL='%s'\n", c2[i].label );
-		fprintf( dwipe_result_fp, "DWIPE_METHOD='%s'\n", dwipe_method_label( dwipe_options.method) );
-		fprintf( dwipe_result_fp, "DWIPE_ROUNDS='%i'\n", dwipe_options.rounds );
-		
-		if( dwipe_options.verify == DWIPE_VERIFY_NONE )
-		{
-			fprintf( dwipe_result_fp, "DWIPE_VERIFY='off'\n" );
-		}
-		if( dwipe_options.verify == DWIPE_VERIFY_ALL  )
-		{
-			fprintf( dwipe_result_fp, "DWIPE_VERIFY='all'\n" );
-		}
-		if( dwipe_options.verify == DWIPE_VERIFY_LAST )
-		{
-			fprintf( dwipe_result_fp, "DWIPE_VERIFY='last'\n" );
-		}
-		
-		if( c2[i].result < 0 )
-		{
-			dwipe_log( DWIPE_LOG_NOTICE, "Wipe of device '%s' failed.", c2[i].device_name );
-			fprintf( dwipe_result_fp, "DWIPE_RESULT='fail'\n" );
-		}
-
-		if( c2[i].result == 0 )
-		{
-			dwipe_log( DWIPE_LOG_NOTICE, "Wipe of device '%s' succeeded.", c2[i].device_name );
-			fprintf( dwipe_result_fp, "DWIPE_RESULT='pass'\n" );
-		}
-
-		if( c2[i].result > 0 )
-		{
-			dwipe_log( DWIPE_LOG_NOTICE, "Wipe of device '%s' incomplete.", c2[i].device_name );
-			fprintf( dwipe_result_fp, "DWIPE_RESULT='fail'\n" );
-		}
-		
-		fclose( dwipe_result_fp );
-	}
-
-	for( i = 0 ; i < dwipe_selected ; i++ )
+	for( i = 0 ; i < dwipe_slots ; i++ )
 	{
 		/* Check for fatal errors. */
 		if( c2[i].result < 0 ){ return -1; }
 	}
 
-	for( i = 0 ; i < dwipe_selected ; i++ )
+	for( i = 0 ; i < dwipe_slots ; i++ )
 	{
 		/* Check for non-fatal errors. */
 		if( c2[i].result > 0 ){ return 1; }
@@ -21,6 +21,11 @@
 #ifndef DWIPE_H_
 #define DWIPE_H_
 
+/* O_DIRECT, sync_file_range() and pwritev2() are GNU extensions.  This must come before any system header. */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #ifndef _LARGEFILE64_SOURCE
 #define _LARGEFILE64_SOURCE
 #endif
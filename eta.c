@@ -0,0 +1,376 @@
+/*
+ *  eta.c: Estimates of the remaining runtime of a wipe.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+/* RATIONALE:
+ *
+ *   The estimate used to divide the bytes that were left by one blended
+ *   rate.  But a verification reads faster than a pass writes, and a
+ *   spinning drive moves about half as many bytes per second on its inner
+ *   tracks as on its outer ones, so that rate was wrong in every phase of a
+ *   wipe and drifted as the heads moved in.
+ *
+ *   The parent knows the plan of a wipe.  Every round writes pass_count
+ *   passes, each of them read back with --verify=all, and then the final
+ *   pass is written and, unless verification is off, read back.  Each of
+ *   these phases covers wipe_size bytes, so round_done alone tells which
+ *   phase is running and how far into the device it has come.
+ *
+ *   The bytes written and the bytes read back have their own moving
+ *   averages.  The first write phase that the parent watches also learns
+ *   the speed of the device in DWIPE_KNOB_ETA_ZONES zones by position,
+ *   without the time that the child slept in the throttle.  Both rates are
+ *   kept as they would be in the first zone, so a phase is estimated zone
+ *   by zone at the speed of each zone, held to the caps that apply now.  A
+ *   zone that the curve has not reached yet is as fast as the last one that
+ *   it has.
+ *
+ */
+
+#include "dwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "logging.h"
+#include "progress.h"
+#include "throttle.h"
+#include "eta.h"
+
+
+int dwipe_eta_init( int count, dwipe_context_t* c )
+{
+/**
+ * Allocates one runtime model per device and attaches it to the context.
+ * The models are private to the parent.
+ *
+ * @parameter count  The number of contexts in the array.
+ * @parameter c      An array of device contexts.
+ * @return           0 on success, -1 on failure.
+ *
+ */
+
+	/* The model array. */
+	dwipe_eta_t* m;
+
+	/* Generic loop variable. */
+	int i;
+
+	m = calloc( count, sizeof( dwipe_eta_t ) );
+
+	if( m == NULL )
+	{
+		dwipe_perror( errno, __FUNCTION__, "calloc" );
+		dwipe_log( DWIPE_LOG_FATAL, "Unable to allocate memory for the runtime estimates." );
+		return -1;
+	}
+
+	for( i = 0 ; i < count ; i++ )
+	{
+		dwipe_eta_reset( &m[i] );
+		c[i].eta_model = &m[i];
+	}
+
+	return 0;
+
+} /* dwipe_eta_init */
+
+
+void dwipe_eta_reset( dwipe_eta_t* m )
+{
+/**
+ * Forgets everything that a model has learned, as for a new drive.
+ *
+ */
+
+	/* Generic loop variable. */
+	int z;
+
+	memset( m, 0, sizeof( dwipe_eta_t ) );
+
+	/* The curve is flat until a pass has measured it. */
+	for( z = 0 ; z < DWIPE_KNOB_ETA_ZONES ; z++ ) { m->shape[z] = 1; }
+
+	m->phase = -1;
+
+} /* dwipe_eta_reset */
+
+
+static int dwipe_eta_kind( dwipe_context_t* c, u64 phase )
+{
+/**
+ * Tells whether a phase of the plan writes the device or reads it back.
+ *
+ */
+
+	/* The number of passes in all rounds. */
+	u64 passes = (u64) dwipe_options.rounds * c->pass_count;
+
+	if( dwipe_options.verify == DWIPE_VERIFY_ALL )
+	{
+		/* Every pass is followed by its verification. */
+		if( phase < 2 * passes ) { return ( phase % 2 ) ? DWIPE_IO_READ : DWIPE_IO_WRITE; }
+		phase -= 2 * passes;
+	}
+
+	else
+	{
+		if( phase < passes ) { return DWIPE_IO_WRITE; }
+		phase -= passes;
+	}
+
+	/* The final pass, and then its verification. */
+	return ( phase == 0 ) ? DWIPE_IO_WRITE : DWIPE_IO_READ;
+
+} /* dwipe_eta_kind */
+
+
+static u64 dwipe_eta_bound( dwipe_context_t* c, int z )
+{
+/**
+ * Returns the position in a pass at which a zone starts.
+ *
+ */
+
+	return c->wipe_size * z / DWIPE_KNOB_ETA_ZONES;
+
+} /* dwipe_eta_bound */
+
+
+static int dwipe_eta_zone( dwipe_context_t* c, u64 position )
+{
+/**
+ * Returns the zone of a position in a pass.
+ *
+ */
+
+	/* The result. */
+	u64 z = position * DWIPE_KNOB_ETA_ZONES / c->wipe_size;
+
+	return ( z < DWIPE_KNOB_ETA_ZONES ) ? z : DWIPE_KNOB_ETA_ZONES - 1;
+
+} /* dwipe_eta_zone */
+
+
+static void dwipe_eta_shape( dwipe_eta_t* m )
+{
+/**
+ * Makes the speed of each zone relative to the first zone that has been
+ * measured.  The zones before it share its speed, and the zones after the
+ * last one that has been measured share the speed of that one.
+ *
+ */
+
+	/* The bytes per nanosecond of the first measured zone. */
+	double first = 0;
+
+	/* The working speed. */
+	double v = 1;
+
+	/* Generic loop variable. */
+	int z;
+
+	for( z = 0 ; z < DWIPE_KNOB_ETA_ZONES && first == 0 ; z++ )
+	{
+		if( m->zone_ns[z] > 0 ) { first = (double) m->zone_bytes[z] / m->zone_ns[z]; }
+	}
+
+	if( first == 0 ) { return; }
+
+	for( z = 0 ; z < DWIPE_KNOB_ETA_ZONES ; z++ )
+	{
+		if( m->zone_ns[z] > 0 && m->zone_bytes[z] > 0 ) { v = (double) m->zone_bytes[z] / m->zone_ns[z] / first; }
+		m->shape[z] = v;
+	}
+
+} /* dwipe_eta_shape */
+
+
+static double dwipe_eta_span( dwipe_context_t* c, double base, u64 from, u64 to )
+{
+/**
+ * Returns the seconds that a phase needs to move from one position of the
+ * pass to another.
+ *
+ * @parameter base  The rate of the phase in the first zone, in bytes per second.
+ *
+ */
+
+	/* The end of the working zone. */
+	u64 end;
+
+	/* The result. */
+	double t = 0;
+
+	/* Generic loop variable. */
+	int z;
+
+	for( z = dwipe_eta_zone( c, from ) ; z < DWIPE_KNOB_ETA_ZONES && from < to ; z++ )
+	{
+		end = ( z + 1 < DWIPE_KNOB_ETA_ZONES ) ? dwipe_eta_bound( c, z + 1 ) : to;
+		if( end > to ) { end = to; }
+
+		if( end > from )
+		{
+			t += (double)( end - from ) / dwipe_throttle_cap( c, base * c->eta_model->shape[z] );
+			from = end;
+		}
+	}
+
+	return t;
+
+} /* dwipe_eta_span */
+
+
+void dwipe_eta_sample( dwipe_context_t* c, dwipe_progress_t* s, u64 now )
+{
+/**
+ * Updates the rates and the speed curve of a running device from a sample
+ * of its counters, and estimates the runtime of the rest of its plan.
+ *
+ * @parameter c    The device context, with fresh round_done and throttled.
+ * @parameter s    The snapshot of the counters of the device.
+ * @parameter now  The CLOCK_MONOTONIC nanoseconds of the sample.
+ * @modifies  c->eta
+ *
+ */
+
+	/* The model. */
+	dwipe_eta_t* m = c->eta_model;
+
+	/* The working phase of the plan, and the position in its pass. */
+	u64 phase;
+	u64 position;
+
+	/* The number of phases in the plan. */
+	u64 phases;
+
+	/* The bytes and the nanoseconds since the last sample, without sleep. */
+	u64 bytes;
+	u64 ns;
+
+	/* The kind of the working phase. */
+	int kind;
+
+	/* The rate of each kind in the first zone, filled in for the kinds that have not run yet. */
+	double base [DWIPE_IO_KINDS];
+
+	/* The seconds of one whole phase of each kind. */
+	double full [DWIPE_IO_KINDS];
+
+	/* The estimate in seconds. */
+	double t;
+
+	/* The working rate. */
+	double rate;
+
+	/* The zone of the last sample. */
+	int z;
+
+	/* The child has not planned its wipe yet. */
+	if( m == NULL || c->wipe_size == 0 || c->round_size == 0 ) { return; }
+
+	if( c->round_done >= c->round_size ) { c->eta = 0; return; }
+
+	phase    = c->round_done / c->wipe_size;
+	position = c->round_done % c->wipe_size;
+	kind     = dwipe_eta_kind( c, phase );
+
+	if( c->paused )
+	{
+		/* The time that the child is stopped says nothing about the device. */
+		m->time = 0;
+		m->rate[ DWIPE_IO_WRITE ].time = 0;
+		m->rate[ DWIPE_IO_READ  ].time = 0;
+		return;
+	}
+
+	/* Learn the curve in the first write phase that is watched. */
+	if( m->phase < 0 && kind == DWIPE_IO_WRITE ) { m->phase = phase; }
+
+	if( m->time == 0 || c->round_done < m->done )
+	{
+		m->done  = c->round_done;
+		m->sleep = s->throttle_ns;
+		m->time  = now;
+	}
+
+	else if( now - m->time >= DWIPE_KNOB_EWMA_INTERVAL )
+	{
+		if( phase == m->phase && m->done / c->wipe_size == phase && c->round_done > m->done )
+		{
+			bytes = c->round_done - m->done;
+			ns    = now - m->time;
+
+			/* The time asleep in the throttle is not the speed of the zone. */
+			ns = ( ns > s->throttle_ns - m->sleep ) ? ns - ( s->throttle_ns - m->sleep ) : 0;
+
+			/* Charge the sample to the zone in the middle of its bytes. */
+			z = dwipe_eta_zone( c, ( m->done % c->wipe_size + position ) / 2 );
+
+			if( ns > 0 )
+			{
+				m->zone_bytes[z] += bytes;
+				m->zone_ns[z]    += ns;
+				dwipe_eta_shape( m );
+			}
+		}
+
+		m->done  = c->round_done;
+		m->sleep = s->throttle_ns;
+		m->time  = now;
+	}
+
+	if( c->pass_type != DWIPE_PASS_NONE )
+	{
+		/* The other kind is idle, and its averages must not count the gap. */
+		m->rate[ ( kind == DWIPE_IO_WRITE ) ? DWIPE_IO_READ : DWIPE_IO_WRITE ].time = 0;
+
+		if( dwipe_ewma_update( &m->rate[kind], ( kind == DWIPE_IO_WRITE ) ? s->bytes_written : s->bytes_verified, now ) )
+		{
+			rate = m->rate[kind].slow;
+
+			/* Undo the throttle, whose caps are applied again zone by zone. */
+			if( c->throttled > 0 ) { rate = rate * 100 / ( 100 - c->throttled ); }
+
+			m->base[kind] = rate / m->shape[ dwipe_eta_zone( c, position ) ];
+		}
+	}
+
+	/* Keep the estimate of the scheduler until the device has a rate. */
+	if( m->base[ DWIPE_IO_WRITE ] == 0 && m->base[ DWIPE_IO_READ ] == 0 ) { return; }
+
+	/* A kind that has not run yet is assumed to be as fast as the other. */
+	base[ DWIPE_IO_WRITE ] = ( m->base[ DWIPE_IO_WRITE ] > 0 ) ? m->base[ DWIPE_IO_WRITE ] : m->base[ DWIPE_IO_READ  ];
+	base[ DWIPE_IO_READ  ] = ( m->base[ DWIPE_IO_READ  ] > 0 ) ? m->base[ DWIPE_IO_READ  ] : m->base[ DWIPE_IO_WRITE ];
+
+	full[ DWIPE_IO_WRITE ] = dwipe_eta_span( c, base[ DWIPE_IO_WRITE ], 0, c->wipe_size );
+	full[ DWIPE_IO_READ  ] = dwipe_eta_span( c, base[ DWIPE_IO_READ  ], 0, c->wipe_size );
+
+	/* The rest of the working phase, and then the whole phases after it. */
+	t = dwipe_eta_span( c, base[ kind ], position, c->wipe_size );
+
+	phases = c->round_size / c->wipe_size;
+
+	for( phase += 1 ; phase < phases ; phase++ ) { t += full[ dwipe_eta_kind( c, phase ) ]; }
+
+	c->eta = t + 0.5;
+
+} /* dwipe_eta_sample */
+
+/* eof */
@@ -0,0 +1,46 @@
+/*
+ *  eta.h: Estimates of the remaining runtime of a wipe.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef ETA_H_
+#define ETA_H_
+
+/* The number of zones that the speed curve of a device is learned in. */
+#define DWIPE_KNOB_ETA_ZONES  32
+
+/* The runtime model of one device.  Only the parent keeps it. */
+struct dwipe_eta_t_
+{
+	dwipe_ewma_t rate [DWIPE_IO_KINDS];         /* The moving averages of the bytes written and read back.   */
+	double       base [DWIPE_IO_KINDS];         /* Each rate as it would be in the first zone, or zero.      */
+	u64          zone_bytes [DWIPE_KNOB_ETA_ZONES]; /* The bytes that the learning pass moved in each zone.  */
+	u64          zone_ns    [DWIPE_KNOB_ETA_ZONES]; /* The nanoseconds that they took, without throttling.   */
+	double       shape      [DWIPE_KNOB_ETA_ZONES]; /* The speed of each zone relative to the first.         */
+	int          phase;                         /* The phase that the curve is learned in, or -1.            */
+	u64          done;                          /* The round_done of the last sample.                        */
+	u64          sleep;                         /* The throttle_ns of the last sample.                       */
+	u64          time;                          /* The CLOCK_MONOTONIC nanoseconds of the last sample.       */
+};
+
+int  dwipe_eta_init( int count, dwipe_context_t* c );                        /* Give every context a model. */
+void dwipe_eta_reset( dwipe_eta_t* m );                                      /* Forget a model.             */
+void dwipe_eta_sample( dwipe_context_t* c, dwipe_progress_t* s, u64 now );  /* Update the estimate.        */
+
+#endif /* ETA_H_ */
+
+/* eof */
@@ -0,0 +1,529 @@
+/*
+ *  events.c: A machine-readable stream of wipe events.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+/* RATIONALE:
+ *
+ *   Provisioning systems used to scrape the ncurses screen.  They now get one
+ *   JSON object per line: an event for every scheduling change, round, pass,
+ *   verification and error, and a sample of every running device each
+ *   second.
+ *
+ *   A child never formats or writes JSON.  It copies a fixed-size record into
+ *   a ring in shared memory, which costs a clock read and a few stores, and
+ *   it drops the record and counts the loss when the ring is full.  The
+ *   parent drains the rings and formats the lines when it wakes up anyway,
+ *   and it writes them in batches with non-blocking writes.  A reader that
+ *   falls behind loses lines, which the next sample reports, but it never
+ *   slows down a wipe.
+ *
+ */
+
+#include <stdarg.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "dwipe.h"
+#include "context.h"
+#include "logging.h"
+#include "progress.h"
+#include "events.h"
+
+
+/* The stream, or -1 when events are off. */
+static int dwipe_events_fd = -1;
+
+/* Set when the stream is a socket, which needs send() to avoid SIGPIPE. */
+static int dwipe_events_socket = 0;
+
+/* The lines that have not been written yet. */
+static char*  dwipe_events_buffer = NULL;
+static size_t dwipe_events_used   = 0;
+
+/* The number of lines that the parent could not hold. */
+static u64 dwipe_events_lost = 0;
+
+/* The time of the last round of samples. */
+static time_t dwipe_events_sampled = 0;
+
+
+static u64 dwipe_events_clock( void )
+{
+/**
+ * Returns the wall clock in nanoseconds.
+ *
+ */
+
+	struct timespec ts;
+
+	clock_gettime( CLOCK_REALTIME, &ts );
+
+	return (u64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+} /* dwipe_events_clock */
+
+
+int dwipe_events_init( const char* path, int count, dwipe_context_t* c )
+{
+/**
+ * Opens the event stream and gives every device an event ring.
+ *
+ * The path may name a regular file, which is appended to, a FIFO, or a
+ * listening Unix-domain stream socket.
+ *
+ * @parameter path   The file name of the stream.
+ * @parameter count  The number of contexts in the array.
+ * @parameter c      An array of device contexts.
+ * @returns          Zero on success, -1 on failure.
+ *
+ */
+
+	/* The type of the path, if it exists. */
+	struct stat st;
+	int found = stat( path, &st ) == 0;
+
+	/* The address of a socket. */
+	struct sockaddr_un addr;
+
+	/* The rings. */
+	dwipe_events_t* rings;
+
+	/* A generic loop variable. */
+	int i;
+
+	if( found && S_ISSOCK( st.st_mode ) )
+	{
+		if( strlen( path ) >= sizeof( addr.sun_path ) )
+		{
+			dwipe_log( DWIPE_LOG_FATAL, "The event socket path '%s' is too long.", path );
+			return -1;
+		}
+
+		memset( &addr, 0, sizeof( addr ) );
+		addr.sun_family = AF_UNIX;
+		strcpy( addr.sun_path, path );
+
+		dwipe_events_fd     = socket( AF_UNIX, SOCK_STREAM, 0 );
+		dwipe_events_socket = 1;
+
+		if( dwipe_events_fd >= 0 && connect( dwipe_events_fd, (struct sockaddr*) &addr, sizeof( addr ) ) != 0 )
+		{
+			close( dwipe_events_fd );
+			dwipe_events_fd = -1;
+		}
+	}
+
+	else if( found && S_ISFIFO( st.st_mode ) )
+	{
+		/* Holding the read end too means that the open never waits for a reader. */
+		dwipe_events_fd = open( path, O_RDWR );
+	}
+
+	else
+	{
+		dwipe_events_fd = open( path, O_WRONLY | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH );
+	}
+
+	if( dwipe_events_fd < 0 )
+	{
+		dwipe_perror( errno, __FUNCTION__, "open" );
+		dwipe_log( DWIPE_LOG_FATAL, "Unable to open the event stream '%s'.", path );
+		return -1;
+	}
+
+	fcntl( dwipe_events_fd, F_SETFL, O_NONBLOCK | ( dwipe_events_socket ? 0 : O_APPEND ) );
+
+	dwipe_events_buffer = malloc( DWIPE_KNOB_EVENTS_BUFFER );
+	rings = dwipe_shm_alloc( count * sizeof( dwipe_events_t ) );
+
+	if( dwipe_events_buffer == NULL || rings == NULL )
+	{
+		dwipe_log( DWIPE_LOG_FATAL, "Unable to allocate memory for the event stream." );
+		dwipe_events_free();
+		return -1;
+	}
+
+	for( i = 0 ; i < count ; i++ )
+	{
+		c[i].events = &rings[i];
+	}
+
+	dwipe_log( DWIPE_LOG_NOTICE, "Writing events to '%s'.", path );
+
+	return 0;
+
+} /* dwipe_events_init */
+
+
+void dwipe_event( dwipe_context_t* c, dwipe_event_type_t type, u64 value )
+{
+/**
+ * Publishes an event.  Only the child of c may call this, and it never waits.
+ *
+ * @parameter c      The device context.
+ * @parameter type   What happened.
+ * @parameter value  A value that depends on the type.
+ *
+ */
+
+	dwipe_events_t* r = c->events;
+
+	/* The next free record. */
+	dwipe_event_t* e;
+
+	/* The positions of the ring. */
+	u64 head;
+	u64 tail;
+
+	if( r == NULL ) { return; }
+
+	head = r->head;
+	tail = __atomic_load_n( &r->tail, __ATOMIC_ACQUIRE );
+
+	if( head - tail >= DWIPE_KNOB_EVENTS_RING )
+	{
+		/* The parent is behind, so lose the event rather than wait. */
+		__atomic_store_n( &r->dropped, r->dropped + 1, __ATOMIC_RELAXED );
+		return;
+	}
+
+	e = &r->ring[ head % DWIPE_KNOB_EVENTS_RING ];
+
+	e->time      = dwipe_events_clock();
+	e->type      = type;
+	e->pass_type = c->progress->pass_type;
+	e->round     = c->progress->round_working;
+	e->pass      = c->progress->pass_working;
+	e->value     = value;
+
+	__atomic_store_n( &r->head, head + 1, __ATOMIC_RELEASE );
+
+} /* dwipe_event */
+
+
+static void dwipe_events_line( const char* format, ... )
+{
+/**
+ * Adds one JSON line to the buffer, or counts it as lost if there is no room.
+ *
+ */
+
+	/* The room in the buffer. */
+	size_t room = DWIPE_KNOB_EVENTS_BUFFER - dwipe_events_used;
+
+	/* The length of the line. */
+	int n;
+
+	va_list ap;
+
+	va_start( ap, format );
+	n = vsnprintf( dwipe_events_buffer + dwipe_events_used, room, format, ap );
+	va_end( ap );
+
+	if( n < 0 || (size_t) n + 1 >= room )
+	{
+		dwipe_events_lost += 1;
+		return;
+	}
+
+	dwipe_events_buffer[ dwipe_events_used + n ] = '\n';
+	dwipe_events_used += n + 1;
+
+} /* dwipe_events_line */
+
+
+static const char* dwipe_events_name( dwipe_context_t* c )
+{
+/**
+ * Returns the device name as a JSON string body.  Device names rarely need
+ * escaping, so the common case is the name itself.
+ *
+ */
+
+	static char escaped[ 2 * FILENAME_MAX ];
+
+	/* The positions in the two strings. */
+	const char* p;
+	size_t n = 0;
+
+	if( strpbrk( c->device_name, "\"\\" ) == NULL ) { return c->device_name; }
+
+	for( p = c->device_name ; *p && n < sizeof( escaped ) - 2 ; p++ )
+	{
+		if( *p == '"' || *p == '\\' ) { escaped[ n++ ] = '\\'; }
+		escaped[ n++ ] = *p;
+	}
+
+	escaped[n] = '\0';
+	return escaped;
+
+} /* dwipe_events_name */
+
+
+static const char* dwipe_events_pass( int pass_type )
+{
+/**
+ * Names a pass type.
+ *
+ */
+
+	switch( pass_type )
+	{
+		case DWIPE_PASS_WRITE:       return "write";
+		case DWIPE_PASS_VERIFY:      return "verify";
+		case DWIPE_PASS_FINAL_BLANK: return "final_blank";
+		case DWIPE_PASS_FINAL_OPS2:  return "final_ops2";
+	}
+
+	return "none";
+
+} /* dwipe_events_pass */
+
+
+static const char* dwipe_events_type( int type )
+{
+/**
+ * Names a child event.
+ *
+ */
+
+	switch( type )
+	{
+		case DWIPE_EVENT_ROUND_START:  return "round_start";
+		case DWIPE_EVENT_ROUND_END:    return "round_end";
+		case DWIPE_EVENT_PASS_START:   return "pass_start";
+		case DWIPE_EVENT_PASS_END:     return "pass_end";
+		case DWIPE_EVENT_VERIFY_START: return "verify_start";
+		case DWIPE_EVENT_VERIFY_END:   return "verify_end";
+		case DWIPE_EVENT_WRITE_ERROR:  return "write_error";
+		case DWIPE_EVENT_VERIFY_ERROR: return "verify_error";
+	}
+
+	return "unknown";
+
+} /* dwipe_events_type */
+
+
+void dwipe_events_state( dwipe_context_t* c, const char* state )
+{
+/**
+ * Emits a change that the parent made, such as queueing or reaping a device.
+ *
+ * @parameter c      The device context.
+ * @parameter state  The name of the event.
+ *
+ */
+
+	/* The current time. */
+	u64 now;
+
+	if( dwipe_events_fd < 0 ) { return; }
+
+	now = dwipe_events_clock();
+
+	dwipe_events_line( "{\"time\":%llu.%03llu,\"event\":\"%s\",\"device\":\"%s\",\"result\":%i,\"signal\":%i,\"removed\":%i}",
+	  now / 1000000000, now / 1000000 % 1000, state, dwipe_events_name( c ), c->result, c->signal, c->removed );
+
+} /* dwipe_events_state */
+
+
+void dwipe_events_outlier( dwipe_context_t* c, const char* event, const char* reason, const char* action, u64 throughput, u64 latency )
+{
+/**
+ * Emits a device that lags its peers, or that has caught up with them.
+ *
+ * @parameter c           The device context.
+ * @parameter event       Either "outlier" or "recovered".
+ * @parameter reason      What is wrong with the device.
+ * @parameter action      The --outlier-action that applies.
+ * @parameter throughput  The median throughput of the peers.
+ * @parameter latency     The median p99 latency of the peers in nanoseconds.
+ *
+ */
+
+	/* The current time. */
+	u64 now;
+
+	if( dwipe_events_fd < 0 ) { return; }
+
+	now = dwipe_events_clock();
+
+	dwipe_events_line( "{\"time\":%llu.%03llu,\"event\":\"%s\",\"device\":\"%s\",\"reason\":\"%s\",\"action\":\"%s\","
+	  "\"throughput\":%llu,\"peer_throughput\":%llu,\"latency_p99\":%llu,\"peer_latency_p99\":%llu}",
+	  now / 1000000000, now / 1000000 % 1000, event, dwipe_events_name( c ), reason, action,
+	  c->throughput, throughput, c->latency_p99, latency );
+
+} /* dwipe_events_outlier */
+
+
+void dwipe_events_drain( int count, dwipe_context_t* c )
+{
+/**
+ * Formats the events that the children have published.
+ *
+ * @parameter count  The number of contexts in the array.
+ * @parameter c      An array of device contexts.
+ *
+ */
+
+	/* The ring of one device. */
+	dwipe_events_t* r;
+
+	/* One event. */
+	dwipe_event_t* e;
+
+	/* The positions of the ring. */
+	u64 head;
+	u64 tail;
+
+	/* A generic loop variable. */
+	int i;
+
+	if( dwipe_events_fd < 0 ) { return; }
+
+	for( i = 0 ; i < count ; i++ )
+	{
+		if( ( r = c[i].events ) == NULL ) { continue; }
+
+		head = __atomic_load_n( &r->head, __ATOMIC_ACQUIRE );
+
+		for( tail = r->tail ; tail != head ; tail++ )
+		{
+			e = &r->ring[ tail % DWIPE_KNOB_EVENTS_RING ];
+
+			dwipe_events_line( "{\"time\":%llu.%03llu,\"event\":\"%s\",\"device\":\"%s\",\"round\":%i,\"pass\":%i,\"pass_type\":\"%s\",\"value\":%llu}",
+			  e->time / 1000000000, e->time / 1000000 % 1000, dwipe_events_type( e->type ), dwipe_events_name( &c[i] ),
+			  e->round, e->pass, dwipe_events_pass( e->pass_type ), e->value );
+		}
+
+		__atomic_store_n( &r->tail, tail, __ATOMIC_RELEASE );
+	}
+
+} /* dwipe_events_drain */
+
+
+void dwipe_events_sample( int count, dwipe_context_t* c )
+{
+/**
+ * Emits the progress of every running device, at most once per interval.
+ *
+ * @parameter count  The number of contexts in the array.
+ * @parameter c      An array of device contexts, freshly sampled.
+ *
+ */
+
+	/* The current time. */
+	time_t now = time( NULL );
+	u64 clock;
+
+	/* A generic loop variable. */
+	int i;
+
+	if( dwipe_events_fd < 0 || now - dwipe_events_sampled < DWIPE_KNOB_EVENTS_INTERVAL ) { return; }
+
+	dwipe_events_sampled = now;
+	clock = dwipe_events_clock();
+
+	for( i = 0 ; i < count ; i++ )
+	{
+		if( c[i].state != DWIPE_STATE_RUNNING ) { continue; }
+
+		dwipe_events_line( "{\"time\":%llu.%03llu,\"event\":\"sample\",\"device\":\"%s\",\"round\":%i,\"rounds\":%i,\"pass\":%i,\"passes\":%i,"
+		  "\"pass_type\":\"%s\",\"bytes_done\":%llu,\"bytes_total\":%llu,\"percent\":%.2f,\"throughput\":%llu,"
+		  "\"throughput_now\":%llu,\"throughput_avg\":%llu,\"eta\":%llu,"
+		  "\"pass_errors\":%llu,\"verify_errors\":%llu,\"paused\":%i,\"events_dropped\":%llu}",
+		  clock / 1000000000, clock / 1000000 % 1000, dwipe_events_name( &c[i] ), c[i].round_working, c[i].round_count, c[i].pass_working, c[i].pass_count,
+		  dwipe_events_pass( c[i].pass_type ), c[i].round_done, c[i].round_size, c[i].round_percent, c[i].throughput,
+		  c[i].throughput_now, c[i].throughput_avg, c[i].eta,
+		  c[i].pass_errors, c[i].verify_errors, c[i].paused,
+		  c[i].events == NULL ? 0 : __atomic_load_n( &c[i].events->dropped, __ATOMIC_RELAXED ) );
+	}
+
+	if( dwipe_events_lost > 0 )
+	{
+		dwipe_events_line( "{\"time\":%llu.%03llu,\"event\":\"lost\",\"lines\":%llu}",
+		  clock / 1000000000, clock / 1000000 % 1000, dwipe_events_lost );
+		dwipe_events_lost = 0;
+	}
+
+} /* dwipe_events_sample */
+
+
+void dwipe_events_flush( void )
+{
+/**
+ * Writes as much of the buffer as the reader takes without waiting.
+ *
+ */
+
+	/* The bytes written. */
+	ssize_t n;
+
+	if( dwipe_events_fd < 0 || dwipe_events_used == 0 ) { return; }
+
+	if( dwipe_events_socket )
+	{
+		n = send( dwipe_events_fd, dwipe_events_buffer, dwipe_events_used, MSG_NOSIGNAL | MSG_DONTWAIT );
+	}
+
+	else
+	{
+		n = write( dwipe_events_fd, dwipe_events_buffer, dwipe_events_used );
+	}
+
+	if( n < 0 )
+	{
+		if( errno != EAGAIN && errno != EINTR )
+		{
+			/* The reader has gone away for good. */
+			dwipe_perror( errno, __FUNCTION__, "write" );
+			dwipe_log( DWIPE_LOG_ERROR, "The event stream has been closed." );
+			close( dwipe_events_fd );
+			dwipe_events_fd = -1;
+		}
+
+		return;
+	}
+
+	/* Keep the part that the reader has not taken. */
+	memmove( dwipe_events_buffer, dwipe_events_buffer + n, dwipe_events_used - n );
+	dwipe_events_used -= n;
+
+} /* dwipe_events_flush */
+
+
+void dwipe_events_free( void )
+{
+/**
+ * Writes what the reader takes and closes the event stream.
+ *
+ */
+
+	if( dwipe_events_fd >= 0 )
+	{
+		dwipe_events_flush();
+		close( dwipe_events_fd );
+		dwipe_events_fd = -1;
+	}
+
+	free( dwipe_events_buffer );
+	dwipe_events_buffer = NULL;
+
+} /* dwipe_events_free */
+
+/* eof */
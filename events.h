@@ -0,0 +1,77 @@
+/*
+ *  events.h: A machine-readable stream of wipe events.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef EVENTS_H_
+#define EVENTS_H_
+
+/* The number of events that a child can publish before the parent drains them. */
+#define DWIPE_KNOB_EVENTS_RING      64
+
+/* The number of bytes of JSON that are held while the reader is slow. */
+#define DWIPE_KNOB_EVENTS_BUFFER    ( 256 * 1024 )
+
+/* The number of seconds between the progress samples of a device. */
+#define DWIPE_KNOB_EVENTS_INTERVAL  1
+
+typedef enum dwipe_event_type_t_
+{
+	DWIPE_EVENT_NONE = 0,
+	DWIPE_EVENT_ROUND_START,    /* The child started a round.                          */
+	DWIPE_EVENT_ROUND_END,      /* The child finished a round.                         */
+	DWIPE_EVENT_PASS_START,     /* The child started writing a pass.                   */
+	DWIPE_EVENT_PASS_END,       /* The child finished writing a pass.  value = result. */
+	DWIPE_EVENT_VERIFY_START,   /* The child started verifying a pass.                 */
+	DWIPE_EVENT_VERIFY_END,     /* The child finished verifying a pass. value = result. */
+	DWIPE_EVENT_WRITE_ERROR,    /* The child failed to write.  value = bytes lost.     */
+	DWIPE_EVENT_VERIFY_ERROR    /* The child read back the wrong data.  value = count. */
+} dwipe_event_type_t;
+
+/* One event as the child publishes it. */
+typedef struct /* dwipe_event_t */
+{
+	u64 time;       /* The CLOCK_REALTIME nanoseconds of the event. */
+	int type;       /* A dwipe_event_type_t.                        */
+	int pass_type;  /* The dwipe_pass_t of the working pass.        */
+	int round;      /* The working round.                           */
+	int pass;       /* The working pass.                            */
+	u64 value;      /* A value that depends on the type.            */
+} dwipe_event_t;
+
+/* The events of one device.  The child moves the head and the parent moves the tail. */
+struct dwipe_events_t_
+{
+	u64 head __attribute__(( aligned( DWIPE_KNOB_CACHELINE ) ));
+	u64 dropped;
+	u64 tail __attribute__(( aligned( DWIPE_KNOB_CACHELINE ) ));
+	dwipe_event_t ring[ DWIPE_KNOB_EVENTS_RING ] __attribute__(( aligned( DWIPE_KNOB_CACHELINE ) ));
+};
+
+int  dwipe_events_init( const char* path, int count, dwipe_context_t* c );  /* Open the event stream.      */
+void dwipe_event( dwipe_context_t* c, dwipe_event_type_t type, u64 value ); /* Publish one child event.    */
+void dwipe_events_state( dwipe_context_t* c, const char* state );           /* Emit a scheduling event.    */
+void dwipe_events_outlier( dwipe_context_t* c, const char* event, const char* reason,
+                           const char* action, u64 throughput, u64 latency ); /* Emit a peer comparison. */
+void dwipe_events_drain( int count, dwipe_context_t* c );                   /* Collect the child events.   */
+void dwipe_events_sample( int count, dwipe_context_t* c );                  /* Emit the periodic samples.  */
+void dwipe_events_flush( void );                                            /* Write what has been held.   */
+void dwipe_events_free( void );                                             /* Close the event stream.     */
+
+#endif /* EVENTS_H_ */
+
+/* eof */
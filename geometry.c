@@ -0,0 +1,227 @@
+/*
+ *  geometry.c: The i/o geometry of devices.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+/* RATIONALE:
+ *
+ *   A pass used to move st_blksize * 1024 bytes at a time, which is 4 MiB or
+ *   512 KiB depending on what fstat() reports, and has nothing to do with
+ *   how the device wants to be written.  The block layer publishes better
+ *   limits in /sys/block/X/queue: the physical sector and the minimum i/o
+ *   size, the full stripe width of a RAID volume as optimal_io_size, the
+ *   largest request that the queue builds and the number of requests that
+ *   it holds.
+ *
+ *   The probe reads those limits and picks a granule for each device: one
+ *   full stripe when the device has one, so that RAID volumes never do a
+ *   read-modify-write, else the discard granularity of a solid state drive,
+ *   else one largest request, so that a spinning drive is never sent a runt
+ *   request at the end of each block.  The block size of a pass is a
+ *   multiple of that granule near DWIPE_KNOB_GEOMETRY_CHUNK, no larger than
+ *   the queue holds, and every block ends on a multiple of the block size,
+ *   which keeps the blocks of a solid state drive inside its erase blocks
+ *   when the passes start at an odd offset.
+ *
+ *   Devices without the sysfs attributes, such as files and old kernels,
+ *   fall back to DWIPE_KNOB_GEOMETRY_CHUNK on sector boundaries.
+ *
+ */
+
+#include "dwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "logging.h"
+#include "geometry.h"
+
+
+static long long dwipe_geometry_read( const char* name, const char* attribute )
+{
+/**
+ * Reads one number from the queue directory of a block device.  Partitions
+ * have no queue of their own, so they use the one of their disk.
+ *
+ * @parameter name       The device name without the directory.
+ * @parameter attribute  The file in the queue directory.
+ * @return               The number, or -1 when it is unavailable.
+ *
+ */
+
+	/* The queue directories of a disk and of a partition. */
+	const char* formats [] = { "/sys/class/block/%s/queue/%s", "/sys/class/block/%s/../queue/%s" };
+
+	/* The path of the attribute. */
+	char path [FILENAME_MAX];
+
+	/* The attribute file. */
+	FILE* fp;
+
+	/* The value of the attribute. */
+	long long value;
+
+	/* Generic loop variable. */
+	int i;
+
+	for( i = 0 ; i < sizeof( formats ) / sizeof( formats[0] ) ; i++ )
+	{
+		snprintf( path, sizeof( path ), formats[i], name, attribute );
+
+		fp = fopen( path, "r" );
+		if( fp == NULL ) { continue; }
+
+		if( fscanf( fp, "%lli", &value ) != 1 ) { value = -1; }
+		fclose( fp );
+
+		return value;
+	}
+
+	return -1;
+
+} /* dwipe_geometry_read */
+
+
+int dwipe_geometry_probe( dwipe_context_t* c )
+{
+/**
+ * Chooses the block size and the alignment of the passes from the queue
+ * limits of a device.  The probe calls this once the sector size is known.
+ *
+ * @parameter  c              The device context.
+ * @modifies   c->io_size     The bytes in one block of a pass.
+ * @modifies   c->io_unit     The granule that the block size is a multiple of.
+ * @modifies   c->io_depth    The requests that one block puts in the queue.
+ * @modifies   c->rotational  Set for spinning media.
+ * @return                    0, because every device gets a usable geometry.
+ *
+ */
+
+	/* The device name without the directory. */
+	const char* name;
+
+	/* The queue limits of the device. */
+	long long physical;
+	long long minimum;
+	long long optimal;
+	long long request;
+	long long requests;
+	long long discard;
+
+	/* The smallest write that the device does without a read-modify-write. */
+	long long align;
+
+	/* The granule of the blocks, and why it was chosen. */
+	long long unit;
+	const char* reason;
+
+	/* The largest block that the queue holds. */
+	long long limit;
+
+	name = strrchr( c->device_name, '/' );
+	name = ( name == NULL ) ? c->device_name : name + 1;
+
+	physical      = dwipe_geometry_read( name, "physical_block_size" );
+	minimum       = dwipe_geometry_read( name, "minimum_io_size" );
+	optimal       = dwipe_geometry_read( name, "optimal_io_size" );
+	request       = dwipe_geometry_read( name, "max_sectors_kb" );
+	requests      = dwipe_geometry_read( name, "nr_requests" );
+	discard       = dwipe_geometry_read( name, "discard_granularity" );
+	c->rotational = dwipe_geometry_read( name, "rotational" ) != 0;
+
+	align = ( c->sector_size > 0 ) ? c->sector_size : 512;
+	if( physical > align && physical % align == 0 ) { align = physical; }
+	if( minimum  > align && minimum  % align == 0 ) { align = minimum;  }
+
+	if( request > 0 ) { request = request * 1024 - request * 1024 % align; }
+
+	if( optimal > 0 && optimal % align == 0 )
+	{
+		/* A RAID volume reports its full stripe. */
+		unit   = optimal;
+		reason = "stripe";
+	}
+
+	else if( ! c->rotational && discard > align && discard % align == 0 )
+	{
+		unit   = discard;
+		reason = "erase block";
+	}
+
+	else if( request > 0 )
+	{
+		unit   = request;
+		reason = "request";
+	}
+
+	else
+	{
+		unit   = align;
+		reason = "sector";
+	}
+
+	/* The nearest multiple of the granule to the block size that we aim for. */
+	c->io_size = ( DWIPE_KNOB_GEOMETRY_CHUNK + unit / 2 ) / unit * unit;
+
+	/* Keep one block within what the queue holds. */
+	limit = DWIPE_KNOB_GEOMETRY_CHUNK_MAX;
+	if( request > 0 && requests > 0 && request * requests < limit ) { limit = request * requests; }
+	if( c->io_size > limit ) { c->io_size = limit / unit * unit; }
+
+	if( c->io_size < unit ) { c->io_size = unit; }
+
+	c->io_unit  = unit;
+	c->io_depth = ( request > 0 ) ? ( c->io_size + request - 1 ) / request : 1;
+
+	dwipe_log( DWIPE_LOG_INFO, "Device '%s' has physical sectors of %lli, minimum i/o of %lli, optimal i/o of %lli," \
+	  " requests of %lli KiB, a queue of %lli requests and a discard granularity of %lli.", \
+	  c->device_name, physical, minimum, optimal, request / 1024, requests, discard );
+
+	dwipe_log( DWIPE_LOG_NOTICE, "Device '%s' is %s and will be written in blocks of %zu bytes on %s boundaries of %zu," \
+	  " %i requests deep.", c->device_name, c->rotational ? "rotational" : "solid state", \
+	  c->io_size, reason, c->io_unit, c->io_depth );
+
+	return 0;
+
+} /* dwipe_geometry_probe */
+
+
+size_t dwipe_geometry_block( dwipe_context_t* c, u64 offset, size_t blocksize )
+{
+/**
+ * Shortens a block so that it ends on a multiple of the block size.  Only
+ * the first block of a pass or of a range that starts at an odd offset
+ * is affected.
+ *
+ * @parameter offset     The offset of the block on the device.
+ * @parameter blocksize  The size of the block.
+ * @return               The size of the aligned block.
+ *
+ */
+
+	/* The bytes to the next boundary. */
+	u64 room;
+
+	if( c->io_size == 0 ) { return blocksize; }
+
+	room = c->io_size - offset % c->io_size;
+
+	return ( blocksize < room ) ? blocksize : room;
+
+} /* dwipe_geometry_block */
+
+/* eof */
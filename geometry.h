@@ -0,0 +1,34 @@
+/*
+ *  geometry.h: The i/o geometry of devices.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef GEOMETRY_H_
+#define GEOMETRY_H_
+
+/* The block size that a pass aims for, which is rounded to the geometry of the device. */
+#define DWIPE_KNOB_GEOMETRY_CHUNK      (4 << 20)
+
+/* The largest block size that the geometry may choose, unless one stripe is larger. */
+#define DWIPE_KNOB_GEOMETRY_CHUNK_MAX  (64 << 20)
+
+int    dwipe_geometry_probe( dwipe_context_t* c );                              /* Choose the i/o sizes.   */
+size_t dwipe_geometry_block( dwipe_context_t* c, u64 offset, size_t blocksize ); /* Align a block of a pass. */
+
+#endif /* GEOMETRY_H_ */
+
+/* eof */
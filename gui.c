@@ -35,6 +35,10 @@
 #include "options.h"
 #include "gui.h"
 #include "pass.h"
+#include "schedule.h"
+#include "probe.h"
+#include "peer.h"
+#include "progress.h"
 
 
 #define DWIPE_GUI_PANE        8
@@ -114,6 +118,7 @@ const char* stats_title = " Statistics ";
 /* Footer labels. */
 const char* dwipe_buttons1 = " P=PRNG M=Method V=Verify R=Rounds, J=Up K=Down Space=Select, F10=Start ";
 const char* dwipe_buttons2 = " J=Up K=Down Space=Select";
+const char* dwipe_buttons3 = " J=Up K=Down PgUp PgDn, C=Compact/Detailed ";
 
 
 
@@ -309,6 +314,9 @@ void dwipe_gui_free( void )
  *
  */
 
+	/* A headless run never started the gui. */
+	if( main_window == NULL ) { return; }
+
 	/* Free ncurses resources. */
 	delwin( footer_window  );
 	delwin( header_window  );
@@ -374,6 +382,9 @@ void dwipe_gui_select( int count, dwipe_context_t* c )
 
 	do
 	{
+		/* Pick up finished probes, and redraw once a second while any are running. */
+		timeout( dwipe_probe_poll( count, c ) > 0 ? DWIPE_KNOB_SLEEP * 1000 : -1 );
+
 		/* Clear the main window. */
 		werase( main_window );
 
@@ -449,6 +460,13 @@ void dwipe_gui_select( int count, dwipe_context_t* c )
 				case DWIPE_SELECT_SKIPPED:
                                         wprintw( main_window, " [ SKIPPED ] %s", c[i+offset].label == NULL ? "Unrecognized Device" : c[i+offset].label);
                                         break;
+
+				case DWIPE_SELECT_PROBING:
+
+					/* The device has not answered yet.  It may be spinning up. */
+					wprintw( main_window, " [ PROBING ] %s", c[i+offset].device_name );
+					break;
+
 				default:
 					
 					/* TODO: Handle the sanity error. */
@@ -557,7 +575,7 @@ void dwipe_gui_select( int count, dwipe_context_t* c )
 								&& c[i].device_part   > 0
 							)
 							{
-                                if(c[i].select != DWIPE_SELECT_SKIPPED)
+                                if(c[i].select != DWIPE_SELECT_SKIPPED && c[i].select != DWIPE_SELECT_PROBING)
 								    c[i].select = DWIPE_SELECT_FALSE;
 							}
 
@@ -605,7 +623,7 @@ void dwipe_gui_select( int count, dwipe_context_t* c )
 								)
 								{
 									/* Enable the disk element. */
-                                    if(c[i].select != DWIPE_SELECT_SKIPPED)
+                                    if(c[i].select != DWIPE_SELECT_SKIPPED && c[i].select != DWIPE_SELECT_PROBING)
 									    c[i].select = DWIPE_SELECT_FALSE;
 								}
 
@@ -639,7 +657,7 @@ void dwipe_gui_select( int count, dwipe_context_t* c )
 								&& c[i].device_part   > 0
 							)
 							{
-                                if(c[i].select != DWIPE_SELECT_SKIPPED)
+                                if(c[i].select != DWIPE_SELECT_SKIPPED && c[i].select != DWIPE_SELECT_PROBING)
 								    c[i].select = DWIPE_SELECT_TRUE_PARENT;
 							}
 
@@ -664,7 +682,7 @@ void dwipe_gui_select( int count, dwipe_context_t* c )
 								&& c[i].device_part   == 0
 							)
 							{
-                                if(c[i].select != DWIPE_SELECT_SKIPPED)
+                                if(c[i].select != DWIPE_SELECT_SKIPPED && c[i].select != DWIPE_SELECT_PROBING)
 								    c[i].select = DWIPE_SELECT_FALSE_CHILD;
 							}
 						}
@@ -717,7 +735,10 @@ void dwipe_gui_select( int count, dwipe_context_t* c )
 			};
 		}
 
-	} while( keystroke != KEY_F(10) || selected == 0 );
+	} while( keystroke != KEY_F(10) || ( selected == 0 && ! dwipe_options.station ) );
+
+	/* Block on the keyboard again. */
+	timeout( -1 );
 
 	/* Clear the main window. */
 	werase( main_window );
@@ -1392,7 +1413,8 @@ void
 dwipe_gui_load( void )
 {
 /**
- * Prints the system load average to the statistics window.
+ * Prints the system load average to the statistics window.  The file is
+ * read again only every DWIPE_KNOB_GUI_LOAD seconds.
  *
  * @modifies stat_window      Prints the system load average to the statistics window.
  *
@@ -1406,13 +1428,17 @@ dwipe_gui_load( void )
 	float load_05;
 	float load_15;
 
+	/* When the file was last read. */
+	static time_t dwipe_loaded = 0;
+	time_t now = time( NULL );
+
+	if( now - dwipe_loaded < DWIPE_KNOB_GUI_LOAD ) { return; }
+
+	dwipe_loaded = now;
 
 	/* Open the loadavg file. */
 	dwipe_fp = fopen( DWIPE_KNOB_LOADAVG, "r" );
 
-	/* Print the label. */
-	mvwprintw( stats_window, DWIPE_GUI_STATS_LOAD_Y, DWIPE_GUI_STATS_LOAD_X, "Load Averages:" );
-
 	if( dwipe_fp )
 	{
 		/* The load averages are the first three numbers in the file. */
@@ -1442,45 +1468,341 @@ dwipe_gui_load( void )
 
 
 
+static const char* dwipe_gui_duration( u64 ns )
+{
+/**
+ * Formats a latency in the unit that suits it.  The result is overwritten
+ * by the next call.
+ *
+ */
+
+	static char buffer[ 16 ];
+
+	     if( ns < 1000000    ) { snprintf( buffer, sizeof( buffer ), "%lluus", ns / 1000    ); }
+	else if( ns < 1000000000 ) { snprintf( buffer, sizeof( buffer ), "%llums", ns / 1000000 ); }
+	else                       { snprintf( buffer, sizeof( buffer ), "%.1fs",  ns / 1e9     ); }
+
+	return buffer;
+
+} /* dwipe_gui_duration */
+
+
+static const char* dwipe_gui_rate( u64 rate )
+{
+/**
+ * Formats a throughput in the unit that suits it.  The result is
+ * overwritten by the next call.
+ *
+ */
+
+	static char buffer[ 24 ];
+
+	     if( rate >= INT64_C( 1000000000000000 ) ) { snprintf( buffer, sizeof( buffer ), "%llu TB/s", rate / INT64_C( 1000000000000 ) ); }
+	else if( rate >= INT64_C( 1000000000000    ) ) { snprintf( buffer, sizeof( buffer ), "%llu GB/s", rate / INT64_C( 1000000000    ) ); }
+	else if( rate >= INT64_C( 1000000000       ) ) { snprintf( buffer, sizeof( buffer ), "%llu MB/s", rate / INT64_C( 1000000       ) ); }
+	else if( rate >= INT64_C( 1000000          ) ) { snprintf( buffer, sizeof( buffer ), "%llu KB/s", rate / INT64_C( 1000          ) ); }
+	else                                           { snprintf( buffer, sizeof( buffer ), "%llu B/s",  rate                          ); }
+
+	return buffer;
+
+} /* dwipe_gui_rate */
+
+
+/* The columns of the compact view after the device label, in the order that they are dropped last. */
+static const struct { const char* title; int width; } dwipe_gui_columns[] =
+{
+	{ "State",   9 },
+	{ "Done",    7 },
+	{ "Pass",   10 },
+	{ "Rate",    9 },
+	{ "Now",     9 },
+	{ "ETA",     9 },
+	{ "Errors",  7 },
+	{ "Notes",  18 }
+};
+
+#define DWIPE_GUI_COLUMNS  ( sizeof( dwipe_gui_columns ) / sizeof( dwipe_gui_columns[0] ) )
+
+/* The cells of a line: the label and the columns. */
+#define DWIPE_GUI_CELLS    ( DWIPE_GUI_COLUMNS + 1 )
+
+/* A hash of what each cell of the main window shows, so that only changed cells are drawn. */
+static u64* dwipe_gui_cells = NULL;
+static int  dwipe_gui_lines = 0;
+
+/* Set when the status windows must be drawn from scratch. */
+static int dwipe_gui_stale = 1;
+
+
+void dwipe_gui_invalidate( void )
+{
+/**
+ * Makes the next status update draw everything again, as after another
+ * screen has been shown.
+ *
+ */
+
+	dwipe_gui_stale = 1;
+
+} /* dwipe_gui_invalidate */
+
+
+static int dwipe_gui_cell( int y, int cell, int x, int width, const char* text )
+{
+/**
+ * Prints a cell of the main window, padded or cut to its width, unless it
+ * already shows the same text.
+ *
+ * @return  1 when the cell was drawn, else 0.
+ *
+ */
+
+	/* The FNV-1a hash of the cell, which also covers its place. */
+	u64 hash = UINT64_C( 14695981039346656037 ) ^ ( (u64) x << 32 | width );
+	const char* p;
+
+	/* The cache slot of the cell. */
+	u64* slot;
+
+	if( y < 0 || y >= dwipe_gui_lines || width <= 0 ) { return 0; }
+
+	for( p = text ; *p ; p++ ) { hash = ( hash ^ (unsigned char) *p ) * UINT64_C( 1099511628211 ); }
+
+	slot = &dwipe_gui_cells[ y * DWIPE_GUI_CELLS + cell ];
+
+	if( *slot == hash ) { return 0; }
+
+	*slot = hash;
+	mvwprintw( main_window, y, x, "%-*.*s", width, width, text );
+
+	return 1;
+
+} /* dwipe_gui_cell */
+
+
+static void dwipe_gui_detail( dwipe_context_t* c, char* line, size_t size )
+{
+/**
+ * Formats the status line of a device for the detailed view.
+ *
+ */
+
+	/* The length of the line so far. */
+	size_t n = 0;
+
+	/* Appends to the line without running past its end. */
+	#define DWIPE_GUI_PRINT( ... ) do { if( n < size ) { n += snprintf( line + n, size - n, __VA_ARGS__ ); } } while( 0 )
+
+	line[0] = 0;
+
+	/* Check whether the child process is still running the wipe. */
+	if( c->state == DWIPE_STATE_RUNNING )
+	{
+		/* Print percentage and pass information. */
+		DWIPE_GUI_PRINT( "[%05.2f%%, round %i of %i, pass %i of %i] ", \
+		  c->round_percent, c->round_working, c->round_count, c->pass_working, c->pass_count );
+
+	} /* child running */
+
+	else if( c->state == DWIPE_STATE_QUEUED )
+	{
+		if( dwipe_groups[ c->group ].host < 0 )
+		{
+			DWIPE_GUI_PRINT( "[queued] " );
+		}
+
+		else
+		{
+			/* Tell the user which link the device is waiting for. */
+			DWIPE_GUI_PRINT( "[queued, host %i bus %i, %i active] ", \
+			  dwipe_groups[ c->group ].host, dwipe_groups[ c->group ].bus, dwipe_groups[ c->group ].active );
+		}
+
+		/* Show the runtime that the scheduler expects for this device. */
+		DWIPE_GUI_PRINT( "[est. %02llu:%02llu:%02llu] ", c->eta / 3600, c->eta / 60 % 60, c->eta % 60 );
+
+	} /* child queued */
+
+	else
+	{
+		if( c->removed )            { DWIPE_GUI_PRINT( "(failure, removed) " );                }
+		else if( c->result == 0 )   { DWIPE_GUI_PRINT( "(success) " );                         }
+		else if( c->signal )        { DWIPE_GUI_PRINT( "(failure, signal %i) ", c->signal );   }
+		else                        { DWIPE_GUI_PRINT( "(failure, code %i) ", c->result );     }
+
+	} /* child returned */
+
+	if( c->verify_errors ) { DWIPE_GUI_PRINT( "[verify errors: %llu] ", c->verify_errors ); }
+	if( c->pass_errors   ) { DWIPE_GUI_PRINT( "[pass errors: %llu] ",   c->pass_errors   ); }
+
+	switch( c->pass_type )
+	{
+		case DWIPE_PASS_FINAL_BLANK: DWIPE_GUI_PRINT( "[blanking] " );      break;
+		case DWIPE_PASS_FINAL_OPS2:  DWIPE_GUI_PRINT( "[OPS-II final] " );  break;
+		case DWIPE_PASS_WRITE:       DWIPE_GUI_PRINT( "[writing] " );       break;
+		case DWIPE_PASS_VERIFY:      DWIPE_GUI_PRINT( "[verifying] " );     break;
+		case DWIPE_PASS_NONE:                                               break;
+	}
+
+	if( c->sync_status ) { DWIPE_GUI_PRINT( "[syncing] " ); }
+	if( c->paused      ) { DWIPE_GUI_PRINT( "[paused] "  ); }
+	if( c->outlier     ) { DWIPE_GUI_PRINT( "[%s] ", dwipe_peer_name( c->outlier ) ); }
+
+	/* Queued devices have not moved any bytes yet. */
+	if( c->state == DWIPE_STATE_QUEUED ) { return; }
+
+	/* The smoothed rate, and the rate over the last sample, which shows a stall at once. */
+	DWIPE_GUI_PRINT( "[%s, ", dwipe_gui_rate( c->throughput ) );
+	DWIPE_GUI_PRINT( "now %s] ", dwipe_gui_rate( c->throughput_now ) );
+
+	if( c->throttled > 0 )
+	{
+		/* Time asleep under a cap is not time that the device needed. */
+		DWIPE_GUI_PRINT( "[throttled %i%%] ", c->throttled );
+	}
+
+	if( c->latency_max > 0 )
+	{
+		/* Show the latency tail, where a stalling drive shows up first. */
+		DWIPE_GUI_PRINT( "[p50 %s ",  dwipe_gui_duration( c->latency_p50 ) );
+		DWIPE_GUI_PRINT( "p99 %s ",   dwipe_gui_duration( c->latency_p99 ) );
+		DWIPE_GUI_PRINT( "max %s] ",  dwipe_gui_duration( c->latency_max ) );
+	}
+
+	#undef DWIPE_GUI_PRINT
+
+} /* dwipe_gui_detail */
+
+
+static void dwipe_gui_compact( dwipe_context_t* c, int y, int label, int columns )
+{
+/**
+ * Prints the line of a device in the compact view, cell by cell.
+ *
+ * @parameter y        The line of the main window.
+ * @parameter label    The width of the label cell.
+ * @parameter columns  The number of columns that fit after the label.
+ *
+ */
+
+	/* The text of each cell. */
+	char text[ DWIPE_GUI_COLUMNS ][ 32 ];
+
+	/* The working column. */
+	int x = 2;
+
+	/* Generic loop variable. */
+	int i;
+
+	memset( text, 0, sizeof( text ) );
+
+	if( c->state == DWIPE_STATE_RUNNING )
+	{
+		switch( c->pass_type )
+		{
+			case DWIPE_PASS_FINAL_BLANK: strcpy( text[0], "blanking" );  break;
+			case DWIPE_PASS_FINAL_OPS2:  strcpy( text[0], "ops2 final" ); break;
+			case DWIPE_PASS_WRITE:       strcpy( text[0], "writing" );   break;
+			case DWIPE_PASS_VERIFY:      strcpy( text[0], "verifying" ); break;
+			case DWIPE_PASS_NONE:        strcpy( text[0], "running" );   break;
+		}
+
+		snprintf( text[1], sizeof( text[1] ), "%6.2f%%", c->round_percent );
+		snprintf( text[2], sizeof( text[2] ), "r%i/%i p%i/%i", c->round_working, c->round_count, c->pass_working, c->pass_count );
+		snprintf( text[3], sizeof( text[3] ), "%s", dwipe_gui_rate( c->throughput ) );
+		snprintf( text[4], sizeof( text[4] ), "%s", dwipe_gui_rate( c->throughput_now ) );
+		snprintf( text[5], sizeof( text[5] ), "%02llu:%02llu:%02llu", c->eta / 3600, c->eta / 60 % 60, c->eta % 60 );
+	}
+
+	else if( c->state == DWIPE_STATE_QUEUED )
+	{
+		strcpy( text[0], "queued" );
+
+		/* Show the runtime that the scheduler expects for this device. */
+		snprintf( text[5], sizeof( text[5] ), "~%02llu:%02llu:%02llu", c->eta / 3600, c->eta / 60 % 60, c->eta % 60 );
+	}
+
+	else
+	{
+		if( c->removed )          { strcpy( text[0], "removed" ); }
+		else if( c->result == 0 ) { strcpy( text[0], "success" ); }
+		else if( c->signal )      { snprintf( text[0], sizeof( text[0] ), "signal %i", c->signal ); }
+		else                      { snprintf( text[0], sizeof( text[0] ), "failed %i", c->result ); }
+	}
+
+	if( c->pass_errors + c->verify_errors > 0 )
+	{
+		snprintf( text[6], sizeof( text[6] ), "%llu", c->pass_errors + c->verify_errors );
+	}
+
+	snprintf( text[7], sizeof( text[7] ), "%s%s%s%s", c->sync_status ? "sync " : "", c->paused ? "paused " : "",
+	  c->outlier ? dwipe_peer_name( c->outlier ) : "", c->throttled > 0 ? " throttled" : "" );
+
+	/* A device without a label is known by its file name. */
+	dwipe_gui_cell( y, 0, x, label, ( c->label != NULL && c->label[0] ) ? c->label : c->device_name );
+	x += label + 1;
+
+	for( i = 0 ; i < columns ; i++ )
+	{
+		dwipe_gui_cell( y, i + 1, x, dwipe_gui_columns[i].width, text[i] );
+		x += dwipe_gui_columns[i].width + 1;
+	}
+
+} /* dwipe_gui_compact */
+
+
 void dwipe_gui_status( int count, dwipe_context_t* c )
 {
 /**
  * Shows runtime statistics and overall progress.
  *
+ * Only the cells that have changed are drawn, and only the devices that are
+ * in view are formatted, so the cost of a refresh does not grow with the
+ * number of devices.  The refresh is also paced by its own clock, so that a
+ * burst of wakeups does not redraw the screen each time.
+ *
  * @parameter count           The number of contexts in the array.
  * @parameter c               An array of device contexts.
  *
  * @modifies  main_window     Prints information into the main window.
- * @modifies  c[].throughput  Updates the i/o throughput value. 
  *
  */
 
-	/* Throughput print formats. */
-	char* dwipe_tera = "%llu TB/s";
-	char* dwipe_giga = "%llu GB/s";
-	char* dwipe_mega = "%llu MB/s";
-	char* dwipe_kilo = "%llu KB/s";
-	char* dwipe_unit = "%llu B/s";
-
-	/* The throughput format pointer. */
-	char* dwipe_format;
-
 	/* We count time from when this function is first called. */
 	static time_t dwipe_time_start = 0;
 
 	/* The current time. */
 	time_t dwipe_time_now;
 
+	/* When the screen was last drawn, on the monotonic clock. */
+	static u64 dwipe_drawn = 0;
+	u64 clock;
+
 	/* The index of the element that is visible in the first slot. */
 	static int offset;
 
-	/* The number of elements that we can show in the window. */
+	/* Set for the compact view, or -1 until it has been chosen. */
+	static int compact = -1;
+
+	/* The window dimensions at the last draw. */
+	static int last_lines = 0;
+	static int last_cols  = 0;
+
+	/* The number of elements that we can show in the window, and have shown. */
 	int slots;
+	int shown;
+
+	/* The number of devices that can be shown at all. */
+	int listed = 0;
 
 	/* Window dimensions. */
 	int wlines;
 	int wcols;
 
+	/* The width of the label and the number of columns of the compact view. */
+	int label;
+	int columns;
+
 	/* Generic loop variable. */
 	int i;
 
@@ -1490,6 +1812,17 @@ void dwipe_gui_status( int count, dwipe_context_t* c )
 	/* User input buffer. */
 	int keystroke;
 
+	/* Set when a keystroke asks for a redraw now. */
+	int pressed = 0;
+
+	/* Set when devices are left below the window, and the scroll marks on the borders. */
+	int more;
+	static int marks = 0;
+
+	/* A line of text. */
+	char line[ 512 ];
+	size_t n;
+
 	/* The combined througput of all processes. */
 	u64 dwipe_throughput = 0;
 
@@ -1499,11 +1832,6 @@ void dwipe_gui_status( int count, dwipe_context_t* c )
 	/* The combined number of errors of all processes. */
 	u64 dwipe_errors = 0;
 
-	/* Time values. */
-	int dwipe_hh;
-	int dwipe_mm;
-	int dwipe_ss;
-
 	/* The number of active wipe processes. */
 	int dwipe_active = 0;
 
@@ -1517,47 +1845,34 @@ void dwipe_gui_status( int count, dwipe_context_t* c )
 	/* Get the window dimensions. */
 	getmaxyx( main_window, wlines, wcols );
 
-	/* Less four lines for the box and padding. */
-	slots = wlines - 4;
-
-	/* Each element prints three lines. */
-	slots /= 3;
-
-	/* Get the current time. */
-	dwipe_time_now = time( NULL );
-
-	/* Erase the main window. */
-	werase( main_window );
-
-	/* Erase the stats window. */
-	werase( stats_window );
-
-	/* Initialize our working offset to the third line. */
-	yy = 2;
+	for( i = 0 ; i < count ; i++ )
+	{
+		/* Empty station slots have nothing to show. */
+		if( c[i].state != DWIPE_STATE_NONE ) { listed += 1; }
+	}
 
+	if( compact < 0 )
+	{
+		/* Start in the compact view when the detailed view would not fit. */
+		compact = listed > ( wlines - 4 ) / 3;
+	}
 
-	/* Try to get a keystroke. */
-	keystroke = getch();
+	/* Less four lines for the box and padding, and each detailed element prints three lines. */
+	slots = compact ? wlines - 4 : ( wlines - 4 ) / 3;
 
-	switch( keystroke )
+	/* Read every waiting keystroke. */
+	while( ( keystroke = getch() ) != ERR )
 	{
+		pressed = 1;
+
+		switch( keystroke )
+		{
 			case KEY_DOWN:
 			case 'j':
 			case 'J':
 
 				/* Scroll down. */
 				offset += 1;
-
-				if( count < slots )
-				{
-					offset = 0;
-				}
-
-				else if( offset + slots > count )
-				{
-					offset = count - slots;
-				}
-
 				break;
 
 			case KEY_UP:
@@ -1566,12 +1881,27 @@ void dwipe_gui_status( int count, dwipe_context_t* c )
 
 				/* Scroll up. */
 				offset -= 1;
+				break;
 
-				if( offset < 0 )
-				{
-					offset = 0;
-				}
+			case KEY_NPAGE:
 
+				/* Scroll down by a screen. */
+				offset += slots;
+				break;
+
+			case KEY_PPAGE:
+
+				/* Scroll up by a screen. */
+				offset -= slots;
+				break;
+
+			case 'c':
+			case 'C':
+
+				/* Switch between the compact and the detailed view. */
+				compact = ! compact;
+				slots = compact ? wlines - 4 : ( wlines - 4 ) / 3;
+				dwipe_gui_stale = 1;
 				break;
 
 			default:
@@ -1579,38 +1909,69 @@ void dwipe_gui_status( int count, dwipe_context_t* c )
 				/* Do nothing. */
 				break;
 
-	} /* keystroke */
+		} /* keystroke */
+	}
+
+	if( offset + slots > count ) { offset = count - slots; }
+	if( offset < 0 )             { offset = 0; }
+
+	clock = dwipe_progress_clock();
+
+	if( ! pressed && ! dwipe_gui_stale && clock - dwipe_drawn < DWIPE_KNOB_GUI_INTERVAL * UINT64_C( 1000000 ) )
+	{
+		/* The screen was drawn a moment ago and the next tick will catch up. */
+		return;
+	}
+
+	dwipe_drawn = clock;
+
+	if( wlines != last_lines || wcols != last_cols )
+	{
+		/* Size the cell cache to the window. */
+		free( dwipe_gui_cells );
+		dwipe_gui_cells = malloc( wlines * DWIPE_GUI_CELLS * sizeof( u64 ) );
+		dwipe_gui_lines = ( dwipe_gui_cells == NULL ) ? 0 : wlines;
+
+		last_lines = wlines;
+		last_cols  = wcols;
+		dwipe_gui_stale = 1;
+	}
+
+	if( dwipe_gui_stale )
+	{
+		/* Draw the frames and the labels, which do not change. */
+		werase( main_window );
+		box( main_window, 0, 0 );
+		marks = 0;
+
+		if( dwipe_gui_cells != NULL ) { memset( dwipe_gui_cells, 0, dwipe_gui_lines * DWIPE_GUI_CELLS * sizeof( u64 ) ); }
+
+		werase( stats_window );
+		box( stats_window, 0, 0 );
+		mvwprintw( stats_window, 0, ( DWIPE_GUI_STATS_W - strlen( stats_title ) ) /2, "%s", stats_title );
+		mvwprintw( stats_window, DWIPE_GUI_STATS_RUNTIME_Y,    DWIPE_GUI_STATS_RUNTIME_X,    "Runtime:" );
+		mvwprintw( stats_window, DWIPE_GUI_STATS_ETA_Y,        DWIPE_GUI_STATS_ETA_X,        "Remaining:" );
+		mvwprintw( stats_window, DWIPE_GUI_STATS_LOAD_Y,       DWIPE_GUI_STATS_LOAD_X,       "Load Averages:" );
+		mvwprintw( stats_window, DWIPE_GUI_STATS_THROUGHPUT_Y, DWIPE_GUI_STATS_THROUGHPUT_X, "Throughput:" );
+		mvwprintw( stats_window, DWIPE_GUI_STATS_ERRORS_Y,     DWIPE_GUI_STATS_ERRORS_X,     "Errors:" );
+
+		werase( footer_window );
+		dwipe_gui_title( footer_window, dwipe_buttons3 );
+		wrefresh( footer_window );
+
+		dwipe_gui_stale = 0;
+	}
 
 
 	/* Enumerate all contexts to compute statistics. */
 	for( i = 0 ; i < count ; i++ )
 	{
 		/* Check whether the child process is still running the wipe. */
-		if( c[i].pid > 0 )
+		if( c[i].state == DWIPE_STATE_RUNNING )
 		{
 			/* Increment the child counter. */
 			dwipe_active += 1;
 
-			/* Maintain a rolling average of throughput. */
-			dwipe_update_speedring( &c[i].speedring, c[i].round_done, dwipe_time_now );
-
-			if( c[i].speedring.timestotal > 0 )
-			{
-				/* Update the current average throughput in bytes-per-second. */
-				c[i].throughput = c[i].speedring.bytestotal / c[i].speedring.timestotal;
-
-				/* Update the estimated remaining runtime. */
-				c[i].eta = ( c[i].round_size - c[i].round_done ) / c[i].throughput;
-
-				if( c[i].eta > dwipe_maxeta )
-				{
-					dwipe_maxeta = c[i].eta;
-				}
-			}
-
-			/* Update the percentage value. */
-			c[i].round_percent = (double) c[i].round_done / (double) c[i].round_size * 100;
-
 			/* Accumulate combined throughput. */
 			dwipe_throughput += c[i].throughput;
 
@@ -1622,89 +1983,84 @@ void dwipe_gui_status( int count, dwipe_context_t* c )
 
 	} /* for statistics */
 
+	/* The batch finishes when the last queued device does, not the slowest running one. */
+	dwipe_maxeta = dwipe_schedule_eta( count, c );
 
-	/* Print information for the user. */
-	for( i = offset ; i < offset + slots && i < count ; i++ )
+
+	/* Fit as many columns after a readable label as the window has room for. */
+	for( columns = 0, n = 0 ; columns < DWIPE_GUI_COLUMNS ; columns++ )
 	{
-		/* Print the context label. */
-		mvwprintw( main_window, yy++, 2, "%s", c[i].label );
+		if( 4 + DWIPE_KNOB_GUI_LABEL + n + dwipe_gui_columns[columns].width + 1 > wcols ) { break; }
+		n += dwipe_gui_columns[columns].width + 1;
+	}
 
-		/* Check whether the child process is still running the wipe. */
-		if( c[i].pid > 0 )
-		{
-			/* Print percentage and pass information. */
-			mvwprintw( main_window, yy++, 4, "[%05.2f%%, round %i of %i, pass %i of %i] ", \
-			  c[i].round_percent, c[i].round_working, c[i].round_count, c[i].pass_working, c[i].pass_count );
+	label = wcols - 4 - n;
 
-		} /* child running */
+	if( compact )
+	{
+		/* Title the columns. */
+		n = snprintf( line, sizeof( line ), "%-*.*s", label + 1, label + 1, "Device" );
 
-		else
+		for( i = 0 ; i < columns && n < sizeof( line ) ; i++ )
 		{
-			if( c[i].result == 0 ) { mvwprintw( main_window, yy++, 4, "(success) " );                         }
-			else if( c[i].signal ) { mvwprintw( main_window, yy++, 4, "(failure, signal %i) ", c[i].signal ); }
-			else                   { mvwprintw( main_window, yy++, 4, "(failure, code %i) ", c[i].result );   }
-
-		} /* child returned */
-
-		if( c[i].verify_errors ) { wprintw( main_window, "[verify errors: %llu] ", c[i].verify_errors ); }
- 		if( c[i].pass_errors   ) { wprintw( main_window, "[pass errors: %llu] ",   c[i].pass_errors   ); }
-
+			n += snprintf( line + n, sizeof( line ) - n, "%-*s", dwipe_gui_columns[i].width + 1, dwipe_gui_columns[i].title );
+		}
 
-		switch( c[i].pass_type )
-		{
-			case DWIPE_PASS_FINAL_BLANK:
-  				wprintw( main_window, "[blanking] " );
-				break;
+		dwipe_gui_cell( 1, 0, 2, wcols - 4, line );
+	}
 
-			case DWIPE_PASS_FINAL_OPS2:
-  				wprintw( main_window, "[OPS-II final] " );
-				break;
+	/* Initialize our working offset to the third line. */
+	yy = 2;
 
-			case DWIPE_PASS_WRITE:
-				wprintw( main_window, "[writing] " );
-				break;
+	/* Print information for the user. */
+	for( i = offset, shown = 0 ; shown < slots && i < count ; i++ )
+	{
+		/* Empty station slots have nothing to show. */
+		if( c[i].state == DWIPE_STATE_NONE ) { continue; }
 
-			case DWIPE_PASS_VERIFY:
-				wprintw( main_window, "[verifying] " );
-				break;
+		shown += 1;
 
-			case DWIPE_PASS_NONE:
-				break;
+		if( compact )
+		{
+			dwipe_gui_compact( &c[i], yy++, label, columns );
+			continue;
 		}
 
-  		if( c[i].sync_status   ) { wprintw( main_window, "[syncing] "   ); }
-
-		     if( c[i].throughput >= INT64_C( 1000000000000000 ) )
-			    { wprintw( main_window, "[%llu TB/s] ", c[i].throughput / INT64_C( 1000000000000 ) ); }
-		else if( c[i].throughput >= INT64_C( 1000000000000    ) )
-		       { wprintw( main_window, "[%llu GB/s] ", c[i].throughput / INT64_C( 1000000000    ) ); }
-		else if( c[i].throughput >= INT64_C( 1000000000       ) )
-		       { wprintw( main_window, "[%llu MB/s] ", c[i].throughput / INT64_C( 1000000       ) ); }
-		else if( c[i].throughput >= INT64_C( 1000000          ) )
-		       { wprintw( main_window, "[%llu KB/s] ", c[i].throughput / INT64_C( 1000          ) ); }
-		else
-		       { wprintw( main_window, "[%llu B/s] ",  c[i].throughput / INT64_C( 1             ) ); }
+		/* Print the context label. */
+		dwipe_gui_cell( yy++, 0, 2, wcols - 4, c[i].label );
 
-		/* Insert whitespace. */
+		/* Print the status line and leave a blank line. */
+		dwipe_gui_detail( &c[i], line, sizeof( line ) );
+		dwipe_gui_cell( yy++, 0, 4, wcols - 6, line );
 		yy += 1;
 
 	} /* for */
 
-	if( offset > 0 )
+	/* Check whether any device is left below the window. */
+	for( more = 0 ; i < count && ! more ; i++ ) { more = c[i].state != DWIPE_STATE_NONE; }
+
+	/* Blank the lines that no device uses any more. */
+	for( ; yy < wlines - 2 ; yy++ )
 	{
-		mvwprintw( main_window, 1, wcols -8, " More " );
-		waddch( main_window, ACS_UARROW );
+		if( dwipe_gui_cell( yy, 0, 2, wcols - 4, "" ) )
+		{
+			/* The blank covers the other cells of the line too. */
+			memset( &dwipe_gui_cells[ yy * DWIPE_GUI_CELLS + 1 ], 0, ( DWIPE_GUI_CELLS - 1 ) * sizeof( u64 ) );
+		}
 	}
 
-	if( count - offset > slots )
+	if( ( offset > 0 ) + 2 * more != marks )
 	{
-		mvwprintw( main_window, wlines -2, wcols -8, " More " );
-		waddch( main_window, ACS_DARROW );
-	}
+		/* Mark the borders when there are devices above or below the window. */
+		marks = ( offset > 0 ) + 2 * more;
 
+		if( marks & 1 ) { mvwprintw( main_window, 0, wcols - 8, " More " ); waddch( main_window, ACS_UARROW ); }
+		else            { mvwhline( main_window, 0, wcols - 8, ACS_HLINE, 7 ); }
+
+		if( marks & 2 ) { mvwprintw( main_window, wlines - 1, wcols - 8, " More " ); waddch( main_window, ACS_DARROW ); }
+		else            { mvwhline( main_window, wlines - 1, wcols - 8, ACS_HLINE, 7 ); }
+	}
 
-	/* Box the main window. */
-	box( main_window, 0, 0 );
 
 	/* Refresh the main window. */
 	wrefresh( main_window );
@@ -1712,64 +2068,31 @@ void dwipe_gui_status( int count, dwipe_context_t* c )
 	/* Update the load average field. */
 	dwipe_gui_load();
 
-
-	     if( dwipe_throughput >= INT64_C( 1000000000000000 ) )
-		    { dwipe_throughput /= INT64_C( 1000000000000    ); dwipe_format = dwipe_tera; }
-	else if( dwipe_throughput >= INT64_C( 1000000000000    ) )
-	       { dwipe_throughput /= INT64_C( 1000000000       ); dwipe_format = dwipe_giga; }
-	else if( dwipe_throughput >= INT64_C( 1000000000       ) )
-	       { dwipe_throughput /= INT64_C( 1000000          ); dwipe_format = dwipe_mega; }
-	else if( dwipe_throughput >= INT64_C( 1000000          ) )
-	       { dwipe_throughput /= INT64_C( 1000             ); dwipe_format = dwipe_kilo; }
-	else
-	       { dwipe_throughput /= INT64_C( 1                ); dwipe_format = dwipe_unit; }
-
 	/* Print the combined throughput. */
-	mvwprintw( stats_window, DWIPE_GUI_STATS_THROUGHPUT_Y, DWIPE_GUI_STATS_THROUGHPUT_X, "Throughput:" );
-
-	if( dwipe_throughput > 0 )
-	{
-		mvwprintw( stats_window, DWIPE_GUI_STATS_THROUGHPUT_Y, DWIPE_GUI_STATS_TAB, dwipe_format, dwipe_throughput );
-	}
+	mvwprintw( stats_window, DWIPE_GUI_STATS_THROUGHPUT_Y, DWIPE_GUI_STATS_TAB, "%-*s", DWIPE_GUI_STATS_W - DWIPE_GUI_STATS_TAB - 1,
+	  dwipe_throughput > 0 ? dwipe_gui_rate( dwipe_throughput ) : "" );
 
 	/* Change the current time into a delta. */
-	dwipe_time_now -= dwipe_time_start;
-
-	/* Put the delta into HH:mm:ss form. */
-	dwipe_hh = dwipe_time_now / 3600;
-	dwipe_time_now %= 3600;
-	dwipe_mm = dwipe_time_now / 60;
-	dwipe_time_now %= 60;
-	dwipe_ss = dwipe_time_now;
+	dwipe_time_now = time( NULL ) - dwipe_time_start;
 
 	/* Print the runtime. */
-	mvwprintw( stats_window, DWIPE_GUI_STATS_RUNTIME_Y, 1, "Runtime:" );
-	mvwprintw( stats_window, DWIPE_GUI_STATS_RUNTIME_Y, DWIPE_GUI_STATS_TAB, "%02i:%02i:%02i", dwipe_hh, dwipe_mm, dwipe_ss );
-
-	mvwprintw( stats_window, DWIPE_GUI_STATS_ETA_Y, 1, "Remaining:" );
+	mvwprintw( stats_window, DWIPE_GUI_STATS_RUNTIME_Y, DWIPE_GUI_STATS_TAB, "%02i:%02i:%02i", \
+	  (int)( dwipe_time_now / 3600 ), (int)( dwipe_time_now / 60 % 60 ), (int)( dwipe_time_now % 60 ) );
 
 	if( dwipe_maxeta > 0 )
 	{
-		/* Do it again for the estimated runtime remaining. */
-		dwipe_hh = dwipe_maxeta / 3600;
-		dwipe_maxeta %= 3600;
-		dwipe_mm = dwipe_maxeta / 60;
-		dwipe_maxeta %= 60;
-		dwipe_ss = dwipe_maxeta;
-	
 		/* Print the estimated runtime remaining. */
-		mvwprintw( stats_window, DWIPE_GUI_STATS_ETA_Y, DWIPE_GUI_STATS_TAB, "%02i:%02i:%02i", dwipe_hh, dwipe_mm, dwipe_ss );
+		mvwprintw( stats_window, DWIPE_GUI_STATS_ETA_Y, DWIPE_GUI_STATS_TAB, "%02i:%02i:%02i", \
+		  (int)( dwipe_maxeta / 3600 ), (int)( dwipe_maxeta / 60 % 60 ), (int)( dwipe_maxeta % 60 ) );
 	}
 
-	/* Print the error count. */
-	mvwprintw( stats_window, DWIPE_GUI_STATS_ERRORS_Y, DWIPE_GUI_STATS_ERRORS_X, "Errors:" );
-	mvwprintw( stats_window, DWIPE_GUI_STATS_ERRORS_Y, DWIPE_GUI_STATS_TAB, "%llu", dwipe_errors );
-
-	/* Add a border. */
-	box( stats_window, 0, 0 );
+	else
+	{
+		mvwprintw( stats_window, DWIPE_GUI_STATS_ETA_Y, DWIPE_GUI_STATS_TAB, "%-8s", "" );
+	}
 
-	/* Add a title. */
-	mvwprintw( stats_window, 0, ( DWIPE_GUI_STATS_W - strlen( stats_title ) ) /2, "%s", stats_title );
+	/* Print the error count. */
+	mvwprintw( stats_window, DWIPE_GUI_STATS_ERRORS_Y, DWIPE_GUI_STATS_TAB, "%-*llu", DWIPE_GUI_STATS_W - DWIPE_GUI_STATS_TAB - 1, dwipe_errors );
 
 	/* Refresh the stats window. */
 	wrefresh( stats_window );
@@ -1777,41 +2100,4 @@ void dwipe_gui_status( int count, dwipe_context_t* c )
 } /* dwipe_gui_status */
 
 
-void dwipe_update_speedring( dwipe_speedring_t* speedring, u64 speedring_bytes, time_t speedring_now )
-{
-	if( speedring->timeslast == 0 )
-	{
-		/* Ignore the first sample and initialize. */
-		speedring->timeslast = speedring_now;
-		return;
-	}
-
-	if( speedring_now - speedring->timeslast < DWIPE_KNOB_SPEEDRING_GRANULARITY )
-	{
-		/* Avoid jitter caused by frequent updates. */
-		return;
-	}
-
-	/* Subtract the oldest speed sample from the accumulator. */
-	speedring->bytestotal -= speedring->bytes[ speedring->position ];
-	speedring->timestotal -= speedring->times[ speedring->position ];
-
-	/* Put the lastest bytes-per-second sample into the ring buffer. */
-	speedring->bytes[ speedring->position ] = speedring_bytes - speedring->byteslast;
-	speedring->times[ speedring->position ] = speedring_now   - speedring->timeslast;
-
-	/* Add the newest speed sample to the accumulator. */
-	speedring->bytestotal += speedring->bytes[ speedring->position ];
-	speedring->timestotal += speedring->times[ speedring->position ];
-
-	/* Remember the last sample. */
-	speedring->byteslast = speedring_bytes;
-	speedring->timeslast = speedring_now;
-
-	if( ++speedring->position >= DWIPE_KNOB_SPEEDRING_SIZE )
-	{
-		speedring->position = 0;
-	}
-}
-
 /* eof */
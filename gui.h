@@ -22,18 +22,26 @@
 #ifndef GUI_H_
 #define GUI_H_
 
+/* The least milliseconds between two redraws of the status screen, unless a key is pressed. */
+#define DWIPE_KNOB_GUI_INTERVAL  500
+
+/* The seconds between two reads of the load average. */
+#define DWIPE_KNOB_GUI_LOAD      5
+
+/* The narrowest device label of the compact view, before columns are dropped. */
+#define DWIPE_KNOB_GUI_LABEL     16
+
 void dwipe_gui_free( void );                             /* Stop the GUI.              */
 void dwipe_gui_init( void );                             /* Start the GUI.             */
 void dwipe_gui_select( int count, dwipe_context_t* c );  /* Select devices to wipe.    */
 void dwipe_gui_status( int count, dwipe_context_t* c );  /* Update operation progress. */
+void dwipe_gui_invalidate( void );                       /* Redraw the status in full. */
 void dwipe_gui_method( void );                           /* Change the method option.  */
 void dwipe_gui_options( void );                          /* Update the options window. */
 void dwipe_gui_prng( void );                             /* Change the prng option.    */
 void dwipe_gui_rounds( void );                           /* Change the rounds option.  */
 void dwipe_gui_verify( void );                           /* Change the verify option.  */
 
-void dwipe_update_speedring( dwipe_speedring_t* speedring, u64 speedring_done, time_t speedring_now );
-
 #endif /* GUI_H_ */
 
 /* eof */
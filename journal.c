@@ -0,0 +1,624 @@
+/*
+ *  journal.c: Checkpoints that let an interrupted wipe continue.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+/* RATIONALE:
+ *
+ *   A multi-pass wipe of a large drive runs for days, and a power cut or a
+ *   reboot used to throw all of that work away.  With --journal, the child
+ *   of each device periodically records where it is: the method, the round,
+ *   the pass or verification, and the last offset that fdatasync() has put
+ *   on the media.  The record is written to a temporary file, synced, and
+ *   renamed over the old one, so that a crash leaves either checkpoint
+ *   whole.  Checkpoints are at least --checkpoint-interval seconds apart,
+ *   because each one costs a flush of the device.
+ *
+ *   The random patterns of a method must come out the same when it is
+ *   resumed, or the verification of a resumed pass would fail.  So a
+ *   journaled wipe draws one seed from the entropy source, records it, and
+ *   takes every later random choice from a PRNG stream of that seed.  A
+ *   random pass is reseeded every DWIPE_KNOB_JOURNAL_SEGMENT bytes, so that
+ *   a resumed pass only regenerates the part of one segment before its
+ *   offset.
+ *
+ *   With --resume, a checkpoint is only trusted when the serial number and
+ *   the size of the drive, the method options and the ranges all match it.  A drive
+ *   without a serial number cannot be told apart from another of the same
+ *   size, so its wipe starts over.
+ *
+ */
+
+#include <ctype.h>
+
+#include "dwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "logging.h"
+#include "progress.h"
+#include "journal.h"
+#include "range.h"
+
+
+static void dwipe_journal_key( dwipe_context_t* c, char* key, size_t size )
+{
+/**
+ * Names the checkpoint file of a device after its serial number, or after
+ * its device file when the serial number is unknown.
+ *
+ */
+
+	/* The name to use. */
+	const char* name = c->device_serial;
+
+	/* Generic loop variable. */
+	size_t i;
+
+	if( name == NULL )
+	{
+		name = strrchr( c->device_name, '/' );
+		name = ( name == NULL ) ? c->device_name : name + 1;
+	}
+
+	snprintf( key, size, "%s", name );
+
+	for( i = 0 ; key[i] != 0 ; i++ )
+	{
+		/* Keep the name safe for a file system. */
+		if( ! isalnum( (unsigned char) key[i] ) && key[i] != '-' && key[i] != '.' ) { key[i] = '_'; }
+	}
+
+} /* dwipe_journal_key */
+
+
+static int dwipe_journal_load( dwipe_context_t* c, dwipe_journal_t* j )
+{
+/**
+ * Reads the checkpoint of a device and checks that it belongs to this drive
+ * and to these options.
+ *
+ * @return  0 when the wipe can continue from the checkpoint, else -1.
+ *
+ */
+
+	/* The record, and a pointer to its working line. */
+	char buffer [DWIPE_KNOB_JOURNAL_SIZE];
+	char* line;
+
+	/* The key and the value of a line. */
+	char key [32];
+	char value [DWIPE_KNOB_JOURNAL_SIZE];
+
+	/* The fields that must match. */
+	char serial [DWIPE_KNOB_JOURNAL_SIZE] = "";
+	char method [DWIPE_KNOB_JOURNAL_SIZE] = "";
+	char prng [DWIPE_KNOB_JOURNAL_SIZE] = "";
+	char ranges [DWIPE_KNOB_JOURNAL_SIZE] = "";
+	char expected [DWIPE_KNOB_JOURNAL_SIZE];
+	unsigned long long size = 0;
+	int rounds = 0;
+	int verify = -1;
+	int seeded = 0;
+
+	/* Generic holders. */
+	int fd;
+	ssize_t n;
+	size_t i;
+	unsigned int x;
+
+	fd = open( j->path, O_RDONLY );
+
+	if( fd < 0 )
+	{
+		if( errno != ENOENT ) { dwipe_perror( errno, __FUNCTION__, "open" ); }
+		dwipe_log( DWIPE_LOG_NOTICE, "There is no checkpoint for '%s' in '%s'.", c->device_name, j->path );
+		return -1;
+	}
+
+	n = read( fd, buffer, sizeof( buffer ) - 1 );
+	close( fd );
+
+	if( n <= 0 )
+	{
+		dwipe_log( DWIPE_LOG_WARNING, "The checkpoint '%s' is empty.", j->path );
+		return -1;
+	}
+
+	buffer[n] = 0;
+
+	for( line = strtok( buffer, "\n" ) ; line != NULL ; line = strtok( NULL, "\n" ) )
+	{
+		value[0] = 0;
+
+		if( sscanf( line, "DWIPE_%31[A-Z_]='%[^']'", key, value ) < 1 ) { continue; }
+
+		if( strcmp( key, "SERIAL" ) == 0 ) { snprintf( serial, sizeof( serial ), "%s", value ); }
+		if( strcmp( key, "SIZE"   ) == 0 ) { sscanf( value, "%llu", &size ); }
+		if( strcmp( key, "METHOD" ) == 0 ) { snprintf( method, sizeof( method ), "%s", value ); }
+		if( strcmp( key, "PRNG"   ) == 0 ) { snprintf( prng, sizeof( prng ), "%s", value ); }
+		if( strcmp( key, "RANGES" ) == 0 ) { snprintf( ranges, sizeof( ranges ), "%s", value ); }
+		if( strcmp( key, "ROUNDS" ) == 0 ) { sscanf( value, "%i", &rounds ); }
+		if( strcmp( key, "VERIFY" ) == 0 ) { sscanf( value, "%i", &verify ); }
+		if( strcmp( key, "STEP"   ) == 0 ) { sscanf( value, "%i", &j->resume_step ); }
+		if( strcmp( key, "OFFSET" ) == 0 ) { sscanf( value, "%llu", &j->resume_offset ); }
+		if( strcmp( key, "ROUND"  ) == 0 ) { sscanf( value, "%i", &j->resume_round ); }
+		if( strcmp( key, "PASS"   ) == 0 ) { sscanf( value, "%i", &j->resume_pass ); }
+		if( strcmp( key, "ROUND_DONE"    ) == 0 ) { sscanf( value, "%llu", &j->round_done ); }
+		if( strcmp( key, "PASS_DONE"     ) == 0 ) { sscanf( value, "%llu", &j->pass_done ); }
+		if( strcmp( key, "PASS_ERRORS"   ) == 0 ) { sscanf( value, "%llu", &j->pass_errors ); }
+		if( strcmp( key, "VERIFY_ERRORS" ) == 0 ) { sscanf( value, "%llu", &j->verify_errors ); }
+
+		if( strcmp( key, "SEED" ) == 0 && strlen( value ) == 2 * sizeof( j->seed ) )
+		{
+			for( i = 0 ; i < sizeof( j->seed ) ; i++ )
+			{
+				if( sscanf( &value[2*i], "%2x", &x ) != 1 ) { break; }
+				j->seed[i] = x;
+			}
+
+			seeded = ( i == sizeof( j->seed ) );
+		}
+	}
+
+	if( c->device_serial == NULL || strcmp( serial, c->device_serial ) != 0 || size != c->device_size )
+	{
+		dwipe_log( DWIPE_LOG_WARNING, "The checkpoint '%s' is for another drive than '%s'.", j->path, c->device_name );
+		return -1;
+	}
+
+	dwipe_range_format( c, expected, sizeof( expected ) );
+
+	if( strcmp( method, dwipe_method_label( dwipe_options.method ) ) != 0
+	 || strcmp( ranges, expected ) != 0
+	 || strcmp( prng, dwipe_options.prng->label ) != 0
+	 || rounds != dwipe_options.rounds || verify != dwipe_options.verify )
+	{
+		dwipe_log( DWIPE_LOG_WARNING, "The checkpoint '%s' was taken with other method options.", j->path );
+		return -1;
+	}
+
+	if( ! seeded || j->resume_step < 1 || j->resume_offset > c->wipe_size )
+	{
+		dwipe_log( DWIPE_LOG_WARNING, "The checkpoint '%s' is damaged.", j->path );
+		return -1;
+	}
+
+	return 0;
+
+} /* dwipe_journal_load */
+
+
+int dwipe_journal_attach( dwipe_context_t* c )
+{
+/**
+ * Gives a device that is about to be wiped its journal, which holds the
+ * checkpoint when the wipe is resumed and a new seed when it is not.  The
+ * parent calls this before the fork.
+ *
+ * @parameter c  The device context.
+ * @return       0 on success, -1 when the wipe cannot be journaled.
+ *
+ */
+
+	/* The journal. */
+	dwipe_journal_t* j;
+
+	/* The file name of the device in the journal directory. */
+	char key [FILENAME_MAX];
+
+	/* The result holder. */
+	ssize_t r;
+
+	/* A device that is wiped again starts a new journal. */
+	free( c->journal );
+	c->journal = NULL;
+
+	if( dwipe_options.journal == NULL ) { return 0; }
+
+	j = calloc( 1, sizeof( dwipe_journal_t ) );
+
+	if( j == NULL )
+	{
+		dwipe_perror( errno, __FUNCTION__, "calloc" );
+		dwipe_log( DWIPE_LOG_ERROR, "Unable to allocate the journal of '%s'.", c->device_name );
+		return -1;
+	}
+
+	dwipe_journal_key( c, key, sizeof( key ) );
+
+	if( snprintf( j->path, sizeof( j->path ), "%s/%s.journal", dwipe_options.journal, key ) >= sizeof( j->path ) )
+	{
+		dwipe_log( DWIPE_LOG_ERROR, "The journal path of '%s' is too long.", c->device_name );
+		free( j );
+		return -1;
+	}
+
+	if( dwipe_options.resume && c->device_serial == NULL )
+	{
+		/* Another drive of the same size could have left this checkpoint. */
+		dwipe_log( DWIPE_LOG_WARNING, "The wipe of '%s' starts over because the drive has no serial number.", c->device_name );
+	}
+
+	else if( dwipe_options.resume && dwipe_journal_load( c, j ) == 0 )
+	{
+		j->resume = 1;
+
+		dwipe_log( DWIPE_LOG_NOTICE, "Resuming the wipe of '%s' at round %i, pass %i, offset %llu.", \
+		  c->device_name, j->resume_round, j->resume_pass, j->resume_offset );
+
+		c->journal = j;
+		return 0;
+	}
+
+	/* Every random choice of the wipe comes from this seed, which replaces any that a failed load left. */
+	r = read( c->entropy_fd, j->seed, sizeof( j->seed ) );
+
+	if( r != sizeof( j->seed ) )
+	{
+		dwipe_perror( errno, __FUNCTION__, "read" );
+		dwipe_log( DWIPE_LOG_ERROR, "Unable to seed the journal of '%s'.", c->device_name );
+		free( j );
+		return -1;
+	}
+
+	c->journal = j;
+	return 0;
+
+} /* dwipe_journal_attach */
+
+
+void dwipe_journal_resume( dwipe_context_t* c )
+{
+/**
+ * Restores the progress counters of a resumed wipe, so that the skipped
+ * passes are counted as done.  The child calls this before the first pass.
+ *
+ */
+
+	/* The journal. */
+	dwipe_journal_t* j = c->journal;
+
+	if( j == NULL ) { return; }
+
+	/* The first checkpoint is one interval away. */
+	j->checkpointed = dwipe_progress_clock();
+
+	if( ! j->resume ) { return; }
+
+	dwipe_progress_count( c, &c->progress->round_done, j->round_done );
+	dwipe_progress_count( c, &c->progress->pass_done, j->pass_done );
+	dwipe_progress_count( c, &c->progress->pass_errors, j->pass_errors );
+	dwipe_progress_count( c, &c->progress->verify_errors, j->verify_errors );
+
+} /* dwipe_journal_resume */
+
+
+ssize_t dwipe_journal_entropy( dwipe_context_t* c, void* buffer, size_t count )
+{
+/**
+ * Reads random bytes for a method.  A journaled wipe takes them from the
+ * stream of its recorded seed, so that a resumed wipe makes the same choices.
+ *
+ * @return  The number of bytes read, or -1 with errno set.
+ *
+ */
+
+	/* The journal. */
+	dwipe_journal_t* j = c->journal;
+
+	/* The seed of the stream. */
+	dwipe_entropy_t seed;
+
+	if( j == NULL ) { return read( c->entropy_fd, buffer, count ); }
+
+	if( j->schedule == NULL )
+	{
+		seed.length = sizeof( j->seed );
+		seed.s      = j->seed;
+		c->prng->init( &j->schedule, &seed );
+	}
+
+	c->prng->read( &j->schedule, buffer, count );
+
+	return count;
+
+} /* dwipe_journal_entropy */
+
+
+u64 dwipe_journal_start( dwipe_context_t* c, int reading )
+{
+/**
+ * Counts a pass or a verification that is starting and finds where it
+ * should start.
+ *
+ * @parameter reading  Set for a verification.
+ * @return             The offset to start at, which is the device size when
+ *                     the step had finished before the checkpoint.
+ *
+ */
+
+	/* The journal. */
+	dwipe_journal_t* j = c->journal;
+
+	if( j == NULL ) { return 0; }
+
+	j->step   += 1;
+	j->reading = reading;
+
+	/* Seed the first segment at the first block. */
+	j->segment_index = -1;
+
+	if( ! j->resume || j->step > j->resume_step ) { return 0; }
+
+	if( j->step < j->resume_step ) { return c->wipe_size; }
+
+	dwipe_log( DWIPE_LOG_NOTICE, "Continuing %s of pass %i, round %i, on '%s' at offset %llu.", \
+	  reading ? "the verification" : "the write", c->progress->pass_working, c->progress->round_working, c->device_name, j->resume_offset );
+
+	return j->resume_offset;
+
+} /* dwipe_journal_start */
+
+
+size_t dwipe_journal_block( dwipe_context_t* c, u64 offset, size_t blocksize )
+{
+/**
+ * Reseeds the PRNG of a random pass when a block starts a new segment, and
+ * shortens a block that would cross into the next one.
+ *
+ * @parameter offset     The device offset of the block.
+ * @parameter blocksize  The size of the block.
+ * @return               The size of the block to use.
+ *
+ */
+
+	/* The journal. */
+	dwipe_journal_t* j = c->journal;
+
+	/* The seed of the segment. */
+	dwipe_entropy_t seed;
+
+	/* Bytes of the segment before the offset, which are thrown away. */
+	static char discard [65536];
+	u64 skip;
+
+	/* The segment of the offset, and the bytes left in it. */
+	long long k = offset / DWIPE_KNOB_JOURNAL_SEGMENT;
+	u64 left = DWIPE_KNOB_JOURNAL_SEGMENT - offset % DWIPE_KNOB_JOURNAL_SEGMENT;
+
+	/* Generic loop variable. */
+	int i;
+
+	if( j == NULL ) { return blocksize; }
+
+	if( k != j->segment_index )
+	{
+		/* The segment seed is the pass seed with the segment number mixed in. */
+		memcpy( j->segment, c->prng_seed.s, sizeof( j->segment ) );
+		for( i = 0 ; i < 8 ; i++ ) { j->segment[i] ^= (u8)( k >> ( 8 * i ) ); }
+
+		seed.length = sizeof( j->segment );
+		seed.s      = j->segment;
+		c->prng->init( &c->prng_state, &seed );
+
+		for( skip = offset % DWIPE_KNOB_JOURNAL_SEGMENT ; skip > 0 ; skip -= i )
+		{
+			i = ( skip < sizeof( discard ) ) ? skip : sizeof( discard );
+			c->prng->read( &c->prng_state, discard, i );
+		}
+
+		j->segment_index = k;
+	}
+
+	return ( blocksize < left ) ? blocksize : left;
+
+} /* dwipe_journal_block */
+
+
+static void dwipe_journal_write( dwipe_context_t* c, u64 offset )
+{
+/**
+ * Atomically replaces the checkpoint of a device.
+ *
+ */
+
+	/* The journal. */
+	dwipe_journal_t* j = c->journal;
+
+	/* The record. */
+	char buffer [DWIPE_KNOB_JOURNAL_SIZE];
+	char seed [2 * DWIPE_KNOB_PRNG_STATE_LENGTH + 1];
+	char ranges [DWIPE_KNOB_JOURNAL_SIZE];
+	int n;
+
+	/* The temporary file. */
+	char path [FILENAME_MAX + 8];
+	int fd;
+
+	/* Generic loop variable. */
+	size_t i;
+
+	for( i = 0 ; i < sizeof( j->seed ) ; i++ ) { sprintf( &seed[2*i], "%02x", j->seed[i] ); }
+
+	dwipe_range_format( c, ranges, sizeof( ranges ) );
+
+	n = snprintf( buffer, sizeof( buffer ),
+	  "DWIPE_JOURNAL='1'\n"
+	  "DWIPE_SERIAL='%s'\n"
+	  "DWIPE_SIZE='%llu'\n"
+	  "DWIPE_METHOD='%s'\n"
+	  "DWIPE_PRNG='%s'\n"
+	  "DWIPE_RANGES='%s'\n"
+	  "DWIPE_ROUNDS='%i'\n"
+	  "DWIPE_VERIFY='%i'\n"
+	  "DWIPE_SEED='%s'\n"
+	  "DWIPE_STEP='%i'\n"
+	  "DWIPE_OFFSET='%llu'\n"
+	  "DWIPE_ROUND='%i'\n"
+	  "DWIPE_PASS='%i'\n"
+	  "DWIPE_ROUND_DONE='%llu'\n"
+	  "DWIPE_PASS_DONE='%llu'\n"
+	  "DWIPE_PASS_ERRORS='%llu'\n"
+	  "DWIPE_VERIFY_ERRORS='%llu'\n",
+	  c->device_serial == NULL ? "" : c->device_serial,
+	  (unsigned long long) c->device_size,
+	  dwipe_method_label( dwipe_options.method ),
+	  dwipe_options.prng->label,
+	  ranges,
+	  dwipe_options.rounds,
+	  dwipe_options.verify,
+	  seed,
+	  j->step,
+	  offset,
+	  c->progress->round_working,
+	  c->progress->pass_working,
+	  c->progress->round_done,
+	  c->progress->pass_done,
+	  c->progress->pass_errors,
+	  c->progress->verify_errors );
+
+	if( n < 0 || n >= sizeof( buffer ) )
+	{
+		dwipe_log( DWIPE_LOG_SANITY, "The checkpoint of '%s' does not fit its buffer.", c->device_name );
+		return;
+	}
+
+	snprintf( path, sizeof( path ), "%s.tmp", j->path );
+
+	fd = open( path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR );
+
+	if( fd < 0 )
+	{
+		dwipe_perror( errno, __FUNCTION__, "open" );
+		dwipe_log( DWIPE_LOG_ERROR, "Unable to write the checkpoint '%s'.", path );
+		return;
+	}
+
+	if( write( fd, buffer, n ) != n || fdatasync( fd ) != 0 )
+	{
+		dwipe_perror( errno, __FUNCTION__, "write" );
+		dwipe_log( DWIPE_LOG_ERROR, "Unable to write the checkpoint '%s'.", path );
+		close( fd );
+		unlink( path );
+		return;
+	}
+
+	close( fd );
+
+	if( rename( path, j->path ) != 0 )
+	{
+		dwipe_perror( errno, __FUNCTION__, "rename" );
+		dwipe_log( DWIPE_LOG_ERROR, "Unable to replace the checkpoint '%s'.", j->path );
+		unlink( path );
+		return;
+	}
+
+	/* Make the rename itself durable. */
+	fd = open( dwipe_options.journal, O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+
+	if( fd >= 0 )
+	{
+		fsync( fd );
+		close( fd );
+	}
+
+} /* dwipe_journal_write */
+
+
+void dwipe_journal_checkpoint( dwipe_context_t* c, u64 offset, int done )
+{
+/**
+ * Records the position of the working pass or verification when a
+ * checkpoint is due.  A write position is only recorded once it is on the
+ * media, so the device is flushed first.
+ *
+ * @parameter offset  The bytes of the step that are done.
+ * @parameter done    Set when the step has finished and its writes are synced,
+ *                    which always makes a checkpoint.
+ *
+ */
+
+	/* The journal. */
+	dwipe_journal_t* j = c->journal;
+
+	/* The clock when the flush started, and the result holder. */
+	u64 t;
+	int r;
+
+	if( j == NULL ) { return; }
+
+	if( ! done && dwipe_progress_clock() - j->checkpointed < dwipe_options.checkpoint_interval * 1000000000ULL ) { return; }
+
+	if( ! done && ! j->reading )
+	{
+		/* Tell our parent that we are syncing the device. */
+		dwipe_progress_set( c, &c->progress->sync_status, 1 );
+
+		t = dwipe_progress_clock();
+		r = fdatasync( c->device_fd );
+		dwipe_progress_count( c, &c->progress->sync_ns, dwipe_progress_clock() - t );
+
+		dwipe_progress_set( c, &c->progress->sync_status, 0 );
+
+		if( r != 0 )
+		{
+			/* The old checkpoint is still true. */
+			dwipe_perror( errno, __FUNCTION__, "fdatasync" );
+			return;
+		}
+	}
+
+	dwipe_journal_write( c, offset );
+
+	j->checkpointed = dwipe_progress_clock();
+
+} /* dwipe_journal_checkpoint */
+
+
+void dwipe_journal_finish( dwipe_context_t* c )
+{
+/**
+ * Removes the checkpoint of a wipe that has finished, so that it is never
+ * resumed.
+ *
+ */
+
+	/* The directory descriptor. */
+	int fd;
+
+	if( c->journal == NULL ) { return; }
+
+	if( unlink( c->journal->path ) != 0 && errno != ENOENT )
+	{
+		dwipe_perror( errno, __FUNCTION__, "unlink" );
+		dwipe_log( DWIPE_LOG_ERROR, "Unable to remove the checkpoint '%s'.", c->journal->path );
+		return;
+	}
+
+	fd = open( dwipe_options.journal, O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+
+	if( fd >= 0 )
+	{
+		fsync( fd );
+		close( fd );
+	}
+
+} /* dwipe_journal_finish */
+
+/* eof */
@@ -0,0 +1,64 @@
+/*
+ *  journal.h: Checkpoints that let an interrupted wipe continue.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef JOURNAL_H_
+#define JOURNAL_H_
+
+/* The default number of seconds between the checkpoints of one device. */
+#define DWIPE_KNOB_JOURNAL_INTERVAL  60
+
+/* The bytes of a journaled random pass between reseeds of the PRNG. */
+#define DWIPE_KNOB_JOURNAL_SEGMENT   ( 1ULL << 30 )
+
+/* The largest checkpoint record. */
+#define DWIPE_KNOB_JOURNAL_SIZE      8192
+
+/* The checkpoint state of one wipe.  The parent fills it in before the fork. */
+struct dwipe_journal_t_
+{
+	char  path [FILENAME_MAX];                   /* The checkpoint file of the device.              */
+	u8    seed [DWIPE_KNOB_PRNG_STATE_LENGTH];   /* The seed of every random choice of the method.  */
+	u8    segment [DWIPE_KNOB_PRNG_STATE_LENGTH];/* The seed of the working random segment.         */
+	long long segment_index;                      /* The working segment, or -1 before the first.    */
+	void* schedule;                              /* The PRNG state that expands the seed.           */
+	int   resume;                                /* Set when the wipe continues from a checkpoint.  */
+	int   resume_step;                           /* The pass or verification that was interrupted.  */
+	u64   resume_offset;                         /* Where that step had reached, in bytes of a pass. */
+	int   resume_round;                          /* The round of that step.                         */
+	int   resume_pass;                           /* The pass of that step.                          */
+	u64   round_done;                            /* The progress counters at the checkpoint.        */
+	u64   pass_done;
+	u64   pass_errors;
+	u64   verify_errors;
+	int   step;                                  /* The working pass or verification of the child.  */
+	int   reading;                               /* Set while the working step is a verification.   */
+	u64   checkpointed;                          /* The CLOCK_MONOTONIC ns of the last checkpoint.  */
+};
+
+int     dwipe_journal_attach( dwipe_context_t* c );                         /* Load or start a journal.       */
+void    dwipe_journal_resume( dwipe_context_t* c );                         /* Restore the counters.          */
+ssize_t dwipe_journal_entropy( dwipe_context_t* c, void* buffer, size_t count );  /* Draw random bytes.   */
+u64     dwipe_journal_start( dwipe_context_t* c, int reading );             /* Find where a step starts.      */
+size_t  dwipe_journal_block( dwipe_context_t* c, u64 offset, size_t blocksize );  /* Seed a segment.    */
+void    dwipe_journal_checkpoint( dwipe_context_t* c, u64 offset, int done );  /* Record the position.    */
+void    dwipe_journal_finish( dwipe_context_t* c );                         /* Forget a finished wipe.        */
+
+#endif /* JOURNAL_H_ */
+
+/* eof */
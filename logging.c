@@ -19,156 +19,529 @@
  */
 
 
+/* RATIONALE:
+ *
+ *   Every message used to open the log file, lock it, format the date and
+ *   the text with several calls into stdio, unlock it and close it again, in
+ *   whichever child logged it.  That is a handful of system calls and a lock
+ *   that all the children fight over, and some messages are logged from
+ *   inside the loops of a pass.
+ *
+ *   Now the parent holds the log file open and is the only process that
+ *   writes to it.  A child formats each message once, into a private buffer,
+ *   and copies it into a ring of fixed-size records in shared memory, which
+ *   costs no system call and no lock.  The parent drains the rings when it
+ *   wakes up anyway and writes the records in one batch.  When a ring is
+ *   full, an error is still written straight to the file, but anything less
+ *   is dropped and counted, so that logging never slows down a wipe.
+ *
+ *   A message that is the same as the one before it is only counted, and the
+ *   count is logged with the next different message or after a while.  Each
+ *   call site, which is known by its format string, may also log only so
+ *   many messages each second; the messages over that rate are counted
+ *   instead, unless they report an error.  Both are done where the message
+ *   is made, so that a noisy loop does not even fill its ring.
+ *
+ */
+
+#include <pthread.h>
+
 #include "dwipe.h"
 #include "context.h"
 #include "method.h"
 #include "prng.h"
 #include "options.h"
 #include "logging.h"
+#include "progress.h"
 
 
-void dwipe_log( dwipe_log_t level, const char* format, ... )
+/* One preformatted message as the child publishes it. */
+typedef struct /* dwipe_log_record_t */
+{
+	time_t time;                               /* The wall clock of the message. */
+	int    level;                              /* A dwipe_log_t.                 */
+	char   text[ DWIPE_KNOB_LOG_BUFFERSIZE ];  /* The message without a newline. */
+} dwipe_log_record_t;
+
+/* The log records of one device.  The child moves the head and the parent moves the tail. */
+struct dwipe_logring_t_
+{
+	u64 head __attribute__(( aligned( DWIPE_KNOB_CACHELINE ) ));
+	u64 dropped;
+	u64 tail __attribute__(( aligned( DWIPE_KNOB_CACHELINE ) ));
+	dwipe_log_record_t ring[ DWIPE_KNOB_LOG_RING ] __attribute__(( aligned( DWIPE_KNOB_CACHELINE ) ));
+};
+
+/* The names of the levels, which are also the --loglevel arguments. */
+static const char* dwipe_log_names[] = { "", "debug", "info", "notice", "warning", "error", "fatal", "sanity" };
+
+/* The log file, which is opened by the first message under dwipe_log_mutex. */
+static int dwipe_log_fd = -1;
+static int dwipe_log_opened = 0;
+
+/* The ring of this process when it is a child, else NULL. */
+static dwipe_logring_t* dwipe_log_ring = NULL;
+
+/* Serializes the threads of the parent, and its writes to the log file.  A child has only one thread. */
+static pthread_mutex_t dwipe_log_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* The working message and the last one that was logged. */
+static char  dwipe_log_buffers[2][ DWIPE_KNOB_LOG_BUFFERSIZE ];
+static char* dwipe_log_text = dwipe_log_buffers[0];
+static char* dwipe_log_last = dwipe_log_buffers[1];
+static int   dwipe_log_last_level = -1;
+
+/* The number of times that the last message has been repeated since it was logged, and when it was. */
+static u64    dwipe_log_repeats = 0;
+static time_t dwipe_log_repeated = 0;
+
+/* The allowance of one call site, which is known by its format string. */
+typedef struct /* dwipe_log_site_t */
+{
+	const char* format;    /* The format of the call site, or NULL.     */
+	int         tokens;    /* The messages that may still be logged.    */
+	time_t      refilled;  /* When the allowance was last topped up.    */
+} dwipe_log_site_t;
+
+/* The allowances of the busiest call sites, and the messages over their rate. */
+static dwipe_log_site_t dwipe_log_sites[ DWIPE_KNOB_LOG_SITES ];
+static u64 dwipe_log_suppressed = 0;
+
+
+static int dwipe_log_line( char* buffer, size_t size, time_t t, int level, const char* text )
 {
 /**
- *  Writes a message to the program log file.
+ * Formats one line of the log file.
+ *
+ * @return  The length of the line, which ends with a newline.
  *
  */
 
+	/* The broken-down system time.  Probe threads log concurrently. */
+	struct tm tm;
 
-	/* A result buffer. */
-	int r;
+	/* The length of the line. */
+	int n;
 
-	/* A time buffer. */
-	time_t t;
+	gmtime_r( &t, &tm );
+
+	/* Print the date. The rc script uses the same format. */
+	n = snprintf( buffer, size, "[%i/%02i/%02i %02i:%02i:%02i] dwipe: ", \
+	  1900 + tm.tm_year, 1 + tm.tm_mon, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec );
+
+	if( level > DWIPE_LOG_NONE && level <= DWIPE_LOG_SANITY )
+	{
+		/* TODO: Request that the user report a sanity failure. */
+		n += snprintf( buffer + n, size - n, "%s: ", dwipe_log_names[level] );
+	}
 
-	/* A pointer to the system time struct. */
-	struct tm* p;
+	else if( level != DWIPE_LOG_NONE )
+	{
+		n += snprintf( buffer + n, size - n, "level %i: ", level );
+	}
 
-	/* The log file pointer. */
-	FILE* fp;
+	n += snprintf( buffer + n, size - n, "%s", text );
 
-	/* The log file descriptor. */
-	int fd;
+	/* A message that is too long is cut short rather than lost. */
+	if( (size_t) n > size - 2 ) { n = size - 2; }
 
-	/* The variable argument pointer. */
-	va_list ap;
+	buffer[ n++ ] = '\n';
+	buffer[ n ] = 0;
 
-	/* Get the current time. */
-	t = time( NULL );
-	p = gmtime( &t );
+	return n;
 
-	/* Open the log file for appending. */
-	fp = fopen( DWIPE_KNOB_LOGFILE, "a" );
+} /* dwipe_log_line */
 
-	if( fp == NULL )
+
+static void dwipe_log_write( const char* buffer, size_t size )
+{
+/**
+ * Appends whole lines to the log file, and opens it the first time.  The
+ * caller holds dwipe_log_mutex, unless it is a child, which has one thread.
+ *
+ */
+
+	/* The path of the log file. */
+	const char* path = ( dwipe_options.logfile != NULL ) ? dwipe_options.logfile : DWIPE_KNOB_LOGFILE;
+
+	if( ! dwipe_log_opened )
 	{
-		fprintf( stderr, "dwipe_log: Unable to open '%s' for logging.\n", DWIPE_KNOB_LOGFILE );
-		return;
+		dwipe_log_opened = 1;
+		dwipe_log_fd = open( path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH );
+
+		if( dwipe_log_fd < 0 )
+		{
+			perror( "dwipe_log: open:" );
+			fprintf( stderr, "dwipe_log: Unable to open '%s' for logging.\n", path );
+		}
 	}
-	
-	/* Get the file descriptor of the log file. */
-	fd = fileno( fp );
 
-	/* Block and lock. */
-	r = flock( fd, LOCK_EX );
+	/* An appended write lands whole, so the lines of the threads do not mix. */
+	if( dwipe_log_fd >= 0 && write( dwipe_log_fd, buffer, size ) < 0 )
+	{
+		perror( "dwipe_log: write:" );
+	}
+
+} /* dwipe_log_write */
+
 
-	if( r != 0 )
+static void dwipe_log_put( time_t t, int level, const char* text )
+{
+/**
+ * Logs one message, through the ring of a child or straight to the file.
+ *
+ */
+
+	/* A line of the log file. */
+	char line[ DWIPE_KNOB_LOG_BUFFERSIZE + 64 ];
+
+	/* The next free record. */
+	dwipe_log_record_t* e;
+
+	/* The positions of the ring. */
+	u64 head;
+	u64 tail;
+
+	if( dwipe_log_ring != NULL )
 	{
-		perror( "dwipe_log: flock:" );
-		fprintf( stderr, "dwipe_log: Unable to lock '%s' for logging.\n", DWIPE_KNOB_LOGFILE );
-		return;
+		head = dwipe_log_ring->head;
+		tail = __atomic_load_n( &dwipe_log_ring->tail, __ATOMIC_ACQUIRE );
+
+		if( head - tail < DWIPE_KNOB_LOG_RING )
+		{
+			e = &dwipe_log_ring->ring[ head % DWIPE_KNOB_LOG_RING ];
+			e->time  = t;
+			e->level = level;
+			strcpy( e->text, text );
+
+			__atomic_store_n( &dwipe_log_ring->head, head + 1, __ATOMIC_RELEASE );
+			return;
+		}
+
+		if( level < DWIPE_LOG_ERROR )
+		{
+			/* The parent is behind, so lose the message rather than wait. */
+			__atomic_fetch_add( &dwipe_log_ring->dropped, 1, __ATOMIC_RELAXED );
+			return;
+		}
 	}
 
-	/* Print the date. The rc script uses the same format. */
-	fprintf( fp, "[%i/%02i/%02i %02i:%02i:%02i] dwipe: ", \
-	  1900 + p->tm_year, 1 + p->tm_mon, p->tm_mday, p->tm_hour, p->tm_min, p->tm_sec );
+	dwipe_log_write( line, dwipe_log_line( line, sizeof( line ), t, level, text ) );
 
-	switch( level )
+} /* dwipe_log_put */
+
+
+static void dwipe_log_pending( time_t t )
+{
+/**
+ * Logs the counts of the messages that were repeated or over the rate.
+ *
+ */
+
+	/* The text of a count. */
+	char text[ 64 ];
+
+	if( dwipe_log_repeats > 0 )
 	{
+		snprintf( text, sizeof( text ), "The last message was repeated %llu times.", dwipe_log_repeats );
+		dwipe_log_put( t, dwipe_log_last_level, text );
+		dwipe_log_repeats = 0;
+	}
 
-		case DWIPE_LOG_NONE:
-			/* Do nothing. */
-			break;
+	if( dwipe_log_suppressed > 0 )
+	{
+		snprintf( text, sizeof( text ), "%llu messages were suppressed.", dwipe_log_suppressed );
+		dwipe_log_put( t, DWIPE_LOG_WARNING, text );
+		dwipe_log_suppressed = 0;
+	}
+
+	dwipe_log_repeated = t;
 
-		case DWIPE_LOG_DEBUG:
-			fprintf( fp, "debug: " );
-			break;
+} /* dwipe_log_pending */
 
-		case DWIPE_LOG_INFO:
-			fprintf( fp, "info: " );
-			break;
 
-		case DWIPE_LOG_NOTICE:
-			fprintf( fp, "notice: " );
-			break;
+static int dwipe_log_admit( time_t t, int level, const char* format )
+{
+/**
+ * Checks that a new message is within the rate of its call site.
+ *
+ */
 
-		case DWIPE_LOG_WARNING:
-			fprintf( fp, "warning: " );
-			break;
+	/* The allowance of the call site.  Sites that share a slot take it from each other. */
+	dwipe_log_site_t* site = &dwipe_log_sites[ ( (uintptr_t) format >> 3 ) % DWIPE_KNOB_LOG_SITES ];
 
-		case DWIPE_LOG_ERROR:
-			fprintf( fp, "error: " );
-			break;
+	/* Errors are never held back. */
+	if( level >= DWIPE_LOG_ERROR ) { return 1; }
 
-		case DWIPE_LOG_FATAL:
-			fprintf( fp, "fatal: " );
-			break;
+	if( site->format != format )
+	{
+		site->format   = format;
+		site->tokens   = DWIPE_KNOB_LOG_BURST;
+		site->refilled = t;
+	}
 
-		case DWIPE_LOG_SANITY:
-			/* TODO: Request that the user report the log. */
-			fprintf( fp, "sanity: " );
-			break;
+	if( t > site->refilled )
+	{
+		/* Top up the allowance for the seconds that have passed. */
+		if( t - site->refilled > DWIPE_KNOB_LOG_BURST / DWIPE_KNOB_LOG_RATE ) { site->tokens = DWIPE_KNOB_LOG_BURST; }
+		else { site->tokens += ( t - site->refilled ) * DWIPE_KNOB_LOG_RATE; }
 
-		default:
-			fprintf( fp, "level %i: ", level );
+		if( site->tokens > DWIPE_KNOB_LOG_BURST ) { site->tokens = DWIPE_KNOB_LOG_BURST; }
+		site->refilled = t;
+	}
 
+	if( site->tokens > 0 )
+	{
+		site->tokens -= 1;
+		return 1;
 	}
 
+	dwipe_log_suppressed += 1;
+	return 0;
+
+} /* dwipe_log_admit */
+
+
+void dwipe_log( dwipe_log_t level, const char* format, ... )
+{
+/**
+ *  Writes a message to the program log file.
+ *
+ */
+
+	/* The current time. */
+	time_t t;
+
+	/* The swap holder of the message buffers. */
+	char* p;
+
+	/* The variable argument pointer. */
+	va_list ap;
+
+	if( level != DWIPE_LOG_NONE && level < dwipe_options.loglevel ) { return; }
+
+	t = time( NULL );
+
+	if( dwipe_log_ring == NULL ) { pthread_mutex_lock( &dwipe_log_mutex ); }
+
 	/* Fetch the argument list. */
 	va_start( ap, format );
 
-	/* Print the event. */
-	vfprintf( fp, format, ap );
+	/* Format the event. */
+	vsnprintf( dwipe_log_text, DWIPE_KNOB_LOG_BUFFERSIZE, format, ap );
 
-/*
-	if( level >= DWIPE_LOG_WARNING )
+	/* Release the argument list. */
+	va_end( ap );
+
+	if( level == dwipe_log_last_level && strcmp( dwipe_log_text, dwipe_log_last ) == 0 )
 	{
-		vfprintf( stderr, format, ap );
+		/* Count the repeat, and log the count now and then. */
+		dwipe_log_repeats += 1;
+		if( t - dwipe_log_repeated >= DWIPE_KNOB_LOG_COALESCE ) { dwipe_log_pending( t ); }
 	}
-*/
 
-	/* Release the argument list. */
-	va_end( ap );
+	else if( dwipe_log_admit( t, level, format ) )
+	{
+		dwipe_log_pending( t );
+		dwipe_log_put( t, level, dwipe_log_text );
+
+		/* Keep the message to compare with the next one. */
+		p = dwipe_log_last;
+		dwipe_log_last = dwipe_log_text;
+		dwipe_log_text = p;
+		dwipe_log_last_level = level;
+	}
 
-	/* Append a newline. */
-	fprintf( fp, "\n" );
+	if( dwipe_log_ring == NULL ) { pthread_mutex_unlock( &dwipe_log_mutex ); }
 
-/*
-	if( level >= DWIPE_LOG_WARNING )
+} /* dwipe_log */
+
+
+int dwipe_log_parse( const char* name )
+{
+/**
+ * Reads the name of a log level.
+ *
+ * @return  The dwipe_log_t, or -1 when the name is unknown.
+ *
+ */
+
+	/* A generic loop variable. */
+	int i;
+
+	for( i = DWIPE_LOG_DEBUG ; i <= DWIPE_LOG_FATAL ; i++ )
 	{
-		fprintf( stderr, "\n" );
+		if( strcmp( name, dwipe_log_names[i] ) == 0 ) { return i; }
 	}
-*/
 
-	/* Unlock the file. */
-	r = flock( fd, LOCK_UN );
+	return -1;
 
-	if( r != 0 )
+} /* dwipe_log_parse */
+
+
+int dwipe_log_init( int count, dwipe_context_t* c )
+{
+/**
+ * Gives every device a ring for the messages of its child.
+ *
+ * @parameter count  The number of contexts in the array.
+ * @parameter c      An array of device contexts.
+ * @return           0 on success, -1 on failure.
+ *
+ */
+
+	/* The rings. */
+	dwipe_logring_t* rings;
+
+	/* A generic loop variable. */
+	int i;
+
+	rings = dwipe_shm_alloc( count * sizeof( dwipe_logring_t ) );
+
+	if( rings == NULL )
 	{
-		perror( "dwipe_log: flock:" );
-		fprintf( stderr, "Error: Unable to unlock '%s' after logging.\n", DWIPE_KNOB_LOGFILE );
+		dwipe_log( DWIPE_LOG_FATAL, "Unable to allocate shared memory for the log rings." );
+		return -1;
 	}
 
-	/* Close the stream. */
-	r = fclose( fp );
+	for( i = 0 ; i < count ; i++ )
+	{
+		c[i].logring = &rings[i];
+	}
+
+	return 0;
+
+} /* dwipe_log_init */
+
+
+void dwipe_log_attach( dwipe_context_t* c )
+{
+/**
+ * Sends the messages of a child through the ring of its device.  Only the
+ * child of c may call this, before it logs anything.
+ *
+ */
+
+	dwipe_log_ring = c->logring;
+
+	/* The child starts with its own allowances and nothing to repeat. */
+	dwipe_log_last_level = -1;
+	dwipe_log_repeats    = 0;
+	dwipe_log_suppressed = 0;
+	memset( dwipe_log_sites, 0, sizeof( dwipe_log_sites ) );
 
-	if( r != 0 )
+} /* dwipe_log_attach */
+
+
+void dwipe_log_flush( void )
+{
+/**
+ * Logs the counts that are still held, as a child does before it exits.
+ *
+ */
+
+	if( dwipe_log_ring == NULL ) { pthread_mutex_lock( &dwipe_log_mutex ); }
+
+	if( dwipe_log_repeats > 0 || dwipe_log_suppressed > 0 ) { dwipe_log_pending( time( NULL ) ); }
+
+	if( dwipe_log_ring == NULL ) { pthread_mutex_unlock( &dwipe_log_mutex ); }
+
+} /* dwipe_log_flush */
+
+
+void dwipe_log_drain( int count, dwipe_context_t* c )
+{
+/**
+ * Writes the messages that the children have published, in one batch.
+ *
+ * @parameter count  The number of contexts in the array.
+ * @parameter c      An array of device contexts.
+ *
+ */
+
+	/* The lines of the batch. */
+	static char batch[ DWIPE_KNOB_LOG_BATCH ];
+	size_t n = 0;
+
+	/* The ring of one device. */
+	dwipe_logring_t* r;
+
+	/* One record. */
+	dwipe_log_record_t* e;
+
+	/* The positions of the ring. */
+	u64 head;
+	u64 tail;
+
+	/* The messages that a child could not publish. */
+	u64 dropped;
+	char text[ DWIPE_KNOB_LOG_BUFFERSIZE ];
+
+	/* A generic loop variable. */
+	int i;
+
+	/* The probe threads may be logging, and the first message opens the file. */
+	pthread_mutex_lock( &dwipe_log_mutex );
+
+	for( i = 0 ; i < count ; i++ )
 	{
-		perror( "dwipe_log: fclose:" );
-		fprintf( stderr, "Error: Unable to close '%s' after logging.\n", DWIPE_KNOB_LOGFILE );
+		if( ( r = c[i].logring ) == NULL ) { continue; }
+
+		head = __atomic_load_n( &r->head, __ATOMIC_ACQUIRE );
+
+		for( tail = r->tail ; tail != head ; tail++ )
+		{
+			if( n + DWIPE_KNOB_LOG_BUFFERSIZE + 64 > sizeof( batch ) )
+			{
+				dwipe_log_write( batch, n );
+				n = 0;
+			}
+
+			e = &r->ring[ tail % DWIPE_KNOB_LOG_RING ];
+			n += dwipe_log_line( batch + n, sizeof( batch ) - n, e->time, e->level, e->text );
+		}
+
+		__atomic_store_n( &r->tail, tail, __ATOMIC_RELEASE );
+
+		if( __atomic_load_n( &r->dropped, __ATOMIC_RELAXED ) > 0 )
+		{
+			dropped = __atomic_exchange_n( &r->dropped, 0, __ATOMIC_RELAXED );
+
+			if( n + DWIPE_KNOB_LOG_BUFFERSIZE + 64 > sizeof( batch ) )
+			{
+				dwipe_log_write( batch, n );
+				n = 0;
+			}
+
+			snprintf( text, sizeof( text ), "%llu messages of the wipe of '%s' were lost.", dropped, c[i].device_name );
+			n += dwipe_log_line( batch + n, sizeof( batch ) - n, time( NULL ), DWIPE_LOG_WARNING, text );
+		}
 	}
 
-} /* dwipe_log */
+	if( n > 0 ) { dwipe_log_write( batch, n ); }
+
+	pthread_mutex_unlock( &dwipe_log_mutex );
+
+} /* dwipe_log_drain */
+
+
+void dwipe_log_reset( dwipe_context_t* c )
+{
+/**
+ * Writes what the last child of a reused context left in its ring, and
+ * empties the ring for the next one.  No child of c may be running.
+ *
+ */
+
+	if( c->logring == NULL ) { return; }
+
+	dwipe_log_drain( 1, c );
+
+	c->logring->head    = 0;
+	c->logring->tail    = 0;
+	c->logring->dropped = 0;
+
+} /* dwipe_log_reset */
 
 
 void dwipe_perror( int dwipe_errno, const char* f, const char* s )
@@ -22,6 +22,22 @@
 #ifndef LOGGING_H_
 #define LOGGING_H_
 
+/* The number of log records that a child can publish before the parent drains them. */
+#define DWIPE_KNOB_LOG_RING      64
+
+/* The messages that a call site can log at once, and then each second, before it is muted. */
+#define DWIPE_KNOB_LOG_BURST     32
+#define DWIPE_KNOB_LOG_RATE      8
+
+/* The number of call sites whose rate is kept by each process. */
+#define DWIPE_KNOB_LOG_SITES     64
+
+/* The seconds that a repeated message is counted before the count is logged. */
+#define DWIPE_KNOB_LOG_COALESCE  10
+
+/* The bytes of child records that the parent writes at once. */
+#define DWIPE_KNOB_LOG_BATCH     ( 64 * 1024 )
+
 typedef enum dwipe_log_t_
 {
 	DWIPE_LOG_NONE = 0,
@@ -36,6 +52,12 @@ typedef enum dwipe_log_t_
 
 void dwipe_log( dwipe_log_t level, const char* format, ... );
 void dwipe_perror( int dwipe_errno, const char* f, const char* s );
+int  dwipe_log_parse( const char* name );                    /* Read a --loglevel name.        */
+int  dwipe_log_init( int count, dwipe_context_t* c );        /* Give every device a log ring.  */
+void dwipe_log_attach( dwipe_context_t* c );                 /* Log through a ring in a child. */
+void dwipe_log_flush( void );                                /* Log the pending repeat counts. */
+void dwipe_log_drain( int count, dwipe_context_t* c );       /* Write the child records.       */
+void dwipe_log_reset( dwipe_context_t* c );                  /* Empty the ring of a new drive. */
 
 #endif /* LOGGING_H_ */
 
@@ -44,6 +44,12 @@
 #include "options.h"
 #include "pass.h"
 #include "logging.h"
+#include "progress.h"
+#include "events.h"
+#include "journal.h"
+#include "tune.h"
+#include "arena.h"
+#include "durability.h"
 
 
 /*
@@ -85,26 +91,96 @@ const char* dwipe_method_label( dwipe_method_t method )
 } /* dwipe_method_label */
 
 
-int dwipe_zero( DWIPE_METHOD_SIGNATURE )
+static int dwipe_method_count( const dwipe_pattern_t* patterns )
 {
 /**
- * Fill the device with zeroes.
+ *  Returns the number of passes in a pattern array, which is padded with
+ *  { 0, NULL }.
+ *
+ */
+
+	/* The result. */
+	int i = 0;
+
+	while( patterns[i].length ) { i += 1; }
+
+	return i;
+
+} /* dwipe_method_count */
+
+
+u64 dwipe_method_round_size( int pass_count, loff_t device_size )
+{
+/**
+ *  Returns the number of bytes that dwipe_runmethod will move across all
+ *  rounds, including the final pass and its verification.  The device_size
+ *  is the number of bytes that one pass covers.
  *
  */
 
-	/* Do nothing because dwipe_runmethod appends a zero-fill. */
-	dwipe_pattern_t patterns [] =
+	/* The number of bytes in one round. */
+	u64 pass_size = pass_count * device_size;
+
+	/* The result. */
+	u64 round_size;
+
+	if( dwipe_options.verify == DWIPE_VERIFY_ALL )
 	{
-		{ 0, NULL }
-	};
+		/* We must read back all passes, so double the byte count. */
+		pass_size *= 2;
+	}
+
+	round_size = dwipe_options.rounds * pass_size;
+
+	/* The final pass is always a zero fill, except ops2 which is random. */
+	round_size += device_size;
+
+	if( dwipe_options.verify == DWIPE_VERIFY_LAST || dwipe_options.verify == DWIPE_VERIFY_ALL )
+	{
+		/* We must read back the last pass to verify it. */
+		round_size += device_size;
+	}
+
+	return round_size;
+
+} /* dwipe_method_round_size */
+
+
+/* Do nothing because dwipe_runmethod appends a zero-fill. */
+static dwipe_pattern_t dwipe_zero_patterns [] =
+{
+	{ 0, NULL }
+};
+
+int dwipe_zero( DWIPE_METHOD_SIGNATURE )
+{
+/**
+ * Fill the device with zeroes.
+ *
+ */
 
 	/* Run the method. */
-	return dwipe_runmethod( c, patterns );
+	return dwipe_runmethod( c, dwipe_zero_patterns );
 
 } /* dwipe_zero */
 
 
 
+/* Random characters for the DoD methods.  Each child fills its own copy. (Elements 2 and 6 are unused.) */
+static char dwipe_dod [7];
+
+static dwipe_pattern_t dwipe_dod522022m_patterns [] =
+{
+	{  1, &dwipe_dod[0] }, /* Pass 1: A random character.               */
+	{  1, &dwipe_dod[1] }, /* Pass 2: The bitwise complement of pass 1. */
+	{ -1, ""            }, /* Pass 3: A random stream.                  */
+	{  1, &dwipe_dod[3] }, /* Pass 4: A random character.               */
+	{  1, &dwipe_dod[4] }, /* Pass 5: A random character.               */
+	{  1, &dwipe_dod[5] }, /* Pass 6: The bitwise complement of pass 5. */
+	{ -1, ""            }, /* Pass 7: A random stream.                  */
+	{  0, NULL          }
+};
+
 int dwipe_dod522022m( DWIPE_METHOD_SIGNATURE )
 {
 /**
@@ -115,28 +191,16 @@ int dwipe_dod522022m( DWIPE_METHOD_SIGNATURE )
 	/* A result holder. */
 	int r;
 
-	/* Random characters. (Elements 2 and 6 are unused.) */
-	char dod [7];
-
-	dwipe_pattern_t patterns [] =
-	{
-		{  1, &dod[0] }, /* Pass 1: A random character.               */
-		{  1, &dod[1] }, /* Pass 2: The bitwise complement of pass 1. */
-		{ -1, ""      }, /* Pass 3: A random stream.                  */
-		{  1, &dod[3] }, /* Pass 4: A random character.               */
-		{  1, &dod[4] }, /* Pass 5: A random character.               */
-		{  1, &dod[5] }, /* Pass 6: The bitwise complement of pass 5. */
-		{ -1, ""      }, /* Pass 7: A random stream.                  */
-		{  0, NULL   }
-	};
+	/* Random characters. */
+	char* dod = dwipe_dod;
 
 	/* Load the array with random characters. */
-	r = read( c->entropy_fd, &dod, sizeof( dod ) );
+	r = dwipe_journal_entropy( c, dwipe_dod, sizeof( dwipe_dod ) );
 
 	/* NOTE: Only the random data in dod[0], dod[3], and dod[4] is actually used. */
 
 	/* Check the result. */
-	if( r != sizeof( dod ) )
+	if( r != sizeof( dwipe_dod ) )
 	{
 		r = errno;
 		dwipe_perror( r, __FUNCTION__, "read" );
@@ -155,12 +219,20 @@ int dwipe_dod522022m( DWIPE_METHOD_SIGNATURE )
 	dod[5] = ~ dod[4];
 
 	/* Run the DoD 5220.22-M method. */
-	return dwipe_runmethod( c, patterns );
+	return dwipe_runmethod( c, dwipe_dod522022m_patterns );
 
 } /* dwipe_dod522022m */
 
 
 
+static dwipe_pattern_t dwipe_dodshort_patterns [] =
+{
+	{  1, &dwipe_dod[0] }, /* Pass 1: A random character.               */
+	{  1, &dwipe_dod[1] }, /* Pass 2: The bitwise complement of pass 1. */
+	{ -1, ""            }, /* Pass 3: A random stream.                  */
+	{  0, NULL          }
+};
+
 int dwipe_dodshort( DWIPE_METHOD_SIGNATURE )
 {
 /**
@@ -172,24 +244,16 @@ int dwipe_dodshort( DWIPE_METHOD_SIGNATURE )
 	/* A result holder. */
 	int r;
 
-	/* Random characters. (Element 3 is unused.) */
-	char dod [3];
-
-	dwipe_pattern_t patterns [] =
-	{
-		{  1, &dod[0] }, /* Pass 1: A random character.               */
-		{  1, &dod[1] }, /* Pass 2: The bitwise complement of pass 1. */
-		{ -1, ""      }, /* Pass 3: A random stream.                  */
-		{  0, NULL   }
-	};
+	/* Random characters. (Only the first three are read.) */
+	char* dod = dwipe_dod;
 
 	/* Load the array with random characters. */
-	r = read( c->entropy_fd, &dod, sizeof( dod ) );
+	r = dwipe_journal_entropy( c, dwipe_dod, 3 );
 
 	/* NOTE: Only the random data in dod[0] is actually used. */
 
 	/* Check the result. */
-	if( r != sizeof( dod ) )
+	if( r != 3 )
 	{
 		r = errno;
 		dwipe_perror( r, __FUNCTION__, "read" );
@@ -205,12 +269,53 @@ int dwipe_dodshort( DWIPE_METHOD_SIGNATURE )
 	dod[1] = ~ dod[0];
 
 	/* Run the DoD 5220.022-M short method. */
-	return dwipe_runmethod( c, patterns );
+	return dwipe_runmethod( c, dwipe_dodshort_patterns );
 
 } /* dwipe_dodshort */
 
 
 
+/* Define the Gutmann method. */
+static dwipe_pattern_t dwipe_gutmann_book [] =
+{
+	{ -1, ""             }, /* Random pass.                                      */
+	{ -1, ""             }, /* Random pass.                                      */
+	{ -1, ""             }, /* Random pass.                                      */
+	{ -1, ""             }, /* Random pass.                                      */
+	{  3, "\x55\x55\x55" }, /* Static pass: 0x555555  01010101 01010101 01010101 */
+	{  3, "\xAA\xAA\xAA" }, /* Static pass: 0XAAAAAA  10101010 10101010 10101010 */
+	{  3, "\x92\x49\x24" }, /* Static pass: 0x924924  10010010 01001001 00100100 */
+	{  3, "\x49\x24\x92" }, /* Static pass: 0x492492  01001001 00100100 10010010 */
+	{  3, "\x24\x92\x49" }, /* Static pass: 0x249249  00100100 10010010 01001001 */
+	{  3, "\x00\x00\x00" }, /* Static pass: 0x000000  00000000 00000000 00000000 */
+	{  3, "\x11\x11\x11" }, /* Static pass: 0x111111  00010001 00010001 00010001 */
+	{  3, "\x22\x22\x22" }, /* Static pass: 0x222222  00100010 00100010 00100010 */
+	{  3, "\x33\x33\x33" }, /* Static pass: 0x333333  00110011 00110011 00110011 */
+	{  3, "\x44\x44\x44" }, /* Static pass: 0x444444  01000100 01000100 01000100 */
+	{  3, "\x55\x55\x55" }, /* Static pass: 0x555555  01010101 01010101 01010101 */
+	{  3, "\x66\x66\x66" }, /* Static pass: 0x666666  01100110 01100110 01100110 */
+	{  3, "\x77\x77\x77" }, /* Static pass: 0x777777  01110111 01110111 01110111 */
+	{  3, "\x88\x88\x88" }, /* Static pass: 0x888888  10001000 10001000 10001000 */
+	{  3, "\x99\x99\x99" }, /* Static pass: 0x999999  10011001 10011001 10011001 */
+	{  3, "\xAA\xAA\xAA" }, /* Static pass: 0xAAAAAA  10101010 10101010 10101010 */
+	{  3, "\xBB\xBB\xBB" }, /* Static pass: 0xBBBBBB  10111011 10111011 10111011 */
+	{  3, "\xCC\xCC\xCC" }, /* Static pass: 0xCCCCCC  11001100 11001100 11001100 */
+	{  3, "\xDD\xDD\xDD" }, /* Static pass: 0xDDDDDD  11011101 11011101 11011101 */
+	{  3, "\xEE\xEE\xEE" }, /* Static pass: 0xEEEEEE  11101110 11101110 11101110 */
+	{  3, "\xFF\xFF\xFF" }, /* Static pass: 0xFFFFFF  11111111 11111111 11111111 */
+	{  3, "\x92\x49\x24" }, /* Static pass: 0x924924  10010010 01001001 00100100 */
+	{  3, "\x49\x24\x92" }, /* Static pass: 0x492492  01001001 00100100 10010010 */
+	{  3, "\x24\x92\x49" }, /* Static pass: 0x249249  00100100 10010010 01001001 */
+	{  3, "\x6D\xB6\xDB" }, /* Static pass: 0x6DB6DB  01101101 10110110 11011011 */
+	{  3, "\xB6\xDB\x6D" }, /* Static pass: 0xB6DB6D  10110110 11011011 01101101 */
+	{  3, "\xDB\x6D\xB6" }, /* Static pass: 0XDB6DB6  11011011 01101101 10110110 */
+	{ -1, ""             }, /* Random pass.                                      */
+	{ -1, ""             }, /* Random pass.                                      */
+	{ -1, ""             }, /* Random pass.                                      */
+	{ -1, ""             }, /* Random pass.                                      */
+	{ 0, NULL }
+};
+
 int dwipe_gutmann( DWIPE_METHOD_SIGNATURE )
 {
 /**
@@ -222,7 +327,7 @@ int dwipe_gutmann( DWIPE_METHOD_SIGNATURE )
 	int r;
 
 	/* The number of patterns in the Guttman Wipe, also used to index the 'patterns' array. */
-	int i = 35;
+	int i = dwipe_method_count( dwipe_gutmann_book );
 
 	/* An index into the 'book' array. */
 	int j;
@@ -230,55 +335,20 @@ int dwipe_gutmann( DWIPE_METHOD_SIGNATURE )
 	/* The N-th element that has not been used. */
 	int n;
 
-	/* Define the Gutmann method. */
-	dwipe_pattern_t book [] =
-	{
-		{ -1, ""             }, /* Random pass.                                      */
-		{ -1, ""             }, /* Random pass.                                      */
-		{ -1, ""             }, /* Random pass.                                      */
-		{ -1, ""             }, /* Random pass.                                      */
-		{  3, "\x55\x55\x55" }, /* Static pass: 0x555555  01010101 01010101 01010101 */
-		{  3, "\xAA\xAA\xAA" }, /* Static pass: 0XAAAAAA  10101010 10101010 10101010 */
-		{  3, "\x92\x49\x24" }, /* Static pass: 0x924924  10010010 01001001 00100100 */
-		{  3, "\x49\x24\x92" }, /* Static pass: 0x492492  01001001 00100100 10010010 */
-		{  3, "\x24\x92\x49" }, /* Static pass: 0x249249  00100100 10010010 01001001 */
-		{  3, "\x00\x00\x00" }, /* Static pass: 0x000000  00000000 00000000 00000000 */
-		{  3, "\x11\x11\x11" }, /* Static pass: 0x111111  00010001 00010001 00010001 */
-		{  3, "\x22\x22\x22" }, /* Static pass: 0x222222  00100010 00100010 00100010 */
-		{  3, "\x33\x33\x33" }, /* Static pass: 0x333333  00110011 00110011 00110011 */
-		{  3, "\x44\x44\x44" }, /* Static pass: 0x444444  01000100 01000100 01000100 */
-		{  3, "\x55\x55\x55" }, /* Static pass: 0x555555  01010101 01010101 01010101 */
-		{  3, "\x66\x66\x66" }, /* Static pass: 0x666666  01100110 01100110 01100110 */
-		{  3, "\x77\x77\x77" }, /* Static pass: 0x777777  01110111 01110111 01110111 */
-		{  3, "\x88\x88\x88" }, /* Static pass: 0x888888  10001000 10001000 10001000 */
-		{  3, "\x99\x99\x99" }, /* Static pass: 0x999999  10011001 10011001 10011001 */
-		{  3, "\xAA\xAA\xAA" }, /* Static pass: 0xAAAAAA  10101010 10101010 10101010 */
-		{  3, "\xBB\xBB\xBB" }, /* Static pass: 0xBBBBBB  10111011 10111011 10111011 */
-		{  3, "\xCC\xCC\xCC" }, /* Static pass: 0xCCCCCC  11001100 11001100 11001100 */
-		{  3, "\xDD\xDD\xDD" }, /* Static pass: 0xDDDDDD  11011101 11011101 11011101 */
-		{  3, "\xEE\xEE\xEE" }, /* Static pass: 0xEEEEEE  11101110 11101110 11101110 */
-		{  3, "\xFF\xFF\xFF" }, /* Static pass: 0xFFFFFF  11111111 11111111 11111111 */
-		{  3, "\x92\x49\x24" }, /* Static pass: 0x924924  10010010 01001001 00100100 */
-		{  3, "\x49\x24\x92" }, /* Static pass: 0x492492  01001001 00100100 10010010 */
-		{  3, "\x24\x92\x49" }, /* Static pass: 0x249249  00100100 10010010 01001001 */
-		{  3, "\x6D\xB6\xDB" }, /* Static pass: 0x6DB6DB  01101101 10110110 11011011 */
-		{  3, "\xB6\xDB\x6D" }, /* Static pass: 0xB6DB6D  10110110 11011011 01101101 */
-		{  3, "\xDB\x6D\xB6" }, /* Static pass: 0XDB6DB6  11011011 01101101 10110110 */
-		{ -1, ""             }, /* Random pass.                                      */
-		{ -1, ""             }, /* Random pass.                                      */
-		{ -1, ""             }, /* Random pass.                                      */
-		{ -1, ""             }, /* Random pass.                                      */
-		{ 0, NULL }
-	};
+	/* The passes that have not been copied yet. */
+	dwipe_pattern_t book [ sizeof( dwipe_gutmann_book ) / sizeof( dwipe_pattern_t ) ];
 
 	/* Put the book array into this array in random order. */
-	dwipe_pattern_t patterns [36];
+	dwipe_pattern_t patterns [ sizeof( dwipe_gutmann_book ) / sizeof( dwipe_pattern_t ) ];
 
 	/* An entropy buffer. */
 	u16 s [i];
 
+	/* The shuffle marks the passes that it has copied. */
+	memcpy( book, dwipe_gutmann_book, sizeof( book ) );
+
 	/* Load the array with random characters. */
-	r = read( c->entropy_fd, &s, sizeof( s ) );
+	r = dwipe_journal_entropy( c, &s, sizeof( s ) );
 
 	if( r != sizeof( s ) )
 	{
@@ -320,8 +390,9 @@ int dwipe_gutmann( DWIPE_METHOD_SIGNATURE )
 	}
 
 	/* Ensure that the array is terminated. */
-	patterns[35].length = 0;
-	patterns[35].s = NULL;
+	i = dwipe_method_count( dwipe_gutmann_book );
+	patterns[i].length = 0;
+	patterns[i].s = NULL;
 
 	/* Run the Gutmann method. */
 	return dwipe_runmethod( c, patterns );
@@ -330,6 +401,14 @@ int dwipe_gutmann( DWIPE_METHOD_SIGNATURE )
 
 
 
+/* One round of OPS-II.  Even passes write a random character, and odd passes its complement. */
+static dwipe_pattern_t dwipe_ops2_round [] =
+{
+	{ 1, NULL }, { 1, NULL }, { 1, NULL }, { 1, NULL },
+	{ 1, NULL }, { 1, NULL }, { 1, NULL }, { 1, NULL },
+	{ 0, NULL }
+};
+
 int dwipe_ops2( DWIPE_METHOD_SIGNATURE )
 {
 /**
@@ -402,7 +481,7 @@ int dwipe_ops2( DWIPE_METHOD_SIGNATURE )
 
 
 	/* Load the array of random characters. */
-	r = read( c->entropy_fd, s, u );
+	r = dwipe_journal_entropy( c, s, u );
 
 	if( r != u )
 	{
@@ -471,6 +550,13 @@ int dwipe_ops2( DWIPE_METHOD_SIGNATURE )
 
 
 
+/* Define the random method. */
+static dwipe_pattern_t dwipe_random_patterns [] =
+{
+	{ -1, ""   },
+	{  0, NULL }
+};
+
 int dwipe_random( DWIPE_METHOD_SIGNATURE )
 {
 /**
@@ -478,20 +564,35 @@ int dwipe_random( DWIPE_METHOD_SIGNATURE )
  *
  */
 
-	/* Define the random method. */
-	dwipe_pattern_t patterns [] =
-	{
-		{ -1, ""   },
-		{  0, NULL }
-	};
-
 	/* Run the method. */
-	return dwipe_runmethod( c, patterns );
+	return dwipe_runmethod( c, dwipe_random_patterns );
 
 } /* dwipe_zero */
 
 
 
+int dwipe_method_passes( dwipe_method_t method )
+{
+/**
+ *  Returns the number of passes in one round of the method, not counting
+ *  the final pass that dwipe_runmethod appends.  The count is taken from
+ *  the pattern array of the method, so that it cannot drift from the table.
+ *
+ */
+
+	if( method == &dwipe_dod522022m ) { return dwipe_method_count( dwipe_dod522022m_patterns ); }
+	if( method == &dwipe_dodshort   ) { return dwipe_method_count( dwipe_dodshort_patterns   ); }
+	if( method == &dwipe_gutmann    ) { return dwipe_method_count( dwipe_gutmann_book        ); }
+	if( method == &dwipe_ops2       ) { return dwipe_method_count( dwipe_ops2_round ) * dwipe_options.rounds; }
+	if( method == &dwipe_random     ) { return dwipe_method_count( dwipe_random_patterns     ); }
+	if( method == &dwipe_zero       ) { return dwipe_method_count( dwipe_zero_patterns       ); }
+
+	/* else */
+	return 0;
+
+} /* dwipe_method_passes */
+
+
 int dwipe_runmethod( DWIPE_METHOD_SIGNATURE, dwipe_pattern_t* patterns )
 {
 /**
@@ -505,6 +606,10 @@ int dwipe_runmethod( DWIPE_METHOD_SIGNATURE, dwipe_pattern_t* patterns )
 	/* An index variable. */
 	int i = 0;
 
+	/* Another index variable, and the longest static pattern. */
+	int j;
+	int longest = 0;
+
 	/* The zero-fill pattern for the final pass of most methods. */
 	dwipe_pattern_t pattern_zero = { 1, "\x00" };
 
@@ -522,14 +627,14 @@ int dwipe_runmethod( DWIPE_METHOD_SIGNATURE, dwipe_pattern_t* patterns )
 	}
 
 	/* Count the number of patterns in the array. */
-	while( patterns[i].length ) { i += 1; }
+	i = dwipe_method_count( patterns );
  
 
 	/* Tell the parent the number of device passes that will be run in one round. */
 	c->pass_count = i;
 
 	/* Set the number of bytes that will be written across all passes in one round. */
-	c->pass_size = c->pass_count * c->device_size;
+	c->pass_size = c->pass_count * c->wipe_size;
 
 	if( dwipe_options.verify == DWIPE_VERIFY_ALL )
 	{
@@ -542,42 +647,50 @@ int dwipe_runmethod( DWIPE_METHOD_SIGNATURE, dwipe_pattern_t* patterns )
 	c->round_count = dwipe_options.rounds;
 
 	/* Set the number of bytes that will be written across all rounds. */
-	c->round_size = c->round_count * c->pass_size;
+	c->round_size = dwipe_method_round_size( c->pass_count, c->wipe_size );
 
-	/* The final pass is always a zero fill, except ops2 which is random. */
-	c->round_size += c->device_size;
+	/* Count the passes of a resumed wipe that finished before its checkpoint. */
+	dwipe_journal_resume( c );
 
-	if( dwipe_options.verify == DWIPE_VERIFY_LAST || dwipe_options.verify == DWIPE_VERIFY_ALL )
-	{
-		/* We must read back the last pass to verify it. */
-		c->round_size += c->device_size;
-	}
 
+	/* Open the device the way that the sync policy writes it. */
+	if( dwipe_durability_open( c ) != 0 ) { return -1; }
+
+	/* Time the block size of the device before the first pass overwrites the timing. */
+	dwipe_tune( c );
+
+	/* The static passes need room for two copies of their longest pattern. */
+	for( j = 0 ; patterns[j].length ; j++ ) { if( patterns[j].length > longest ) { longest = patterns[j].length; } }
+
+	/* Allocate the buffers that every pass borrows, now that the block size is final. */
+	if( dwipe_arena_init( c, longest ) != 0 ) { return -1; }
 
 	/* Initialize the working round counter. */
-	c->round_working = 0;
+	dwipe_progress_set( c, &c->progress->round_working, 0 );
 
 	dwipe_log( DWIPE_LOG_NOTICE, "Invoking method '%s' on device '%s'.", \
 	  dwipe_method_label( dwipe_options.method ), c->device_name );
 
-	while( c->round_working < c->round_count )
+	while( c->progress->round_working < c->round_count )
 	{
 		/* Increment the round counter. */
-		c->round_working += 1;
+		dwipe_progress_set( c, &c->progress->round_working, c->progress->round_working + 1 );
 
 		dwipe_log( DWIPE_LOG_NOTICE, "Starting round %i of %i on device '%s'.", \
-		  c->round_working, c->round_count, c->device_name );
+		  c->progress->round_working, c->round_count, c->device_name );
+
+		dwipe_event( c, DWIPE_EVENT_ROUND_START, 0 );
 
 		/* Initialize the working pass counter. */
-		c->pass_working = 0;
+		dwipe_progress_set( c, &c->progress->pass_working, 0 );
 
 		for( i = 0 ; i < c->pass_count ; i++ )
 		{
 			/* Increment the working pass. */
-			c->pass_working += 1;
+			dwipe_progress_set( c, &c->progress->pass_working, c->progress->pass_working + 1 );
 
 			dwipe_log( DWIPE_LOG_NOTICE, "Starting pass %i of %i, round %i of %i, on device '%s'.", \
-			  c->pass_working, c->pass_count, c->round_working, c->round_count, c->device_name );
+			  c->progress->pass_working, c->pass_count, c->progress->round_working, c->round_count, c->device_name );
 
 			if( patterns[i].length == 0 )
 			{
@@ -590,9 +703,11 @@ int dwipe_runmethod( DWIPE_METHOD_SIGNATURE, dwipe_pattern_t* patterns )
 			{
 
 				/* Write a static pass. */
-				c->pass_type = DWIPE_PASS_WRITE;
+				dwipe_progress_set( c, &c->progress->pass_type, DWIPE_PASS_WRITE );
+				dwipe_event( c, DWIPE_EVENT_PASS_START, 0 );
 				r = dwipe_static_pass( c, &patterns[i] );
-				c->pass_type = DWIPE_PASS_NONE;
+				dwipe_event( c, DWIPE_EVENT_PASS_END, r );
+				dwipe_progress_set( c, &c->progress->pass_type, DWIPE_PASS_NONE );
 	
 				/* Check for a fatal error. */
 				if( r < 0 ) { return r; }
@@ -601,33 +716,35 @@ int dwipe_runmethod( DWIPE_METHOD_SIGNATURE, dwipe_pattern_t* patterns )
 				{
 
 					dwipe_log( DWIPE_LOG_NOTICE, "Verifying pass %i of %i, round %i of %i, on device '%s'.", \
-			  		  c->pass_working, c->pass_count, c->round_working, c->round_count, c->device_name );
+			  		  c->progress->pass_working, c->pass_count, c->progress->round_working, c->round_count, c->device_name );
 
 					/* Verify this pass. */
-					c->pass_type = DWIPE_PASS_VERIFY;
+					dwipe_progress_set( c, &c->progress->pass_type, DWIPE_PASS_VERIFY );
+					dwipe_event( c, DWIPE_EVENT_VERIFY_START, 0 );
 					r = dwipe_static_verify( c, &patterns[i] );
-					c->pass_type = DWIPE_PASS_NONE;
+					dwipe_event( c, DWIPE_EVENT_VERIFY_END, r );
+					dwipe_progress_set( c, &c->progress->pass_type, DWIPE_PASS_NONE );
 	
 					/* Check for a fatal error. */
 					if( r < 0 ) { return r; }
 
 					dwipe_log( DWIPE_LOG_NOTICE, "Verified pass %i of %i, round %i of %i, on device '%s'.", \
-			  		  c->pass_working, c->pass_count, c->round_working, c->round_count, c->device_name );
+			  		  c->progress->pass_working, c->pass_count, c->progress->round_working, c->round_count, c->device_name );
 				}
 		
 			} /* static pass */
 	
 			else
 			{
-				c->pass_type = DWIPE_PASS_WRITE;
+				dwipe_progress_set( c, &c->progress->pass_type, DWIPE_PASS_WRITE );
 
 				/* Seed the PRNG. */
-				r = read( c->entropy_fd, c->prng_seed.s, c->prng_seed.length );
+				r = dwipe_journal_entropy( c, c->prng_seed.s, c->prng_seed.length );
 	
 				/* Check the result. */
 				if( r < 0 )
 				{
-					c->pass_type = DWIPE_PASS_NONE;
+					dwipe_progress_set( c, &c->progress->pass_type, DWIPE_PASS_NONE );
 					dwipe_perror( errno, __FUNCTION__, "read" );
 					dwipe_log( DWIPE_LOG_FATAL, "Unable to seed the PRNG." );
 					return -1;
@@ -642,8 +759,10 @@ int dwipe_runmethod( DWIPE_METHOD_SIGNATURE, dwipe_pattern_t* patterns )
 				}
 	
 				/* Write the random pass. */
+				dwipe_event( c, DWIPE_EVENT_PASS_START, 0 );
 				r = dwipe_random_pass( c );
-				c->pass_type = DWIPE_PASS_NONE;
+				dwipe_event( c, DWIPE_EVENT_PASS_END, r );
+				dwipe_progress_set( c, &c->progress->pass_type, DWIPE_PASS_NONE );
 	
 				/* Check for a fatal error. */
 				if( r < 0 ) { return r; }
@@ -651,29 +770,33 @@ int dwipe_runmethod( DWIPE_METHOD_SIGNATURE, dwipe_pattern_t* patterns )
 				if( dwipe_options.verify == DWIPE_VERIFY_ALL )
 				{
 					dwipe_log( DWIPE_LOG_NOTICE, "Verifying pass %i of %i, round %i of %i, on device '%s'.", \
-			  		  c->pass_working, c->pass_count, c->round_working, c->round_count, c->device_name );
+			  		  c->progress->pass_working, c->pass_count, c->progress->round_working, c->round_count, c->device_name );
 
 					/* Verify this pass. */
-					c->pass_type = DWIPE_PASS_VERIFY;
+					dwipe_progress_set( c, &c->progress->pass_type, DWIPE_PASS_VERIFY );
+					dwipe_event( c, DWIPE_EVENT_VERIFY_START, 0 );
 					r = dwipe_random_verify( c );
-					c->pass_type = DWIPE_PASS_NONE;
+					dwipe_event( c, DWIPE_EVENT_VERIFY_END, r );
+					dwipe_progress_set( c, &c->progress->pass_type, DWIPE_PASS_NONE );
 	
 					/* Check for a fatal error. */
 					if( r < 0 ) { return r; }
 
 					dwipe_log( DWIPE_LOG_NOTICE, "Verified pass %i of %i, round %i of %i, on device '%s'.", \
-			  		  c->pass_working, c->pass_count, c->round_working, c->round_count, dwipe_method_label( dwipe_options.method ) );
+			  		  c->progress->pass_working, c->pass_count, c->progress->round_working, c->round_count, dwipe_method_label( dwipe_options.method ) );
 				}
 	
 			} /* random pass */
 	
 			dwipe_log( DWIPE_LOG_NOTICE, "Finished pass %i of %i, round %i of %i, on device '%s'.", \
-			  c->pass_working, c->pass_count, c->round_working, c->round_count, c->device_name );
+			  c->progress->pass_working, c->pass_count, c->progress->round_working, c->round_count, c->device_name );
 
 		} /* for passes */
 
 		dwipe_log( DWIPE_LOG_NOTICE, "Finished round %i of %i on device '%s'.", \
-		  c->round_working, c->round_count, c->device_name );
+		  c->progress->round_working, c->round_count, c->device_name );
+
+		dwipe_event( c, DWIPE_EVENT_ROUND_END, 0 );
 	
 	} /* while rounds */
 
@@ -683,10 +806,10 @@ int dwipe_runmethod( DWIPE_METHOD_SIGNATURE, dwipe_pattern_t* patterns )
 		/* NOTE: The OPS-II method specifically requires that a random pattern be left on the device. */
 
 		/* Tell the parent that we are running the final pass. */
-		c->pass_type = DWIPE_PASS_FINAL_OPS2;
+		dwipe_progress_set( c, &c->progress->pass_type, DWIPE_PASS_FINAL_OPS2 );
 
 		/* Seed the PRNG. */
-		r = read( c->entropy_fd, c->prng_seed.s, c->prng_seed.length );
+		r = dwipe_journal_entropy( c, c->prng_seed.s, c->prng_seed.length );
 	
 		/* Check the result. */
 		if( r < 0 )
@@ -707,7 +830,9 @@ int dwipe_runmethod( DWIPE_METHOD_SIGNATURE, dwipe_pattern_t* patterns )
 		dwipe_log( DWIPE_LOG_NOTICE, "Writing final random pattern to '%s'.", c->device_name );
 
 		/* The final ops2 pass. */
+		dwipe_event( c, DWIPE_EVENT_PASS_START, 0 );
 		r = dwipe_random_pass( c );
+		dwipe_event( c, DWIPE_EVENT_PASS_END, r );
 
 		/* Check for a fatal error. */
 		if( r < 0 ) { return r; }
@@ -717,7 +842,9 @@ int dwipe_runmethod( DWIPE_METHOD_SIGNATURE, dwipe_pattern_t* patterns )
 			dwipe_log( DWIPE_LOG_NOTICE, "Verifying the final random pattern on '%s' is empty.", c->device_name );
 
 			/* Verify the final zero pass. */
+			dwipe_event( c, DWIPE_EVENT_VERIFY_START, 0 );
 			r = dwipe_random_verify( c );
+			dwipe_event( c, DWIPE_EVENT_VERIFY_END, r );
 
 			/* Check for a fatal error. */
 			if( r < 0 ) { return r; }
@@ -733,12 +860,14 @@ int dwipe_runmethod( DWIPE_METHOD_SIGNATURE, dwipe_pattern_t* patterns )
 	else
 	{
 		/* Tell the user that we are on the final pass. */
-		c->pass_type = DWIPE_PASS_FINAL_BLANK;
+		dwipe_progress_set( c, &c->progress->pass_type, DWIPE_PASS_FINAL_BLANK );
 
 		dwipe_log( DWIPE_LOG_NOTICE, "Blanking device '%s'.", c->device_name );
 
 		/* The final zero pass. */
+		dwipe_event( c, DWIPE_EVENT_PASS_START, 0 );
 		r = dwipe_static_pass( c, &pattern_zero );
+		dwipe_event( c, DWIPE_EVENT_PASS_END, r );
 	
 		/* Check for a fatal error. */
 		if( r < 0 ) { return r; }
@@ -749,7 +878,9 @@ int dwipe_runmethod( DWIPE_METHOD_SIGNATURE, dwipe_pattern_t* patterns )
 			dwipe_log( DWIPE_LOG_NOTICE, "Verifying that '%s' is empty.", c->device_name );
 	
 			/* Verify the final zero pass. */
+			dwipe_event( c, DWIPE_EVENT_VERIFY_START, 0 );
 			r = dwipe_static_verify( c, &pattern_zero );
+			dwipe_event( c, DWIPE_EVENT_VERIFY_END, r );
 	
 			/* Check for a fatal error. */
 			if( r < 0 ) { return r; }
@@ -766,23 +897,26 @@ int dwipe_runmethod( DWIPE_METHOD_SIGNATURE, dwipe_pattern_t* patterns )
 	free( c->prng_seed.s );
 	
 	/* Tell the parent that we have fininshed the final pass. */
-	c->pass_type = DWIPE_PASS_NONE;
+	dwipe_progress_set( c, &c->progress->pass_type, DWIPE_PASS_NONE );
+
+	/* A finished wipe must never be resumed. */
+	dwipe_journal_finish( c );
 
-	if( c->verify_errors > 0 )
+	if( c->progress->verify_errors > 0 )
 	{
 		/* We finished, but with non-fatal verification errors. */
-		dwipe_log( DWIPE_LOG_ERROR, "%llu verification errors on device '%s'.", c->verify_errors, c->device_name );
+		dwipe_log( DWIPE_LOG_ERROR, "%llu verification errors on device '%s'.", c->progress->verify_errors, c->device_name );
 	}
 
-	if( c->pass_errors > 0 )
+	if( c->progress->pass_errors > 0 )
 	{
 		/* We finished, but with non-fatal wipe errors. */
-		dwipe_log( DWIPE_LOG_ERROR, "%llu wipe errors on device '%s'.", c->pass_errors, c->device_name );
+		dwipe_log( DWIPE_LOG_ERROR, "%llu wipe errors on device '%s'.", c->progress->pass_errors, c->device_name );
 	}
 
 	/* FIXME: The 'round_errors' context member is not being used. */
 
-	if( c->pass_errors > 0 || c->round_errors > 0 || c->verify_errors > 0 )
+	if( c->progress->pass_errors > 0 || c->progress->round_errors > 0 || c->progress->verify_errors > 0 )
 	{
 		/* We finished, but with non-fatal errors. */
 		return 1;
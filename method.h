@@ -43,6 +43,8 @@ typedef struct /* dwipe_pattern_t */
 } dwipe_pattern_t;
 
 const char* dwipe_method_label( dwipe_method_t method );
+int dwipe_method_passes( dwipe_method_t method );
+u64 dwipe_method_round_size( int pass_count, loff_t device_size );
 int dwipe_runmethod( DWIPE_METHOD_SIGNATURE, dwipe_pattern_t* patterns );
 
 int dwipe_dod522022m( DWIPE_METHOD_SIGNATURE );
@@ -0,0 +1,433 @@
+/*
+ *  metrics.c: Prometheus metrics for wipe stations.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+/* RATIONALE:
+ *
+ *   Fleet dashboards want the same numbers from every station, so the
+ *   metrics are rendered in the Prometheus text format from snapshots of
+ *   the shared progress slots, never from what the gui happens to show.
+ *
+ *   They can be served on a TCP port, one connection at a time from the
+ *   supervisor's loop, or written to a textfile for the node exporter.  The
+ *   textfile is written to a temporary name and renamed, so that the
+ *   collector never reads half of it.  A scrape blocks the parent for at
+ *   most DWIPE_KNOB_METRICS_TIMEOUT, which delays the screen but never the
+ *   children that do the i/o.
+ *
+ */
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "dwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "logging.h"
+#include "progress.h"
+#include "supervise.h"
+#include "metrics.h"
+
+
+/* The context array that is reported. */
+static int dwipe_metrics_count = 0;
+static dwipe_context_t* dwipe_metrics_c = NULL;
+
+/* The listening socket, or -1. */
+static int dwipe_metrics_fd = -1;
+
+/* The time of the last textfile. */
+static time_t dwipe_metrics_written = 0;
+
+/* The time that the program started. */
+static time_t dwipe_metrics_start = 0;
+
+
+static void dwipe_metrics_label( FILE* f, dwipe_context_t* c, const char* extra )
+{
+/**
+ * Prints the label set of a device, escaped as the text format requires.
+ *
+ * @parameter extra  Labels that come before the device, each followed by a comma.
+ *
+ */
+
+	/* A position in the device name. */
+	const char* p;
+
+	fprintf( f, "{%sdevice=\"", extra );
+
+	for( p = c->device_name ; *p ; p++ )
+	{
+		if( *p == '\\' || *p == '"' ) { fputc( '\\', f ); }
+		if( *p == '\n' ) { fputs( "\\n", f ); continue; }
+		fputc( *p, f );
+	}
+
+	fputs( "\"}", f );
+
+} /* dwipe_metrics_label */
+
+
+static void dwipe_metrics_family( FILE* f, const char* name, const char* type, const char* help )
+{
+/**
+ * Prints the header of a metric family.
+ *
+ */
+
+	fprintf( f, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type );
+
+} /* dwipe_metrics_family */
+
+
+static void dwipe_metrics_render( FILE* f )
+{
+/**
+ * Prints every metric.
+ *
+ * @parameter f  Where to print.
+ *
+ */
+
+	dwipe_context_t* c = dwipe_metrics_c;
+
+	/* The snapshots of the progress slots. */
+	dwipe_progress_t* s;
+
+	/* The number of devices in each state. */
+	int states[ DWIPE_STATE_REPORTED + 1 ] = { 0 };
+
+	/* The station totals. */
+	u64 written  = 0;
+	u64 verified = 0;
+
+	/* The names of the states. */
+	static const char* names[] = { "idle", "queued", "running", "done", "finished" };
+
+	/* The quantiles that are reported. */
+	static const double quantiles[] = { 0.5, 0.9, 0.99 };
+
+	/* The names of the kinds of i/o. */
+	static const char* ops[] = { "write", "read" };
+
+	/* The extra labels, and the histogram that is being printed. */
+	char label[ 48 ];
+	dwipe_latency_t* h;
+
+	/* Generic loop variables. */
+	int i;
+	int j;
+	int k;
+
+	s = malloc( dwipe_metrics_count * sizeof( dwipe_progress_t ) );
+
+	if( s == NULL )
+	{
+		dwipe_perror( errno, __FUNCTION__, "malloc" );
+		return;
+	}
+
+	for( i = 0 ; i < dwipe_metrics_count ; i++ )
+	{
+		dwipe_progress_snapshot( c[i].progress, &s[i] );
+
+		if( c[i].device_name == NULL ) { continue; }
+
+		states[ c[i].state ] += 1;
+		written  += s[i].bytes_written;
+		verified += s[i].bytes_verified;
+	}
+
+	dwipe_metrics_family( f, "dwipe_start_time_seconds", "gauge", "The time that the station started." );
+	fprintf( f, "dwipe_start_time_seconds %lu\n", (unsigned long) dwipe_metrics_start );
+
+	dwipe_metrics_family( f, "dwipe_devices", "gauge", "The number of devices in each state." );
+	for( j = 0 ; j <= DWIPE_STATE_REPORTED ; j++ )
+	{
+		fprintf( f, "dwipe_devices{state=\"%s\"} %i\n", names[j], states[j] );
+	}
+
+	dwipe_metrics_family( f, "dwipe_station_bytes_written_total", "counter", "The bytes written to all devices." );
+	fprintf( f, "dwipe_station_bytes_written_total %llu\n", written );
+
+	dwipe_metrics_family( f, "dwipe_station_bytes_verified_total", "counter", "The bytes read back from all devices." );
+	fprintf( f, "dwipe_station_bytes_verified_total %llu\n", verified );
+
+	/* One family at a time, as the text format requires. */
+#define DWIPE_METRICS_EACH( name, type, help, format, value ) \
+	dwipe_metrics_family( f, name, type, help ); \
+	for( i = 0 ; i < dwipe_metrics_count ; i++ ) \
+	{ \
+		if( c[i].device_name == NULL || c[i].state == DWIPE_STATE_NONE ) { continue; } \
+		fputs( name, f ); dwipe_metrics_label( f, &c[i], "" ); fprintf( f, " " format "\n", value ); \
+	}
+
+	DWIPE_METRICS_EACH( "dwipe_bytes_written_total",  "counter", "The bytes written in all passes.",          "%llu", s[i].bytes_written )
+	DWIPE_METRICS_EACH( "dwipe_bytes_verified_total", "counter", "The bytes read back in all verifications.", "%llu", s[i].bytes_verified )
+	DWIPE_METRICS_EACH( "dwipe_bytes_total",          "gauge",   "The bytes that the method will move.",      "%llu", c[i].round_size )
+	DWIPE_METRICS_EACH( "dwipe_round",                "gauge",   "The working round.",                        "%i",   c[i].round_working )
+	DWIPE_METRICS_EACH( "dwipe_rounds",               "gauge",   "The number of rounds.",                     "%i",   c[i].round_count )
+	DWIPE_METRICS_EACH( "dwipe_pass",                 "gauge",   "The working pass.",                         "%i",   c[i].pass_working )
+	DWIPE_METRICS_EACH( "dwipe_passes",               "gauge",   "The number of passes in a round.",          "%i",   c[i].pass_count )
+	DWIPE_METRICS_EACH( "dwipe_throughput_bytes_per_second", "gauge", "The recent average throughput.",      "%llu", c[i].throughput )
+	DWIPE_METRICS_EACH( "dwipe_throughput_now_bytes_per_second", "gauge", "The throughput over the last sample.", "%llu", c[i].throughput_now )
+	DWIPE_METRICS_EACH( "dwipe_throughput_avg_bytes_per_second", "gauge", "The long average throughput.",    "%llu", c[i].throughput_avg )
+	DWIPE_METRICS_EACH( "dwipe_eta_seconds",          "gauge",   "The estimated time to completion.",         "%llu", c[i].eta )
+	DWIPE_METRICS_EACH( "dwipe_write_errors_total",   "counter", "The bytes that could not be written.",      "%llu", s[i].pass_errors )
+	DWIPE_METRICS_EACH( "dwipe_verify_errors_total",  "counter", "The blocks that did not verify.",           "%llu", s[i].verify_errors )
+	DWIPE_METRICS_EACH( "dwipe_sync_seconds_total",   "counter", "The time spent flushing the device.",       "%.6f", s[i].sync_ns / 1e9 )
+	DWIPE_METRICS_EACH( "dwipe_prng_seconds_total",   "counter", "The time spent filling buffers from the PRNG.", "%.6f", s[i].prng_ns / 1e9 )
+	DWIPE_METRICS_EACH( "dwipe_rate_limit_bytes_per_second", "gauge", "The rate limit, or zero for none.",    "%llu", s[i].rate_limit )
+	DWIPE_METRICS_EACH( "dwipe_throttle_seconds_total", "counter", "The time spent asleep under a rate limit.", "%.6f", s[i].throttle_ns / 1e9 )
+	DWIPE_METRICS_EACH( "dwipe_result",               "gauge",   "The exit value of a finished wipe.",        "%i",   c[i].result )
+	DWIPE_METRICS_EACH( "dwipe_outlier",              "gauge",   "Why the drive lags its peers, or zero.",    "%i",   c[i].outlier )
+
+#undef DWIPE_METRICS_EACH
+
+	dwipe_metrics_family( f, "dwipe_io_latency_seconds", "summary", "The time taken by one read or write." );
+
+	for( i = 0 ; i < dwipe_metrics_count ; i++ )
+	{
+		if( c[i].device_name == NULL || c[i].state == DWIPE_STATE_NONE ) { continue; }
+
+		for( k = 0 ; k < DWIPE_IO_KINDS ; k++ )
+		{
+			h = &s[i].latency[k];
+
+			for( j = 0 ; j < (int)( sizeof( quantiles ) / sizeof( quantiles[0] ) ) ; j++ )
+			{
+				snprintf( label, sizeof( label ), "op=\"%s\",quantile=\"%g\",", ops[k], quantiles[j] );
+				fputs( "dwipe_io_latency_seconds", f ); dwipe_metrics_label( f, &c[i], label );
+				fprintf( f, " %.6f\n", dwipe_latency_quantile( h, quantiles[j] ) / 1e9 );
+			}
+
+			snprintf( label, sizeof( label ), "op=\"%s\",", ops[k] );
+			fputs( "dwipe_io_latency_seconds_sum", f ); dwipe_metrics_label( f, &c[i], label );
+			fprintf( f, " %.6f\n", h->ns / 1e9 );
+			fputs( "dwipe_io_latency_seconds_count", f ); dwipe_metrics_label( f, &c[i], label );
+			fprintf( f, " %llu\n", h->count );
+		}
+	}
+
+	dwipe_metrics_family( f, "dwipe_io_latency_max_seconds", "gauge", "The slowest read or write." );
+
+	for( i = 0 ; i < dwipe_metrics_count ; i++ )
+	{
+		if( c[i].device_name == NULL || c[i].state == DWIPE_STATE_NONE ) { continue; }
+
+		for( k = 0 ; k < DWIPE_IO_KINDS ; k++ )
+		{
+			snprintf( label, sizeof( label ), "op=\"%s\",", ops[k] );
+			fputs( "dwipe_io_latency_max_seconds", f ); dwipe_metrics_label( f, &c[i], label );
+			fprintf( f, " %.6f\n", s[i].latency[k].max_ns / 1e9 );
+		}
+	}
+
+	free( s );
+
+} /* dwipe_metrics_render */
+
+
+static void dwipe_metrics_serve( int fd, void* arg )
+{
+/**
+ * Answers one scrape.
+ *
+ */
+
+	/* The connection. */
+	int client;
+
+	/* The socket timeouts. */
+	struct timeval tv = { DWIPE_KNOB_METRICS_TIMEOUT, 0 };
+
+	/* The request, which is read and ignored. */
+	char request[ 1024 ];
+
+	/* The body of the reply. */
+	char*  body = NULL;
+	size_t size = 0;
+	FILE*  f;
+
+	/* The header of the reply. */
+	char header[ 128 ];
+	int n;
+
+	client = accept( fd, NULL, NULL );
+
+	if( client < 0 ) { return; }
+
+	setsockopt( client, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof( tv ) );
+	setsockopt( client, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof( tv ) );
+
+	/* Every path is the metrics, but the request must be read before the reply. */
+	if( recv( client, request, sizeof( request ), 0 ) <= 0 )
+	{
+		close( client );
+		return;
+	}
+
+	f = open_memstream( &body, &size );
+
+	if( f != NULL )
+	{
+		dwipe_metrics_render( f );
+		fclose( f );
+
+		n = snprintf( header, sizeof( header ), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %lu\r\n\r\n", (unsigned long) size );
+
+		if( send( client, header, n, MSG_NOSIGNAL ) == n ) { send( client, body, size, MSG_NOSIGNAL ); }
+	}
+
+	free( body );
+	close( client );
+
+} /* dwipe_metrics_serve */
+
+
+static void dwipe_metrics_write( void )
+{
+/**
+ * Replaces the textfile.
+ *
+ */
+
+	/* The temporary file name. */
+	char path[ FILENAME_MAX ];
+
+	FILE* f;
+
+	snprintf( path, sizeof( path ), "%s.tmp", dwipe_options.metrics_file );
+
+	f = fopen( path, "w" );
+
+	if( f == NULL )
+	{
+		dwipe_perror( errno, __FUNCTION__, "fopen" );
+		return;
+	}
+
+	dwipe_metrics_render( f );
+
+	if( fclose( f ) != 0 || rename( path, dwipe_options.metrics_file ) != 0 )
+	{
+		dwipe_perror( errno, __FUNCTION__, "rename" );
+		unlink( path );
+	}
+
+} /* dwipe_metrics_write */
+
+
+int dwipe_metrics_init( int count, dwipe_context_t* c )
+{
+/**
+ * Opens the metrics port if one was given.
+ *
+ * @parameter count  The number of contexts in the array.
+ * @parameter c      The context array that is reported.
+ * @returns          Zero on success, -1 on failure.
+ *
+ */
+
+	/* The address to listen on. */
+	struct sockaddr_in addr;
+
+	/* The value of SO_REUSEADDR. */
+	int one = 1;
+
+	dwipe_metrics_count = count;
+	dwipe_metrics_c     = c;
+	dwipe_metrics_start = time( NULL );
+
+	if( dwipe_options.metrics_port == 0 ) { return 0; }
+
+	memset( &addr, 0, sizeof( addr ) );
+	addr.sin_family      = AF_INET;
+	addr.sin_port        = htons( dwipe_options.metrics_port );
+	addr.sin_addr.s_addr = htonl( INADDR_ANY );
+
+	dwipe_metrics_fd = socket( AF_INET, SOCK_STREAM, 0 );
+
+	if( dwipe_metrics_fd < 0
+	    || setsockopt( dwipe_metrics_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof( one ) ) != 0
+	    || bind( dwipe_metrics_fd, (struct sockaddr*) &addr, sizeof( addr ) ) != 0
+	    || listen( dwipe_metrics_fd, 4 ) != 0 )
+	{
+		dwipe_perror( errno, __FUNCTION__, "bind" );
+		dwipe_log( DWIPE_LOG_FATAL, "Unable to serve metrics on port %i.", dwipe_options.metrics_port );
+		if( dwipe_metrics_fd >= 0 ) { close( dwipe_metrics_fd ); }
+		dwipe_metrics_fd = -1;
+		return -1;
+	}
+
+	fcntl( dwipe_metrics_fd, F_SETFL, O_NONBLOCK );
+
+	if( dwipe_supervise_watch( dwipe_metrics_fd, dwipe_metrics_serve, NULL ) != 0 )
+	{
+		close( dwipe_metrics_fd );
+		dwipe_metrics_fd = -1;
+		return -1;
+	}
+
+	dwipe_log( DWIPE_LOG_NOTICE, "Serving metrics on port %i.", dwipe_options.metrics_port );
+
+	return 0;
+
+} /* dwipe_metrics_init */
+
+
+void dwipe_metrics_tick( void )
+{
+/**
+ * Rewrites the textfile if it is due.
+ *
+ */
+
+	/* The current time. */
+	time_t now = time( NULL );
+
+	if( dwipe_options.metrics_file == NULL || now - dwipe_metrics_written < DWIPE_KNOB_METRICS_INTERVAL ) { return; }
+
+	dwipe_metrics_written = now;
+	dwipe_metrics_write();
+
+} /* dwipe_metrics_tick */
+
+
+void dwipe_metrics_free( void )
+{
+/**
+ * Writes the final textfile and closes the metrics port.
+ *
+ */
+
+	if( dwipe_options.metrics_file != NULL && dwipe_metrics_c != NULL ) { dwipe_metrics_write(); }
+
+	if( dwipe_metrics_fd >= 0 )
+	{
+		dwipe_supervise_unwatch( dwipe_metrics_fd );
+		close( dwipe_metrics_fd );
+		dwipe_metrics_fd = -1;
+	}
+
+} /* dwipe_metrics_free */
+
+/* eof */
@@ -0,0 +1,35 @@
+/*
+ *  metrics.h: Prometheus metrics for wipe stations.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef METRICS_H_
+#define METRICS_H_
+
+/* The number of seconds between rewrites of the textfile. */
+#define DWIPE_KNOB_METRICS_INTERVAL  5
+
+/* The number of seconds that a scraper may take to send its request or read the reply. */
+#define DWIPE_KNOB_METRICS_TIMEOUT   1
+
+int  dwipe_metrics_init( int count, dwipe_context_t* c );  /* Open the listener.             */
+void dwipe_metrics_tick( void );                           /* Rewrite the textfile when due. */
+void dwipe_metrics_free( void );                           /* Write the final textfile.      */
+
+#endif /* METRICS_H_ */
+
+/* eof */
@@ -24,6 +24,13 @@
 #include "prng.h"
 #include "options.h"
 #include "logging.h"
+#include "journal.h"
+#include "range.h"
+#include "progress.h"
+#include "badsector.h"
+#include "tune.h"
+#include "writeback.h"
+#include "durability.h"
 
 /* The global options struct. */
 dwipe_options_t dwipe_options;
@@ -41,12 +48,73 @@ void dwipe_options_usage()
     fprintf(stderr, "         The pseudo random number generator implementation.\n");
     fprintf(stderr, "    -r|--rounds : default 1\n");
     fprintf(stderr, "         The number of times that the wipe method should be called.\n");
-    fprintf(stderr, "    -s|--sync   : default off\n");
-    fprintf(stderr, "         A flag to indicate whether writes should be sync'd.\n");
+    fprintf(stderr, "    -s|--sync[=none|pass|periodic[:MiB]|dsync|fua] : default pass, or dsync for a bare -s\n");
+    fprintf(stderr, "         How writes are made durable: never, per pass, every %i MiB, with O_DSYNC or per block with FUA.\n", DWIPE_KNOB_SYNC_PERIOD);
     fprintf(stderr, "    -v|--verify [off|last|all] : default last\n");
     fprintf(stderr, "         A flag to indicate whether writes should be verified.\n");
     fprintf(stderr, "    -e|--exclude [dev] :\n");
     fprintf(stderr, "         Device should survive from dwipe\n");
+    fprintf(stderr, "    --group-limit [n] : default 0 (unlimited)\n");
+    fprintf(stderr, "         The number of devices wiped at once on each host adapter and bus.\n");
+    fprintf(stderr, "    --group-bandwidth [MB/s] : default 0 (unlimited)\n");
+    fprintf(stderr, "         Stop starting devices on a host adapter and bus above this rate.\n");
+    fprintf(stderr, "    --order [fifo|longest|lpt] : default lpt\n");
+    fprintf(stderr, "         The order in which queued devices are started.\n");
+    fprintf(stderr, "    --expected-throughput [MB/s] : default %i\n", DWIPE_KNOB_EXPECTED_THROUGHPUT / 1000000);
+    fprintf(stderr, "         The assumed speed of a device before it has been measured.\n");
+    fprintf(stderr, "    --probe-threads [n] : default %i\n", DWIPE_KNOB_PROBE_THREADS);
+    fprintf(stderr, "         The number of devices that are probed at once at startup.\n");
+    fprintf(stderr, "    --probe-timeout [seconds] : default %i\n", DWIPE_KNOB_PROBE_TIMEOUT);
+    fprintf(stderr, "         Disable a device that does not answer its probe in time.\n");
+    fprintf(stderr, "    --station   : default off\n");
+    fprintf(stderr, "         Keep running and wipe whole disks as they are plugged in.\n");
+    fprintf(stderr, "    --headless  : default off\n");
+    fprintf(stderr, "         Run without the terminal interface.  Needs -a or --control.\n");
+    fprintf(stderr, "    --control [path] :\n");
+    fprintf(stderr, "         Accept start, stop, pause, status and rate commands on this Unix socket.\n");
+    fprintf(stderr, "    --events [path] :\n");
+    fprintf(stderr, "         Write JSON lines of progress to this file, FIFO or Unix socket.\n");
+    fprintf(stderr, "    --metrics-port [port] : default off\n");
+    fprintf(stderr, "         Serve Prometheus metrics over HTTP on this TCP port.\n");
+    fprintf(stderr, "    --metrics-file [path] :\n");
+    fprintf(stderr, "         Rewrite Prometheus metrics to this textfile every few seconds.\n");
+    fprintf(stderr, "    --outlier-action [flag|deprioritize|abort] : default flag\n");
+    fprintf(stderr, "         What to do with a drive that is much slower than others of its model.\n");
+    fprintf(stderr, "    --rate-device [MB/s] : default 0 (unlimited)\n");
+    fprintf(stderr, "         Cap the bandwidth of each device.\n");
+    fprintf(stderr, "    --rate-group [MB/s] : default 0 (unlimited)\n");
+    fprintf(stderr, "         Cap the combined bandwidth of the devices on each host adapter and bus.\n");
+    fprintf(stderr, "    --rate-station [MB/s] : default 0 (unlimited)\n");
+    fprintf(stderr, "         Cap the combined bandwidth of all devices.\n");
+    fprintf(stderr, "    --journal [directory] :\n");
+    fprintf(stderr, "         Keep a checkpoint of each wipe in this directory.\n");
+    fprintf(stderr, "    --resume    : default off\n");
+    fprintf(stderr, "         Continue the wipes of drives that have a checkpoint in the journal.\n");
+    fprintf(stderr, "    --checkpoint-interval [seconds] : default %i\n", DWIPE_KNOB_JOURNAL_INTERVAL);
+    fprintf(stderr, "         The least time between two checkpoints of one device.\n");
+    fprintf(stderr, "    --range [offset[:length],...] : default the whole device\n");
+    fprintf(stderr, "         Only wipe these extents.  A negative offset counts from the end, a missing\n");
+    fprintf(stderr, "         length reaches the end, and numbers take s (sectors), K, M, G or T suffixes.\n");
+    fprintf(stderr, "    --tolerant  : default off\n");
+    fprintf(stderr, "         Skip and list bad sectors instead of failing the device.\n");
+    fprintf(stderr, "    --retries [count] : default %i\n", DWIPE_KNOB_BADSECTOR_RETRIES);
+    fprintf(stderr, "         Try a failed sector this many more times before skipping it.\n");
+    fprintf(stderr, "    --max-bad-sectors [count] : default %i\n", DWIPE_KNOB_BADSECTOR_MAX);
+    fprintf(stderr, "         Fail the device when it has more bad sectors than this.\n");
+    fprintf(stderr, "    --autotune  : default off\n");
+    fprintf(stderr, "         Time a few block sizes on each device before its first pass and keep the fastest.\n");
+    fprintf(stderr, "    --tune-cache [path] : default %s\n", DWIPE_KNOB_TUNE_CACHE);
+    fprintf(stderr, "         Remember the tuned block size of each drive model in this file.\n");
+    fprintf(stderr, "    --mlock     : default off\n");
+    fprintf(stderr, "         Lock the i/o buffers of each wipe in memory so that they are never swapped.\n");
+    fprintf(stderr, "    --hugepages [off|auto|reserve] : default auto\n");
+    fprintf(stderr, "         Back the i/o buffers with 2 MiB pages, and with reserve grow the pool for them first.\n");
+    fprintf(stderr, "    --writeback-window [MiB] : default %i\n", DWIPE_KNOB_WRITEBACK_WINDOW);
+    fprintf(stderr, "         Write each pass back to the media this much at a time.  0 leaves it to the final sync.\n");
+    fprintf(stderr, "    --logfile [path] : default %s\n", DWIPE_KNOB_LOGFILE);
+    fprintf(stderr, "         Append the program log to this file.\n");
+    fprintf(stderr, "    --loglevel [debug|info|notice|warning|error|fatal] : default debug\n");
+    fprintf(stderr, "         Leave the messages below this level out of the log.\n");
     fprintf(stderr, "    -h|--help   :\n");
     fprintf(stderr, "         Show this help\n");
 }
@@ -71,13 +139,13 @@ int dwipe_options_parse( int argc, char** argv )
 	int i;
 
 	/* The list of acceptable short options. */
-	char dwipe_options_short [] = "ahm:p:r:sv:e:";
+	char dwipe_options_short [] = "ahm:p:r:s::v:e:";
 
 	/* The list of acceptable long options. */
 	static struct option dwipe_options_long [] =
 	{
 		/* Set when the user wants to wipe without a confirmation prompt. */
-		{ "autonuke", no_argument, 0, 0 },
+		{ "autonuke", no_argument, 0, 'a' },
 
 		/* A GNU standard option. Corresponds to the 'h' short option. */
 		{ "help", no_argument, 0, 'h' },
@@ -92,13 +160,87 @@ int dwipe_options_parse( int argc, char** argv )
 		{ "rounds", required_argument, 0, 'r' },
 
 		/* A flag to indicate whether the devices whould be opened in sync mode. */
-		{ "sync", no_argument, 0, 0 },
+		{ "sync", optional_argument, 0, 's' },
 
 		/* Verify that wipe patterns are being written to the device. */
-		{ "verify", required_argument, 0, 0 },
+		{ "verify", required_argument, 0, 'v' },
 
-		/* Verify that wipe patterns are being written to the device. */
-		{ "exclude", required_argument, 0, 0 },
+		/* A device that must not be wiped. */
+		{ "exclude", required_argument, 0, 'e' },
+
+		/* The number of devices that may be wiped at once behind one host adapter and bus. */
+		{ "group-limit", required_argument, 0, 0 },
+
+		/* The aggregate throughput, in megabytes per second, above which a group admits no more devices. */
+		{ "group-bandwidth", required_argument, 0, 0 },
+
+		/* The order in which queued devices are started. */
+		{ "order", required_argument, 0, 0 },
+
+		/* The throughput, in megabytes per second, that is assumed for an unmeasured device. */
+		{ "expected-throughput", required_argument, 0, 0 },
+
+		/* The number of devices that are probed at once at startup. */
+		{ "probe-threads", required_argument, 0, 0 },
+
+		/* The number of seconds after which a device probe is abandoned. */
+		{ "probe-timeout", required_argument, 0, 0 },
+
+		/* Keep running and wipe every whole disk that is plugged in. */
+		{ "station", no_argument, 0, 0 },
+
+		/* Run without the terminal interface. */
+		{ "headless", no_argument, 0, 0 },
+
+		/* The path of the Unix-domain control socket. */
+		{ "control", required_argument, 0, 0 },
+
+		/* The path of the JSON event stream. */
+		{ "events", required_argument, 0, 0 },
+
+		/* The TCP port that serves Prometheus metrics. */
+		{ "metrics-port", required_argument, 0, 0 },
+
+		/* The textfile that receives Prometheus metrics. */
+		{ "metrics-file", required_argument, 0, 0 },
+
+		/* What to do with a drive that lags the drives of the same model. */
+		{ "outlier-action", required_argument, 0, 0 },
+
+		/* The bandwidth caps, in megabytes per second, of a device, a group and the station. */
+		{ "rate-device",  required_argument, 0, 0 },
+		{ "rate-group",   required_argument, 0, 0 },
+		{ "rate-station", required_argument, 0, 0 },
+
+		/* The directory of the checkpoints, and whether to continue from them. */
+		{ "journal", required_argument, 0, 0 },
+		{ "resume", no_argument, 0, 0 },
+		{ "checkpoint-interval", required_argument, 0, 0 },
+
+		/* The extents of each device that are wiped. */
+		{ "range", required_argument, 0, 0 },
+
+		/* Whether and how hard to work around bad sectors. */
+		{ "tolerant", no_argument, 0, 0 },
+		{ "retries", required_argument, 0, 0 },
+		{ "max-bad-sectors", required_argument, 0, 0 },
+
+		/* Whether to time the block size of each device, and where to remember it. */
+		{ "autotune", no_argument, 0, 0 },
+		{ "tune-cache", required_argument, 0, 0 },
+
+		/* Whether to lock the i/o buffers in memory. */
+		{ "mlock", no_argument, 0, 0 },
+
+		/* Whether to back the i/o buffers with huge pages. */
+		{ "hugepages", required_argument, 0, 0 },
+
+		/* The megabytes of dirty cache that a pass may build up before it is written back. */
+		{ "writeback-window", required_argument, 0, 0 },
+
+		/* Where the program log goes, and how much of it. */
+		{ "logfile", required_argument, 0, 0 },
+		{ "loglevel", required_argument, 0, 0 },
 
 		/* Requisite padding for getopt(). */
 		{ 0, 0, 0, 0 }
@@ -116,9 +258,40 @@ int dwipe_options_parse( int argc, char** argv )
 	dwipe_options.method   = &dwipe_dodshort;
 	dwipe_options.prng     = &dwipe_twister;
 	dwipe_options.rounds   = 1;
-	dwipe_options.sync     = 0;
+	dwipe_options.sync     = DWIPE_SYNC_PASS;
+	dwipe_options.sync_period = DWIPE_KNOB_SYNC_PERIOD;
 	dwipe_options.verify   = DWIPE_VERIFY_LAST;
     dwipe_options.exclude  = NULL;
+	dwipe_options.group_limit     = 0;
+	dwipe_options.group_bandwidth = 0;
+	dwipe_options.order           = DWIPE_ORDER_LPT;
+	dwipe_options.expected_throughput = DWIPE_KNOB_EXPECTED_THROUGHPUT;
+	dwipe_options.probe_threads   = DWIPE_KNOB_PROBE_THREADS;
+	dwipe_options.probe_timeout   = DWIPE_KNOB_PROBE_TIMEOUT;
+	dwipe_options.station         = 0;
+	dwipe_options.headless        = 0;
+	dwipe_options.control         = NULL;
+	dwipe_options.events          = NULL;
+	dwipe_options.metrics_port    = 0;
+	dwipe_options.metrics_file    = NULL;
+	dwipe_options.outlier_action  = DWIPE_OUTLIER_FLAG;
+	dwipe_options.rate_device     = 0;
+	dwipe_options.rate_group      = 0;
+	dwipe_options.rate_station    = 0;
+	dwipe_options.journal         = NULL;
+	dwipe_options.resume          = 0;
+	dwipe_options.checkpoint_interval = DWIPE_KNOB_JOURNAL_INTERVAL;
+	dwipe_options.range           = NULL;
+	dwipe_options.tolerant        = 0;
+	dwipe_options.retries         = DWIPE_KNOB_BADSECTOR_RETRIES;
+	dwipe_options.max_bad_sectors = DWIPE_KNOB_BADSECTOR_MAX;
+	dwipe_options.autotune        = 0;
+	dwipe_options.tune_cache      = DWIPE_KNOB_TUNE_CACHE;
+	dwipe_options.mlock           = 0;
+	dwipe_options.hugepages       = DWIPE_HUGEPAGES_AUTO;
+	dwipe_options.writeback_window = DWIPE_KNOB_WRITEBACK_WINDOW;
+	dwipe_options.logfile         = DWIPE_KNOB_LOGFILE;
+	dwipe_options.loglevel        = DWIPE_LOG_DEBUG;
 
 
 	/* Parse command line options. */
@@ -132,6 +305,328 @@ int dwipe_options_parse( int argc, char** argv )
 
 		switch( dwipe_opt )
 		{
+			case 0:  /* Long options without a short equivalent. */
+
+				if( strcmp( dwipe_options_long[i].name, "group-limit" ) == 0 )
+				{
+					if( sscanf( optarg, " %i", &dwipe_options.group_limit ) != 1 \
+					    || dwipe_options.group_limit < 0
+					  )
+					{
+						fprintf( stderr, "Error: The group-limit argument must be a non-negative integer.\n" );
+						exit( EINVAL );
+					}
+
+					break;
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "group-bandwidth" ) == 0 )
+				{
+					if( sscanf( optarg, " %llu", &dwipe_options.group_bandwidth ) != 1 )
+					{
+						fprintf( stderr, "Error: The group-bandwidth argument must be a non-negative integer.\n" );
+						exit( EINVAL );
+					}
+
+					/* The argument is given in megabytes per second. */
+					dwipe_options.group_bandwidth *= 1000000;
+					break;
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "order" ) == 0 )
+				{
+					if( strcmp( optarg, "fifo" ) == 0 )
+					{
+						dwipe_options.order = DWIPE_ORDER_FIFO;
+						break;
+					}
+
+					if( strcmp( optarg, "longest" ) == 0 )
+					{
+						dwipe_options.order = DWIPE_ORDER_LONGEST;
+						break;
+					}
+
+					if( strcmp( optarg, "lpt" ) == 0 )
+					{
+						dwipe_options.order = DWIPE_ORDER_LPT;
+						break;
+					}
+
+					fprintf( stderr, "Error: Unknown order '%s'.\n", optarg );
+					exit( EINVAL );
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "expected-throughput" ) == 0 )
+				{
+					if( sscanf( optarg, " %llu", &dwipe_options.expected_throughput ) != 1 \
+					    || dwipe_options.expected_throughput == 0
+					  )
+					{
+						fprintf( stderr, "Error: The expected-throughput argument must be a positive integer.\n" );
+						exit( EINVAL );
+					}
+
+					/* The argument is given in megabytes per second. */
+					dwipe_options.expected_throughput *= 1000000;
+					break;
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "probe-threads" ) == 0 )
+				{
+					if( sscanf( optarg, " %i", &dwipe_options.probe_threads ) != 1 \
+					    || dwipe_options.probe_threads < 1
+					  )
+					{
+						fprintf( stderr, "Error: The probe-threads argument must be a positive integer.\n" );
+						exit( EINVAL );
+					}
+
+					break;
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "probe-timeout" ) == 0 )
+				{
+					if( sscanf( optarg, " %i", &dwipe_options.probe_timeout ) != 1 \
+					    || dwipe_options.probe_timeout < 1
+					  )
+					{
+						fprintf( stderr, "Error: The probe-timeout argument must be a positive integer.\n" );
+						exit( EINVAL );
+					}
+
+					break;
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "station" ) == 0 )
+				{
+					dwipe_options.station = 1;
+					break;
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "headless" ) == 0 )
+				{
+					dwipe_options.headless = 1;
+					break;
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "control" ) == 0 )
+				{
+					dwipe_options.control = optarg;
+					break;
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "events" ) == 0 )
+				{
+					dwipe_options.events = optarg;
+					break;
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "metrics-port" ) == 0 )
+				{
+					if( sscanf( optarg, " %i", &dwipe_options.metrics_port ) != 1 \
+					    || dwipe_options.metrics_port < 1 || dwipe_options.metrics_port > 65535
+					  )
+					{
+						fprintf( stderr, "Error: The metrics-port argument must be a TCP port number.\n" );
+						exit( EINVAL );
+					}
+
+					break;
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "metrics-file" ) == 0 )
+				{
+					dwipe_options.metrics_file = optarg;
+					break;
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "outlier-action" ) == 0 )
+				{
+					if( strcmp( optarg, "flag" ) == 0 )
+					{
+						dwipe_options.outlier_action = DWIPE_OUTLIER_FLAG;
+						break;
+					}
+
+					if( strcmp( optarg, "deprioritize" ) == 0 )
+					{
+						dwipe_options.outlier_action = DWIPE_OUTLIER_DEPRIORITIZE;
+						break;
+					}
+
+					if( strcmp( optarg, "abort" ) == 0 )
+					{
+						dwipe_options.outlier_action = DWIPE_OUTLIER_ABORT;
+						break;
+					}
+
+					fprintf( stderr, "Error: Unknown outlier action '%s'.\n", optarg );
+					exit( EINVAL );
+				}
+
+				if( strncmp( dwipe_options_long[i].name, "rate-", 5 ) == 0 )
+				{
+					/* The cap that this option sets. */
+					u64* rate = &dwipe_options.rate_device;
+
+					if( strcmp( dwipe_options_long[i].name, "rate-group"   ) == 0 ) { rate = &dwipe_options.rate_group;   }
+					if( strcmp( dwipe_options_long[i].name, "rate-station" ) == 0 ) { rate = &dwipe_options.rate_station; }
+
+					if( sscanf( optarg, " %llu", rate ) != 1 )
+					{
+						fprintf( stderr, "Error: The %s argument must be a non-negative integer.\n", dwipe_options_long[i].name );
+						exit( EINVAL );
+					}
+
+					/* The argument is given in megabytes per second. */
+					*rate *= 1000000;
+					break;
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "journal" ) == 0 )
+				{
+					dwipe_options.journal = optarg;
+					break;
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "resume" ) == 0 )
+				{
+					dwipe_options.resume = 1;
+					break;
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "checkpoint-interval" ) == 0 )
+				{
+					if( sscanf( optarg, " %i", &dwipe_options.checkpoint_interval ) != 1 \
+					    || dwipe_options.checkpoint_interval < 1
+					  )
+					{
+						fprintf( stderr, "Error: The checkpoint-interval argument must be a positive integer.\n" );
+						exit( EINVAL );
+					}
+
+					break;
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "range" ) == 0 )
+				{
+					if( dwipe_range_parse( optarg, 0, 0, NULL ) < 0 )
+					{
+						fprintf( stderr, "Error: The range argument must be a list of at most %i offset[:length] extents.\n", DWIPE_KNOB_RANGE_MAX );
+						exit( EINVAL );
+					}
+
+					dwipe_options.range = optarg;
+					break;
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "tolerant" ) == 0 )
+				{
+					dwipe_options.tolerant = 1;
+					break;
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "retries" ) == 0 )
+				{
+					if( sscanf( optarg, " %i", &dwipe_options.retries ) != 1 || dwipe_options.retries < 0 )
+					{
+						fprintf( stderr, "Error: The retries argument must be a non-negative integer.\n" );
+						exit( EINVAL );
+					}
+
+					break;
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "max-bad-sectors" ) == 0 )
+				{
+					if( sscanf( optarg, " %llu", &dwipe_options.max_bad_sectors ) != 1 \
+					    || dwipe_options.max_bad_sectors == 0
+					  )
+					{
+						fprintf( stderr, "Error: The max-bad-sectors argument must be a positive integer.\n" );
+						exit( EINVAL );
+					}
+
+					break;
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "autotune" ) == 0 )
+				{
+					dwipe_options.autotune = 1;
+					break;
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "tune-cache" ) == 0 )
+				{
+					dwipe_options.tune_cache = optarg;
+					break;
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "mlock" ) == 0 )
+				{
+					dwipe_options.mlock = 1;
+					break;
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "hugepages" ) == 0 )
+				{
+					if( strcmp( optarg, "off" ) == 0 )
+					{
+						dwipe_options.hugepages = DWIPE_HUGEPAGES_OFF;
+						break;
+					}
+
+					if( strcmp( optarg, "auto" ) == 0 )
+					{
+						dwipe_options.hugepages = DWIPE_HUGEPAGES_AUTO;
+						break;
+					}
+
+					if( strcmp( optarg, "reserve" ) == 0 )
+					{
+						dwipe_options.hugepages = DWIPE_HUGEPAGES_RESERVE;
+						break;
+					}
+
+					fprintf( stderr, "Error: Unknown huge page mode '%s'.\n", optarg );
+					exit( EINVAL );
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "writeback-window" ) == 0 )
+				{
+					if( sscanf( optarg, " %i", &dwipe_options.writeback_window ) != 1 || dwipe_options.writeback_window < 0 )
+					{
+						fprintf( stderr, "Error: The writeback-window argument must be a non-negative integer.\n" );
+						exit( EINVAL );
+					}
+
+					break;
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "logfile" ) == 0 )
+				{
+					dwipe_options.logfile = optarg;
+					break;
+				}
+
+				if( strcmp( dwipe_options_long[i].name, "loglevel" ) == 0 )
+				{
+					dwipe_options.loglevel = dwipe_log_parse( optarg );
+
+					if( dwipe_options.loglevel < 0 )
+					{
+						fprintf( stderr, "Error: Unknown log level '%s'.\n", optarg );
+						exit( EINVAL );
+					}
+
+					break;
+				}
+
+				/* Else getopt_long() returned an option that we forgot to handle. */
+				fprintf( stderr, "Error: Unhandled option '--%s'.\n", dwipe_options_long[i].name );
+				exit( EINVAL );
+
             case 'a':
                 dwipe_options.autonuke = 1;
                 break;
@@ -220,7 +715,19 @@ int dwipe_options_parse( int argc, char** argv )
 				break;
 
             case 's':
-                dwipe_options.sync = 1;
+                /* A bare flag asks for synchronous writes, as it always has. */
+                if( optarg == NULL )
+                {
+                    dwipe_options.sync = DWIPE_SYNC_DSYNC;
+                    break;
+                }
+
+                if( dwipe_durability_parse( optarg, &dwipe_options.sync, &dwipe_options.sync_period ) != 0 )
+                {
+                    fprintf( stderr, "Error: Unknown sync policy '%s'.\n", optarg );
+                    exit( EINVAL );
+                }
+
                 break;
 
             case 'v':
@@ -260,6 +767,20 @@ int dwipe_options_parse( int argc, char** argv )
 
 	} /* command line options */
 
+	if( dwipe_options.headless && ! dwipe_options.autonuke && dwipe_options.control == NULL )
+	{
+		/* Nobody could ever select a device. */
+		fprintf( stderr, "Error: The headless option needs either the autonuke or the control option.\n" );
+		exit( EINVAL );
+	}
+
+	if( dwipe_options.resume && dwipe_options.journal == NULL )
+	{
+		/* There is nothing to resume from. */
+		fprintf( stderr, "Error: The resume option needs the journal option.\n" );
+		exit( EINVAL );
+	}
+
 	/* Return the number of options that were processed. */
 	return optind;
 
@@ -289,8 +810,39 @@ void dwipe_options_log( void )
 	dwipe_log( DWIPE_LOG_NOTICE, "  banner   = %s", dwipe_options.banner );
 	dwipe_log( DWIPE_LOG_NOTICE, "  method   = %s", dwipe_method_label( dwipe_options.method ) );
 	dwipe_log( DWIPE_LOG_NOTICE, "  rounds   = %i", dwipe_options.rounds );
-	dwipe_log( DWIPE_LOG_NOTICE, "  sync     = %i", dwipe_options.sync );
+	dwipe_log( DWIPE_LOG_NOTICE, "  sync     = %s", dwipe_durability_name( dwipe_options.sync ) );
+	dwipe_log( DWIPE_LOG_NOTICE, "  sync-period     = %i MiB", dwipe_options.sync_period );
 	dwipe_log( DWIPE_LOG_NOTICE, "  exclude  = %s", dwipe_options.exclude == NULL ? "none" :  dwipe_options.exclude);
+	dwipe_log( DWIPE_LOG_NOTICE, "  group-limit     = %i", dwipe_options.group_limit );
+	dwipe_log( DWIPE_LOG_NOTICE, "  group-bandwidth = %llu B/s", dwipe_options.group_bandwidth );
+	dwipe_log( DWIPE_LOG_NOTICE, "  order    = %i", dwipe_options.order );
+	dwipe_log( DWIPE_LOG_NOTICE, "  expected-throughput = %llu B/s", dwipe_options.expected_throughput );
+	dwipe_log( DWIPE_LOG_NOTICE, "  probe-threads   = %i", dwipe_options.probe_threads );
+	dwipe_log( DWIPE_LOG_NOTICE, "  probe-timeout   = %i s", dwipe_options.probe_timeout );
+	dwipe_log( DWIPE_LOG_NOTICE, "  station  = %i", dwipe_options.station );
+	dwipe_log( DWIPE_LOG_NOTICE, "  headless = %i", dwipe_options.headless );
+	dwipe_log( DWIPE_LOG_NOTICE, "  control  = %s", dwipe_options.control == NULL ? "none" : dwipe_options.control );
+	dwipe_log( DWIPE_LOG_NOTICE, "  events   = %s", dwipe_options.events == NULL ? "none" : dwipe_options.events );
+	dwipe_log( DWIPE_LOG_NOTICE, "  metrics-port    = %i", dwipe_options.metrics_port );
+	dwipe_log( DWIPE_LOG_NOTICE, "  metrics-file    = %s", dwipe_options.metrics_file == NULL ? "none" : dwipe_options.metrics_file );
+	dwipe_log( DWIPE_LOG_NOTICE, "  outlier-action  = %i", dwipe_options.outlier_action );
+	dwipe_log( DWIPE_LOG_NOTICE, "  rate-device     = %llu B/s", dwipe_options.rate_device );
+	dwipe_log( DWIPE_LOG_NOTICE, "  rate-group      = %llu B/s", dwipe_options.rate_group );
+	dwipe_log( DWIPE_LOG_NOTICE, "  rate-station    = %llu B/s", dwipe_options.rate_station );
+	dwipe_log( DWIPE_LOG_NOTICE, "  journal  = %s", dwipe_options.journal == NULL ? "none" : dwipe_options.journal );
+	dwipe_log( DWIPE_LOG_NOTICE, "  resume   = %i", dwipe_options.resume );
+	dwipe_log( DWIPE_LOG_NOTICE, "  checkpoint-interval = %i s", dwipe_options.checkpoint_interval );
+	dwipe_log( DWIPE_LOG_NOTICE, "  range    = %s", dwipe_options.range == NULL ? "all" : dwipe_options.range );
+	dwipe_log( DWIPE_LOG_NOTICE, "  tolerant = %i", dwipe_options.tolerant );
+	dwipe_log( DWIPE_LOG_NOTICE, "  retries  = %i", dwipe_options.retries );
+	dwipe_log( DWIPE_LOG_NOTICE, "  max-bad-sectors = %llu", dwipe_options.max_bad_sectors );
+	dwipe_log( DWIPE_LOG_NOTICE, "  autotune = %i", dwipe_options.autotune );
+	dwipe_log( DWIPE_LOG_NOTICE, "  tune-cache      = %s", dwipe_options.tune_cache );
+	dwipe_log( DWIPE_LOG_NOTICE, "  mlock    = %i", dwipe_options.mlock );
+	dwipe_log( DWIPE_LOG_NOTICE, "  hugepages       = %i", dwipe_options.hugepages );
+	dwipe_log( DWIPE_LOG_NOTICE, "  writeback-window = %i MiB", dwipe_options.writeback_window );
+	dwipe_log( DWIPE_LOG_NOTICE, "  logfile  = %s", dwipe_options.logfile );
+	dwipe_log( DWIPE_LOG_NOTICE, "  loglevel = %i", dwipe_options.loglevel );
 
 	switch( dwipe_options.verify )
 	{
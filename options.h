@@ -24,25 +24,57 @@
 
 /* Program knobs. */
 #define DWIPE_KNOB_ENTROPY                "/dev/urandom"
+#define DWIPE_KNOB_EXPECTED_THROUGHPUT    100000000           /* Bytes per second before any wipe is measured. */
 #define DWIPE_KNOB_IDENTITY_SIZE          512
 #define DWIPE_KNOB_LABEL_SIZE             512
 #define DWIPE_KNOB_LOADAVG                "/proc/loadavg"
 #define DWIPE_KNOB_LOG_BUFFERSIZE         1024                /* Maximum length of a log event. */
+#define DWIPE_KNOB_LOGFILE                "/var/log/dban/dwipe.txt"  /* The default --logfile. */
 #define DWIPE_KNOB_PARTITIONS             "/proc/partitions"
 #define DWIPE_KNOB_PARTITIONS_PREFIX      "/dev/"
 #define DWIPE_KNOB_PRNG_STATE_LENGTH      512                 /* 128 words */
+#define DWIPE_KNOB_PROBE_THREADS          16                  /* Devices probed at once at startup.  */
+#define DWIPE_KNOB_PROBE_TIMEOUT          30                  /* Seconds before a probe is abandoned. */
 #define DWIPE_KNOB_SCSI                   "/proc/scsi/scsi"
 #define DWIPE_KNOB_SLEEP                  1
+#define DWIPE_KNOB_STATION_SLOTS          64                  /* Drives that a station can add while running. */
 #define DWIPE_KNOB_STAT                   "/proc/stat"
 #define DBAN_VERSION                      "2.2.1"
 
-/* FIXME: This should be a command line option. */
-#define DWIPE_KNOB_LOGFILE "/var/log/dban/dwipe.txt"
-
 /* Function prototypes for loading options from the environment and command line. */
 int dwipe_options_parse( int argc, char** argv );
 void dwipe_options_log( void );
 
+typedef enum dwipe_order_t_
+{
+	DWIPE_ORDER_FIFO = 0,  /* Start devices in enumeration order.                        */
+	DWIPE_ORDER_LONGEST,   /* Start the devices with the most bytes to move first.        */
+	DWIPE_ORDER_LPT        /* Start the devices with the longest expected runtime first.  */
+} dwipe_order_t;
+
+typedef enum dwipe_outlier_action_t_
+{
+	DWIPE_OUTLIER_FLAG = 0,      /* Report a drive that lags its peers.                        */
+	DWIPE_OUTLIER_DEPRIORITIZE,  /* Also move it to the idle i/o class and free its group slot. */
+	DWIPE_OUTLIER_ABORT          /* Stop wiping it.                                            */
+} dwipe_outlier_action_t;
+
+typedef enum dwipe_sync_t_
+{
+	DWIPE_SYNC_NONE = 0,         /* Leave the writes to the kernel.                            */
+	DWIPE_SYNC_PASS,             /* Flush the device at the end of each pass.                  */
+	DWIPE_SYNC_PERIODIC,         /* Also flush it every sync_period megabytes.                 */
+	DWIPE_SYNC_DSYNC,            /* Open the device with O_DSYNC.                              */
+	DWIPE_SYNC_FUA               /* Write each block with direct i/o and RWF_DSYNC.            */
+} dwipe_sync_t;
+
+typedef enum dwipe_hugepages_t_
+{
+	DWIPE_HUGEPAGES_OFF = 0,     /* Back the i/o buffers with ordinary pages.                  */
+	DWIPE_HUGEPAGES_AUTO,        /* Use huge pages when the kernel has them to give.           */
+	DWIPE_HUGEPAGES_RESERVE      /* Also grow the huge page pool for every device at startup.  */
+} dwipe_hugepages_t;
+
 typedef struct /* dwipe_options_t */
 {
 	int            autonuke;  /* Do not prompt the user for confirmation when set.          */
@@ -50,9 +82,40 @@ typedef struct /* dwipe_options_t */
 	dwipe_method_t method;    /* A function pointer to the wipe method that will be used.   */
 	dwipe_prng_t*  prng;      /* The pseudo random number generator implementation.         */
 	int            rounds;    /* The number of times that the wipe method should be called. */
-	int            sync;      /* A flag to indicate whether writes should be sync'd.        */
+	dwipe_sync_t   sync;      /* How the writes are made durable.                           */
+	int            sync_period; /* The megabytes between flushes of the periodic policy.    */
 	dwipe_verify_t verify;    /* A flag to indicate whether writes should be verified.      */
     char*          exclude;
+	int            group_limit;      /* The maximum number of active wipes per host and bus.    */
+	u64            group_bandwidth;  /* The aggregate bytes per second admitted per host and bus. */
+	dwipe_order_t  order;            /* The order in which queued devices are started.          */
+	u64            expected_throughput; /* The assumed bytes per second of an unmeasured device. */
+	int            probe_threads;    /* The number of devices that are probed at once.          */
+	int            probe_timeout;    /* The seconds after which a device probe is abandoned.    */
+	int            station;          /* Keep running and wipe drives as they are plugged in.    */
+	int            headless;         /* Run without the terminal interface.                     */
+	char*          control;          /* The path of the control socket, or NULL for none.       */
+	char*          events;           /* The path of the JSON event stream, or NULL for none.    */
+	int            metrics_port;     /* The TCP port that serves Prometheus metrics, or zero.   */
+	char*          metrics_file;     /* The textfile that receives Prometheus metrics, or NULL. */
+	dwipe_outlier_action_t outlier_action; /* What to do with a drive that lags its peers.    */
+	u64            rate_device;      /* The bytes per second that each device may move, or zero. */
+	u64            rate_group;       /* The bytes per second that each group may move, or zero.  */
+	u64            rate_station;     /* The bytes per second that the station may move, or zero. */
+	char*          journal;          /* The directory of the wipe checkpoints, or NULL for none. */
+	int            resume;           /* Continue the wipes that have a checkpoint when set.      */
+	int            checkpoint_interval; /* The least seconds between two checkpoints of a device. */
+	char*          range;            /* The extents that every pass covers, or NULL for all.     */
+	int            tolerant;         /* Skip bad sectors instead of failing the pass when set.   */
+	int            retries;          /* The number of times that a failed sector is tried again. */
+	u64            max_bad_sectors;  /* The number of bad sectors after which a pass fails.      */
+	int            autotune;         /* Time the block size of each device when set.             */
+	char*          tune_cache;       /* The file that keeps the tuned block size of each model.  */
+	int            mlock;            /* Lock the i/o buffers of each child in memory when set.   */
+	dwipe_hugepages_t hugepages;     /* Whether the i/o buffers are backed by huge pages.        */
+	int            writeback_window; /* The megabytes of a pass that are written back at a time. */
+	char*          logfile;          /* The file that the program log is appended to.            */
+	int            loglevel;         /* The dwipe_log_t below which messages are not logged.     */
 } dwipe_options_t;
 
 extern dwipe_options_t dwipe_options;
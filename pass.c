@@ -25,6 +25,88 @@
 #include "options.h"
 #include "pass.h"
 #include "logging.h"
+#include "progress.h"
+#include "throttle.h"
+#include "events.h"
+#include "journal.h"
+#include "range.h"
+#include "badsector.h"
+#include "geometry.h"
+#include "arena.h"
+#include "writeback.h"
+#include "durability.h"
+
+
+static ssize_t dwipe_pass_pread( dwipe_context_t* c, char* buffer, const char* expected, size_t count, u64 offset )
+{
+/**
+ * Reads a whole block, and reads the rest of it again after a short read.
+ *
+ * @return  The bytes read, which are fewer than count only when the device
+ *          stopped returning any, or -1 on an error.
+ *
+ */
+
+	/* The bytes read so far, and the result of the last read. */
+	size_t done = 0;
+	ssize_t r;
+
+	while( done < count )
+	{
+		r = dwipe_badsector_pread( c, buffer + done, expected + done, count - done, offset + done );
+
+		if( r < 0  ) { return -1; }
+		if( r == 0 ) { break; }
+
+		done += r;
+	}
+
+	return done;
+
+} /* dwipe_pass_pread */
+
+
+static ssize_t dwipe_pass_pwrite( dwipe_context_t* c, const char* buffer, size_t count, u64 offset )
+{
+/**
+ * Writes a whole block, and writes the rest of it again after a short write.
+ *
+ * @return  The bytes written, which are fewer than count only when the
+ *          device stopped taking any, or -1 on an error.
+ *
+ */
+
+	/* The bytes written so far, and the result of the last write. */
+	size_t done = 0;
+	ssize_t r;
+
+	while( done < count )
+	{
+		r = dwipe_badsector_pwrite( c, buffer + done, count - done, offset + done );
+
+		if( r < 0  ) { return -1; }
+		if( r == 0 ) { break; }
+
+		done += r;
+	}
+
+	return done;
+
+} /* dwipe_pass_pwrite */
+
+
+static void dwipe_pass_skipped( dwipe_context_t* c, u64 bytes )
+{
+/**
+ * Counts the bytes of a block that the device would not move, so that the
+ * pass still adds up to its size.  The caller has counted them as errors.
+ *
+ */
+
+	dwipe_progress_count( c, &c->progress->round_done, bytes );
+	dwipe_progress_count( c, &c->progress->pass_done,  bytes );
+
+} /* dwipe_pass_skipped */
 
 
 int dwipe_random_verify( dwipe_context_t* c )
@@ -37,11 +119,14 @@ int dwipe_random_verify( dwipe_context_t* c )
 	/* The result holder. */
 	int r;
 
+	/* The clock when an operation started, and then its duration. */
+	u64 t;
+
 	/* The IO size. */
 	size_t blocksize;
 
-	/* The result buffer for calls to lseek. */
-	loff_t offset;
+	/* The offset of the working block on the device. */
+	u64 offset;
 
 	/* The input buffer. */
 	char* b;
@@ -49,8 +134,11 @@ int dwipe_random_verify( dwipe_context_t* c )
 	/* The pattern buffer that is used to check the input buffer. */
 	char* d;
 
+	/* The offset where the pass starts, which is past zero when it is resumed. */
+	u64 start;
+
 	/* The number of bytes remaining in the pass. */
-	u64 z = c->device_size;
+	u64 z;
 
 
 	if( c->prng_seed.s == NULL )
@@ -65,85 +153,93 @@ int dwipe_random_verify( dwipe_context_t* c )
 		return -1;
 	}
 
-	/* Create the input buffer. */
-	b = malloc( c->device_stat.st_blksize * 1024 );
+	/* A verification that finished before the checkpoint is skipped. */
+	start = dwipe_journal_start( c, 1 );
+	if( start == c->wipe_size ) { return 0; }
+	z = c->wipe_size - start;
+
+	/* Borrow the input buffer. */
+	b = dwipe_arena_get( c, DWIPE_ARENA_INPUT, c->io_size );
 
 	/* Check the memory allocation. */
 	if( ! b )
 	{
-		dwipe_perror( errno, __FUNCTION__, "malloc" );
+		dwipe_perror( errno, __FUNCTION__, "dwipe_arena_get" );
 		dwipe_log( DWIPE_LOG_FATAL, "Unable to allocate memory for the input buffer." );
 		return -1;
 	}
 
-	/* Create the pattern buffer */
-	d = malloc( c->device_stat.st_blksize * 1024  );
+	/* Borrow the pattern buffer. */
+	d = dwipe_arena_get( c, DWIPE_ARENA_OUTPUT, c->io_size );
 
 	/* Check the memory allocation. */
 	if( ! d )
 	{
-		dwipe_perror( errno, __FUNCTION__, "malloc" );
+		dwipe_perror( errno, __FUNCTION__, "dwipe_arena_get" );
 		dwipe_log( DWIPE_LOG_FATAL, "Unable to allocate memory for the pattern buffer." );
 		return -1;
 	}
 
-	/* Reset the file pointer. */
-	offset = lseek( c->device_fd, 0, SEEK_SET );
-
-	if( offset == (loff_t)-1 )
-	{
-		dwipe_perror( errno, __FUNCTION__, "lseek" );
-		dwipe_log( DWIPE_LOG_FATAL, "Unable to reset the '%s' file offset.", c->device_name );
-		return -1;
-	}
-
-	if( offset != 0 )
-	{
-		/* This is system insanity. */
-		dwipe_log( DWIPE_LOG_SANITY, "lseek() returned a bogus offset on '%s'.", c->device_name );
-		return -1;
-	}
-
 	/* Tell our parent that we are syncing the device. */
-	c->sync_status = 1;
+	dwipe_progress_set( c, &c->progress->sync_status, 1 );
 
 	/* Sync the device. */
-	r = fdatasync( c->device_fd );
+	t = dwipe_progress_clock();
+	r = dwipe_durability_sync( c );
+	dwipe_progress_count( c, &c->progress->sync_ns, dwipe_progress_clock() - t );
 
 	/* Tell our parent that we have finished syncing the device. */
-	c->sync_status = 0;
+	dwipe_progress_set( c, &c->progress->sync_status, 0 );
 
 	if( r != 0 )
 	{
-		/* FIXME: Is there a better way to handle this? */
+		/* The last pass is not known to be on the media, so reading it back proves nothing. */
 		dwipe_perror( errno, __FUNCTION__, "fdatasync" );
-		dwipe_log( DWIPE_LOG_WARNING, "Buffer flush failure on '%s'.", c->device_name );
+		dwipe_log( DWIPE_LOG_FATAL, "Buffer flush failure on '%s'.", c->device_name );
+		return -1;
 	}
 
-	/* Reseed the PRNG. */
-	c->prng->init( &c->prng_state, &c->prng_seed );
+	/* Reseed the PRNG.  A journaled pass is seeded by segments as it goes. */
+	if( c->journal == NULL ) { c->prng->init( &c->prng_state, &c->prng_seed ); }
 
 	while( z > 0 )
 	{
-		if( c->device_stat.st_blksize * 1024 < z )
+		if( c->io_size < z )
 		{
-			blocksize = c->device_stat.st_blksize * 1024;
+			blocksize = c->io_size;
 		}
 		else
 		{
 			/* This is a seatbelt for buggy drivers and programming errors because */
-			/* the device size should always be an even multiple of its blocksize. */
+			/* the device size should always be an even multiple of its sector size. */
 			blocksize = z;
-			dwipe_log( DWIPE_LOG_WARNING,
-			  "%s: The size of '%s' is not a multiple of its block size %i.",
-			  __FUNCTION__, c->device_name, c->device_stat.st_blksize );
+
+			if( c->sector_size > 0 && z % c->sector_size != 0 )
+			{
+				dwipe_log( DWIPE_LOG_WARNING,
+				  "%s: The size of '%s' is not a multiple of its sector size %i.",
+				  __FUNCTION__, c->device_name, c->sector_size );
+			}
 		}
 
+		/* Keep the block inside one segment of a journaled pass. */
+		blocksize = dwipe_journal_block( c, c->wipe_size - z, blocksize );
+
+		/* Place the block on the device, inside one of the ranges that are wiped. */
+		offset = dwipe_range_map( c, c->wipe_size - z, &blocksize );
+
+		/* End the block on a boundary of the device geometry. */
+		blocksize = dwipe_geometry_block( c, offset, blocksize );
+
 		/* Fill the output buffer with the random pattern. */
+		t = dwipe_progress_clock();
 		c->prng->read( &c->prng_state, d, blocksize );
+		dwipe_progress_count( c, &c->progress->prng_ns, dwipe_progress_clock() - t );
 
 		/* Read the buffer in from the device. */
-		r = read( c->device_fd, b, blocksize );
+		t = dwipe_progress_clock();
+		r = dwipe_pass_pread( c, b, d, blocksize, offset );
+		t = dwipe_progress_clock() - t;
 
 		/* Check the result. */
 		if( r < 0 )
@@ -156,43 +252,41 @@ int dwipe_random_verify( dwipe_context_t* c )
 		/* Check for a partial read. */
 		if( r != blocksize )
 		{
-			/* TODO: Handle a partial read. */
-
-			/* The number of bytes that were not read. */
+			/* The number of bytes that the device would not return. */
 			int s = blocksize - r;
 
-			dwipe_log( DWIPE_LOG_WARNING, "%s: Partial read from '%s', %i bytes short.", __FUNCTION__, c->device_name, s );
+			dwipe_log( DWIPE_LOG_ERROR, "%s: %i bytes of '%s' at offset %llu were not verified.", __FUNCTION__, s, c->device_name, offset + r );
 			
 			/* Increment the error count. */
-			c->verify_errors += 1;
-
-			/* Bump the file pointer to the next block. */
-			offset = lseek( c->device_fd, s, SEEK_CUR );
-
-			if( offset == (loff_t)-1 )
-			{
-				dwipe_perror( errno, __FUNCTION__, "lseek" );
-				dwipe_log( DWIPE_LOG_ERROR, "Unable to bump the '%s' file offset after a partial read.", c->device_name );
-				return -1;
-			}
+			dwipe_progress_count( c, &c->progress->verify_errors, 1 );
+			dwipe_event( c, DWIPE_EVENT_VERIFY_ERROR, 1 );
+			dwipe_pass_skipped( c, s );
 
 		} /* partial read */
 
 		/* Compare buffer contents. */
-		if( memcmp( b, d, blocksize ) != 0 ) { c->verify_errors += 1; }
+		if( memcmp( b, d, blocksize ) != 0 ) { dwipe_progress_count( c, &c->progress->verify_errors, 1 ); dwipe_event( c, DWIPE_EVENT_VERIFY_ERROR, 1 ); }
 
-		/* Decrement the bytes remaining in this pass. */
-		z -= r;
+		/* Decrement the bytes remaining in this pass.  A short block was retried, */
+		/* and the bytes that the device still would not move were counted above. */
+		z -= blocksize;
 
 		/* Increment the total progress counters. */
-		c->round_done += r;
-		c->pass_done += r;
+		dwipe_progress_add( c, DWIPE_IO_READ, r, t );
+
+		/* The block will not be read again, so keep it out of the cache. */
+		dwipe_writeback_read( c, offset, blocksize );
+
+		/* Stay under the rate limit of this device. */
+		dwipe_throttle( c, r );
+
+		/* Record how far the pass has come when a checkpoint is due. */
+		dwipe_journal_checkpoint( c, c->wipe_size - z, 0 );
 
 	} /* while bytes remaining */
 
-	/* Release the buffers. */
-	free( b );
-	free( d );
+	/* The verification is done. */
+	dwipe_journal_checkpoint( c, c->wipe_size, 1 );
 
 	/* We're done. */
 	return 0;
@@ -211,17 +305,23 @@ int dwipe_random_pass( DWIPE_METHOD_SIGNATURE )
 	/* The result holder. */
 	int r;
 
+	/* The clock when an operation started, and then its duration. */
+	u64 t;
+
 	/* The IO size. */
 	size_t blocksize;
 
-	/* The result buffer for calls to lseek. */
-	loff_t offset;
+	/* The offset of the working block on the device. */
+	u64 offset;
 
 	/* The output buffer. */
 	char* b;
 
+	/* The offset where the pass starts, which is past zero when it is resumed. */
+	u64 start;
+
 	/* The number of bytes remaining in the pass. */
-	u64 z = c->device_size;
+	u64 z;
 
 
 	if( c->prng_seed.s == NULL )
@@ -237,59 +337,66 @@ int dwipe_random_pass( DWIPE_METHOD_SIGNATURE )
 	}
 
 
-	/* Create the output buffer. */
-	b = malloc( c->device_stat.st_blksize * 1024 );
+	/* A pass that finished before the checkpoint is skipped. */
+	start = dwipe_journal_start( c, 0 );
+	if( start == c->wipe_size ) { return 0; }
+	z = c->wipe_size - start;
+
+	/* Borrow the output buffer. */
+	b = dwipe_arena_get( c, DWIPE_ARENA_OUTPUT, c->io_size );
 
 	/* Check the memory allocation. */
 	if( ! b )
 	{
-		dwipe_perror( errno, __FUNCTION__, "malloc" );
+		dwipe_perror( errno, __FUNCTION__, "dwipe_arena_get" );
 		dwipe_log( DWIPE_LOG_FATAL, "Unable to allocate memory for the output buffer." );
 		return -1;
 	}
 
-	/* Seed the PRNG. */
-	c->prng->init( &c->prng_state, &c->prng_seed );
-
-	/* Reset the file pointer. */
-	offset = lseek( c->device_fd, 0, SEEK_SET );
-
-	if( offset == (loff_t)-1 )
-	{
-		dwipe_perror( errno, __FUNCTION__, "lseek" );
-		dwipe_log( DWIPE_LOG_FATAL, "Unable to reset the '%s' file offset.", c->device_name );
-		return -1;
-	}
-
-	if( offset != 0 )
-	{
-		/* This is system insanity. */
-		dwipe_log( DWIPE_LOG_SANITY, "__FUNCTION__: lseek() returned a bogus offset on '%s'.", c->device_name );
-		return -1;
-	}
+	/* Seed the PRNG.  A journaled pass is seeded by segments as it goes. */
+	if( c->journal == NULL ) { c->prng->init( &c->prng_state, &c->prng_seed ); }
 
+	/* Start the rolling writeback of this pass. */
+	dwipe_writeback_start( c );
 
 	while( z > 0 )
 	{
-		if( c->device_stat.st_blksize * 1024 < z )
+		if( c->io_size < z )
 		{
-			blocksize = c->device_stat.st_blksize * 1024;
+			blocksize = c->io_size;
 		}
 		else
 		{
 			/* This is a seatbelt for buggy drivers and programming errors because */
-			/* the device size should always be an even multiple of its blocksize. */
+			/* the device size should always be an even multiple of its sector size. */
 			blocksize = z;
-			dwipe_log( DWIPE_LOG_WARNING,
-			  "%s: The size of '%s' is not a multiple of its block size %i.",
-			  __FUNCTION__, c->device_name, c->device_stat.st_blksize );
+
+			if( c->sector_size > 0 && z % c->sector_size != 0 )
+			{
+				dwipe_log( DWIPE_LOG_WARNING,
+				  "%s: The size of '%s' is not a multiple of its sector size %i.",
+				  __FUNCTION__, c->device_name, c->sector_size );
+			}
 		}
 
+		/* Keep the block inside one segment of a journaled pass. */
+		blocksize = dwipe_journal_block( c, c->wipe_size - z, blocksize );
+
+		/* Place the block on the device, inside one of the ranges that are wiped. */
+		offset = dwipe_range_map( c, c->wipe_size - z, &blocksize );
+
+		/* End the block on a boundary of the device geometry. */
+		blocksize = dwipe_geometry_block( c, offset, blocksize );
+
 		/* Fill the output buffer with the random pattern. */
+		t = dwipe_progress_clock();
 		c->prng->read( &c->prng_state, b, blocksize );
+		dwipe_progress_count( c, &c->progress->prng_ns, dwipe_progress_clock() - t );
 
 		/* Write the next block out to the device. */
-		r = write( c->device_fd, b, blocksize );
+		t = dwipe_progress_clock();
+		r = dwipe_pass_pwrite( c, b, blocksize, offset );
+		t = dwipe_progress_clock() - t;
 
 		/* Check the result for a fatal error. */
 		if( r < 0 )
@@ -302,56 +409,66 @@ int dwipe_random_pass( DWIPE_METHOD_SIGNATURE )
 		/* Check for a partial write. */
 		if( r != blocksize )
 		{
-			/* TODO: Handle a partial write. */
-
-			/* The number of bytes that were not written. */
+			/* The number of bytes that the device would not take. */
 			int s = blocksize - r;
 			
 			/* Increment the error count by the number of bytes that were not written. */
-			c->pass_errors += s;
+			dwipe_progress_count( c, &c->progress->pass_errors, s );
+			dwipe_event( c, DWIPE_EVENT_WRITE_ERROR, s );
+			dwipe_pass_skipped( c, s );
 
-			dwipe_log( DWIPE_LOG_WARNING, "Partial write on '%s', %i bytes short.", c->device_name, s );
-
-			/* Bump the file pointer to the next block. */
-			offset = lseek( c->device_fd, s, SEEK_CUR );
-
-			if( offset == (loff_t)-1 )
-			{
-				dwipe_perror( errno, __FUNCTION__, "lseek" );
-				dwipe_log( DWIPE_LOG_ERROR, "Unable to bump the '%s' file offset after a partial write.", c->device_name );
-				return -1;
-			}
+			dwipe_log( DWIPE_LOG_ERROR, "%i bytes of '%s' at offset %llu were not wiped.", s, c->device_name, offset + r );
 
 		} /* partial write */
 
-		/* Decrement the bytes remaining in this pass. */
-		z -= r;
+		/* Decrement the bytes remaining in this pass.  A short block was retried, */
+		/* and the bytes that the device still would not move were counted above. */
+		z -= blocksize;
+
+		/* Write the older blocks back to the media as the pass goes. */
+		dwipe_writeback_write( c, offset, r );
 
 		/* Increment the total progress counters. */
-		c->round_done += r;
-		c->pass_done += r;
+		dwipe_progress_add( c, DWIPE_IO_WRITE, r, t );
+
+		/* Stay under the rate limit of this device. */
+		dwipe_throttle( c, r );
+
+		/* Record how far the pass has come when a checkpoint is due. */
+		dwipe_journal_checkpoint( c, c->wipe_size - z, 0 );
 
 	} /* remaining bytes */
 
-	/* Release the output buffer. */
-	free( b );
+	/* Wait for the last windows, which leaves little for the sync. */
+	if( dwipe_writeback_finish( c ) != 0 )
+	{
+		/* A window that failed to reach the media fails the pass. */
+		dwipe_log( DWIPE_LOG_FATAL, "Buffer flush failure on '%s'.", c->device_name );
+		return -1;
+	}
 
 	/* Tell our parent that we are syncing the device. */
-	c->sync_status = 1;
+	dwipe_progress_set( c, &c->progress->sync_status, 1 );
 
 	/* Sync the device. */
-	r = fdatasync( c->device_fd );
+	t = dwipe_progress_clock();
+	r = dwipe_durability_sync( c );
+	dwipe_progress_count( c, &c->progress->sync_ns, dwipe_progress_clock() - t );
 
 	/* Tell our parent that we have finished syncing the device. */
-	c->sync_status = 0;
+	dwipe_progress_set( c, &c->progress->sync_status, 0 );
 
 	if( r != 0 )
 	{
-		/* FIXME: Is there a better way to handle this? */
+		/* The pass is not known to be on the media, so it failed. */
 		dwipe_perror( errno, __FUNCTION__, "fdatasync" );
-		dwipe_log( DWIPE_LOG_WARNING, "Buffer flush failure on '%s'.", c->device_name );
+		dwipe_log( DWIPE_LOG_FATAL, "Buffer flush failure on '%s'.", c->device_name );
+		return -1;
 	}
 
+	/* The whole pass is on the media. */
+	dwipe_journal_checkpoint( c, c->wipe_size, 1 );
+
 	/* We're done. */
 	return 0;	
 
@@ -369,11 +486,14 @@ int dwipe_static_verify( DWIPE_METHOD_SIGNATURE, dwipe_pattern_t* pattern )
 	/* The result holder. */
 	int r;
 
+	/* The clock when an operation started, and then its duration. */
+	u64 t;
+
 	/* The IO size. */
 	size_t blocksize;
 
-	/* The result buffer for calls to lseek. */
-	loff_t offset;
+	/* The offset of the working block on the device. */
+	u64 offset;
 
 	/* The input buffer. */
 	char* b;
@@ -385,10 +505,13 @@ int dwipe_static_verify( DWIPE_METHOD_SIGNATURE, dwipe_pattern_t* pattern )
 	char* q;
 
 	/* The pattern buffer window offset. */
-	int w = 0;
+	int w;
+
+	/* The offset where the pass starts, which is past zero when it is resumed. */
+	u64 start;
 
 	/* The number of bytes remaining in the pass. */
-	u64 z = c->device_size;
+	u64 z;
 
 	if( pattern == NULL )
 	{
@@ -404,88 +527,92 @@ int dwipe_static_verify( DWIPE_METHOD_SIGNATURE, dwipe_pattern_t* pattern )
 		return -1;
 	}
 
-	/* Create the input buffer. */
-	b = malloc( c->device_stat.st_blksize * 1024 );
+	/* A verification that finished before the checkpoint is skipped. */
+	start = dwipe_journal_start( c, 1 );
+	if( start == c->wipe_size ) { return 0; }
+	z = c->wipe_size - start;
+
+	/* Borrow the input buffer. */
+	b = dwipe_arena_get( c, DWIPE_ARENA_INPUT, c->io_size );
 
 	/* Check the memory allocation. */
 	if( ! b )
 	{
-		dwipe_perror( errno, __FUNCTION__, "malloc" );
+		dwipe_perror( errno, __FUNCTION__, "dwipe_arena_get" );
 		dwipe_log( DWIPE_LOG_FATAL, "Unable to allocate memory for the input buffer." );
 		return -1;
 	}
 
-	/* Create the pattern buffer */
-	d = malloc( c->device_stat.st_blksize * 1024 + pattern->length * 2 );
+	/* Borrow the pattern buffer. */
+	d = dwipe_arena_get( c, DWIPE_ARENA_OUTPUT, c->io_size + pattern->length * 2 );
 
 	/* Check the memory allocation. */
 	if( ! d )
 	{
-		dwipe_perror( errno, __FUNCTION__, "malloc" );
+		dwipe_perror( errno, __FUNCTION__, "dwipe_arena_get" );
 		dwipe_log( DWIPE_LOG_FATAL, "Unable to allocate memory for the pattern buffer." );
 		return -1;
 	}
 
-	for( q = d ; q < d + c->device_stat.st_blksize * 1024 + pattern->length ; q += pattern->length )
+	for( q = d ; q < d + c->io_size + pattern->length ; q += pattern->length )
 	{
 		/* Fill the pattern buffer with the pattern. */
 		memcpy( q, pattern->s, pattern->length );
 	}
 
 	/* Tell our parent that we are syncing the device. */
-	c->sync_status = 1;
+	dwipe_progress_set( c, &c->progress->sync_status, 1 );
 
 	/* Sync the device. */
-	r = fdatasync( c->device_fd );
+	t = dwipe_progress_clock();
+	r = dwipe_durability_sync( c );
+	dwipe_progress_count( c, &c->progress->sync_ns, dwipe_progress_clock() - t );
 
 	/* Tell our parent that we have finished syncing the device. */
-	c->sync_status = 0;
+	dwipe_progress_set( c, &c->progress->sync_status, 0 );
 
 	if( r != 0 )
 	{
-		/* FIXME: Is there a better way to handle this? */
+		/* The last pass is not known to be on the media, so reading it back proves nothing. */
 		dwipe_perror( errno, __FUNCTION__, "fdatasync" );
-		dwipe_log( DWIPE_LOG_WARNING, "Buffer flush failure on '%s'.", c->device_name );
-	}
-
-
-	/* Reset the file pointer. */
-	offset = lseek( c->device_fd, 0, SEEK_SET );
-
-	if( offset == (loff_t)-1 )
-	{
-		dwipe_perror( errno, __FUNCTION__, "lseek" );
-		dwipe_log( DWIPE_LOG_FATAL, "Unable to reset the '%s' file offset.", c->device_name );
-		return -1;
-	}
-
-	if( offset != 0 )
-	{
-		/* This is system insanity. */
-		dwipe_log( DWIPE_LOG_SANITY, "dwipe_static_verify: lseek() returned a bogus offset on '%s'.", c->device_name );
+		dwipe_log( DWIPE_LOG_FATAL, "Buffer flush failure on '%s'.", c->device_name );
 		return -1;
 	}
 
 
 	while( z > 0 )
 	{
-		if( c->device_stat.st_blksize * 1024 < z )
+		if( c->io_size < z )
 		{
-			blocksize = c->device_stat.st_blksize * 1024;
+			blocksize = c->io_size;
 		}
 		else
 		{
 			/* This is a seatbelt for buggy drivers and programming errors because */
-			/* the device size should always be an even multiple of its blocksize. */
+			/* the device size should always be an even multiple of its sector size. */
 			blocksize = z;
-			dwipe_log( DWIPE_LOG_WARNING,
-			  "%s: The size of '%s' is not a multiple of its block size %i.",
-			  __FUNCTION__, c->device_name, c->device_stat.st_blksize );
+
+			if( c->sector_size > 0 && z % c->sector_size != 0 )
+			{
+				dwipe_log( DWIPE_LOG_WARNING,
+				  "%s: The size of '%s' is not a multiple of its sector size %i.",
+				  __FUNCTION__, c->device_name, c->sector_size );
+			}
 		}
 
-		/* Fill the output buffer with the random pattern. */
+		/* Place the block on the device, inside one of the ranges that are wiped. */
+		offset = dwipe_range_map( c, c->wipe_size - z, &blocksize );
+
+		/* End the block on a boundary of the device geometry. */
+		blocksize = dwipe_geometry_block( c, offset, blocksize );
+
+		/* The pattern repeats from the start of the pass. */
+		w = ( c->wipe_size - z ) % pattern->length;
+
 		/* Read the buffer in from the device. */
-		r = read( c->device_fd, b, blocksize );
+		t = dwipe_progress_clock();
+		r = dwipe_pass_pread( c, b, &d[w], blocksize, offset );
+		t = dwipe_progress_clock() - t;
 
 		/* Check the result. */
 		if( r < 0 )
@@ -499,52 +626,42 @@ int dwipe_static_verify( DWIPE_METHOD_SIGNATURE, dwipe_pattern_t* pattern )
 		if( r == blocksize )
 		{
 			/* Check every byte in the buffer. */
-			if( memcmp( b, &d[w], r ) != 0 ) { c->verify_errors += 1; }
+			if( memcmp( b, &d[w], r ) != 0 ) { dwipe_progress_count( c, &c->progress->verify_errors, 1 ); dwipe_event( c, DWIPE_EVENT_VERIFY_ERROR, 1 ); }
 		}
 		else
 		{
-			/* The number of bytes that were not read. */
+			/* The number of bytes that the device would not return. */
 			int s = blocksize - r;
 
-			/* TODO: Handle a partial read. */
-
 			/* Increment the error count. */
-			c->verify_errors += 1;
+			dwipe_progress_count( c, &c->progress->verify_errors, 1 );
+			dwipe_event( c, DWIPE_EVENT_VERIFY_ERROR, 1 );
+			dwipe_pass_skipped( c, s );
 			
-			dwipe_log( DWIPE_LOG_WARNING, "Partial read on '%s', %i bytes short.", c->device_name, s );
-
-			/* Bump the file pointer to the next block. */
-			offset = lseek( c->device_fd, s, SEEK_CUR );
-
-			if( offset == (loff_t)-1 )
-			{
-				dwipe_perror( errno, __FUNCTION__, "lseek" );
-				dwipe_log( DWIPE_LOG_ERROR, "Unable to bump the '%s' file offset after a partial read.", c->device_name );
-				return -1;
-			}
+			dwipe_log( DWIPE_LOG_ERROR, "%i bytes of '%s' at offset %llu were not verified.", s, c->device_name, offset + r );
 
 		} /* partial read */
 
-		/* Adjust the window. */
-		w = ( c->device_stat.st_blksize * 1024 + w ) % pattern->length;
+		/* Decrement the bytes remaining in this pass.  A short block was retried, */
+		/* and the bytes that the device still would not move were counted above. */
+		z -= blocksize;
 
-		/* Intuition check: 
-		 *   If the pattern length evenly divides the block size
-		 *   then ( w == 0 ) always.
-		 */
+		/* Increment the total progress counters. */
+		dwipe_progress_add( c, DWIPE_IO_READ, r, t );
 
-		/* Decrement the bytes remaining in this pass. */
-		z -= r;
+		/* The block will not be read again, so keep it out of the cache. */
+		dwipe_writeback_read( c, offset, blocksize );
 
-		/* Increment the total progress counters. */
-		c->round_done += r;
-		c->pass_done += r;
+		/* Stay under the rate limit of this device. */
+		dwipe_throttle( c, r );
+
+		/* Record how far the pass has come when a checkpoint is due. */
+		dwipe_journal_checkpoint( c, c->wipe_size - z, 0 );
 
 	} /* while bytes remaining */
 
-	/* Release the buffers. */
-	free( b );
-	free( d );
+	/* The verification is done. */
+	dwipe_journal_checkpoint( c, c->wipe_size, 1 );
 
 	/* We're done. */
 	return 0;
@@ -563,11 +680,14 @@ int dwipe_static_pass( DWIPE_METHOD_SIGNATURE, dwipe_pattern_t* pattern )
 	/* The result holder. */
 	int r;
 
+	/* The clock when an operation started, and then its duration. */
+	u64 t;
+
 	/* The IO size. */
 	size_t blocksize;
 
-	/* The result buffer for calls to lseek. */
-	loff_t offset;
+	/* The offset of the working block on the device. */
+	u64 offset;
 
 	/* The output buffer. */
 	char* b;
@@ -576,10 +696,13 @@ int dwipe_static_pass( DWIPE_METHOD_SIGNATURE, dwipe_pattern_t* pattern )
 	char* p;
 
 	/* The output buffer window offset. */
-	int w = 0;
+	int w;
+
+	/* The offset where the pass starts, which is past zero when it is resumed. */
+	u64 start;
 
 	/* The number of bytes remaining in the pass. */
-	u64 z = c->device_size;
+	u64 z;
 
 	if( pattern == NULL )
 	{
@@ -595,61 +718,65 @@ int dwipe_static_pass( DWIPE_METHOD_SIGNATURE, dwipe_pattern_t* pattern )
 		return -1;
 	}
 
-	/* Create the output buffer. */
-	b = malloc( c->device_stat.st_blksize * 1024 + pattern->length * 2 );
+	/* A pass that finished before the checkpoint is skipped. */
+	start = dwipe_journal_start( c, 0 );
+	if( start == c->wipe_size ) { return 0; }
+	z = c->wipe_size - start;
+
+	/* Borrow the output buffer. */
+	b = dwipe_arena_get( c, DWIPE_ARENA_OUTPUT, c->io_size + pattern->length * 2 );
 
 	/* Check the memory allocation. */
 	if( ! b )
 	{
-		dwipe_perror( errno, __FUNCTION__, "malloc" );
+		dwipe_perror( errno, __FUNCTION__, "dwipe_arena_get" );
 		dwipe_log( DWIPE_LOG_FATAL, "Unable to allocate memory for the pattern buffer." );
 		return -1;
 	}
 
-	for( p = b ; p < b + c->device_stat.st_blksize * 1024 + pattern->length ; p += pattern->length )
+	for( p = b ; p < b + c->io_size + pattern->length ; p += pattern->length )
 	{
 		/* Fill the output buffer with the pattern. */
 		memcpy( p, pattern->s, pattern->length ); 
 	}
 
 
-	/* Reset the file pointer. */
-	offset = lseek( c->device_fd, 0, SEEK_SET );
-
-	if( offset == (loff_t)-1 )
-	{
-		dwipe_perror( errno, __FUNCTION__, "lseek" );
-		dwipe_log( DWIPE_LOG_FATAL, "Unable to reset the '%s' file offset.", c->device_name );
-		return -1;
-	}
-
-	if( offset != 0 )
-	{
-		/* This is system insanity. */
-		dwipe_log( DWIPE_LOG_SANITY, "__FUNCTION__: lseek() returned a bogus offset on '%s'.", c->device_name );
-		return -1;
-	}
-
+	/* Start the rolling writeback of this pass. */
+	dwipe_writeback_start( c );
 
 	while( z > 0 )
 	{
-		if( c->device_stat.st_blksize * 1024 < z )
+		if( c->io_size < z )
 		{
-			blocksize = c->device_stat.st_blksize * 1024;
+			blocksize = c->io_size;
 		}
 		else
 		{
 			/* This is a seatbelt for buggy drivers and programming errors because */
-			/* the device size should always be an even multiple of its blocksize. */
+			/* the device size should always be an even multiple of its sector size. */
 			blocksize = z;
-			dwipe_log( DWIPE_LOG_WARNING,
-			  "%s: The size of '%s' is not a multiple of its block size %i.",
-			  __FUNCTION__, c->device_name, c->device_stat.st_blksize );
+
+			if( c->sector_size > 0 && z % c->sector_size != 0 )
+			{
+				dwipe_log( DWIPE_LOG_WARNING,
+				  "%s: The size of '%s' is not a multiple of its sector size %i.",
+				  __FUNCTION__, c->device_name, c->sector_size );
+			}
 		}
 
-		/* Fill the output buffer with the random pattern. */
+		/* Place the block on the device, inside one of the ranges that are wiped. */
+		offset = dwipe_range_map( c, c->wipe_size - z, &blocksize );
+
+		/* End the block on a boundary of the device geometry. */
+		blocksize = dwipe_geometry_block( c, offset, blocksize );
+
+		/* The pattern repeats from the start of the pass. */
+		w = ( c->wipe_size - z ) % pattern->length;
+
 		/* Write the next block out to the device. */
-		r = write( c->device_fd, &b[w], blocksize );
+		t = dwipe_progress_clock();
+		r = dwipe_pass_pwrite( c, &b[w], blocksize, offset );
+		t = dwipe_progress_clock() - t;
 
 		/* Check the result for a fatal error. */
 		if( r < 0 )
@@ -662,66 +789,67 @@ int dwipe_static_pass( DWIPE_METHOD_SIGNATURE, dwipe_pattern_t* pattern )
 		/* Check for a partial write. */
 		if( r != blocksize )
 		{
-			/* TODO: Handle a partial write. */
-
-			/* The number of bytes that were not written. */
+			/* The number of bytes that the device would not take. */
 			int s = blocksize - r;
 			
 			/* Increment the error count. */
-			c->pass_errors += s;
-
-			dwipe_log( DWIPE_LOG_WARNING, "Partial write on '%s', %i bytes short.", c->device_name, s );
-
-			/* Bump the file pointer to the next block. */
-			offset = lseek( c->device_fd, s, SEEK_CUR );
+			dwipe_progress_count( c, &c->progress->pass_errors, s );
+			dwipe_event( c, DWIPE_EVENT_WRITE_ERROR, s );
+			dwipe_pass_skipped( c, s );
 
-			if( offset == (loff_t)-1 )
-			{
-				dwipe_perror( errno, __FUNCTION__, "lseek" );
-				dwipe_log( DWIPE_LOG_ERROR, "Unable to bump the '%s' file offset after a partial write.", c->device_name );
-				return -1;
-			}
+			dwipe_log( DWIPE_LOG_ERROR, "%i bytes of '%s' at offset %llu were not wiped.", s, c->device_name, offset + r );
 
 		} /* partial write */
 
 
-		/* Adjust the window. */
-		w = ( c->device_stat.st_blksize * 1024 + w ) % pattern->length;
+		/* Decrement the bytes remaining in this pass.  A short block was retried, */
+		/* and the bytes that the device still would not move were counted above. */
+		z -= blocksize;
 
-		/* Intuition check: 
-		 *
-		 *   If the pattern length evenly divides the block size
-		 *   then ( w == 0 ) always.
-		 */
-
-		/* Decrement the bytes remaining in this pass. */
-		z -= r;
+		/* Write the older blocks back to the media as the pass goes. */
+		dwipe_writeback_write( c, offset, r );
 
 		/* Increment the total progress counterr. */
-		c->round_done += r;
-		c->pass_done += r;
+		dwipe_progress_add( c, DWIPE_IO_WRITE, r, t );
+
+		/* Stay under the rate limit of this device. */
+		dwipe_throttle( c, r );
+
+		/* Record how far the pass has come when a checkpoint is due. */
+		dwipe_journal_checkpoint( c, c->wipe_size - z, 0 );
 
 	} /* remaining bytes */
 
+	/* Wait for the last windows, which leaves little for the sync. */
+	if( dwipe_writeback_finish( c ) != 0 )
+	{
+		/* A window that failed to reach the media fails the pass. */
+		dwipe_log( DWIPE_LOG_FATAL, "Buffer flush failure on '%s'.", c->device_name );
+		return -1;
+	}
+
 	/* Tell our parent that we are syncing the device. */
-	c->sync_status = 1;
+	dwipe_progress_set( c, &c->progress->sync_status, 1 );
 
 	/* Sync the device. */
-	r = fdatasync( c->device_fd );
+	t = dwipe_progress_clock();
+	r = dwipe_durability_sync( c );
+	dwipe_progress_count( c, &c->progress->sync_ns, dwipe_progress_clock() - t );
 
 	/* Tell our parent that we have finished syncing the device. */
-	c->sync_status = 0;
+	dwipe_progress_set( c, &c->progress->sync_status, 0 );
 
 	if( r != 0 )
 	{
-		/* FIXME: Is there a better way to handle this? */
+		/* The pass is not known to be on the media, so it failed. */
 		dwipe_perror( errno, __FUNCTION__, "fdatasync" );
-		dwipe_log( DWIPE_LOG_WARNING, "Buffer flush failure on '%s'.", c->device_name );
+		dwipe_log( DWIPE_LOG_FATAL, "Buffer flush failure on '%s'.", c->device_name );
+		return -1;
 	}
 
-	/* Release the output buffer. */
-	free( b );
-	
+	/* The whole pass is on the media. */
+	dwipe_journal_checkpoint( c, c->wipe_size, 1 );
+
 	/* We're done. */
 	return 0;	
 
@@ -0,0 +1,324 @@
+/*
+ *  peer.c: Detect drives that lag behind identical drives.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+/* RATIONALE:
+ *
+ *   In a batch of identical drives, one that writes at a fraction of the
+ *   speed of its siblings is usually failing, and it decides when the batch
+ *   finishes.  No fixed threshold tells a slow drive from a slow model, but
+ *   its siblings do: drives with the same vendor, model, revision and size
+ *   (the label that dwipe_device_identify() builds) are peers, and each
+ *   running drive is compared with the median of its peers.
+ *
+ *   A drive is slow when its throughput falls under half of the peer
+ *   median, and stalling when its p99 latency is several times the peer
+ *   p99.  It must fail a few checks in a row before it is flagged, so a
+ *   single remap or a pass change does not count.  The --outlier-action
+ *   option decides what happens next: the drive is only flagged, or it is
+ *   moved to the idle i/o class and stops counting against its scheduler
+ *   group so that a healthy drive can have its slot, or it is aborted.
+ *
+ *   Partitions, throttled drives and paused drives are never compared,
+ *   because their speed says nothing about the drive.
+ *
+ */
+
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "dwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "logging.h"
+#include "progress.h"
+#include "events.h"
+#include "peer.h"
+
+#ifndef IOPRIO_CLASS_IDLE
+#define IOPRIO_CLASS_IDLE   3
+#define IOPRIO_CLASS_SHIFT  13
+#define IOPRIO_WHO_PROCESS  1
+#endif
+
+
+/* The time of the last check. */
+static u64 dwipe_peer_checked = 0;
+
+/* The throughput and latency of the peers of the working drive. */
+static u64* dwipe_peer_throughput = NULL;
+static u64* dwipe_peer_latency    = NULL;
+static int  dwipe_peer_size       = 0;
+
+
+const char* dwipe_peer_name( int outlier )
+{
+/**
+ * Returns the name of an outlier reason.
+ *
+ */
+
+	switch( outlier )
+	{
+		case DWIPE_PEER_SLOW:     return "slow";
+		case DWIPE_PEER_STALLING: return "stalling";
+	}
+
+	return "none";
+
+} /* dwipe_peer_name */
+
+
+static const char* dwipe_peer_action( void )
+{
+/**
+ * Returns the name of the --outlier-action.
+ *
+ */
+
+	switch( dwipe_options.outlier_action )
+	{
+		case DWIPE_OUTLIER_DEPRIORITIZE: return "deprioritize";
+		case DWIPE_OUTLIER_ABORT:        return "abort";
+		case DWIPE_OUTLIER_FLAG:         break;
+	}
+
+	return "flag";
+
+} /* dwipe_peer_action */
+
+
+static int dwipe_peer_eligible( dwipe_context_t* c )
+{
+/**
+ * Decides whether the speed of a device says anything about the drive.
+ *
+ */
+
+	if( c->state != DWIPE_STATE_RUNNING || c->paused ) { return 0; }
+
+	/* The moving average has not taken its first sample yet. */
+	if( c->throughput == 0 ) { return 0; }
+
+	/* An unidentified device has no model to compare, and a partition shares its drive. */
+	if( c->label == NULL || c->label[0] == '\0' || c->device_part > 0 ) { return 0; }
+
+	/* A throttled device is slow on purpose. */
+	if( __atomic_load_n( &c->progress->rate_limit, __ATOMIC_RELAXED ) > 0 ) { return 0; }
+
+	/* A device that we have already demoted is slow because of us. */
+	if( c->outlier && dwipe_options.outlier_action != DWIPE_OUTLIER_FLAG ) { return 0; }
+
+	return 1;
+
+} /* dwipe_peer_eligible */
+
+
+static u64 dwipe_peer_median( u64* v, int n )
+{
+/**
+ * Returns the median of a short array, which is sorted in place.
+ *
+ */
+
+	/* Generic loop variables. */
+	int i;
+	int j;
+
+	/* The value that is being inserted. */
+	u64 x;
+
+	for( i = 1 ; i < n ; i++ )
+	{
+		x = v[i];
+		for( j = i ; j > 0 && v[ j - 1 ] > x ; j-- ) { v[j] = v[ j - 1 ]; }
+		v[j] = x;
+	}
+
+	if( n % 2 ) { return v[ n / 2 ]; }
+
+	return ( v[ n / 2 - 1 ] + v[ n / 2 ] ) / 2;
+
+} /* dwipe_peer_median */
+
+
+static void dwipe_peer_act( dwipe_context_t* c, u64 throughput, u64 latency )
+{
+/**
+ * Applies the --outlier-action to a device that has just been flagged.
+ *
+ */
+
+	dwipe_log( DWIPE_LOG_WARNING, "Device '%s' is %s: %llu B/s and p99 %llu us against %llu B/s and %llu us on its peers.",
+	  c->device_name, dwipe_peer_name( c->outlier ), c->throughput, c->latency_p99 / 1000, throughput, latency / 1000 );
+
+	dwipe_events_outlier( c, "outlier", dwipe_peer_name( c->outlier ), dwipe_peer_action(), throughput, latency );
+
+	switch( dwipe_options.outlier_action )
+	{
+		case DWIPE_OUTLIER_DEPRIORITIZE:
+
+			/* The scheduler stops counting the device, and its i/o only runs when the disks are idle. */
+			if( setpriority( PRIO_PROCESS, c->pid, 19 ) != 0 )
+			{
+				dwipe_perror( errno, __FUNCTION__, "setpriority" );
+			}
+
+			if( syscall( SYS_ioprio_set, IOPRIO_WHO_PROCESS, c->pid, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT ) != 0 )
+			{
+				dwipe_perror( errno, __FUNCTION__, "ioprio_set" );
+			}
+
+			dwipe_log( DWIPE_LOG_NOTICE, "Moved the wipe of '%s' to the idle i/o class.", c->device_name );
+			break;
+
+		case DWIPE_OUTLIER_ABORT:
+
+			dwipe_log( DWIPE_LOG_NOTICE, "Aborting the wipe of '%s'.", c->device_name );
+			kill( c->pid, SIGTERM );
+
+			/* A stopped child only dies once it runs again. */
+			if( c->paused ) { kill( c->pid, SIGCONT ); c->paused = 0; }
+			break;
+
+		case DWIPE_OUTLIER_FLAG:
+			break;
+	}
+
+} /* dwipe_peer_act */
+
+
+void dwipe_peer_check( int count, dwipe_context_t* c )
+{
+/**
+ * Compares every running device with the running devices of the same
+ * model, and flags the ones that lag.  Only the parent may call this, and
+ * it does nothing until DWIPE_KNOB_PEER_INTERVAL has passed.
+ *
+ * @parameter count  The number of contexts in the array.
+ * @parameter c      An array of device contexts.
+ * @modifies  c[].outlier, c[].outlier_strikes
+ *
+ */
+
+	/* Generic loop variables. */
+	int i;
+	int j;
+
+	/* The number of peers of the working device. */
+	int n;
+
+	/* The peer medians. */
+	u64 throughput;
+	u64 latency;
+
+	/* What is wrong with the working device. */
+	int outlier;
+
+	/* The current time. */
+	u64 now = dwipe_progress_clock();
+
+	if( now - dwipe_peer_checked < (u64) DWIPE_KNOB_PEER_INTERVAL * 1000000000 ) { return; }
+
+	dwipe_peer_checked = now;
+
+	if( count > dwipe_peer_size )
+	{
+		free( dwipe_peer_throughput );
+		free( dwipe_peer_latency );
+
+		dwipe_peer_throughput = malloc( count * sizeof( u64 ) );
+		dwipe_peer_latency    = malloc( count * sizeof( u64 ) );
+
+		if( dwipe_peer_throughput == NULL || dwipe_peer_latency == NULL )
+		{
+			dwipe_perror( errno, __FUNCTION__, "malloc" );
+			free( dwipe_peer_throughput ); dwipe_peer_throughput = NULL;
+			free( dwipe_peer_latency );    dwipe_peer_latency    = NULL;
+			dwipe_peer_size = 0;
+			return;
+		}
+
+		dwipe_peer_size = count;
+	}
+
+	for( i = 0 ; i < count ; i++ )
+	{
+		if( ! dwipe_peer_eligible( &c[i] ) ) { continue; }
+
+		n = 0;
+
+		for( j = 0 ; j < count ; j++ )
+		{
+			if( j == i || ! dwipe_peer_eligible( &c[j] ) ) { continue; }
+			if( strcmp( c[j].label, c[i].label ) != 0 )    { continue; }
+
+			dwipe_peer_throughput[n] = c[j].throughput;
+			dwipe_peer_latency[n]    = c[j].latency_p99;
+			n += 1;
+		}
+
+		if( n < DWIPE_KNOB_PEER_MINIMUM )
+		{
+			/* Too few peers to tell the drive from the model. */
+			c[i].outlier_strikes = 0;
+			continue;
+		}
+
+		throughput = dwipe_peer_median( dwipe_peer_throughput, n );
+		latency    = dwipe_peer_median( dwipe_peer_latency,    n );
+
+		outlier = DWIPE_PEER_NONE;
+
+		if( c[i].throughput * 100 < throughput * DWIPE_KNOB_PEER_SLOW )
+		{
+			outlier = DWIPE_PEER_SLOW;
+		}
+
+		else if( c[i].latency_p99 > DWIPE_KNOB_PEER_STALL_FLOOR && c[i].latency_p99 > latency * DWIPE_KNOB_PEER_STALL )
+		{
+			outlier = DWIPE_PEER_STALLING;
+		}
+
+		if( outlier == DWIPE_PEER_NONE )
+		{
+			c[i].outlier_strikes = 0;
+
+			if( c[i].outlier )
+			{
+				/* Only a flagged device can recover, because a demoted one is no longer compared. */
+				dwipe_log( DWIPE_LOG_NOTICE, "Device '%s' keeps up with its peers again.", c[i].device_name );
+				dwipe_events_outlier( &c[i], "recovered", dwipe_peer_name( c[i].outlier ), dwipe_peer_action(), throughput, latency );
+				c[i].outlier = DWIPE_PEER_NONE;
+			}
+
+			continue;
+		}
+
+		if( ++c[i].outlier_strikes < DWIPE_KNOB_PEER_STRIKES || c[i].outlier == outlier ) { continue; }
+
+		c[i].outlier = outlier;
+		dwipe_peer_act( &c[i], throughput, latency );
+	}
+
+} /* dwipe_peer_check */
+
+/* eof */
@@ -0,0 +1,53 @@
+/*
+ *  peer.h: Detect drives that lag behind identical drives.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef PEER_H_
+#define PEER_H_
+
+/* The number of other running drives of the same model that are needed to judge one. */
+#define DWIPE_KNOB_PEER_MINIMUM       2
+
+/* The percentage of the peer throughput below which a drive is slow. */
+#define DWIPE_KNOB_PEER_SLOW          50
+
+/* The multiple of the peer p99 latency above which a drive is stalling. */
+#define DWIPE_KNOB_PEER_STALL         4
+
+/* The p99 latency, in nanoseconds, below which a drive is never stalling. */
+#define DWIPE_KNOB_PEER_STALL_FLOOR   50000000
+
+/* The number of checks in a row that a drive must fail before it is an outlier. */
+#define DWIPE_KNOB_PEER_STRIKES       3
+
+/* The number of seconds between checks, which is longer than the short throughput average. */
+#define DWIPE_KNOB_PEER_INTERVAL      10
+
+typedef enum dwipe_peer_t_
+{
+	DWIPE_PEER_NONE = 0,   /* The drive keeps up with its peers.          */
+	DWIPE_PEER_SLOW,       /* The drive moves fewer bytes than its peers. */
+	DWIPE_PEER_STALLING    /* The drive has a much longer latency tail.   */
+} dwipe_peer_t;
+
+void        dwipe_peer_check( int count, dwipe_context_t* c );  /* Compare running drives with their peers. */
+const char* dwipe_peer_name( int outlier );                     /* Name the reason for an outlier.          */
+
+#endif /* PEER_H_ */
+
+/* eof */
@@ -20,6 +20,7 @@
 
 #include "dwipe.h"
 #include "prng.h"
+#include "context.h"
 #include "logging.h"
 
 #include "mt19937ar-cok.h"
@@ -0,0 +1,483 @@
+/*
+ *  probe.c: Concurrent device probing at startup.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+/* RATIONALE:
+ *
+ *   Probing a device means an open, several ioctls, a seek to the end and a
+ *   handful of sysfs reads.  A drive that is still spinning up can hold any
+ *   of these for many seconds, and a large enclosure has dozens of drives, so
+ *   probing them one after another made startup take minutes.
+ *
+ *   A small pool of detached threads now probes the devices concurrently.
+ *   Each thread works on a private copy of the context, and only the main
+ *   thread copies finished results into the context array, so the selection
+ *   screen can draw the array while probes are still running.  A probe that
+ *   runs longer than --probe-timeout is abandoned: its device is disabled and
+ *   the late result, if any, is discarded by the thread that produced it.
+ *   A thread that is stuck in the kernel cannot be cancelled, but it no longer
+ *   holds anything else back.
+ *
+ */
+
+#include <pthread.h>
+
+#include "dwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "device.h"
+#include "logging.h"
+#include "probe.h"
+
+/* The microseconds between polls while waiting for every probe. */
+#define DWIPE_PROBE_INTERVAL  100000
+
+typedef enum dwipe_probe_state_t_
+{
+	DWIPE_PROBE_QUEUED = 0,  /* Waiting for a thread.                            */
+	DWIPE_PROBE_RUNNING,     /* A thread is probing the device.                  */
+	DWIPE_PROBE_DONE,        /* The result is waiting to be collected.           */
+	DWIPE_PROBE_COLLECTED,   /* The result has been copied into the context.     */
+	DWIPE_PROBE_ABANDONED    /* The probe took too long and its device is disabled. */
+} dwipe_probe_state_t;
+
+typedef struct /* dwipe_probe_job_t */
+{
+	dwipe_probe_state_t state;   /* Where this probe is.                              */
+	time_t              start;   /* When a thread started the probe.                  */
+	int                 errors;  /* The number of errors that the probe reported.     */
+	dwipe_context_t     result;  /* The context before and after the probe, with its own device name. */
+} dwipe_probe_job_t;
+
+/* Guards every job and the next job index. */
+static pthread_mutex_t dwipe_probe_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static dwipe_probe_job_t* dwipe_probe_jobs;
+static int dwipe_probe_count;
+static int dwipe_probe_next;
+
+/* The number of collected probes that failed. */
+static int dwipe_probe_failed;
+
+
+
+static void* dwipe_probe_worker( void* arg )
+{
+/**
+ * Probes queued devices until there are none left.
+ *
+ */
+
+	/* The job index. */
+	int i;
+
+	/* The private copy of the context that is probed. */
+	dwipe_context_t c;
+
+	/* The number of probe errors. */
+	int errors;
+
+	while( 1 )
+	{
+		pthread_mutex_lock( &dwipe_probe_lock );
+
+		/* Skip the queued jobs that were abandoned before they started. */
+		while( dwipe_probe_next < dwipe_probe_count && dwipe_probe_jobs[ dwipe_probe_next ].state != DWIPE_PROBE_QUEUED )
+		{
+			dwipe_probe_next += 1;
+		}
+
+		if( dwipe_probe_next >= dwipe_probe_count )
+		{
+			pthread_mutex_unlock( &dwipe_probe_lock );
+			break;
+		}
+
+		i = dwipe_probe_next++;
+		dwipe_probe_jobs[i].state = DWIPE_PROBE_RUNNING;
+		dwipe_probe_jobs[i].start = time( NULL );
+		c = dwipe_probe_jobs[i].result;
+
+		pthread_mutex_unlock( &dwipe_probe_lock );
+
+		errors = dwipe_device_probe( &c );
+
+		pthread_mutex_lock( &dwipe_probe_lock );
+
+		if( dwipe_probe_jobs[i].state == DWIPE_PROBE_RUNNING )
+		{
+			/* Hand the result to the main thread. */
+			dwipe_probe_jobs[i].result = c;
+			dwipe_probe_jobs[i].errors = errors;
+			dwipe_probe_jobs[i].state  = DWIPE_PROBE_DONE;
+		}
+
+		else
+		{
+			/* Nobody wants this result any more, and the job owns all of it. */
+			dwipe_log( DWIPE_LOG_NOTICE, "Discarded the late probe of device '%s'.", c.device_name );
+			if( c.device_fd >= 0 ) { close( c.device_fd ); }
+			free( c.device_name );
+			free( c.device_serial );
+			free( c.ranges );
+			free( c.label );
+		}
+
+		pthread_mutex_unlock( &dwipe_probe_lock );
+	}
+
+	return NULL;
+
+} /* dwipe_probe_worker */
+
+
+
+int dwipe_probe_start( int count, dwipe_context_t* c )
+{
+/**
+ * Marks every context as probing and starts the probe threads.
+ *
+ * @parameter count  The number of contexts in the array.
+ * @parameter c      An array of contexts with device_name set and device_fd = -1.
+ * @modifies  c[].select  Set to DWIPE_SELECT_PROBING.
+ * @return           0 on success, -1 on failure.
+ *
+ */
+
+	/* The thread handle and its attributes. */
+	pthread_t      thread;
+	pthread_attr_t attr;
+
+	/* The number of threads that were started. */
+	int threads = 0;
+
+	/* Generic loop variable. */
+	int i;
+
+	dwipe_probe_jobs = calloc( count, sizeof( dwipe_probe_job_t ) );
+
+	if( dwipe_probe_jobs == NULL )
+	{
+		dwipe_perror( errno, __FUNCTION__, "calloc" );
+		dwipe_log( DWIPE_LOG_FATAL, "Unable to allocate the probe jobs." );
+		return -1;
+	}
+
+	dwipe_probe_count  = count;
+	dwipe_probe_next   = 0;
+	dwipe_probe_failed = 0;
+
+	for( i = 0 ; i < count ; i++ )
+	{
+		c[i].select = DWIPE_SELECT_PROBING;
+		dwipe_probe_jobs[i].state  = DWIPE_PROBE_QUEUED;
+		dwipe_probe_jobs[i].result = c[i];
+
+		/* A hung probe outlives the context, so it must not share the name that main frees. */
+		dwipe_probe_jobs[i].result.device_name = strdup( c[i].device_name );
+
+		if( dwipe_probe_jobs[i].result.device_name == NULL )
+		{
+			dwipe_perror( errno, __FUNCTION__, "strdup" );
+			dwipe_log( DWIPE_LOG_FATAL, "Unable to allocate the probe jobs." );
+			while( i-- > 0 ) { free( dwipe_probe_jobs[i].result.device_name ); }
+			free( dwipe_probe_jobs );
+			dwipe_probe_jobs = NULL;
+			return -1;
+		}
+	}
+
+	/* Nobody joins the threads, so that a hung probe cannot hang the program. */
+	pthread_attr_init( &attr );
+	pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+
+	for( i = 0 ; i < dwipe_options.probe_threads && i < count ; i++ )
+	{
+		if( pthread_create( &thread, &attr, dwipe_probe_worker, NULL ) != 0 )
+		{
+			dwipe_log( DWIPE_LOG_WARNING, "Unable to start probe thread %i.", i );
+			break;
+		}
+
+		threads += 1;
+	}
+
+	pthread_attr_destroy( &attr );
+
+	if( threads == 0 && count > 0 )
+	{
+		/* Probe in this thread instead. */
+		dwipe_probe_worker( NULL );
+	}
+
+	dwipe_log( DWIPE_LOG_INFO, "Probing %i devices with %i threads.", count, threads );
+
+	return 0;
+
+} /* dwipe_probe_start */
+
+
+
+static int dwipe_probe_disk( dwipe_context_t* a, dwipe_context_t* b )
+{
+/**
+ * Returns non-zero if the two contexts are on the same disk.
+ *
+ */
+
+	return a->device_type   == b->device_type
+	    && a->device_host   == b->device_host
+	    && a->device_bus    == b->device_bus
+	    && a->device_target == b->device_target
+	    && a->device_lun    == b->device_lun;
+
+} /* dwipe_probe_disk */
+
+
+
+static void dwipe_probe_select( int count, dwipe_context_t* c, int k )
+{
+/**
+ * Sets the initial selection of a freshly probed context.
+ *
+ * Probes finish in any order, so the --exclude rules and the implied
+ * selection of partitions are applied against whichever of the disk and its
+ * partitions are already known, from either side.
+ *
+ * @parameter count  The number of contexts in the array.
+ * @parameter c      An array of device contexts.
+ * @parameter k      The index of the context that has just been probed.
+ *
+ */
+
+	/* Generic loop variable. */
+	int i;
+
+	/* Whether c[k] is the excluded device itself. */
+	int excluded = dwipe_options.exclude && strcmp( c[k].device_name, dwipe_options.exclude ) == 0;
+
+	if( c[k].select == DWIPE_SELECT_DISABLED ) { return; }
+
+	if( excluded )
+	{
+		c[k].select = DWIPE_SELECT_SKIPPED;
+		dwipe_log( DWIPE_LOG_INFO, "Device '%s' is excluded.", c[k].device_name );
+	}
+
+	for( i = 0 ; i < count ; i++ )
+	{
+		if( i == k || c[i].select == DWIPE_SELECT_PROBING || ! dwipe_probe_disk( &c[i], &c[k] ) ) { continue; }
+
+		if( excluded && c[k].device_part == 0 && c[i].device_part > 0 && c[i].select != DWIPE_SELECT_DISABLED )
+		{
+			/* An excluded disk takes its partitions with it. */
+			c[i].select = DWIPE_SELECT_SKIPPED;
+			dwipe_log( DWIPE_LOG_INFO, "Device '%s' is excluded.", c[i].device_name );
+		}
+
+		if( c[k].device_part > 0 && c[i].device_part == 0 && c[i].select == DWIPE_SELECT_SKIPPED
+		    && dwipe_options.exclude && strcmp( c[i].device_name, dwipe_options.exclude ) == 0 )
+		{
+			/* This is a partition of the excluded disk. */
+			c[k].select = DWIPE_SELECT_SKIPPED;
+			dwipe_log( DWIPE_LOG_INFO, "Device '%s' is excluded.", c[k].device_name );
+		}
+	}
+
+	if( c[k].select == DWIPE_SELECT_SKIPPED ) { return; }
+
+	if( dwipe_options.autonuke )
+	{
+		/* When the autonuke option is set, select all disks. */
+		c[k].select = c[k].device_part == 0 ? DWIPE_SELECT_TRUE : DWIPE_SELECT_TRUE_PARENT;
+		return;
+	}
+
+	/* The user must manually select devices. */
+	c[k].select = DWIPE_SELECT_FALSE;
+
+	/* Agree with any selection that the user has already made on this disk. */
+	for( i = 0 ; i < count ; i++ )
+	{
+		if( i == k || ! dwipe_probe_disk( &c[i], &c[k] ) ) { continue; }
+
+		if( c[k].device_part > 0 && c[i].device_part == 0 && c[i].select == DWIPE_SELECT_TRUE )
+		{
+			c[k].select = DWIPE_SELECT_TRUE_PARENT;
+		}
+
+		if( c[k].device_part == 0 && c[i].device_part > 0 && c[i].select == DWIPE_SELECT_TRUE )
+		{
+			c[k].select = DWIPE_SELECT_FALSE_CHILD;
+		}
+	}
+
+} /* dwipe_probe_select */
+
+
+
+static void dwipe_probe_abandon( dwipe_context_t* c, dwipe_probe_job_t* job, const char* why )
+{
+/**
+ * Disables a device whose probe has not finished.  Call with the lock held.
+ *
+ */
+
+	/* A running probe frees its own copy when it finishes, but a queued one never starts. */
+	if( job->state == DWIPE_PROBE_QUEUED ) { free( job->result.device_name ); }
+
+	job->state = DWIPE_PROBE_ABANDONED;
+	c->select  = DWIPE_SELECT_DISABLED;
+
+	c->label = malloc( DWIPE_KNOB_LABEL_SIZE );
+
+	if( c->label != NULL )
+	{
+		snprintf( c->label, DWIPE_KNOB_LABEL_SIZE, "%s (%s)", c->device_name, why );
+	}
+
+	dwipe_log( DWIPE_LOG_WARNING, "Disabled device '%s': %s.", c->device_name, why );
+
+} /* dwipe_probe_abandon */
+
+
+
+int dwipe_probe_poll( int count, dwipe_context_t* c )
+{
+/**
+ * Copies finished probes into the contexts and abandons probes that have
+ * run for longer than the probe timeout.  Only the main thread calls this.
+ *
+ * @parameter count  The number of contexts in the array.
+ * @parameter c      An array of device contexts.
+ * @return           The number of devices that are still probing.
+ *
+ */
+
+	/* The number of unfinished probes. */
+	int pending = 0;
+
+	/* The current time. */
+	time_t now = time( NULL );
+
+	/* Generic loop variable. */
+	int i;
+
+	if( dwipe_probe_jobs == NULL ) { return 0; }
+
+	pthread_mutex_lock( &dwipe_probe_lock );
+
+	for( i = 0 ; i < count ; i++ )
+	{
+		dwipe_probe_job_t* job = &dwipe_probe_jobs[i];
+
+		if( c[i].select != DWIPE_SELECT_PROBING ) { continue; }
+
+		if( job->state == DWIPE_PROBE_DONE )
+		{
+			/* The context takes the name of the job in place of its own. */
+			free( c[i].device_name );
+			c[i] = job->result;
+			job->state = DWIPE_PROBE_COLLECTED;
+
+			if( job->errors > 0 )
+			{
+				/* The device cannot be wiped safely. */
+				dwipe_probe_failed += 1;
+				c[i].select = DWIPE_SELECT_DISABLED;
+			}
+
+			dwipe_probe_select( count, c, i );
+			continue;
+		}
+
+		if( job->state == DWIPE_PROBE_RUNNING && now - job->start >= dwipe_options.probe_timeout )
+		{
+			dwipe_probe_abandon( &c[i], job, "probe timed out" );
+			continue;
+		}
+
+		pending += 1;
+	}
+
+	pthread_mutex_unlock( &dwipe_probe_lock );
+
+	return pending;
+
+} /* dwipe_probe_poll */
+
+
+
+int dwipe_probe_wait( int count, dwipe_context_t* c )
+{
+/**
+ * Waits until every probe has finished or timed out.
+ *
+ * @parameter count  The number of contexts in the array.
+ * @parameter c      An array of device contexts.
+ * @return           The number of probes that reported errors.
+ *
+ */
+
+	while( dwipe_probe_poll( count, c ) > 0 )
+	{
+		usleep( DWIPE_PROBE_INTERVAL );
+	}
+
+	return dwipe_probe_failed;
+
+} /* dwipe_probe_wait */
+
+
+
+int dwipe_probe_finish( int count, dwipe_context_t* c )
+{
+/**
+ * Collects the probes that have finished and abandons the rest, so that
+ * the contexts are no longer shared with any thread.
+ *
+ * @parameter count  The number of contexts in the array.
+ * @parameter c      An array of device contexts.
+ * @return           The number of probes that reported errors.
+ *
+ */
+
+	/* Generic loop variable. */
+	int i;
+
+	dwipe_probe_poll( count, c );
+
+	pthread_mutex_lock( &dwipe_probe_lock );
+
+	for( i = 0 ; i < count ; i++ )
+	{
+		if( c[i].select == DWIPE_SELECT_PROBING )
+		{
+			dwipe_probe_abandon( &c[i], &dwipe_probe_jobs[i], "probe abandoned" );
+		}
+	}
+
+	pthread_mutex_unlock( &dwipe_probe_lock );
+
+	return dwipe_probe_failed;
+
+} /* dwipe_probe_finish */
+
+/* eof */
@@ -0,0 +1,30 @@
+/*
+ *  probe.h: Concurrent device probing at startup.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef PROBE_H_
+#define PROBE_H_
+
+int dwipe_probe_start( int count, dwipe_context_t* c );   /* Start probing every context.             */
+int dwipe_probe_poll( int count, dwipe_context_t* c );    /* Collect results; count unfinished probes. */
+int dwipe_probe_wait( int count, dwipe_context_t* c );    /* Collect every result; count failures.     */
+int dwipe_probe_finish( int count, dwipe_context_t* c );  /* Abandon unfinished probes.                */
+
+#endif /* PROBE_H_ */
+
+/* eof */
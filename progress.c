@@ -0,0 +1,597 @@
+/*
+ *  progress.c: Shared progress counters for wipe processes.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+/* RATIONALE:
+ *
+ *   The children used to bump the counters in their own dwipe_context_t,
+ *   which lives in the shared context array next to the contexts of every
+ *   other device.  Each write pulled a cache line that the parent and the
+ *   neighbouring children were reading, and a u64 read by the parent on a
+ *   32-bit machine could see half of an update.
+ *
+ *   Now each device owns one cache-line-aligned slot in a separate shared
+ *   segment.  Only its child writes the counters in the slot, with relaxed
+ *   atomic stores inside a sequence lock, and the parent copies a consistent
+ *   snapshot into the context when it samples.  The fields of dwipe_context_t that share
+ *   names with the slot are the parent's view and are never written by a
+ *   child.
+ *
+ */
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include "dwipe.h"
+#include "context.h"
+#include "logging.h"
+#include "progress.h"
+#include "eta.h"
+
+
+void* dwipe_shm_alloc( size_t size )
+{
+/**
+ * Allocates zeroed memory that is shared with children forked later.
+ *
+ * The segment is marked for removal as soon as it is attached, so that it
+ * goes away with the last process that uses it, even after a crash.
+ *
+ * @parameter size  The number of bytes to allocate.
+ * @return          The attached memory, or NULL on failure.
+ *
+ */
+
+	/* The shared memory handle. */
+	int shmid;
+
+	/* The attached memory. */
+	void* p;
+
+	shmid = shmget( IPC_PRIVATE, size, IPC_CREAT | S_IRUSR | S_IWUSR );
+
+	if( shmid < 0 )
+	{
+		dwipe_perror( errno, __FUNCTION__, "shmget" );
+		return NULL;
+	}
+
+	p = shmat( shmid, NULL, 0 );
+
+	if( p == (void*) -1 )
+	{
+		dwipe_perror( errno, __FUNCTION__, "shmat" );
+		shmctl( shmid, IPC_RMID, NULL );
+		return NULL;
+	}
+
+	/* The segment stays attached until exit. */
+	shmctl( shmid, IPC_RMID, NULL );
+
+	/* New segments are zeroed by the kernel. */
+	return p;
+
+} /* dwipe_shm_alloc */
+
+
+
+u64 dwipe_progress_clock( void )
+{
+/**
+ * Returns the monotonic clock in nanoseconds.
+ *
+ */
+
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return (u64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+} /* dwipe_progress_clock */
+
+
+
+int dwipe_progress_init( int count, dwipe_context_t* c )
+{
+/**
+ * Allocates one progress slot per device and attaches it to the context.
+ *
+ * @parameter count  The number of contexts in the array.
+ * @parameter c      An array of device contexts.
+ * @return           0 on success, -1 on failure.
+ *
+ */
+
+	/* The slot array. */
+	dwipe_progress_t* p;
+
+	/* Generic loop variable. */
+	int i;
+
+	p = dwipe_shm_alloc( count * sizeof( dwipe_progress_t ) );
+
+	if( p == NULL )
+	{
+		dwipe_log( DWIPE_LOG_FATAL, "Unable to allocate shared memory for the progress counters." );
+		return -1;
+	}
+
+	for( i = 0 ; i < count ; i++ )
+	{
+		c[i].progress = &p[i];
+	}
+
+	return 0;
+
+} /* dwipe_progress_init */
+
+
+
+static void dwipe_progress_begin( dwipe_progress_t* p )
+{
+/**
+ * Opens a write to a slot.  The sequence is odd until dwipe_progress_end.
+ *
+ */
+
+	__atomic_store_n( &p->sequence, p->sequence + 1, __ATOMIC_RELAXED );
+	__atomic_thread_fence( __ATOMIC_RELEASE );
+
+} /* dwipe_progress_begin */
+
+
+
+static void dwipe_progress_end( dwipe_progress_t* p )
+{
+/**
+ * Closes a write to a slot and stamps it.
+ *
+ */
+
+	__atomic_store_n( &p->timestamp, dwipe_progress_clock(), __ATOMIC_RELAXED );
+	__atomic_store_n( &p->sequence, p->sequence + 1, __ATOMIC_RELEASE );
+
+} /* dwipe_progress_end */
+
+
+
+void dwipe_progress_add( dwipe_context_t* c, dwipe_io_t kind, u64 bytes, u64 ns )
+{
+/**
+ * Publishes one i/o.  Only the child of c may call this.
+ *
+ * @parameter c      The device context.
+ * @parameter kind   Whether the i/o was a write or a read.
+ * @parameter bytes  The number of bytes that were read or written.
+ * @parameter ns     The time that the i/o took.
+ *
+ */
+
+	dwipe_progress_t* p = c->progress;
+
+	/* The histogram of this kind of i/o. */
+	dwipe_latency_t* h = &p->latency[ kind ];
+
+	/* The microseconds of the i/o, its most significant bit, and its bucket. */
+	u64 us = ns / 1000;
+	int o;
+	int k;
+
+	if( us < ( 1 << DWIPE_KNOB_LATENCY_SUB_BITS ) )
+	{
+		/* Small values have a bucket each. */
+		k = us;
+	}
+
+	else
+	{
+		/* Take the octave and the next SUB_BITS bits below its leading one. */
+		o = 63 - __builtin_clzll( us );
+		k = ( o - DWIPE_KNOB_LATENCY_SUB_BITS + 1 ) << DWIPE_KNOB_LATENCY_SUB_BITS;
+		k += ( us >> ( o - DWIPE_KNOB_LATENCY_SUB_BITS ) ) & ( ( 1 << DWIPE_KNOB_LATENCY_SUB_BITS ) - 1 );
+		if( k >= DWIPE_KNOB_LATENCY_BUCKETS ) { k = DWIPE_KNOB_LATENCY_BUCKETS - 1; }
+	}
+
+	dwipe_progress_begin( p );
+	__atomic_store_n( &p->round_done, p->round_done + bytes, __ATOMIC_RELAXED );
+	__atomic_store_n( &p->pass_done,  p->pass_done  + bytes, __ATOMIC_RELAXED );
+
+	if( kind == DWIPE_IO_WRITE ) { __atomic_store_n( &p->bytes_written,  p->bytes_written  + bytes, __ATOMIC_RELAXED ); }
+	else                         { __atomic_store_n( &p->bytes_verified, p->bytes_verified + bytes, __ATOMIC_RELAXED ); }
+
+	__atomic_store_n( &h->count,     h->count     + 1,  __ATOMIC_RELAXED );
+	__atomic_store_n( &h->ns,        h->ns        + ns, __ATOMIC_RELAXED );
+	__atomic_store_n( &h->bucket[k], h->bucket[k] + 1,  __ATOMIC_RELAXED );
+	if( ns > h->max_ns ) { __atomic_store_n( &h->max_ns, ns, __ATOMIC_RELAXED ); }
+	dwipe_progress_end( p );
+
+} /* dwipe_progress_add */
+
+
+
+void dwipe_progress_count( dwipe_context_t* c, u64* counter, u64 n )
+{
+/**
+ * Adds to an error count or a time.  Only the child of c may call this.
+ *
+ * @parameter c        The device context.
+ * @parameter counter  The counter in c->progress to increase.
+ * @parameter n        The number of errors or nanoseconds.
+ *
+ */
+
+	dwipe_progress_begin( c->progress );
+	__atomic_store_n( counter, *counter + n, __ATOMIC_RELAXED );
+	dwipe_progress_end( c->progress );
+
+} /* dwipe_progress_count */
+
+
+
+void dwipe_progress_set( dwipe_context_t* c, int* field, int value )
+{
+/**
+ * Changes the working pass, round, pass type or sync status.  Only the
+ * child of c may call this, and the parent copies the field into its
+ * context when it samples the slot.
+ *
+ * @parameter c      The device context.
+ * @parameter field  The field in c->progress to change.
+ * @parameter value  The new value.
+ *
+ */
+
+	dwipe_progress_begin( c->progress );
+	__atomic_store_n( field, value, __ATOMIC_RELAXED );
+	dwipe_progress_end( c->progress );
+
+} /* dwipe_progress_set */
+
+
+
+int dwipe_progress_snapshot( dwipe_progress_t* p, dwipe_progress_t* snapshot )
+{
+/**
+ * Copies a consistent view of a slot, retrying while its child is writing.
+ * A child that died in the middle of a write leaves the sequence odd, so
+ * the retries are bounded.
+ *
+ * @parameter p         The slot to read.
+ * @parameter snapshot  Receives the copy.
+ * @return              0 on success, -1 when the copy may be torn.
+ *
+ */
+
+	/* The sequence before and after the copy. */
+	u64 s1;
+	u64 s2;
+
+	/* The copies that are left to try. */
+	int tries = DWIPE_KNOB_PROGRESS_TRIES;
+
+	/* Generic loop variables. */
+	int i;
+	int j;
+
+	do
+	{
+		s1 = __atomic_load_n( &p->sequence, __ATOMIC_ACQUIRE );
+
+		snapshot->timestamp     = __atomic_load_n( &p->timestamp,     __ATOMIC_RELAXED );
+		snapshot->round_done    = __atomic_load_n( &p->round_done,    __ATOMIC_RELAXED );
+		snapshot->pass_done     = __atomic_load_n( &p->pass_done,     __ATOMIC_RELAXED );
+		snapshot->pass_errors   = __atomic_load_n( &p->pass_errors,   __ATOMIC_RELAXED );
+		snapshot->round_errors  = __atomic_load_n( &p->round_errors,  __ATOMIC_RELAXED );
+		snapshot->verify_errors = __atomic_load_n( &p->verify_errors, __ATOMIC_RELAXED );
+		snapshot->bytes_written  = __atomic_load_n( &p->bytes_written,  __ATOMIC_RELAXED );
+		snapshot->bytes_verified = __atomic_load_n( &p->bytes_verified, __ATOMIC_RELAXED );
+		snapshot->sync_ns        = __atomic_load_n( &p->sync_ns,        __ATOMIC_RELAXED );
+		snapshot->prng_ns        = __atomic_load_n( &p->prng_ns,        __ATOMIC_RELAXED );
+		snapshot->throttle_ns    = __atomic_load_n( &p->throttle_ns,    __ATOMIC_RELAXED );
+		snapshot->pass_type      = __atomic_load_n( &p->pass_type,      __ATOMIC_RELAXED );
+		snapshot->pass_working   = __atomic_load_n( &p->pass_working,   __ATOMIC_RELAXED );
+		snapshot->round_working  = __atomic_load_n( &p->round_working,  __ATOMIC_RELAXED );
+		snapshot->sync_status    = __atomic_load_n( &p->sync_status,    __ATOMIC_RELAXED );
+
+		for( j = 0 ; j < DWIPE_IO_KINDS ; j++ )
+		{
+			snapshot->latency[j].count  = __atomic_load_n( &p->latency[j].count,  __ATOMIC_RELAXED );
+			snapshot->latency[j].ns     = __atomic_load_n( &p->latency[j].ns,     __ATOMIC_RELAXED );
+			snapshot->latency[j].max_ns = __atomic_load_n( &p->latency[j].max_ns, __ATOMIC_RELAXED );
+
+			for( i = 0 ; i < DWIPE_KNOB_LATENCY_BUCKETS ; i++ )
+			{
+				snapshot->latency[j].bucket[i] = __atomic_load_n( &p->latency[j].bucket[i], __ATOMIC_RELAXED );
+			}
+		}
+
+		__atomic_thread_fence( __ATOMIC_ACQUIRE );
+		s2 = __atomic_load_n( &p->sequence, __ATOMIC_RELAXED );
+
+	} while( ( ( s1 & 1 ) || s1 != s2 ) && --tries > 0 );
+
+	snapshot->sequence = s1;
+
+	/* The parent sets the cap without the sequence. */
+	snapshot->rate_limit = __atomic_load_n( &p->rate_limit, __ATOMIC_RELAXED );
+
+	return ( tries > 0 ) ? 0 : -1;
+
+} /* dwipe_progress_snapshot */
+
+
+
+void dwipe_progress_settle( dwipe_context_t* c )
+{
+/**
+ * Closes the write that a child was killed in, so that its slot can be
+ * read again.  Only the parent may call this, after it reaped the child.
+ *
+ */
+
+	dwipe_progress_t* p = c->progress;
+
+	if( p == NULL ) { return; }
+
+	if( __atomic_load_n( &p->sequence, __ATOMIC_ACQUIRE ) & 1 )
+	{
+		__atomic_store_n( &p->sequence, p->sequence + 1, __ATOMIC_RELEASE );
+	}
+
+} /* dwipe_progress_settle */
+
+
+
+u64 dwipe_latency_bound( int k )
+{
+/**
+ * Returns the upper bound of a latency bucket in nanoseconds.
+ *
+ */
+
+	/* The number of sub-buckets in an octave. */
+	const int n = 1 << DWIPE_KNOB_LATENCY_SUB_BITS;
+
+	/* The octave of the bucket. */
+	int o;
+
+	if( k < n ) { return (u64)( k + 1 ) * 1000; }
+
+	o = k / n + DWIPE_KNOB_LATENCY_SUB_BITS - 1;
+
+	/* The bucket starts at (n + sub) << (o - SUB_BITS) and is one step wide. */
+	return (u64)( ( n + k % n + 1 ) << ( o - DWIPE_KNOB_LATENCY_SUB_BITS ) ) * 1000;
+
+} /* dwipe_latency_bound */
+
+
+
+void dwipe_latency_merge( dwipe_latency_t* sum, const dwipe_latency_t* h )
+{
+/**
+ * Adds histogram h to histogram sum.
+ *
+ */
+
+	/* Generic loop variable. */
+	int i;
+
+	sum->count += h->count;
+	sum->ns    += h->ns;
+	if( h->max_ns > sum->max_ns ) { sum->max_ns = h->max_ns; }
+
+	for( i = 0 ; i < DWIPE_KNOB_LATENCY_BUCKETS ; i++ )
+	{
+		sum->bucket[i] += h->bucket[i];
+	}
+
+} /* dwipe_latency_merge */
+
+
+
+u64 dwipe_latency_quantile( const dwipe_latency_t* h, double q )
+{
+/**
+ * Estimates a quantile of latency from a histogram.
+ *
+ * @parameter h  A histogram.
+ * @parameter q  The quantile, between 0 and 1.
+ * @return       The upper bound in nanoseconds of the bucket that holds the
+ *               quantile, but no more than the maximum, or zero if there has
+ *               been no i/o.
+ *
+ */
+
+	/* The rank of the quantile, and the count so far. */
+	u64 rank;
+	u64 seen = 0;
+
+	/* The estimate. */
+	u64 bound;
+
+	/* Generic loop variable. */
+	int i;
+
+	if( h->count == 0 ) { return 0; }
+
+	rank = (u64)( q * h->count );
+	if( rank >= h->count ) { rank = h->count - 1; }
+
+	for( i = 0 ; i < DWIPE_KNOB_LATENCY_BUCKETS - 1 ; i++ )
+	{
+		seen += h->bucket[i];
+		if( seen > rank ) { break; }
+	}
+
+	bound = dwipe_latency_bound( i );
+
+	/* The last bucket has no bound, and no bucket bounds more than the maximum. */
+	if( i == DWIPE_KNOB_LATENCY_BUCKETS - 1 || bound > h->max_ns ) { return h->max_ns; }
+
+	return bound;
+
+} /* dwipe_latency_quantile */
+
+
+
+void dwipe_progress_sample( int count, dwipe_context_t* c )
+{
+/**
+ * Copies the published counters into the contexts and updates throughput,
+ * the estimated runtime and the percentage of every running device.
+ *
+ * @parameter count  The number of contexts in the array.
+ * @parameter c      An array of device contexts.
+ *
+ * @modifies  c[].round_done, c[].pass_done, c[].*_errors, c[].latency_*
+ * @modifies  c[].pass_type, c[].pass_working, c[].round_working, c[].sync_status
+ * @modifies  c[].throughput, c[].eta, c[].round_percent, c[].throttle*
+ *
+ */
+
+	/* A copy of one slot. */
+	dwipe_progress_t s;
+
+	/* The latency of reads and writes together. */
+	dwipe_latency_t h;
+
+	/* The current time. */
+	u64 now = dwipe_progress_clock();
+
+	/* Generic loop variable. */
+	int i;
+
+	for( i = 0 ; i < count ; i++ )
+	{
+		/* Only a running child moves its counters. */
+		if( c[i].progress == NULL || c[i].state != DWIPE_STATE_RUNNING ) { continue; }
+
+		/* Keep the last good view when the child is stuck in a write, as a dying one is. */
+		if( dwipe_progress_snapshot( c[i].progress, &s ) != 0 ) { continue; }
+
+		c[i].round_done    = s.round_done;
+		c[i].pass_done     = s.pass_done;
+		c[i].pass_errors   = s.pass_errors;
+		c[i].round_errors  = s.round_errors;
+		c[i].verify_errors = s.verify_errors;
+		c[i].throttle_ns   = s.throttle_ns;
+		c[i].pass_type     = s.pass_type;
+		c[i].pass_working  = s.pass_working;
+		c[i].round_working = s.round_working;
+		c[i].sync_status   = s.sync_status;
+
+		/* Stalls show up in the tail of the latency long before they move the average. */
+		memset( &h, 0, sizeof( h ) );
+		dwipe_latency_merge( &h, &s.latency[ DWIPE_IO_WRITE ] );
+		dwipe_latency_merge( &h, &s.latency[ DWIPE_IO_READ  ] );
+
+		c[i].latency_p50 = dwipe_latency_quantile( &h, 0.50 );
+		c[i].latency_p99 = dwipe_latency_quantile( &h, 0.99 );
+		c[i].latency_max = h.max_ns;
+
+		if( c[i].state != DWIPE_STATE_RUNNING ) { continue; }
+
+		/* Keep the moving averages of throughput, and of the time asleep in the throttle. */
+		if( dwipe_ewma_update( &c[i].ewma, c[i].round_done, now ) )
+		{
+			c[i].throughput     = c[i].ewma.fast;
+			c[i].throughput_avg = c[i].ewma.slow;
+			c[i].throughput_now = c[i].ewma.now;
+		}
+
+		if( dwipe_ewma_update( &c[i].throttle_ewma, c[i].throttle_ns, now ) )
+		{
+			/* Nanoseconds per second, as a percentage. */
+			c[i].throttled = c[i].throttle_ewma.fast / 10000000;
+
+			/* The two averages can straddle a sleep, and the device did some work. */
+			if( c[i].throttled > 99 ) { c[i].throttled = 99; }
+		}
+
+		/* Estimate the remaining runtime from the rest of the plan of the method. */
+		dwipe_eta_sample( &c[i], &s, now );
+
+		if( c[i].round_size > 0 )
+		{
+			/* Update the percentage value. */
+			c[i].round_percent = (double) c[i].round_done / (double) c[i].round_size * 100;
+		}
+
+	} /* for */
+
+} /* dwipe_progress_sample */
+
+
+
+int dwipe_ewma_update( dwipe_ewma_t* e, u64 counter, u64 now )
+{
+/**
+ * Adds a sample of a counter to the moving averages of its rate.
+ *
+ * The weight of a sample is dt / ( window + dt ), so a sample counts for
+ * the time that it covers however irregular the wakeups are, and no
+ * exp() is needed.  The first interval seeds the averages instead of
+ * letting them climb from zero.
+ *
+ * @parameter e        The averages.
+ * @parameter counter  The running total of the counter.
+ * @parameter now      The CLOCK_MONOTONIC nanoseconds of the sample.
+ * @return             1 when the averages moved, 0 when the sample was too soon.
+ *
+ */
+
+	/* The nanoseconds since the last sample, and the rate over them. */
+	double dt;
+	double rate;
+
+	if( e->time == 0 || counter < e->last )
+	{
+		/* Take the first sample, or start again after the counter went back. */
+		e->time = now;
+		e->last = counter;
+		return 0;
+	}
+
+	if( now - e->time < DWIPE_KNOB_EWMA_INTERVAL ) { return 0; }
+
+	dt   = now - e->time;
+	rate = ( counter - e->last ) * 1e9 / dt;
+
+	if( e->samples == 0 )
+	{
+		e->fast = rate;
+		e->slow = rate;
+	}
+
+	else
+	{
+		e->fast += ( rate - e->fast ) * dt / ( DWIPE_KNOB_EWMA_SHORT + dt );
+		e->slow += ( rate - e->slow ) * dt / ( DWIPE_KNOB_EWMA_LONG  + dt );
+	}
+
+	e->now      = rate;
+	e->samples += 1;
+	e->last     = counter;
+	e->time     = now;
+
+	return 1;
+
+} /* dwipe_ewma_update */
+
+/* eof */
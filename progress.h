@@ -0,0 +1,92 @@
+/*
+ *  progress.h: Shared progress counters for wipe processes.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef PROGRESS_H_
+#define PROGRESS_H_
+
+/* The size of a cache line on the machines that we care about. */
+#define DWIPE_KNOB_CACHELINE  64
+
+/* The copies of a slot that a reader tries before it gives up on a child that is stuck in a write. */
+#define DWIPE_KNOB_PROGRESS_TRIES    1000
+
+/* Each power of two of microseconds of i/o latency is split into 2^SUB_BITS linear buckets. */
+#define DWIPE_KNOB_LATENCY_SUB_BITS  2
+
+/* The number of latency buckets, which reach past half a minute.  The last one has no upper bound. */
+#define DWIPE_KNOB_LATENCY_BUCKETS   100
+
+typedef enum dwipe_io_t_
+{
+	DWIPE_IO_WRITE = 0,  /* A write of a pass.                        */
+	DWIPE_IO_READ,       /* A read of a verification.                 */
+	DWIPE_IO_KINDS
+} dwipe_io_t;
+
+/* A log-linear histogram of i/o latency. */
+typedef struct /* dwipe_latency_t */
+{
+	u64 count;                                /* The number of i/o.              */
+	u64 ns;                                   /* The sum of their latencies.     */
+	u64 max_ns;                               /* The slowest one.                */
+	u64 bucket[ DWIPE_KNOB_LATENCY_BUCKETS ]; /* The counts by latency bucket.   */
+} dwipe_latency_t;
+
+/* The hot counters of one device.  Its child writes them under the sequence, and only the parent writes the rate limit. */
+struct dwipe_progress_t_
+{
+	u64 sequence;       /* Odd while the child is publishing.                     */
+	u64 timestamp;      /* The CLOCK_MONOTONIC nanoseconds of the last publish.   */
+	u64 round_done;     /* The number of bytes that have been i/o'd in all rounds. */
+	u64 pass_done;      /* The number of bytes that have been i/o'd in all passes. */
+	u64 pass_errors;    /* The number of errors across all passes.                */
+	u64 round_errors;   /* The number of errors across all rounds.                */
+	u64 verify_errors;  /* The number of verification errors across all passes.   */
+	u64 bytes_written;  /* The number of bytes written in all passes.                 */
+	u64 bytes_verified; /* The number of bytes read back in all verifications.        */
+	u64 sync_ns;        /* The nanoseconds spent flushing the device.                 */
+	u64 prng_ns;        /* The nanoseconds spent filling buffers from the PRNG.       */
+	u64 throttle_ns;    /* The nanoseconds spent asleep under a rate limit.           */
+	int pass_type;      /* The dwipe_pass_t of the working pass.                      */
+	int pass_working;   /* The working pass.                                          */
+	int round_working;  /* The working round.                                         */
+	int sync_status;    /* Set while the child is flushing the device.                */
+	dwipe_latency_t latency[ DWIPE_IO_KINDS ];  /* The latency of writes and of reads.  */
+	u64 rate_limit __attribute__(( aligned( DWIPE_KNOB_CACHELINE ) ));  /* Bytes per second that the child may move, in a line of its own. */
+} __attribute__(( aligned( DWIPE_KNOB_CACHELINE ) ));
+
+void* dwipe_shm_alloc( size_t size );                          /* Allocate memory that children share.  */
+u64   dwipe_progress_clock( void );                            /* Read the monotonic clock.             */
+int   dwipe_progress_init( int count, dwipe_context_t* c );    /* Give every context a progress slot.   */
+void  dwipe_progress_add( dwipe_context_t* c, dwipe_io_t kind, u64 bytes, u64 ns );  /* Publish an i/o.  */
+void  dwipe_progress_count( dwipe_context_t* c, u64* counter, u64 n );  /* Add to a counter.           */
+void  dwipe_progress_set( dwipe_context_t* c, int* field, int value );  /* Move the working position.  */
+
+u64   dwipe_latency_bound( int k );                                           /* The upper bound of a bucket.  */
+void  dwipe_latency_merge( dwipe_latency_t* sum, const dwipe_latency_t* h );  /* Add one histogram to another. */
+u64   dwipe_latency_quantile( const dwipe_latency_t* h, double q );           /* Estimate a latency in ns.     */
+int   dwipe_progress_snapshot( dwipe_progress_t* p, dwipe_progress_t* snapshot );  /* Read a slot.      */
+void  dwipe_progress_settle( dwipe_context_t* c );             /* Close the write of a dead child.      */
+void  dwipe_progress_sample( int count, dwipe_context_t* c );  /* Update the parent's view of progress. */
+
+int   dwipe_ewma_update( dwipe_ewma_t* e, u64 counter, u64 now );  /* Average the rate of a counter.  */
+
+#endif /* PROGRESS_H_ */
+
+/* eof */
@@ -0,0 +1,319 @@
+/*
+ *  range.c: Wipes that are restricted to parts of a device.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+/* RATIONALE:
+ *
+ *   Sometimes only a known region needs wiping: the first and last few
+ *   gigabytes that hold partition tables and RAID metadata, or a region
+ *   that an earlier verification flagged.  The --range option lists
+ *   OFFSET[:LENGTH] extents.  A negative offset counts back from the end of
+ *   the device, a missing length reaches the end, and numbers take an 's'
+ *   suffix for 512 byte sectors or K, M, G and T for binary multiples.
+ *
+ *   The extents of each device are resolved when it is probed: they are
+ *   clipped to the device, widened to whole sectors, sorted and merged, so
+ *   that no byte is written twice in a pass.  A pass then walks the
+ *   concatenation of the extents as if it were a smaller device, and every
+ *   block is placed with pread() and pwrite() at the device offset that
+ *   dwipe_range_map() gives it.  So the byte counts, the checkpoints and the
+ *   pattern windows all follow the extents without knowing about them.
+ *
+ */
+
+#include "dwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "logging.h"
+#include "range.h"
+
+
+static int dwipe_range_number( const char** p, long long* value )
+{
+/**
+ * Reads one number with an optional sign and unit suffix, and moves the
+ * pointer past it.
+ *
+ * @return  0 on success, -1 on a syntax error.
+ *
+ */
+
+	/* The end of the digits. */
+	char* end;
+
+	/* The unit of the number. */
+	long long unit = 1;
+
+	*value = strtoll( *p, &end, 10 );
+
+	if( end == *p ) { return -1; }
+
+	switch( *end )
+	{
+		case 's': case 'S': unit = DWIPE_KNOB_RANGE_SECTOR; end++; break;
+		case 'k': case 'K': unit = 1LL << 10; end++; break;
+		case 'm': case 'M': unit = 1LL << 20; end++; break;
+		case 'g': case 'G': unit = 1LL << 30; end++; break;
+		case 't': case 'T': unit = 1LL << 40; end++; break;
+	}
+
+	*value *= unit;
+	*p = end;
+
+	return 0;
+
+} /* dwipe_range_number */
+
+
+static int dwipe_range_compare( const void* a, const void* b )
+{
+/**
+ * Orders extents by their offset, for qsort().
+ *
+ */
+
+	const dwipe_range_t* x = a;
+	const dwipe_range_t* y = b;
+
+	if( x->offset < y->offset ) { return -1; }
+	if( x->offset > y->offset ) { return  1; }
+	return 0;
+
+} /* dwipe_range_compare */
+
+
+int dwipe_range_parse( const char* spec, loff_t device_size, int sector_size, dwipe_range_t* ranges )
+{
+/**
+ * Reads a list of extents and resolves it against a device.
+ *
+ * @parameter spec         The argument of the --range option.
+ * @parameter device_size  The size of the device.
+ * @parameter sector_size  The sector size of the device, which extents are widened to.
+ * @parameter ranges       Receives up to DWIPE_KNOB_RANGE_MAX extents, or NULL to only check the syntax.
+ * @return                 The number of extents, or -1 on a syntax error.
+ *
+ */
+
+	/* The working position in the list. */
+	const char* p = spec;
+
+	/* The offset and the length of the working extent. */
+	long long offset;
+	long long length;
+
+	/* The ends of the working extent. */
+	u64 start;
+	u64 end;
+
+	/* The number of extents. */
+	int count = 0;
+
+	/* Generic loop variables. */
+	int i;
+	int j;
+
+	if( sector_size <= 0 ) { sector_size = DWIPE_KNOB_RANGE_SECTOR; }
+
+	while( 1 )
+	{
+		if( dwipe_range_number( &p, &offset ) != 0 ) { return -1; }
+
+		/* A missing length reaches the end of the device. */
+		length = -1;
+
+		if( *p == ':' )
+		{
+			p++;
+			if( dwipe_range_number( &p, &length ) != 0 || length <= 0 ) { return -1; }
+		}
+
+		if( *p != ',' && *p != 0 ) { return -1; }
+
+		if( count == DWIPE_KNOB_RANGE_MAX ) { return -1; }
+
+		if( ranges != NULL )
+		{
+			/* A negative offset counts back from the end of the device. */
+			if( offset < 0 ) { start = ( -offset < device_size ) ? device_size + offset : 0; }
+			else             { start = ( offset < device_size ) ? offset : device_size; }
+
+			end = ( length < 0 || length > device_size - start ) ? device_size : start + length;
+
+			/* Widen the extent to whole sectors. */
+			start -= start % sector_size;
+			if( end % sector_size != 0 ) { end += sector_size - end % sector_size; }
+			if( end > device_size ) { end = device_size; }
+
+			ranges[count].offset = start;
+			ranges[count].length = ( end > start ) ? end - start : 0;
+		}
+
+		count += 1;
+
+		if( *p == 0 ) { break; }
+		p++;
+	}
+
+	if( ranges == NULL ) { return count; }
+
+	qsort( ranges, count, sizeof( dwipe_range_t ), dwipe_range_compare );
+
+	/* Merge the extents that overlap or touch, and drop the empty ones. */
+	for( i = 0, j = -1 ; i < count ; i++ )
+	{
+		if( ranges[i].length == 0 ) { continue; }
+
+		if( j >= 0 && ranges[i].offset <= ranges[j].offset + ranges[j].length )
+		{
+			end = ranges[i].offset + ranges[i].length;
+			if( end > ranges[j].offset + ranges[j].length ) { ranges[j].length = end - ranges[j].offset; }
+			continue;
+		}
+
+		ranges[++j] = ranges[i];
+	}
+
+	return j + 1;
+
+} /* dwipe_range_parse */
+
+
+int dwipe_range_resolve( dwipe_context_t* c )
+{
+/**
+ * Finds the extents of a device that every pass covers.  The probe calls
+ * this once the size of the device is known.
+ *
+ * @parameter  c              The device context.
+ * @modifies   c->ranges      The extents, or NULL for the whole device.
+ * @modifies   c->wipe_size   The bytes that one pass covers.
+ * @return                    0 on success, 1 when the device has nothing to wipe.
+ *
+ */
+
+	/* The extents before they are trimmed to their number. */
+	dwipe_range_t ranges [DWIPE_KNOB_RANGE_MAX];
+
+	/* Generic loop variable. */
+	int i;
+
+	c->ranges      = NULL;
+	c->range_count = 0;
+	c->wipe_size   = c->device_size;
+
+	if( dwipe_options.range == NULL ) { return 0; }
+
+	c->range_count = dwipe_range_parse( dwipe_options.range, c->device_size, c->sector_size, ranges );
+
+	if( c->range_count <= 0 )
+	{
+		c->range_count = 0;
+		c->wipe_size   = 0;
+		dwipe_log( DWIPE_LOG_ERROR, "Device '%s' has no bytes in the ranges '%s'.", c->device_name, dwipe_options.range );
+		return 1;
+	}
+
+	c->ranges = malloc( c->range_count * sizeof( dwipe_range_t ) );
+
+	if( c->ranges == NULL )
+	{
+		dwipe_perror( errno, __FUNCTION__, "malloc" );
+		c->range_count = 0;
+		return 1;
+	}
+
+	memcpy( c->ranges, ranges, c->range_count * sizeof( dwipe_range_t ) );
+
+	for( c->wipe_size = 0, i = 0 ; i < c->range_count ; i++ ) { c->wipe_size += c->ranges[i].length; }
+
+	dwipe_log( DWIPE_LOG_NOTICE, "Device '%s' will be wiped in %i ranges of %llu bytes.", \
+	  c->device_name, c->range_count, c->wipe_size );
+
+	return 0;
+
+} /* dwipe_range_resolve */
+
+
+u64 dwipe_range_map( dwipe_context_t* c, u64 position, size_t* blocksize )
+{
+/**
+ * Places a block of a pass on the device, and shortens a block that would
+ * run past the end of its extent.
+ *
+ * @parameter position   The offset of the block in the pass.
+ * @parameter blocksize  The size of the block, which may be reduced.
+ * @return               The offset of the block on the device.
+ *
+ */
+
+	/* Generic loop variable. */
+	int i;
+
+	if( c->ranges == NULL ) { return position; }
+
+	for( i = 0 ; i < c->range_count ; i++ )
+	{
+		if( position < c->ranges[i].length )
+		{
+			if( *blocksize > c->ranges[i].length - position ) { *blocksize = c->ranges[i].length - position; }
+			return c->ranges[i].offset + position;
+		}
+
+		position -= c->ranges[i].length;
+	}
+
+	/* This is past the last extent, which no pass asks for. */
+	*blocksize = 0;
+	return c->device_size;
+
+} /* dwipe_range_map */
+
+
+int dwipe_range_format( dwipe_context_t* c, char* buffer, size_t size )
+{
+/**
+ * Writes the extents of a device as a list that --range would accept.
+ *
+ * @return  0 on success, -1 when the list does not fit the buffer.
+ *
+ */
+
+	/* The length of the list so far. */
+	size_t n = 0;
+
+	/* Generic loop variable. */
+	int i;
+
+	if( size > 0 ) { buffer[0] = 0; }
+
+	if( c->ranges == NULL ) { return 0; }
+
+	for( i = 0 ; i < c->range_count ; i++ )
+	{
+		n += snprintf( buffer + n, size - n, "%s%llu:%llu", i > 0 ? "," : "", c->ranges[i].offset, c->ranges[i].length );
+		if( n >= size ) { return -1; }
+	}
+
+	return 0;
+
+} /* dwipe_range_format */
+
+/* eof */
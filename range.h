@@ -0,0 +1,43 @@
+/*
+ *  range.h: Wipes that are restricted to parts of a device.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef RANGE_H_
+#define RANGE_H_
+
+/* The most ranges that the --range option may list. */
+#define DWIPE_KNOB_RANGE_MAX     64
+
+/* The size of the sectors that an 's' suffix counts. */
+#define DWIPE_KNOB_RANGE_SECTOR  512
+
+/* One extent of a device that every pass covers. */
+struct dwipe_range_t_
+{
+	u64 offset;  /* The first byte of the extent.  */
+	u64 length;  /* The bytes in the extent.       */
+};
+
+int dwipe_range_parse( const char* spec, loff_t device_size, int sector_size, dwipe_range_t* ranges );  /* Read a list. */
+int dwipe_range_resolve( dwipe_context_t* c );                           /* Find the extents of a device.  */
+u64 dwipe_range_map( dwipe_context_t* c, u64 position, size_t* blocksize );  /* Place a block of a pass.   */
+int dwipe_range_format( dwipe_context_t* c, char* buffer, size_t size ); /* Describe the extents.          */
+
+#endif /* RANGE_H_ */
+
+/* eof */
@@ -0,0 +1,203 @@
+/*
+ *  result.c: The per-device result files that the rc scripts read.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#include "dwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "logging.h"
+#include "progress.h"
+#include "peer.h"
+#include "range.h"
+#include "badsector.h"
+#include "durability.h"
+#include "result.h"
+
+
+static void dwipe_result_latency( FILE* f, const char* name, const dwipe_latency_t* h )
+{
+/**
+ * Writes the summary and the non-empty buckets of a latency histogram, in
+ * microseconds.  A bucket is written as its upper bound and its count.
+ *
+ */
+
+	/* Generic loop variable. */
+	int i;
+
+	fprintf( f, "DWIPE_%s_LATENCY='count=%llu mean=%llu p50=%llu p99=%llu max=%llu'\n", name, h->count,
+	  h->count ? h->ns / h->count / 1000 : 0, dwipe_latency_quantile( h, 0.50 ) / 1000,
+	  dwipe_latency_quantile( h, 0.99 ) / 1000, h->max_ns / 1000 );
+
+	fprintf( f, "DWIPE_%s_HISTOGRAM='", name );
+
+	for( i = 0 ; i < DWIPE_KNOB_LATENCY_BUCKETS ; i++ )
+	{
+		if( h->bucket[i] == 0 ) { continue; }
+
+		if( i == DWIPE_KNOB_LATENCY_BUCKETS - 1 ) { fprintf( f, "inf:%llu ", h->bucket[i] ); }
+		else                                      { fprintf( f, "%llu:%llu ", dwipe_latency_bound( i ) / 1000, h->bucket[i] ); }
+	}
+
+	fprintf( f, "'\n" );
+
+} /* dwipe_result_latency */
+
+
+int dwipe_result_write( dwipe_context_t* c )
+{
+/**
+ * Writes '<device>.result' for a device whose wipe has finished.
+ *
+ * @parameter c  The device context.
+ * @return       0 on success, -1 if the file could not be written.
+ *
+ */
+
+	/* Used to write-out the result file. */
+	char dwipe_result_file [FILENAME_MAX];
+	FILE* dwipe_result_fp;
+
+	/* The last counters that the child published. */
+	dwipe_progress_t s;
+
+	/* The nanoseconds that the device spent writing and flushing. */
+	u64 busy;
+
+	/* The extents that were wiped, as offset:length pairs. */
+	char ranges [DWIPE_KNOB_RANGE_MAX * 48];
+
+	/* Generic loop variable. */
+	u64 i;
+
+	if( c->result < 0 )
+	{
+		dwipe_log( DWIPE_LOG_NOTICE, "Wipe of device '%s' failed.", c->device_name );
+	}
+
+	if( c->result == 0 )
+	{
+		dwipe_log( DWIPE_LOG_NOTICE, "Wipe of device '%s' succeeded.", c->device_name );
+	}
+
+	if( c->result > 0 )
+	{
+		dwipe_log( DWIPE_LOG_NOTICE, "Wipe of device '%s' incomplete.", c->device_name );
+	}
+
+	snprintf( dwipe_result_file, sizeof(dwipe_result_file), "%s.result", c->device_name );
+	dwipe_result_fp = fopen( dwipe_result_file, "w" );
+
+	if( dwipe_result_fp == NULL )
+	{
+		dwipe_perror( errno, __FUNCTION__, "fopen" );
+		dwipe_log( DWIPE_LOG_ERROR, "Unable to write the result file '%s'.", dwipe_result_file );
+		return -1;
+	}
+
+	fprintf( dwipe_result_fp, "DWIPE_LABEL='%s'\n", c->label );
+
+	if( c->device_serial != NULL )
+	{
+		fprintf( dwipe_result_fp, "DWIPE_SERIAL='%s'\n", c->device_serial );
+	}
+
+	if( c->ranges != NULL && dwipe_range_format( c, ranges, sizeof( ranges ) ) == 0 )
+	{
+		/* Only these bytes of the device were wiped. */
+		fprintf( dwipe_result_fp, "DWIPE_RANGES='%s'\n", ranges );
+		fprintf( dwipe_result_fp, "DWIPE_RANGE_BYTES='%llu'\n", c->wipe_size );
+	}
+
+	fprintf( dwipe_result_fp, "DWIPE_METHOD='%s'\n", dwipe_method_label( dwipe_options.method) );
+	fprintf( dwipe_result_fp, "DWIPE_ROUNDS='%i'\n", dwipe_options.rounds );
+
+	if( dwipe_options.verify == DWIPE_VERIFY_NONE )
+	{
+		fprintf( dwipe_result_fp, "DWIPE_VERIFY='off'\n" );
+	}
+	if( dwipe_options.verify == DWIPE_VERIFY_ALL  )
+	{
+		fprintf( dwipe_result_fp, "DWIPE_VERIFY='all'\n" );
+	}
+	if( dwipe_options.verify == DWIPE_VERIFY_LAST )
+	{
+		fprintf( dwipe_result_fp, "DWIPE_VERIFY='last'\n" );
+	}
+
+	if( c->result == 0 )
+	{
+		fprintf( dwipe_result_fp, "DWIPE_RESULT='pass'\n" );
+	}
+
+	else
+	{
+		fprintf( dwipe_result_fp, "DWIPE_RESULT='fail'\n" );
+	}
+
+	/* The time that the wipe spent asleep under a rate limit rather than waiting on the device. */
+	fprintf( dwipe_result_fp, "DWIPE_THROTTLED='%llu'\n", c->throttle_ns / 1000000000 );
+
+	/* The block size of the passes, from the queue limits or from --autotune. */
+	fprintf( dwipe_result_fp, "DWIPE_IO_SIZE='%zu'\n", c->io_size );
+
+	/* The most memory that the i/o buffers of the wipe took. */
+	fprintf( dwipe_result_fp, "DWIPE_BUFFER_PEAK='%llu'\n", c->buffer_peak );
+
+	if( c->outlier )
+	{
+		/* The device lagged the other drives of its model. */
+		fprintf( dwipe_result_fp, "DWIPE_OUTLIER='%s'\n", dwipe_peer_name( c->outlier ) );
+	}
+
+	if( c->badsectors != NULL && c->badsectors->count > 0 )
+	{
+		/* The sectors that a tolerant pass skipped, in units of the device sector size. */
+		fprintf( dwipe_result_fp, "DWIPE_BAD_SECTORS='%llu'\n", c->badsectors->count );
+		fprintf( dwipe_result_fp, "DWIPE_SECTOR_SIZE='%i'\n", c->sector_size );
+		fprintf( dwipe_result_fp, "DWIPE_BAD_LBAS='" );
+
+		for( i = 0 ; i < c->badsectors->count && i < DWIPE_KNOB_BADSECTOR_LIST ; i++ )
+		{
+			fprintf( dwipe_result_fp, "%s%llu", i > 0 ? " " : "", c->badsectors->lba[i] );
+		}
+
+		fprintf( dwipe_result_fp, "'\n" );
+	}
+
+	/* The latency of every i/o, so that a drive that stalled can be told from a healthy one. */
+	dwipe_progress_snapshot( c->progress, &s );
+
+	/* What the sync policy cost: the time in flushes, and the rate at which the device took writes with them. */
+	busy = s.latency[ DWIPE_IO_WRITE ].ns + s.sync_ns;
+	fprintf( dwipe_result_fp, "DWIPE_SYNC='%s'\n", dwipe_durability_name( dwipe_options.sync ) );
+	fprintf( dwipe_result_fp, "DWIPE_SYNC_SECONDS='%llu.%03llu'\n", s.sync_ns / 1000000000, s.sync_ns / 1000000 % 1000 );
+	fprintf( dwipe_result_fp, "DWIPE_SYNC_COST='%llu%%'\n", busy > 0 ? s.sync_ns * 100 / busy : 0 );
+	fprintf( dwipe_result_fp, "DWIPE_WRITE_RATE='%llu'\n", busy > 0 ? (u64)( (double) s.bytes_written * 1000000000 / busy ) : 0 );
+
+	dwipe_result_latency( dwipe_result_fp, "WRITE", &s.latency[ DWIPE_IO_WRITE ] );
+	dwipe_result_latency( dwipe_result_fp, "READ",  &s.latency[ DWIPE_IO_READ  ] );
+
+	fclose( dwipe_result_fp );
+
+	return 0;
+
+} /* dwipe_result_write */
+
+/* eof */
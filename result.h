@@ -0,0 +1,27 @@
+/*
+ *  result.h: The per-device result files that the rc scripts read.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef RESULT_H_
+#define RESULT_H_
+
+int dwipe_result_write( dwipe_context_t* c );  /* Write the result file of a finished device. */
+
+#endif /* RESULT_H_ */
+
+/* eof */
@@ -0,0 +1,624 @@
+/*
+ *  schedule.c: Controller-aware scheduling of wipe processes.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+/* RATIONALE:
+ *
+ *   Forty drives behind one SAS expander share one link.  Starting them all at
+ *   once saturates the link and every drive crawls, so devices are grouped by
+ *   host adapter and bus and each group only admits as many wipes as the
+ *   --group-limit and --group-bandwidth options allow.  The rest wait in the
+ *   queue and are started by the parent as others finish.
+ *
+ *   When devices outnumber slots, the start order decides when the batch
+ *   finishes.  The --order lpt policy is Graham's longest-processing-time
+ *   list schedule: each queued device is costed as its round_size over the
+ *   throughput that its group is currently achieving, and the costliest
+ *   device is started in the next free slot so that no long wipe is left
+ *   for the tail of the batch.
+ *
+ */
+
+#include <signal.h>
+
+#include "dwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "schedule.h"
+#include "logging.h"
+#include "progress.h"
+#include "events.h"
+#include "journal.h"
+#include "arena.h"
+
+
+/* The array of host adapter and bus groups. */
+dwipe_group_t* dwipe_groups = NULL;
+
+/* The number of elements in dwipe_groups. */
+int dwipe_group_count = 0;
+
+/* The context indices in dispatch order. */
+static int* dwipe_schedule_order = NULL;
+
+/* The context array that is being sorted, for the qsort() comparator. */
+static dwipe_context_t* dwipe_schedule_sorting = NULL;
+
+
+static int dwipe_schedule_group( dwipe_context_t* c )
+{
+/**
+ * Finds or creates the group of a device.
+ *
+ * @parameter  c  The device context.
+ * @returns       The index of the group in dwipe_groups, or -1 on failure.
+ *
+ */
+
+	/* A generic loop variable. */
+	int i;
+
+	/* The new group array. */
+	dwipe_group_t* g;
+
+	/* Devices without a SCSI address do not share a link that we know about. */
+	if( c->device_host >= 0 )
+	{
+		for( i = 0 ; i < dwipe_group_count ; i++ )
+		{
+			if( dwipe_groups[i].host == c->device_host && dwipe_groups[i].bus == c->device_bus )
+			{
+				return i;
+			}
+		}
+	}
+
+	/* Allocate another group. */
+	g = realloc( dwipe_groups, ( dwipe_group_count + 1 ) * sizeof( dwipe_group_t ) );
+
+	if( g == NULL )
+	{
+		dwipe_perror( errno, __FUNCTION__, "realloc" );
+		dwipe_log( DWIPE_LOG_FATAL, "Unable to allocate the scheduler group array." );
+		return -1;
+	}
+
+	dwipe_groups = g;
+
+	memset( &dwipe_groups[ dwipe_group_count ], 0, sizeof( dwipe_group_t ) );
+	dwipe_groups[ dwipe_group_count ].host = c->device_host;
+	dwipe_groups[ dwipe_group_count ].bus  = c->device_bus;
+
+	return dwipe_group_count++;
+
+} /* dwipe_schedule_group */
+
+
+int dwipe_schedule_add( dwipe_context_t* c )
+{
+/**
+ * Puts one selected device into its group and into the queue.
+ *
+ * @parameter  c         The device context.
+ * @modifies   c->group  The group index of the device.
+ * @modifies   c->state  The device is queued.
+ * @returns              Zero on success, -1 on failure.
+ *
+ */
+
+	/* The number of passes in one round of the selected method. */
+	int passes = dwipe_method_passes( dwipe_options.method );
+
+	c->group = dwipe_schedule_group( c );
+
+	if( c->group < 0 ) { return -1; }
+
+	c->state = DWIPE_STATE_QUEUED;
+
+	/* Estimate the work now; the child sets the same value when it starts. */
+	c->round_size = dwipe_method_round_size( passes, c->wipe_size );
+
+	dwipe_events_state( c, "queued" );
+
+	return 0;
+
+} /* dwipe_schedule_add */
+
+
+int dwipe_schedule_init( int count, dwipe_context_t* c )
+{
+/**
+ * Puts every selected device into its group and into the queue.
+ *
+ * @parameter  count       The number of contexts in the array.
+ * @parameter  c           An array of device contexts.
+ * @modifies   c[].group   The group index of each device.
+ * @modifies   c[].state   Selected devices are queued.
+ * @returns                Zero on success, -1 on failure.
+ *
+ */
+
+	/* A generic loop variable. */
+	int i;
+
+	/* Allocate the dispatch order. */
+	dwipe_schedule_order = malloc( count * sizeof( int ) );
+
+	if( dwipe_schedule_order == NULL )
+	{
+		dwipe_perror( errno, __FUNCTION__, "malloc" );
+		dwipe_log( DWIPE_LOG_FATAL, "Unable to allocate the scheduler queue." );
+		return -1;
+	}
+
+	for( i = 0 ; i < count ; i++ )
+	{
+		dwipe_schedule_order[i] = i;
+
+		/* Empty station slots belong to no group. */
+		c[i].group = -1;
+
+		if( c[i].select == DWIPE_SELECT_TRUE )
+		{
+			if( dwipe_schedule_add( &c[i] ) != 0 ) { return -1; }
+		}
+	}
+
+	for( i = 0 ; i < dwipe_group_count ; i++ )
+	{
+		if( dwipe_groups[i].host < 0 )
+		{
+			dwipe_log( DWIPE_LOG_INFO, "Scheduler group %i is a device without a SCSI address.", i );
+		}
+
+		else
+		{
+			dwipe_log( DWIPE_LOG_INFO, "Scheduler group %i is host %i bus %i.", i, dwipe_groups[i].host, dwipe_groups[i].bus );
+		}
+	}
+
+	return 0;
+
+} /* dwipe_schedule_init */
+
+
+static int dwipe_schedule_admit( dwipe_group_t* g )
+{
+/**
+ * Decides whether a group can take one more running wipe.
+ *
+ */
+
+	/* The concurrency cap. */
+	if( dwipe_options.group_limit > 0 && g->active >= dwipe_options.group_limit )
+	{
+		return 0;
+	}
+
+	/* The bandwidth cap needs at least one running wipe to measure. */
+	if( dwipe_options.group_bandwidth > 0 && g->active > 0 )
+	{
+		/* Wait until every running wipe in the group has a throughput sample. */
+		if( g->unmeasured > 0 ) { return 0; }
+
+		/* Admit another wipe only if the average wipe still fits under the cap. */
+		if( g->throughput + g->throughput / g->active > dwipe_options.group_bandwidth )
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+
+} /* dwipe_schedule_admit */
+
+
+static int dwipe_schedule_start( dwipe_context_t* c )
+{
+/**
+ * Forks a child process that wipes one device.
+ *
+ */
+
+	/* The fork() result holder. */
+	pid_t pid;
+
+	/* The result of the wipe method in the child. */
+	int r;
+
+	if( dwipe_journal_attach( c ) != 0 )
+	{
+		/* The wipe still runs, but it cannot be resumed. */
+		dwipe_log( DWIPE_LOG_WARNING, "The wipe of '%s' is not journaled.", c->device_name );
+	}
+
+	pid = fork();
+
+	if( pid < 0 )
+	{
+		dwipe_perror( errno, __FUNCTION__, "fork" );
+		dwipe_log( DWIPE_LOG_ERROR, "Unable to start the wipe of '%s'.", c->device_name );
+		return -1;
+	}
+
+	if( pid == 0 )
+	{
+		/* The supervisor takes signals through a signalfd, but the child must die on them. */
+		sigset_t signals;
+		sigemptyset( &signals );
+		sigprocmask( SIG_SETMASK, &signals, NULL );
+
+		/* Do not run the ncurses handlers, which would reset the parent's terminal. */
+		signal( SIGINT,  SIG_DFL );
+		signal( SIGTERM, SIG_DFL );
+
+		/* The child logs through its ring, so that it never waits on the log file. */
+		dwipe_log_attach( c );
+
+		/* The child invokes the wipe method, releases its buffers and exits. */
+		r = dwipe_options.method( c );
+		dwipe_arena_free( c );
+		dwipe_log_flush();
+		exit( r );
+	}
+
+	/* The parent puts the child process number in its context. */
+	c->pid   = pid;
+	c->state = DWIPE_STATE_RUNNING;
+
+	dwipe_log( DWIPE_LOG_NOTICE, "Started the wipe of '%s' in scheduler group %i.", c->device_name, c->group );
+
+	dwipe_events_state( c, "started" );
+
+	return 0;
+
+} /* dwipe_schedule_start */
+
+
+static int dwipe_schedule_demoted( dwipe_context_t* c )
+{
+/**
+ * Returns non-zero if a running wipe was demoted as an outlier.  A demoted
+ * drive only gets the bandwidth that the others leave, so it holds no slot.
+ *
+ */
+
+	return c->state == DWIPE_STATE_RUNNING && c->outlier && dwipe_options.outlier_action == DWIPE_OUTLIER_DEPRIORITIZE;
+
+} /* dwipe_schedule_demoted */
+
+
+static void dwipe_schedule_count( int count, dwipe_context_t* c )
+{
+/**
+ * Recounts the state of every group from the contexts.
+ *
+ */
+
+	/* A generic loop variable. */
+	int i;
+
+	/* The group of the working device. */
+	dwipe_group_t* g;
+
+	/* The combined measured throughput of all running wipes. */
+	u64 throughput = 0;
+
+	/* The number of running wipes that have been measured. */
+	int measured = 0;
+
+	for( i = 0 ; i < dwipe_group_count ; i++ )
+	{
+		dwipe_groups[i].active     = 0;
+		dwipe_groups[i].queued     = 0;
+		dwipe_groups[i].throughput = 0;
+		dwipe_groups[i].unmeasured = 0;
+	}
+
+	for( i = 0 ; i < count ; i++ )
+	{
+		if( c[i].group < 0 ) { continue; }
+
+		g = &dwipe_groups[ c[i].group ];
+
+		if( dwipe_schedule_demoted( &c[i] ) ) { continue; }
+
+		if( c[i].state == DWIPE_STATE_RUNNING )
+		{
+			g->active     += 1;
+			g->throughput += c[i].throughput;
+
+			if( c[i].throughput == 0 ) { g->unmeasured += 1; }
+
+			else
+			{
+				throughput += c[i].throughput;
+				measured   += 1;
+			}
+		}
+
+		if( c[i].state == DWIPE_STATE_QUEUED )
+		{
+			g->queued += 1;
+		}
+	}
+
+	for( i = 0 ; i < dwipe_group_count ; i++ )
+	{
+		g = &dwipe_groups[i];
+
+		if( g->active > g->unmeasured )
+		{
+			/* The group has measured wipes, so expect the same again. */
+			g->rate = g->throughput / ( g->active - g->unmeasured );
+		}
+
+		else if( measured > 0 )
+		{
+			/* Borrow the station average. */
+			g->rate = throughput / measured;
+		}
+
+		else
+		{
+			g->rate = dwipe_options.expected_throughput;
+		}
+
+		if( g->rate == 0 ) { g->rate = 1; }
+	}
+
+} /* dwipe_schedule_count */
+
+
+static int dwipe_schedule_compare( const void* a, const void* b )
+{
+/**
+ * Orders context indices so that the device to start first comes first.
+ *
+ */
+
+	/* The two contexts. */
+	dwipe_context_t* x = &dwipe_schedule_sorting[ *(const int*)a ];
+	dwipe_context_t* y = &dwipe_schedule_sorting[ *(const int*)b ];
+
+	/* The sort keys. */
+	double kx = 0;
+	double ky = 0;
+
+	switch( dwipe_options.order )
+	{
+		case DWIPE_ORDER_LONGEST:
+			kx = x->round_size;
+			ky = y->round_size;
+			break;
+
+		case DWIPE_ORDER_LPT:
+			if( x->group >= 0 ) { kx = (double)x->round_size / dwipe_groups[ x->group ].rate; }
+			if( y->group >= 0 ) { ky = (double)y->round_size / dwipe_groups[ y->group ].rate; }
+			break;
+
+		case DWIPE_ORDER_FIFO:
+			break;
+	}
+
+	/* Largest first. */
+	if( kx > ky ) { return -1; }
+	if( kx < ky ) { return  1; }
+
+	/* Keep the enumeration order between equals. */
+	return *(const int*)a - *(const int*)b;
+
+} /* dwipe_schedule_compare */
+
+
+int dwipe_schedule_dispatch( int count, dwipe_context_t* c )
+{
+/**
+ * Starts queued devices while their groups admit them.
+ *
+ * @parameter  count  The number of contexts in the array.
+ * @parameter  c      An array of device contexts.
+ * @returns           The number of wipes that were started.
+ *
+ */
+
+	/* Generic loop variables. */
+	int i;
+	int j;
+
+	/* The number of wipes that were started. */
+	int started = 0;
+
+	/* The group of the working device. */
+	dwipe_group_t* g;
+
+	dwipe_schedule_count( count, c );
+
+	/* The costs change as groups are measured, so sort every time. */
+	dwipe_schedule_sorting = c;
+	qsort( dwipe_schedule_order, count, sizeof( int ), dwipe_schedule_compare );
+
+	for( j = 0 ; j < count ; j++ )
+	{
+		i = dwipe_schedule_order[j];
+
+		if( c[i].state != DWIPE_STATE_QUEUED ) { continue; }
+
+		g = &dwipe_groups[ c[i].group ];
+
+		if( ! dwipe_schedule_admit( g ) ) { continue; }
+
+		if( dwipe_schedule_start( &c[i] ) == 0 )
+		{
+			g->active += 1;
+			g->queued -= 1;
+			started   += 1;
+
+			/* The new wipe has no throughput sample yet. */
+			g->unmeasured += 1;
+		}
+
+		else
+		{
+			/* Treat a failed fork like a failed wipe. */
+			c[i].state  = DWIPE_STATE_DONE;
+			c[i].result = -1;
+		}
+	}
+
+	return started;
+
+} /* dwipe_schedule_dispatch */
+
+
+u64 dwipe_schedule_eta( int count, dwipe_context_t* c )
+{
+/**
+ * Estimates the number of seconds until the whole batch is finished by
+ * replaying the dispatch order into the free slots of each group.
+ *
+ * @parameter  count  The number of contexts in the array.
+ * @parameter  c      An array of device contexts.
+ * @returns           The estimated runtime remaining, in seconds.
+ *
+ */
+
+	/* Generic loop variables. */
+	int i;
+	int j;
+	int k;
+
+	/* The group of the working device. */
+	dwipe_group_t* g;
+
+	/* The time at which each slot of a group becomes free. */
+	u64* slot;
+
+	/* The number of slots in the working group. */
+	int slots;
+
+	/* The remaining time of a running wipe. */
+	u64 t;
+
+	/* The index of the slot that becomes free first. */
+	int first;
+	int m;
+
+	/* The result. */
+	u64 eta = 0;
+
+	if( dwipe_schedule_order == NULL ) { return 0; }
+
+	slot = malloc( count * sizeof( u64 ) );
+
+	if( slot == NULL ) { return 0; }
+
+	dwipe_schedule_count( count, c );
+
+	for( k = 0 ; k < dwipe_group_count ; k++ )
+	{
+		g = &dwipe_groups[k];
+		slots = 0;
+
+		/* Running wipes hold their slots until their own estimates run out. */
+		for( i = 0 ; i < count ; i++ )
+		{
+			if( c[i].group != k || c[i].state != DWIPE_STATE_RUNNING ) { continue; }
+
+			t = ( c[i].eta > 0 ) ? c[i].eta : ( c[i].round_size - c[i].round_done ) / g->rate;
+
+			/* As in dispatch, a demoted wipe holds no slot, but the batch still waits for it. */
+			if( dwipe_schedule_demoted( &c[i] ) )
+			{
+				if( t > eta ) { eta = t; }
+				continue;
+			}
+
+			slot[ slots++ ] = t;
+		}
+
+		if( g->queued > 0 )
+		{
+			/* The number of wipes that the group will run side by side. */
+			int width = g->active + g->queued;
+
+			if( dwipe_options.group_bandwidth > 0 ) { width = g->active > 0 ? g->active : 1; }
+			if( dwipe_options.group_limit > 0 && width > dwipe_options.group_limit ) { width = dwipe_options.group_limit; }
+
+			while( slots < width && slots < count ) { slot[ slots++ ] = 0; }
+
+			for( j = 0 ; j < count ; j++ )
+			{
+				i = dwipe_schedule_order[j];
+
+				if( c[i].group != k || c[i].state != DWIPE_STATE_QUEUED ) { continue; }
+
+				/* Put the device into the slot that becomes free first. */
+				for( first = 0, m = 1 ; m < slots ; m++ )
+				{
+					if( slot[m] < slot[first] ) { first = m; }
+				}
+
+				slot[first] += c[i].round_size / g->rate;
+
+				/* Remember the estimate for the status window. */
+				c[i].eta = c[i].round_size / g->rate;
+			}
+		}
+
+		for( i = 0 ; i < slots ; i++ )
+		{
+			if( slot[i] > eta ) { eta = slot[i]; }
+		}
+	}
+
+	free( slot );
+
+	return eta;
+
+} /* dwipe_schedule_eta */
+
+
+int dwipe_schedule_pending( int count, dwipe_context_t* c )
+{
+/**
+ * Counts the devices that are queued or running.
+ *
+ */
+
+	/* A generic loop variable. */
+	int i;
+
+	/* The result. */
+	int pending = 0;
+
+	for( i = 0 ; i < count ; i++ )
+	{
+		if( c[i].state == DWIPE_STATE_QUEUED || c[i].state == DWIPE_STATE_RUNNING )
+		{
+			pending += 1;
+		}
+	}
+
+	return pending;
+
+} /* dwipe_schedule_pending */
+
+/* eof */
@@ -0,0 +1,46 @@
+/*
+ *  schedule.h: Controller-aware scheduling of wipe processes.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef SCHEDULE_H_
+#define SCHEDULE_H_
+
+/* The devices that share one host adapter and bus, and therefore one link. */
+typedef struct /* dwipe_group_t */
+{
+	int host;        /* The host number, or -1 for a device without a SCSI address. */
+	int bus;         /* The bus (channel) number.                                    */
+	int active;      /* The number of running wipes, as of the last dispatch.        */
+	int queued;      /* The number of queued wipes, as of the last dispatch.         */
+	int unmeasured;  /* The number of running wipes without a throughput sample.     */
+	u64 throughput;  /* The combined throughput of the running wipes.                */
+	u64 rate;        /* The expected throughput of one wipe in this group.           */
+} dwipe_group_t;
+
+extern dwipe_group_t* dwipe_groups;
+extern int            dwipe_group_count;
+
+int  dwipe_schedule_init( int count, dwipe_context_t* c );      /* Group and queue the selected devices. */
+int  dwipe_schedule_add( dwipe_context_t* c );                  /* Group and queue one more device.      */
+int  dwipe_schedule_dispatch( int count, dwipe_context_t* c );  /* Start queued devices that fit.        */
+int  dwipe_schedule_pending( int count, dwipe_context_t* c );   /* Count queued and running devices.     */
+u64  dwipe_schedule_eta( int count, dwipe_context_t* c );       /* Estimate the runtime of the batch.    */
+
+#endif /* SCHEDULE_H_ */
+
+/* eof */
@@ -0,0 +1,486 @@
+/*
+ *  station.c: Hotplug-driven continuous wiping.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+/* RATIONALE:
+ *
+ *   In station mode the context array has spare slots, and the supervisor
+ *   keeps running after the last wipe.  The kernel announces every block
+ *   device on a NETLINK_KOBJECT_UEVENT socket, which the supervisor watches
+ *   along with its children.
+ *
+ *   A whole disk that is added is probed on a thread of its own, because
+ *   the drive may still be spinning up.  The thread hands the probed context
+ *   back through a pipe, and the supervisor copies it into an empty slot,
+ *   or the slot of a drive whose result has already been written, and
+ *   queues it for the scheduler like any other device.
+ *
+ *   A disk that is removed while it is queued or wiping is marked failed
+ *   and its child is killed.  Nothing else is touched.
+ *
+ *   Virtual devices (loop, device-mapper, md, ram) are never wiped here:
+ *   they appear and change when the system is configured, not when a
+ *   technician plugs a drive in.
+ *
+ */
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+#include "dwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "device.h"
+#include "logging.h"
+#include "progress.h"
+#include "schedule.h"
+#include "throttle.h"
+#include "supervise.h"
+#include "station.h"
+#include "badsector.h"
+#include "eta.h"
+
+/* A device that a thread is probing. */
+typedef struct /* dwipe_station_probe_t */
+{
+	dwipe_context_t c;       /* The private context that is probed.  */
+	int             errors;  /* The result of dwipe_device_probe().  */
+} dwipe_station_probe_t;
+
+/* The array of contexts that hot-plugged devices are put into. */
+static dwipe_context_t* dwipe_station_c;
+static int dwipe_station_count;
+
+/* The entropy source for new contexts. */
+static int dwipe_station_entropy;
+
+/* Probe threads write finished probes into this pipe. */
+static int dwipe_station_pipe [2];
+
+
+
+static void* dwipe_station_probe( void* arg )
+{
+/**
+ * Probes one hot-plugged device and hands it to the supervisor.
+ *
+ */
+
+	dwipe_station_probe_t* p = arg;
+
+	p->errors = dwipe_device_probe( &p->c );
+
+	/* A pointer is much smaller than PIPE_BUF, so the write is atomic. */
+	if( write( dwipe_station_pipe[1], &p, sizeof( p ) ) != sizeof( p ) )
+	{
+		dwipe_perror( errno, __FUNCTION__, "write" );
+	}
+
+	return NULL;
+
+} /* dwipe_station_probe */
+
+
+
+static void dwipe_station_discard( dwipe_station_probe_t* p )
+{
+/**
+ * Releases a probed device that will not be wiped.
+ *
+ */
+
+	if( p->c.device_fd >= 0 ) { close( p->c.device_fd ); }
+
+	free( p->c.device_name );
+	free( p->c.device_serial );
+	free( p->c.ranges );
+	free( p->c.label );
+	free( p );
+
+} /* dwipe_station_discard */
+
+
+
+static void dwipe_station_add( const char* name )
+{
+/**
+ * Starts probing a whole disk that has just appeared.
+ *
+ */
+
+	/* The probe job. */
+	dwipe_station_probe_t* p;
+
+	/* The probe thread. */
+	pthread_t thread;
+	pthread_attr_t attr;
+
+	/* Generic loop variable. */
+	int i;
+
+	if( dwipe_options.exclude && strcmp( name, dwipe_options.exclude ) == 0 )
+	{
+		dwipe_log( DWIPE_LOG_INFO, "Device '%s' is excluded.", name );
+		return;
+	}
+
+	for( i = 0 ; i < dwipe_station_count ; i++ )
+	{
+		if( ( dwipe_station_c[i].state == DWIPE_STATE_QUEUED || dwipe_station_c[i].state == DWIPE_STATE_RUNNING )
+		    && strcmp( dwipe_station_c[i].device_name, name ) == 0 )
+		{
+			/* We are already wiping it. */
+			return;
+		}
+	}
+
+	p = calloc( 1, sizeof( dwipe_station_probe_t ) );
+
+	if( p == NULL )
+	{
+		dwipe_perror( errno, __FUNCTION__, "calloc" );
+		return;
+	}
+
+	p->c.device_name      = strdup( name );
+	p->c.device_fd        = -1;
+	p->c.entropy_fd       = dwipe_station_entropy;
+	p->c.prng             = dwipe_options.prng;
+	p->c.select           = DWIPE_SELECT_PROBING;
+
+	pthread_attr_init( &attr );
+	pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+
+	if( p->c.device_name == NULL || pthread_create( &thread, &attr, dwipe_station_probe, p ) != 0 )
+	{
+		dwipe_log( DWIPE_LOG_ERROR, "Unable to probe the new device '%s'.", name );
+		free( p->c.device_name );
+		free( p );
+	}
+
+	else
+	{
+		dwipe_log( DWIPE_LOG_NOTICE, "Device '%s' was plugged in.", name );
+	}
+
+	pthread_attr_destroy( &attr );
+
+} /* dwipe_station_add */
+
+
+
+static void dwipe_station_remove( const char* name )
+{
+/**
+ * Fails the wipe of a whole disk that has been pulled out.
+ *
+ */
+
+	/* Generic loop variable. */
+	int i;
+
+	for( i = 0 ; i < dwipe_station_count ; i++ )
+	{
+		dwipe_context_t* c = &dwipe_station_c[i];
+
+		if( c->state != DWIPE_STATE_QUEUED && c->state != DWIPE_STATE_RUNNING ) { continue; }
+		if( strcmp( c->device_name, name ) != 0 ) { continue; }
+
+		dwipe_log( DWIPE_LOG_WARNING, "Device '%s' was removed before its wipe finished.", name );
+
+		c->removed = 1;
+
+		if( c->state == DWIPE_STATE_QUEUED )
+		{
+			c->state  = DWIPE_STATE_DONE;
+			c->result = -1;
+		}
+
+		else
+		{
+			/* The child may be stuck on the dead device, so do not ask politely. */
+			kill( c->pid, SIGKILL );
+		}
+	}
+
+} /* dwipe_station_remove */
+
+
+
+static void dwipe_station_uevent( int fd, void* arg )
+{
+/**
+ * Reads kernel uevents and acts on whole disks that come and go.
+ *
+ * A uevent is a header like "add@/devices/..." followed by KEY=value
+ * strings, each terminated by a null.
+ *
+ */
+
+	/* The message buffer. */
+	char b [8192];
+
+	/* The sender. */
+	struct sockaddr_nl sa;
+	socklen_t sa_len;
+
+	/* The message length and the working string. */
+	ssize_t n;
+	char* s;
+
+	/* The fields that we care about. */
+	const char* action;
+	const char* subsystem;
+	const char* devtype;
+	const char* devname;
+	const char* devpath;
+
+	/* The device file name. */
+	char name [FILENAME_MAX];
+
+	while( 1 )
+	{
+		sa_len = sizeof( sa );
+		n = recvfrom( fd, b, sizeof( b ) - 1, MSG_DONTWAIT, (struct sockaddr*) &sa, &sa_len );
+
+		if( n < 0 )
+		{
+			if( errno == ENOBUFS )
+			{
+				/* The kernel dropped events; we may have missed a plug. */
+				dwipe_log( DWIPE_LOG_WARNING, "The uevent socket overflowed." );
+				continue;
+			}
+
+			if( errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR )
+			{
+				dwipe_perror( errno, __FUNCTION__, "recvfrom" );
+			}
+
+			return;
+		}
+
+		/* Only the kernel may tell us to wipe something. */
+		if( sa.nl_pid != 0 ) { continue; }
+
+		b[n] = 0;
+
+		action = subsystem = devtype = devname = devpath = NULL;
+
+		for( s = b + strlen( b ) + 1 ; s < b + n ; s += strlen( s ) + 1 )
+		{
+			     if( strncmp( s, "ACTION=",    7  ) == 0 ) { action    = s + 7;  }
+			else if( strncmp( s, "SUBSYSTEM=", 10 ) == 0 ) { subsystem = s + 10; }
+			else if( strncmp( s, "DEVTYPE=",   8  ) == 0 ) { devtype   = s + 8;  }
+			else if( strncmp( s, "DEVNAME=",   8  ) == 0 ) { devname   = s + 8;  }
+			else if( strncmp( s, "DEVPATH=",   8  ) == 0 ) { devpath   = s + 8;  }
+		}
+
+		if( action == NULL || subsystem == NULL || devtype == NULL || devname == NULL || devpath == NULL ) { continue; }
+
+		/* Only whole disks are wiped. */
+		if( strcmp( subsystem, "block" ) != 0 || strcmp( devtype, "disk" ) != 0 ) { continue; }
+
+		if( strstr( devpath, "/devices/virtual/" ) != NULL ) { continue; }
+
+		/* Some kernels send the name with its /dev/ prefix. */
+		if( strncmp( devname, DWIPE_KNOB_PARTITIONS_PREFIX, strlen( DWIPE_KNOB_PARTITIONS_PREFIX ) ) == 0 )
+		{
+			devname += strlen( DWIPE_KNOB_PARTITIONS_PREFIX );
+		}
+
+		snprintf( name, sizeof( name ), "%s%s", DWIPE_KNOB_PARTITIONS_PREFIX, devname );
+
+		if( strcmp( action, "add" ) == 0 )
+		{
+			dwipe_station_add( name );
+		}
+
+		else if( strcmp( action, "remove" ) == 0 )
+		{
+			dwipe_station_remove( name );
+		}
+	}
+
+} /* dwipe_station_uevent */
+
+
+
+static void dwipe_station_probed( int fd, void* arg )
+{
+/**
+ * Puts the devices that have finished probing into free slots.
+ *
+ */
+
+	/* The finished probe. */
+	dwipe_station_probe_t* p;
+
+	/* The progress slot, event ring, bad sector list, log ring and runtime model of the reused context. */
+	dwipe_progress_t*   progress;
+	dwipe_events_t*     events;
+	dwipe_badsectors_t* badsectors;
+	dwipe_logring_t*    logring;
+	dwipe_eta_t*        eta_model;
+
+	/* Generic loop variable. */
+	int i;
+
+	while( read( fd, &p, sizeof( p ) ) == sizeof( p ) )
+	{
+		if( p->errors > 0 || p->c.select == DWIPE_SELECT_DISABLED )
+		{
+			dwipe_log( DWIPE_LOG_ERROR, "Device '%s' failed its probe and will not be wiped.", p->c.device_name );
+			dwipe_station_discard( p );
+			continue;
+		}
+
+		/* Find a slot that is empty or whose result has been written. */
+		for( i = 0 ; i < dwipe_station_count ; i++ )
+		{
+			if( dwipe_station_c[i].state == DWIPE_STATE_REPORTED ) { break; }
+
+			/* Idle devices that a control client may start are not free. */
+			if( dwipe_station_c[i].state == DWIPE_STATE_NONE && dwipe_station_c[i].device_name == NULL ) { break; }
+		}
+
+		if( i == dwipe_station_count )
+		{
+			dwipe_log( DWIPE_LOG_ERROR, "No free slot for device '%s'.", p->c.device_name );
+			dwipe_station_discard( p );
+			continue;
+		}
+
+		/* Release what the previous occupant of the slot left behind. */
+		free( dwipe_station_c[i].device_name );
+		free( dwipe_station_c[i].device_serial );
+		free( dwipe_station_c[i].journal );
+		free( dwipe_station_c[i].ranges );
+		free( dwipe_station_c[i].label );
+
+		progress = dwipe_station_c[i].progress;
+		memset( progress, 0, sizeof( dwipe_progress_t ) );
+		events = dwipe_station_c[i].events;
+		badsectors = dwipe_station_c[i].badsectors;
+		memset( badsectors, 0, sizeof( dwipe_badsectors_t ) );
+		dwipe_log_reset( &dwipe_station_c[i] );
+		logring = dwipe_station_c[i].logring;
+		eta_model = dwipe_station_c[i].eta_model;
+		if( eta_model != NULL ) { dwipe_eta_reset( eta_model ); }
+
+		dwipe_station_c[i]          = p->c;
+		dwipe_station_c[i].progress = progress;
+		dwipe_station_c[i].events   = events;
+		dwipe_station_c[i].badsectors = badsectors;
+		dwipe_station_c[i].logring  = logring;
+		dwipe_station_c[i].eta_model = eta_model;
+		dwipe_station_c[i].select   = DWIPE_SELECT_TRUE;
+		free( p );
+
+		/* The slot was cleared, so give the new drive the default cap again. */
+		if( dwipe_options.rate_device > 0 ) { dwipe_throttle_set( &dwipe_station_c[i], dwipe_options.rate_device ); }
+
+		if( dwipe_schedule_add( &dwipe_station_c[i] ) != 0 )
+		{
+			dwipe_station_c[i].state  = DWIPE_STATE_DONE;
+			dwipe_station_c[i].result = -1;
+			continue;
+		}
+
+		dwipe_log( DWIPE_LOG_NOTICE, "Queued device '%s' in slot %i.", dwipe_station_c[i].device_name, i );
+	}
+
+} /* dwipe_station_probed */
+
+
+
+int dwipe_station_init( int count, dwipe_context_t* c, int entropy_fd )
+{
+/**
+ * Opens the uevent socket and asks the supervisor to watch it.
+ *
+ * @parameter count       The number of slots in the context array.
+ * @parameter c           The context array, whose empty slots have state DWIPE_STATE_NONE.
+ * @parameter entropy_fd  The entropy source for new devices.
+ * @return                0 on success, -1 on failure.
+ *
+ */
+
+	/* The uevent socket. */
+	int fd;
+
+	/* The socket address. */
+	struct sockaddr_nl sa;
+
+	/* The receive buffer size. */
+	int rcvbuf = DWIPE_KNOB_STATION_RCVBUF;
+
+	dwipe_station_c       = c;
+	dwipe_station_count   = count;
+	dwipe_station_entropy = entropy_fd;
+
+	fd = socket( AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT );
+
+	if( fd < 0 )
+	{
+		dwipe_perror( errno, __FUNCTION__, "socket" );
+		dwipe_log( DWIPE_LOG_FATAL, "Unable to listen for hotplug events." );
+		return -1;
+	}
+
+	setsockopt( fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof( rcvbuf ) );
+
+	memset( &sa, 0, sizeof( sa ) );
+	sa.nl_family = AF_NETLINK;
+	sa.nl_groups = 1;  /* The kernel's own broadcast, not udev's. */
+
+	if( bind( fd, (struct sockaddr*) &sa, sizeof( sa ) ) != 0 )
+	{
+		dwipe_perror( errno, __FUNCTION__, "bind" );
+		dwipe_log( DWIPE_LOG_FATAL, "Unable to listen for hotplug events." );
+		close( fd );
+		return -1;
+	}
+
+	if( pipe( dwipe_station_pipe ) != 0 )
+	{
+		dwipe_perror( errno, __FUNCTION__, "pipe" );
+		close( fd );
+		return -1;
+	}
+
+	/* The supervisor reads until the pipe would block. */
+	fcntl( dwipe_station_pipe[0], F_SETFL, O_NONBLOCK );
+
+	if( dwipe_supervise_watch( fd, dwipe_station_uevent, NULL ) != 0
+	    || dwipe_supervise_watch( dwipe_station_pipe[0], dwipe_station_probed, NULL ) != 0 )
+	{
+		return -1;
+	}
+
+	dwipe_log( DWIPE_LOG_NOTICE, "Station mode: listening for drives, %i slots.", count );
+
+	return 0;
+
+} /* dwipe_station_init */
+
+/* eof */
@@ -0,0 +1,30 @@
+/*
+ *  station.h: Hotplug-driven continuous wiping.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef STATION_H_
+#define STATION_H_
+
+/* The size of the uevent receive buffer, so that a burst of plugs is not lost. */
+#define DWIPE_KNOB_STATION_RCVBUF  ( 1024 * 1024 )
+
+int dwipe_station_init( int count, dwipe_context_t* c, int entropy_fd );  /* Listen for block uevents. */
+
+#endif /* STATION_H_ */
+
+/* eof */
@@ -0,0 +1,601 @@
+/*
+ *  supervise.c: The event loop that supervises wipe processes.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+/* RATIONALE:
+ *
+ *   The parent sleeps in epoll_wait() on one descriptor per wipe process
+ *   (a pidfd), a timerfd that paces the status refresh, a signalfd, and the
+ *   terminal.  A child exit wakes the parent at once and only that child is
+ *   reaped, so a failure is noticed immediately and its slot is handed to
+ *   the next queued device without walking every context.
+ *
+ *   Kernels older than 5.3 do not have pidfd_open(), so SIGCHLD on the
+ *   signalfd is used to find exited children instead.
+ *
+ */
+
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+
+#include "dwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "schedule.h"
+#include "supervise.h"
+#include "progress.h"
+#include "events.h"
+#include "metrics.h"
+#include "peer.h"
+#include "result.h"
+#include "gui.h"
+#include "logging.h"
+
+
+/* The kinds of descriptors in the epoll set, kept in the high word of the event data. */
+#define DWIPE_SUPERVISE_TIMER   1
+#define DWIPE_SUPERVISE_SIGNAL  2
+#define DWIPE_SUPERVISE_STDIN   3
+#define DWIPE_SUPERVISE_CHILD   4
+#define DWIPE_SUPERVISE_WATCH   5
+
+#define DWIPE_SUPERVISE_DATA( kind, index )  ( ( (uint64_t)( kind ) << 32 ) | (uint32_t)( index ) )
+
+
+/* A descriptor that another module asked us to watch. */
+typedef struct /* dwipe_supervise_watch_t */
+{
+	int           fd;       /* The watched descriptor.                */
+	dwipe_watch_t handler;  /* Called when the descriptor is readable. */
+	void*         arg;      /* Passed through to the handler.          */
+} dwipe_supervise_watch_t;
+
+static dwipe_supervise_watch_t dwipe_watches [DWIPE_KNOB_SUPERVISE_WATCHES];
+static int dwipe_watch_count = 0;
+
+/* The epoll descriptor, or -1 when the loop is not running. */
+static int dwipe_epoll = -1;
+
+/* Set when the user or the system has asked us to stop. */
+static int dwipe_supervise_stopping = 0;
+
+
+int dwipe_supervise_watch( int fd, dwipe_watch_t handler, void* arg )
+{
+/**
+ * Asks the supervisor to call 'handler' whenever 'fd' is readable.
+ *
+ * @returns  Zero on success, -1 on failure.
+ *
+ */
+
+	/* The epoll registration. */
+	struct epoll_event ev;
+
+	/* The index of a free watch. */
+	int k;
+
+	for( k = 0 ; k < dwipe_watch_count ; k++ )
+	{
+		if( dwipe_watches[k].fd < 0 ) { break; }
+	}
+
+	if( k >= DWIPE_KNOB_SUPERVISE_WATCHES )
+	{
+		dwipe_log( DWIPE_LOG_SANITY, "%s: Too many watched descriptors.", __FUNCTION__ );
+		return -1;
+	}
+
+	dwipe_watches[k].fd      = fd;
+	dwipe_watches[k].handler = handler;
+	dwipe_watches[k].arg     = arg;
+
+	if( dwipe_epoll >= 0 )
+	{
+		/* The loop is already running, so register the descriptor now. */
+		ev.events   = EPOLLIN;
+		ev.data.u64 = DWIPE_SUPERVISE_DATA( DWIPE_SUPERVISE_WATCH, k );
+
+		if( epoll_ctl( dwipe_epoll, EPOLL_CTL_ADD, fd, &ev ) != 0 )
+		{
+			dwipe_perror( errno, __FUNCTION__, "epoll_ctl" );
+			dwipe_watches[k].fd = -1;
+			return -1;
+		}
+	}
+
+	if( k == dwipe_watch_count ) { dwipe_watch_count += 1; }
+
+	return 0;
+
+} /* dwipe_supervise_watch */
+
+
+void dwipe_supervise_unwatch( int fd )
+{
+/**
+ * Stops watching a descriptor.  The caller still owns and closes it.
+ *
+ */
+
+	/* A generic loop variable. */
+	int k;
+
+	for( k = 0 ; k < dwipe_watch_count ; k++ )
+	{
+		if( dwipe_watches[k].fd != fd ) { continue; }
+
+		if( dwipe_epoll >= 0 ) { epoll_ctl( dwipe_epoll, EPOLL_CTL_DEL, fd, NULL ); }
+
+		dwipe_watches[k].fd = -1;
+	}
+
+} /* dwipe_supervise_unwatch */
+
+
+static int dwipe_supervise_pidfd( pid_t pid )
+{
+/**
+ * Opens a pidfd for a child process, or returns -1 if the kernel cannot.
+ *
+ */
+
+#ifdef __NR_pidfd_open
+	return syscall( __NR_pidfd_open, pid, 0 );
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+
+} /* dwipe_supervise_pidfd */
+
+
+static int dwipe_supervise_reap( dwipe_context_t* c )
+{
+/**
+ * Collects the exit status of one child without blocking.
+ *
+ * @returns  1 if the child was reaped, 0 if it is still running, -1 on error.
+ *
+ */
+
+	/* The waitpid() result. */
+	pid_t r;
+
+	r = waitpid( c->pid, &c->status, WNOHANG );
+
+	if( r < 0 )
+	{
+		dwipe_perror( errno, __FUNCTION__, "waitpid" );
+		return -1;
+	}
+
+	if( r == 0 ) { return 0; }
+
+	/* The child may have been killed in the middle of publishing, so close its write and take its last counters. */
+	dwipe_progress_settle( c );
+	dwipe_progress_sample( 1, c );
+
+	/* The child has been reaped. */
+	c->pid   = 0;
+	c->state = DWIPE_STATE_DONE;
+
+	if( WIFEXITED( c->status ) )
+	{
+		/* The child returned normally. */
+		c->result = WEXITSTATUS( c->status );
+	}
+
+	else
+	{
+		/* The child was killed.  Remember the signal. */
+		c->result = r;
+		c->signal = WIFSIGNALED( c->status ) ? WTERMSIG( c->status ) : 0;
+	}
+
+	if( c->removed )
+	{
+		/* Whatever the child managed, the drive left before it was finished. */
+		c->result = -1;
+	}
+
+	/* The last messages of the child come before the news of its end. */
+	dwipe_log_drain( 1, c );
+
+	dwipe_log( DWIPE_LOG_INFO, "Reaped the wipe of '%s' with status %i.", c->device_name, c->status );
+
+	return 1;
+
+} /* dwipe_supervise_reap */
+
+
+void dwipe_supervise_cancel( int count, dwipe_context_t* c, int sig )
+{
+/**
+ * Stops the batch: queued devices are dropped and running ones are signalled.
+ *
+ */
+
+	/* A generic loop variable. */
+	int i;
+
+	dwipe_log( DWIPE_LOG_WARNING, "Cancelling the wipe on signal %i.", sig );
+
+	dwipe_supervise_stopping = 1;
+
+	for( i = 0 ; i < count ; i++ )
+	{
+		if( c[i].state == DWIPE_STATE_QUEUED )
+		{
+			c[i].state  = DWIPE_STATE_DONE;
+			c[i].result = -1;
+			c[i].signal = sig;
+		}
+
+		if( c[i].state == DWIPE_STATE_RUNNING )
+		{
+			kill( c[i].pid, SIGTERM );
+
+			/* A stopped child only dies once it runs again. */
+			if( c[i].paused ) { kill( c[i].pid, SIGCONT ); c[i].paused = 0; }
+		}
+	}
+
+} /* dwipe_supervise_cancel */
+
+
+static void dwipe_supervise_report( int count, dwipe_context_t* c )
+{
+/**
+ * Writes the result file of every device that has just finished, and lets
+ * go of the device so that it can be unplugged.
+ *
+ */
+
+	/* A generic loop variable. */
+	int i;
+
+	/* The last events of a child come before the news of its end. */
+	dwipe_events_drain( count, c );
+	dwipe_log_drain( count, c );
+
+	for( i = 0 ; i < count ; i++ )
+	{
+		if( c[i].state != DWIPE_STATE_DONE ) { continue; }
+
+		dwipe_result_write( &c[i] );
+		dwipe_events_state( &c[i], "finished" );
+
+		if( c[i].device_fd >= 0 )
+		{
+			close( c[i].device_fd );
+			c[i].device_fd = -1;
+		}
+
+		c[i].state = DWIPE_STATE_REPORTED;
+	}
+
+} /* dwipe_supervise_report */
+
+
+int dwipe_supervise( int count, dwipe_context_t* c, int gui )
+{
+/**
+ * Starts queued wipes and waits for events until every wipe is finished.
+ *
+ * @parameter  count  The number of contexts in the array.
+ * @parameter  c      An array of device contexts.
+ * @parameter  gui    Non-zero when the ncurses status window is running.
+ * @returns           Zero on success, or an errno value on a fatal error.
+ *
+ */
+
+	/* Generic loop variables. */
+	int i;
+	int n;
+
+	/* The result holder. */
+	int r = 0;
+
+	/* The pidfd of each context, or -1. */
+	int* pidfd;
+
+	/* Set when pidfd_open() is not available. */
+	int pidfd_missing = 0;
+
+	/* The refresh timer. */
+	int timer_fd;
+	struct itimerspec timer;
+
+	/* The signal descriptor and the signals that it catches. */
+	int signal_fd;
+	sigset_t signals;
+	struct signalfd_siginfo si;
+
+	/* The epoll registration and results. */
+	struct epoll_event ev;
+	struct epoll_event events [DWIPE_KNOB_SUPERVISE_EVENTS];
+
+	/* Set when the counters should be sampled, and when only a keystroke asks for a redraw. */
+	int refresh;
+	int render;
+
+	pidfd = malloc( count * sizeof( int ) );
+
+	if( pidfd == NULL )
+	{
+		dwipe_perror( errno, __FUNCTION__, "malloc" );
+		return errno;
+	}
+
+	for( i = 0 ; i < count ; i++ ) { pidfd[i] = -1; }
+
+	dwipe_epoll = epoll_create1( EPOLL_CLOEXEC );
+
+	if( dwipe_epoll < 0 )
+	{
+		dwipe_perror( errno, __FUNCTION__, "epoll_create1" );
+		free( pidfd );
+		return errno;
+	}
+
+	/* Take SIGCHLD, SIGINT and SIGTERM through a descriptor instead of handlers. */
+	sigemptyset( &signals );
+	sigaddset( &signals, SIGCHLD );
+	sigaddset( &signals, SIGINT  );
+	sigaddset( &signals, SIGTERM );
+	sigprocmask( SIG_BLOCK, &signals, NULL );
+
+	signal_fd = signalfd( -1, &signals, SFD_NONBLOCK | SFD_CLOEXEC );
+
+	if( signal_fd < 0 )
+	{
+		dwipe_perror( errno, __FUNCTION__, "signalfd" );
+		r = errno;
+		goto out;
+	}
+
+	ev.events   = EPOLLIN;
+	ev.data.u64 = DWIPE_SUPERVISE_DATA( DWIPE_SUPERVISE_SIGNAL, 0 );
+	epoll_ctl( dwipe_epoll, EPOLL_CTL_ADD, signal_fd, &ev );
+
+	/* Refresh the status once per DWIPE_KNOB_SLEEP. */
+	timer_fd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+
+	if( timer_fd < 0 )
+	{
+		dwipe_perror( errno, __FUNCTION__, "timerfd_create" );
+		r = errno;
+		goto out;
+	}
+
+	timer.it_interval.tv_sec  = DWIPE_KNOB_SLEEP;
+	timer.it_interval.tv_nsec = 0;
+	timer.it_value            = timer.it_interval;
+	timerfd_settime( timer_fd, 0, &timer, NULL );
+
+	ev.events   = EPOLLIN;
+	ev.data.u64 = DWIPE_SUPERVISE_DATA( DWIPE_SUPERVISE_TIMER, 0 );
+	epoll_ctl( dwipe_epoll, EPOLL_CTL_ADD, timer_fd, &ev );
+
+	if( gui )
+	{
+		/* Keystrokes are read when the terminal is readable, so never block in getch(). */
+		nodelay( stdscr, TRUE );
+
+		ev.events   = EPOLLIN;
+		ev.data.u64 = DWIPE_SUPERVISE_DATA( DWIPE_SUPERVISE_STDIN, 0 );
+		epoll_ctl( dwipe_epoll, EPOLL_CTL_ADD, STDIN_FILENO, &ev );
+	}
+
+	for( i = 0 ; i < dwipe_watch_count ; i++ )
+	{
+		if( dwipe_watches[i].fd < 0 ) { continue; }
+
+		ev.events   = EPOLLIN;
+		ev.data.u64 = DWIPE_SUPERVISE_DATA( DWIPE_SUPERVISE_WATCH, i );
+		epoll_ctl( dwipe_epoll, EPOLL_CTL_ADD, dwipe_watches[i].fd, &ev );
+	}
+
+	/* A station or a controlled daemon runs until it is told to stop, even when it is idle. */
+	while( dwipe_schedule_pending( count, c ) > 0
+	       || ( ( dwipe_options.station || ( dwipe_options.headless && dwipe_options.control ) ) && ! dwipe_supervise_stopping ) )
+	{
+		/* Start queued devices that their groups can admit. */
+		dwipe_schedule_dispatch( count, c );
+
+		/* Watch the children that have just been started. */
+		for( i = 0 ; i < count ; i++ )
+		{
+			if( c[i].state != DWIPE_STATE_RUNNING || pidfd[i] >= 0 || pidfd_missing ) { continue; }
+
+			pidfd[i] = dwipe_supervise_pidfd( c[i].pid );
+
+			if( pidfd[i] < 0 )
+			{
+				dwipe_log( DWIPE_LOG_NOTICE, "pidfd_open() is not available, so SIGCHLD is used to reap children." );
+				pidfd_missing = 1;
+				continue;
+			}
+
+			ev.events   = EPOLLIN;
+			ev.data.u64 = DWIPE_SUPERVISE_DATA( DWIPE_SUPERVISE_CHILD, i );
+			epoll_ctl( dwipe_epoll, EPOLL_CTL_ADD, pidfd[i], &ev );
+
+			/* The child may have exited before we opened the descriptor. */
+			if( dwipe_supervise_reap( &c[i] ) != 0 )
+			{
+				epoll_ctl( dwipe_epoll, EPOLL_CTL_DEL, pidfd[i], NULL );
+				close( pidfd[i] );
+				pidfd[i] = -1;
+			}
+		}
+
+		n = epoll_wait( dwipe_epoll, events, DWIPE_KNOB_SUPERVISE_EVENTS, -1 );
+
+		if( n < 0 )
+		{
+			if( errno == EINTR ) { continue; }
+
+			dwipe_perror( errno, __FUNCTION__, "epoll_wait" );
+			r = errno;
+			break;
+		}
+
+		refresh = 0;
+		render  = 0;
+
+		for( i = 0 ; i < n ; i++ )
+		{
+			/* The index part of the event data. */
+			int k = (uint32_t)( events[i].data.u64 );
+
+			switch( events[i].data.u64 >> 32 )
+			{
+				case DWIPE_SUPERVISE_CHILD:
+
+					if( pidfd[k] < 0 ) { break; }
+
+					if( dwipe_supervise_reap( &c[k] ) != 0 )
+					{
+						epoll_ctl( dwipe_epoll, EPOLL_CTL_DEL, pidfd[k], NULL );
+						close( pidfd[k] );
+						pidfd[k] = -1;
+						refresh = 1;
+					}
+
+					break;
+
+				case DWIPE_SUPERVISE_SIGNAL:
+
+					while( read( signal_fd, &si, sizeof( si ) ) == sizeof( si ) )
+					{
+						if( si.ssi_signo == SIGINT || si.ssi_signo == SIGTERM )
+						{
+							dwipe_supervise_cancel( count, c, si.ssi_signo );
+						}
+					}
+
+					if( pidfd_missing )
+					{
+						/* Without pidfds, any child may be the one that exited. */
+						for( k = 0 ; k < count ; k++ )
+						{
+							if( c[k].state == DWIPE_STATE_RUNNING && pidfd[k] < 0 )
+							{
+								dwipe_supervise_reap( &c[k] );
+							}
+						}
+					}
+
+					refresh = 1;
+					break;
+
+				case DWIPE_SUPERVISE_TIMER:
+				{
+					/* The number of expirations. */
+					uint64_t ticks;
+
+					if( read( timer_fd, &ticks, sizeof( ticks ) ) < 0 ) { /* Spurious wakeup. */ }
+
+					refresh = 1;
+					break;
+				}
+
+				case DWIPE_SUPERVISE_STDIN:
+
+					/* dwipe_gui_status() reads the keystroke, and a keystroke needs no new samples. */
+					render = 1;
+					break;
+
+				case DWIPE_SUPERVISE_WATCH:
+
+					/* An earlier handler in this batch may have dropped the watch. */
+					if( dwipe_watches[k].fd < 0 ) { break; }
+
+					dwipe_watches[k].handler( dwipe_watches[k].fd, dwipe_watches[k].arg );
+					break;
+			}
+		}
+
+		if( refresh )
+		{
+			/* Copy the published counters so that dispatch sees fresh rates. */
+			dwipe_progress_sample( count, c );
+			dwipe_peer_check( count, c );
+			dwipe_events_drain( count, c );
+			dwipe_events_sample( count, c );
+			dwipe_metrics_tick();
+		}
+
+		if( gui && ( refresh || render ) )
+		{
+			/* Show the user what is happening.  The screen paces its own redraws. */
+			dwipe_gui_status( count, c );
+		}
+
+		/* Write the results of the wipes that have finished. */
+		dwipe_supervise_report( count, c );
+
+		/* Hand the events of this wakeup to the reader in one batch. */
+		dwipe_events_flush();
+
+	} /* while */
+
+	/* Pick up the last counters that the children published. */
+	dwipe_progress_sample( count, c );
+	dwipe_supervise_report( count, c );
+	dwipe_events_flush();
+
+	if( gui )
+	{
+		/* Show the final state and restore the terminal mode that main() expects. */
+		dwipe_gui_invalidate();
+		dwipe_gui_status( count, c );
+		nodelay( stdscr, FALSE );
+		halfdelay( DWIPE_KNOB_SLEEP * 10 );
+	}
+
+	close( timer_fd );
+
+out:
+	for( i = 0 ; i < count ; i++ )
+	{
+		if( pidfd[i] >= 0 ) { close( pidfd[i] ); }
+	}
+
+	if( signal_fd >= 0 ) { close( signal_fd ); }
+
+	close( dwipe_epoll );
+	dwipe_epoll = -1;
+
+	free( pidfd );
+
+	sigprocmask( SIG_UNBLOCK, &signals, NULL );
+
+	return r;
+
+} /* dwipe_supervise */
+
+/* eof */
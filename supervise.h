@@ -0,0 +1,39 @@
+/*
+ *  supervise.h: The event loop that supervises wipe processes.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef SUPERVISE_H_
+#define SUPERVISE_H_
+
+/* The maximum number of extra file descriptors that other modules can watch. */
+#define DWIPE_KNOB_SUPERVISE_WATCHES  16
+
+/* The maximum number of events that are handled per wakeup. */
+#define DWIPE_KNOB_SUPERVISE_EVENTS   64
+
+/* The callback for a watched file descriptor. */
+typedef void(*dwipe_watch_t)( int fd, void* arg );
+
+int  dwipe_supervise_watch( int fd, dwipe_watch_t handler, void* arg );  /* Watch an extra descriptor.        */
+void dwipe_supervise_unwatch( int fd );                                  /* Stop watching a descriptor.       */
+void dwipe_supervise_cancel( int count, dwipe_context_t* c, int sig );   /* Stop every wipe and then the loop. */
+int  dwipe_supervise( int count, dwipe_context_t* c, int gui );          /* Run until every wipe is finished. */
+
+#endif /* SUPERVISE_H_ */
+
+/* eof */
@@ -0,0 +1,312 @@
+/*
+ *  throttle.c: I/O rate limiting for wipe processes.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+/* RATIONALE:
+ *
+ *   Some wipes run on shared SAN LUNs and hypervisors, where an unthrottled
+ *   wipe starves production.  Bandwidth is capped at three levels: each
+ *   device, each host adapter and bus group, and the whole station.  Every
+ *   cap is a token bucket in the GCRA form, which is one theoretical
+ *   arrival time per bucket: an i/o pushes it forward by the time that its
+ *   bytes take at the cap, and the child sleeps until the latest of the
+ *   times of its buckets.  An idle bucket banks at most
+ *   DWIPE_KNOB_THROTTLE_BURST of credit, so a cap that is lowered takes
+ *   effect at once.
+ *
+ *   The device cap lives in the progress slot and only its child uses the
+ *   arrival time.  The group and station buckets live in a shared segment,
+ *   and the children of a group move their arrival time with compare and
+ *   swap, so that the sum of their rates stays under the cap.  The parent
+ *   only writes the rates, which the children read after every i/o.
+ *
+ *   The time that a child sleeps is published separately from the time that
+ *   it waits on the device, so that the estimate of the remaining runtime
+ *   can tell a slow drive from a capped one.
+ *
+ */
+
+#include "dwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "logging.h"
+#include "progress.h"
+#include "schedule.h"
+#include "throttle.h"
+
+
+/* When the device of the child may do its next i/o.  Each child has its own copy. */
+static u64 dwipe_throttle_next = 0;
+
+/* The station bucket, followed by one bucket per scheduler group. */
+static dwipe_bucket_t* dwipe_throttle_buckets = NULL;
+static int             dwipe_throttle_count   = 0;
+
+
+int dwipe_throttle_init( int count, dwipe_context_t* c )
+{
+/**
+ * Allocates the station and group buckets and applies the caps that were
+ * given on the command line.  A group has at least one device, so there
+ * can be no more groups than contexts.
+ *
+ * @parameter count  The number of contexts in the array.
+ * @parameter c      An array of device contexts.
+ * @return           0 on success, -1 on failure.
+ *
+ */
+
+	/* Generic loop variable. */
+	int i;
+
+	dwipe_throttle_buckets = dwipe_shm_alloc( ( count + 1 ) * sizeof( dwipe_bucket_t ) );
+
+	if( dwipe_throttle_buckets == NULL )
+	{
+		dwipe_log( DWIPE_LOG_FATAL, "Unable to allocate shared memory for the rate limits." );
+		return -1;
+	}
+
+	dwipe_throttle_count = count + 1;
+
+	if( dwipe_options.rate_station > 0 ) { dwipe_throttle_station( dwipe_options.rate_station ); }
+
+	for( i = 0 ; i < count ; i++ )
+	{
+		if( dwipe_options.rate_group  > 0 ) { dwipe_throttle_group( i, dwipe_options.rate_group ); }
+		if( dwipe_options.rate_device > 0 && c[i].device_name != NULL ) { dwipe_throttle_set( &c[i], dwipe_options.rate_device ); }
+	}
+
+	return 0;
+
+} /* dwipe_throttle_init */
+
+
+static dwipe_bucket_t* dwipe_throttle_bucket( int group )
+{
+/**
+ * Returns the bucket of a scheduler group, or the station bucket for -1.
+ *
+ */
+
+	if( dwipe_throttle_buckets == NULL || group + 1 >= dwipe_throttle_count ) { return NULL; }
+
+	return &dwipe_throttle_buckets[ group + 1 ];
+
+} /* dwipe_throttle_bucket */
+
+
+static u64 dwipe_throttle_take( u64* tat, u64 rate, u64 bytes, u64 now )
+{
+/**
+ * Takes bytes from a bucket.
+ *
+ * @return  The time at which the i/o conforms to the rate.
+ *
+ */
+
+	/* The arrival times before and after this i/o. */
+	u64 t = __atomic_load_n( tat, __ATOMIC_RELAXED );
+	u64 n;
+
+	do
+	{
+		/* Credit from an idle spell is capped at the burst. */
+		n = t + DWIPE_KNOB_THROTTLE_BURST < now ? now - DWIPE_KNOB_THROTTLE_BURST : t;
+		n += bytes * 1000000000 / rate;
+
+	} while( ! __atomic_compare_exchange_n( tat, &t, n, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) );
+
+	return n;
+
+} /* dwipe_throttle_take */
+
+
+void dwipe_throttle( dwipe_context_t* c, u64 bytes )
+{
+/**
+ * Sleeps long enough to keep the device, its group and the station under
+ * their rate limits.  Only the child of c may call this.
+ *
+ * @parameter c      The device context.
+ * @parameter bytes  The number of bytes of the i/o that has just finished.
+ *
+ */
+
+	/* The rate limit in bytes per second, or zero. */
+	u64 rate = __atomic_load_n( &c->progress->rate_limit, __ATOMIC_RELAXED );
+
+	/* The buckets that the device shares. */
+	dwipe_bucket_t* b[2];
+
+	/* The current time, and when the i/o conforms to every cap. */
+	u64 now;
+	u64 wake;
+	u64 t;
+
+	/* The time to sleep. */
+	struct timespec ts;
+
+	/* A generic loop variable. */
+	int i;
+
+	b[0] = dwipe_throttle_bucket( -1 );
+	b[1] = c->group >= 0 ? dwipe_throttle_bucket( c->group ) : NULL;
+
+	now  = dwipe_progress_clock();
+	wake = now;
+
+	if( rate > 0 )
+	{
+		wake = dwipe_throttle_take( &dwipe_throttle_next, rate, bytes, now );
+	}
+
+	for( i = 0 ; i < 2 ; i++ )
+	{
+		if( b[i] == NULL ) { continue; }
+
+		rate = __atomic_load_n( &b[i]->rate, __ATOMIC_RELAXED );
+
+		if( rate == 0 ) { continue; }
+
+		t = dwipe_throttle_take( &b[i]->tat, rate, bytes, now );
+		if( t > wake ) { wake = t; }
+	}
+
+	if( wake <= now ) { return; }
+
+	ts.tv_sec  = ( wake - now ) / 1000000000;
+	ts.tv_nsec = ( wake - now ) % 1000000000;
+	nanosleep( &ts, NULL );
+
+	/* The parent needs to know how much of the runtime was ours and not the device's. */
+	dwipe_progress_count( c, &c->progress->throttle_ns, wake - now );
+
+} /* dwipe_throttle */
+
+
+void dwipe_throttle_set( dwipe_context_t* c, u64 rate_limit )
+{
+/**
+ * Changes the rate limit of a device.  Its child picks it up after its next i/o.
+ *
+ * @parameter c           The device context.
+ * @parameter rate_limit  The limit in bytes per second, or zero for none.
+ *
+ */
+
+	__atomic_store_n( &c->progress->rate_limit, rate_limit, __ATOMIC_RELAXED );
+
+	dwipe_log( DWIPE_LOG_NOTICE, "Rate limit of '%s' set to %llu B/s.", c->device_name, rate_limit );
+
+} /* dwipe_throttle_set */
+
+
+void dwipe_throttle_group( int group, u64 rate_limit )
+{
+/**
+ * Changes the combined rate limit of the devices in one scheduler group.
+ *
+ * @parameter group       The index of the group.
+ * @parameter rate_limit  The limit in bytes per second, or zero for none.
+ *
+ */
+
+	/* The bucket of the group. */
+	dwipe_bucket_t* b = dwipe_throttle_bucket( group );
+
+	if( b == NULL ) { return; }
+
+	__atomic_store_n( &b->rate, rate_limit, __ATOMIC_RELAXED );
+
+} /* dwipe_throttle_group */
+
+
+void dwipe_throttle_station( u64 rate_limit )
+{
+/**
+ * Changes the combined rate limit of every device.
+ *
+ * @parameter rate_limit  The limit in bytes per second, or zero for none.
+ *
+ */
+
+	/* The station bucket. */
+	dwipe_bucket_t* b = dwipe_throttle_bucket( -1 );
+
+	if( b == NULL ) { return; }
+
+	__atomic_store_n( &b->rate, rate_limit, __ATOMIC_RELAXED );
+
+	dwipe_log( DWIPE_LOG_NOTICE, "Rate limit of the station set to %llu B/s.", rate_limit );
+
+} /* dwipe_throttle_station */
+
+
+u64 dwipe_throttle_cap( dwipe_context_t* c, u64 rate )
+{
+/**
+ * Lowers the rate that a device manages while it is not asleep in the
+ * throttle to its fair share of the caps that apply now.  A cap that is
+ * lifted therefore shortens an estimate at once, instead of after the
+ * moving averages have forgotten the throttled samples.
+ *
+ * @parameter c     The device context.
+ * @parameter rate  Bytes per second that the device could move without caps.
+ * @return          Bytes per second, never zero.
+ *
+ */
+
+	/* The fair share of one cap. */
+	u64 cap;
+
+	/* The bucket of the group. */
+	dwipe_bucket_t* b;
+
+	/* The number of running wipes on the station. */
+	int active = 0;
+
+	/* A generic loop variable. */
+	int i;
+
+	cap = __atomic_load_n( &c->progress->rate_limit, __ATOMIC_RELAXED );
+	if( cap > 0 && cap < rate ) { rate = cap; }
+
+	if( c->group >= 0 && c->group < dwipe_group_count && ( b = dwipe_throttle_bucket( c->group ) ) != NULL )
+	{
+		cap = __atomic_load_n( &b->rate, __ATOMIC_RELAXED );
+		if( cap > 0 && dwipe_groups[ c->group ].active > 0 ) { cap /= dwipe_groups[ c->group ].active; }
+		if( cap > 0 && cap < rate ) { rate = cap; }
+	}
+
+	if( ( b = dwipe_throttle_bucket( -1 ) ) != NULL )
+	{
+		for( i = 0 ; i < dwipe_group_count ; i++ ) { active += dwipe_groups[i].active; }
+
+		cap = __atomic_load_n( &b->rate, __ATOMIC_RELAXED );
+		if( cap > 0 && active > 0 ) { cap /= active; }
+		if( cap > 0 && cap < rate ) { rate = cap; }
+	}
+
+	return rate > 0 ? rate : 1;
+
+} /* dwipe_throttle_cap */
+
+/* eof */
@@ -0,0 +1,42 @@
+/*
+ *  throttle.h: I/O rate limiting for wipe processes.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef THROTTLE_H_
+#define THROTTLE_H_
+
+/* The nanoseconds of credit that an idle bucket may bank, which allows a short burst. */
+#define DWIPE_KNOB_THROTTLE_BURST  100000000
+
+/* A token bucket that several children share.  Children only move the arrival time. */
+typedef struct /* dwipe_bucket_t */
+{
+	u64 rate;  /* Bytes per second, or zero for no limit.  The parent writes this. */
+	u64 tat;   /* The CLOCK_MONOTONIC nanoseconds at which the bucket is next empty.  */
+} __attribute__(( aligned( DWIPE_KNOB_CACHELINE ) )) dwipe_bucket_t;
+
+int  dwipe_throttle_init( int count, dwipe_context_t* c );     /* Allocate the shared buckets.    */
+void dwipe_throttle( dwipe_context_t* c, u64 bytes );          /* Pace a child after an i/o.      */
+void dwipe_throttle_set( dwipe_context_t* c, u64 rate_limit );  /* Change the rate of one device.  */
+void dwipe_throttle_group( int group, u64 rate_limit );         /* Change the rate of one group.   */
+void dwipe_throttle_station( u64 rate_limit );                  /* Change the rate of the station. */
+u64  dwipe_throttle_cap( dwipe_context_t* c, u64 rate );       /* Hold a rate to the caps.        */
+
+#endif /* THROTTLE_H_ */
+
+/* eof */
@@ -0,0 +1,337 @@
+/*
+ *  tune.c: Timing the block size of each model of drive.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+/* RATIONALE:
+ *
+ *   The queue limits give a granule for the blocks of a pass, but not the
+ *   block size that a USB bridge, a SATA drive or an NVMe drive is fastest
+ *   with, and one global value is wrong for most of them.  With --autotune
+ *   the child times buffered writes of DWIPE_KNOB_TUNE_BYTES at block sizes
+ *   from DWIPE_KNOB_TUNE_MIN upward, each a multiple of the granule, before
+ *   the first pass.  The writes go to the start of the area that the first
+ *   pass overwrites anyway, and each timing ends with an fdatasync() so that
+ *   it measures the drive rather than the page cache.  The fastest size
+ *   replaces the geometry when it wins by DWIPE_KNOB_TUNE_MARGIN percent.
+ *
+ *   The winner is appended to --tune-cache under the label of the drive,
+ *   which holds its vendor, model and firmware revision, so that the next
+ *   drive of the same model skips the timing.  The file is only appended to
+ *   under flock(), and the last line of a model wins.  A wipe that resumes
+ *   from a checkpoint uses the cache but does not time, because its first
+ *   pass may already be done.
+ *
+ *   Passes issue one request at a time, so the block size is the only thing
+ *   to tune; the number of requests that a block puts in the queue follows
+ *   from it.
+ *
+ */
+
+#include <ctype.h>
+#include <sys/file.h>
+
+#include "dwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "logging.h"
+#include "progress.h"
+#include "journal.h"
+#include "range.h"
+#include "geometry.h"
+#include "arena.h"
+#include "durability.h"
+#include "tune.h"
+
+
+static int dwipe_tune_key( dwipe_context_t* c, char* key, size_t size )
+{
+/**
+ * Makes the cache key of a device from its label without the padding.
+ *
+ * @return  0 on success, -1 when the device has no label to key on.
+ *
+ */
+
+	/* The ends of the label. */
+	const char* p;
+	size_t n;
+
+	if( c->label == NULL ) { return -1; }
+
+	for( p = c->label ; *p == ' ' ; p++ );
+	for( n = strlen( p ) ; n > 0 && isspace( (unsigned char) p[ n - 1 ] ) ; n-- );
+
+	if( n == 0 || n >= size ) { return -1; }
+
+	memcpy( key, p, n );
+	key[n] = 0;
+
+	return 0;
+
+} /* dwipe_tune_key */
+
+
+static size_t dwipe_tune_lookup( dwipe_context_t* c, const char* key )
+{
+/**
+ * Finds the block size that the cache holds for a model.
+ *
+ * @return  The block size, or zero when the cache has none that fits the device.
+ *
+ */
+
+	/* The cache file. */
+	FILE* fp;
+
+	/* One line of the cache, and the size and the model in it. */
+	char line [512];
+	size_t size;
+	int n;
+
+	/* The last size of the model. */
+	size_t found = 0;
+
+	fp = fopen( dwipe_options.tune_cache, "r" );
+	if( fp == NULL ) { return 0; }
+
+	while( fgets( line, sizeof( line ), fp ) != NULL )
+	{
+		line[ strcspn( line, "\n" ) ] = 0;
+
+		if( sscanf( line, "%zu %n", &size, &n ) == 1 && strcmp( line + n, key ) == 0 ) { found = size; }
+	}
+
+	fclose( fp );
+
+	/* A size from another kernel or another geometry may not fit this one. */
+	if( found == 0 || found % c->io_unit != 0 ) { return 0; }
+	if( found > DWIPE_KNOB_GEOMETRY_CHUNK_MAX && found != c->io_unit ) { return 0; }
+
+	return found;
+
+} /* dwipe_tune_lookup */
+
+
+static void dwipe_tune_store( const char* key, size_t size )
+{
+/**
+ * Appends the block size of a model to the cache.
+ *
+ */
+
+	/* The cache file. */
+	FILE* fp;
+
+	fp = fopen( dwipe_options.tune_cache, "a" );
+
+	if( fp == NULL )
+	{
+		dwipe_perror( errno, __FUNCTION__, "fopen" );
+		dwipe_log( DWIPE_LOG_WARNING, "Unable to write the tuning cache '%s'.", dwipe_options.tune_cache );
+		return;
+	}
+
+	/* The children of other drives may append at the same time. */
+	flock( fileno( fp ), LOCK_EX );
+	fprintf( fp, "%zu %s\n", size, key );
+	fflush( fp );
+	flock( fileno( fp ), LOCK_UN );
+
+	fclose( fp );
+
+} /* dwipe_tune_store */
+
+
+static u64 dwipe_tune_time( dwipe_context_t* c, const char* buffer, size_t blocksize, u64 area )
+{
+/**
+ * Writes the start of the first pass in blocks of one size.
+ *
+ * @return  The throughput in bytes per second, or zero on an i/o error.
+ *
+ */
+
+	/* The clock when the timing started. */
+	u64 t;
+
+	/* The position in the pass, and the size and place of the working block. */
+	u64 p;
+	size_t n;
+	u64 offset;
+
+	t = dwipe_progress_clock();
+
+	for( p = 0 ; p < area ; p += n )
+	{
+		n = ( blocksize < area - p ) ? blocksize : area - p;
+		offset = dwipe_range_map( c, p, &n );
+
+		if( n == 0 || dwipe_durability_pwrite( c, buffer, n, offset ) != n ) { return 0; }
+	}
+
+	if( fdatasync( c->device_fd ) != 0 ) { return 0; }
+
+	t = dwipe_progress_clock() - t;
+
+	return ( t > 0 ) ? area * 1000000000ULL / t : 0;
+
+} /* dwipe_tune_time */
+
+
+int dwipe_tune( dwipe_context_t* c )
+{
+/**
+ * Chooses the block size of a device from the cache, or by timing it.  The
+ * child calls this before the first pass.
+ *
+ * @parameter  c           The device context.
+ * @modifies   c->io_size  The block size that the passes use.
+ * @modifies   c->io_depth The requests that one block puts in the queue.
+ * @return                 0, because the geometry is kept when the timing fails.
+ *
+ */
+
+	/* The cache key of the device. */
+	char key [256];
+
+	/* The bytes that each timing writes. */
+	u64 area;
+
+	/* The block sizes that are timed, and the largest of them. */
+	size_t sizes [32];
+	size_t largest = 0;
+	int count = 0;
+
+	/* The throughput of the geometry and of the fastest size. */
+	u64 base;
+	u64 best;
+	size_t best_size;
+
+	/* The throughput of the working size. */
+	u64 rate;
+
+	/* The data that is written, and the state that fills it. */
+	char* buffer;
+	u64 x;
+
+	/* The block size that is aimed for. */
+	u64 target;
+	size_t size;
+
+	/* Generic loop variable. */
+	int i;
+
+	if( ! dwipe_options.autotune || c->io_unit == 0 ) { return 0; }
+
+	if( dwipe_tune_key( c, key, sizeof( key ) ) != 0 ) { key[0] = 0; }
+
+	size = ( key[0] != 0 ) ? dwipe_tune_lookup( c, key ) : 0;
+
+	if( size > 0 )
+	{
+		dwipe_log( DWIPE_LOG_NOTICE, "Device '%s' uses the tuned block size %zu of '%s'.", c->device_name, size, key );
+		goto done;
+	}
+
+	/* The first pass of a resumed wipe may be done, so its area cannot be written. */
+	if( c->journal != NULL && c->journal->resume ) { return 0; }
+
+	area = ( c->wipe_size < DWIPE_KNOB_TUNE_BYTES ) ? c->wipe_size : DWIPE_KNOB_TUNE_BYTES;
+
+	for( target = DWIPE_KNOB_TUNE_MIN ; target * DWIPE_KNOB_TUNE_BLOCKS <= area && target <= DWIPE_KNOB_GEOMETRY_CHUNK_MAX ; target *= 2 )
+	{
+		size = ( target + c->io_unit / 2 ) / c->io_unit * c->io_unit;
+		if( size < c->io_unit ) { size = c->io_unit; }
+
+		if( count > 0 && sizes[ count - 1 ] == size ) { continue; }
+		if( count == sizeof( sizes ) / sizeof( sizes[0] ) ) { break; }
+
+		sizes[ count++ ] = size;
+		if( size > largest ) { largest = size; }
+	}
+
+	if( count < 2 )
+	{
+		dwipe_log( DWIPE_LOG_INFO, "Device '%s' is too small to tune.", c->device_name );
+		return 0;
+	}
+
+	if( c->io_size > largest ) { largest = c->io_size; }
+
+	/* Aligned, so that the fua policy can time direct writes. */
+	if( posix_memalign( (void**) &buffer, DWIPE_KNOB_ARENA_ALIGN, largest ) != 0 )
+	{
+		dwipe_perror( ENOMEM, __FUNCTION__, "posix_memalign" );
+		return 0;
+	}
+
+	/* Incompressible data, so that a drive that compresses is timed fairly. */
+	for( x = dwipe_progress_clock() | 1, i = 0 ; i + sizeof( x ) <= largest ; i += sizeof( x ) )
+	{
+		x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+		memcpy( buffer + i, &x, sizeof( x ) );
+	}
+
+	/* The first timing wakes the drive up and is thrown away. */
+	dwipe_tune_time( c, buffer, c->io_size, area );
+
+	base      = dwipe_tune_time( c, buffer, c->io_size, area );
+	best      = base;
+	best_size = c->io_size;
+
+	for( i = 0 ; i < count && base > 0 ; i++ )
+	{
+		if( sizes[i] == c->io_size ) { continue; }
+
+		rate = dwipe_tune_time( c, buffer, sizes[i], area );
+		if( rate == 0 ) { base = 0; break; }
+
+		dwipe_log( DWIPE_LOG_INFO, "Device '%s' writes blocks of %zu at %llu MB/s.", c->device_name, sizes[i], rate / 1000000 );
+
+		if( rate > best ) { best = rate; best_size = sizes[i]; }
+	}
+
+	free( buffer );
+
+	if( base == 0 )
+	{
+		dwipe_log( DWIPE_LOG_WARNING, "Device '%s' failed a tuning write and keeps blocks of %zu.", c->device_name, c->io_size );
+		return 0;
+	}
+
+	if( best * 100 < base * ( 100 + DWIPE_KNOB_TUNE_MARGIN ) ) { best_size = c->io_size; }
+
+	dwipe_log( DWIPE_LOG_NOTICE, "Device '%s' writes blocks of %zu at %llu MB/s and is tuned to blocks of %zu at %llu MB/s.", \
+	  c->device_name, c->io_size, base / 1000000, best_size, ( best_size == c->io_size ? base : best ) / 1000000 );
+
+	size = best_size;
+
+	if( key[0] != 0 ) { dwipe_tune_store( key, size ); }
+
+done:
+	/* The queue depth grows with the block. */
+	c->io_depth = ( (u64) c->io_depth * size + c->io_size - 1 ) / c->io_size;
+	c->io_size  = size;
+
+	return 0;
+
+} /* dwipe_tune */
+
+/* eof */
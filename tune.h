@@ -0,0 +1,42 @@
+/*
+ *  tune.h: Timing the block size of each model of drive.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef TUNE_H_
+#define TUNE_H_
+
+/* The file that remembers the tuned block size of each model. */
+#define DWIPE_KNOB_TUNE_CACHE   "/var/log/dban/dwipe.tune"
+
+/* The bytes that are written to time each block size. */
+#define DWIPE_KNOB_TUNE_BYTES   ( 32 << 20 )
+
+/* The fewest blocks of one size that a timing writes. */
+#define DWIPE_KNOB_TUNE_BLOCKS  4
+
+/* The smallest block size that is timed. */
+#define DWIPE_KNOB_TUNE_MIN     ( 256 << 10 )
+
+/* The percentage by which a block size must beat the geometry to replace it. */
+#define DWIPE_KNOB_TUNE_MARGIN  5
+
+int dwipe_tune( dwipe_context_t* c );  /* Choose the block size of a device by timing it. */
+
+#endif /* TUNE_H_ */
+
+/* eof */
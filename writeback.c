@@ -0,0 +1,245 @@
+/*
+ *  writeback.c: Rolling writeback of buffered passes.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+/* RATIONALE:
+ *
+ *   A buffered pass used to dirty gigabytes of page cache per drive and
+ *   flush it all with the fdatasync() at its end.  The interface then sat on
+ *   "[syncing]" for minutes, the progress counters ran far ahead of what was
+ *   on the media, and the dirty pages squeezed every other drive.
+ *
+ *   Now the written blocks are gathered into windows of --writeback-window
+ *   megabytes.  When a window fills, sync_file_range() starts its writeback
+ *   without waiting, and the window before it, whose writeback has had a
+ *   whole window of time to run, is waited for and dropped from the cache
+ *   with posix_fadvise().  So at most two windows of a device are dirty or
+ *   in flight, the counters run at most that far ahead of the media, and the
+ *   fdatasync() at the end of a pass only has the last window left to do.
+ *
+ *   A verification drops the blocks that it has read in the same way, so
+ *   that it does not fill the cache with data that is never read again.
+ *
+ *   The time spent waiting on windows is counted as sync time.  A device
+ *   that does not support sync_file_range() is written as before.
+ *
+ */
+
+#include "dwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "logging.h"
+#include "progress.h"
+#include "writeback.h"
+
+
+/* The window that the pass is filling, as device offsets. */
+static u64 dwipe_writeback_fill_start = 0;
+static u64 dwipe_writeback_fill_end   = 0;
+
+/* The window that is being written back. */
+static u64 dwipe_writeback_trail_start = 0;
+static u64 dwipe_writeback_trail_end   = 0;
+
+/* Set when the device does not support rolling writeback. */
+static int dwipe_writeback_disabled = 0;
+
+/* Set when the pass had a writeback failure. */
+static int dwipe_writeback_failed = 0;
+
+
+static int dwipe_writeback_range( dwipe_context_t* c, u64 start, u64 end, unsigned int flags )
+{
+/**
+ * Runs sync_file_range() on a window and handles its failure.
+ *
+ * @return  0 on success, -1 on failure.
+ *
+ */
+
+	if( sync_file_range( c->device_fd, start, end - start, flags ) == 0 ) { return 0; }
+
+	if( errno == EINVAL || errno == ESPIPE || errno == ENOSYS )
+	{
+		/* The final fdatasync() does the whole job instead. */
+		dwipe_log( DWIPE_LOG_INFO, "Device '%s' does not support rolling writeback.", c->device_name );
+		dwipe_writeback_disabled = 1;
+		return -1;
+	}
+
+	dwipe_perror( errno, __FUNCTION__, "sync_file_range" );
+	dwipe_log( DWIPE_LOG_ERROR, "Writeback failure on '%s' between %llu and %llu.", c->device_name, start, end );
+	dwipe_writeback_failed = 1;
+
+	return -1;
+
+} /* dwipe_writeback_range */
+
+
+static void dwipe_writeback_wait( dwipe_context_t* c )
+{
+/**
+ * Waits until the trailing window is on the media and drops it from the cache.
+ *
+ */
+
+	/* The clock when the wait started. */
+	u64 t;
+
+	if( dwipe_writeback_trail_end == dwipe_writeback_trail_start ) { return; }
+
+	t = dwipe_progress_clock();
+
+	if( dwipe_writeback_range( c, dwipe_writeback_trail_start, dwipe_writeback_trail_end, \
+	    SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER ) == 0 )
+	{
+		posix_fadvise( c->device_fd, dwipe_writeback_trail_start, \
+		  dwipe_writeback_trail_end - dwipe_writeback_trail_start, POSIX_FADV_DONTNEED );
+	}
+
+	dwipe_progress_count( c, &c->progress->sync_ns, dwipe_progress_clock() - t );
+
+	dwipe_writeback_trail_start = 0;
+	dwipe_writeback_trail_end   = 0;
+
+} /* dwipe_writeback_wait */
+
+
+static void dwipe_writeback_kick( dwipe_context_t* c )
+{
+/**
+ * Retires the trailing window and starts the writeback of the filled one.
+ *
+ */
+
+	dwipe_writeback_wait( c );
+
+	if( dwipe_writeback_fill_end == dwipe_writeback_fill_start ) { return; }
+
+	if( ! dwipe_writeback_disabled )
+	{
+		/* This only queues the dirty pages and does not wait for them. */
+		dwipe_writeback_range( c, dwipe_writeback_fill_start, dwipe_writeback_fill_end, SYNC_FILE_RANGE_WRITE );
+	}
+
+	dwipe_writeback_trail_start = dwipe_writeback_fill_start;
+	dwipe_writeback_trail_end   = dwipe_writeback_fill_end;
+	dwipe_writeback_fill_start  = 0;
+	dwipe_writeback_fill_end    = 0;
+
+} /* dwipe_writeback_kick */
+
+
+void dwipe_writeback_start( dwipe_context_t* c )
+{
+/**
+ * Forgets the windows of the previous pass.
+ *
+ */
+
+	dwipe_writeback_fill_start  = 0;
+	dwipe_writeback_fill_end    = 0;
+	dwipe_writeback_trail_start = 0;
+	dwipe_writeback_trail_end   = 0;
+	dwipe_writeback_failed      = 0;
+
+} /* dwipe_writeback_start */
+
+
+void dwipe_writeback_write( dwipe_context_t* c, u64 offset, size_t count )
+{
+/**
+ * Adds a written block to the working window, and moves the windows on
+ * when it is full.
+ *
+ * @parameter offset  The offset of the block on the device.
+ * @parameter count   The bytes that were written.
+ *
+ */
+
+	if( dwipe_options.writeback_window == 0 || dwipe_writeback_disabled || count == 0 ) { return; }
+
+	/* Without a flush there is nothing to roll, and synchronous writes leave nothing dirty. */
+	if( dwipe_options.sync != DWIPE_SYNC_PASS && dwipe_options.sync != DWIPE_SYNC_PERIODIC ) { return; }
+
+	/* A window is one extent, so a jump to the next range closes it. */
+	if( dwipe_writeback_fill_end != dwipe_writeback_fill_start && offset != dwipe_writeback_fill_end )
+	{
+		dwipe_writeback_kick( c );
+	}
+
+	if( dwipe_writeback_fill_end == dwipe_writeback_fill_start )
+	{
+		dwipe_writeback_fill_start = offset;
+		dwipe_writeback_fill_end   = offset;
+	}
+
+	dwipe_writeback_fill_end += count;
+
+	if( dwipe_writeback_fill_end - dwipe_writeback_fill_start >= (u64) dwipe_options.writeback_window << 20 )
+	{
+		dwipe_writeback_kick( c );
+	}
+
+} /* dwipe_writeback_write */
+
+
+void dwipe_writeback_read( dwipe_context_t* c, u64 offset, size_t count )
+{
+/**
+ * Drops a block that a verification has read from the cache.
+ *
+ */
+
+	if( dwipe_options.writeback_window == 0 || count == 0 ) { return; }
+
+	posix_fadvise( c->device_fd, offset, count, POSIX_FADV_DONTNEED );
+
+} /* dwipe_writeback_read */
+
+
+int dwipe_writeback_finish( dwipe_context_t* c )
+{
+/**
+ * Waits for the windows of a pass, so that its final fdatasync() has
+ * little left to do.
+ *
+ * @return  0 on success, -1 when a window failed to reach the media.
+ *
+ */
+
+	/* The result of the pass. */
+	int r;
+
+	if( dwipe_options.writeback_window > 0 && ! dwipe_writeback_disabled )
+	{
+		dwipe_writeback_kick( c );
+		dwipe_writeback_wait( c );
+	}
+
+	r = dwipe_writeback_failed ? -1 : 0;
+
+	dwipe_writeback_start( c );
+
+	return r;
+
+} /* dwipe_writeback_finish */
+
+/* eof */
@@ -0,0 +1,33 @@
+/*
+ *  writeback.h: Rolling writeback of buffered passes.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc., 675 Mass
+ *  Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef WRITEBACK_H_
+#define WRITEBACK_H_
+
+/* The default megabytes of a pass that are written back at a time. */
+#define DWIPE_KNOB_WRITEBACK_WINDOW  64
+
+void dwipe_writeback_start( dwipe_context_t* c );                      /* Begin a pass.               */
+void dwipe_writeback_write( dwipe_context_t* c, u64 offset, size_t count );  /* Account a written block. */
+void dwipe_writeback_read( dwipe_context_t* c, u64 offset, size_t count );   /* Drop a verified block.   */
+int  dwipe_writeback_finish( dwipe_context_t* c );                     /* Wait for the last windows.  */
+
+#endif /* WRITEBACK_H_ */
+
+/* eof */